@@ -0,0 +1,100 @@
+#! /usr/bin/env python3
+
+# Throughput of pypbc.bls against the same scheme composed in Python from Element and
+# Pairing operations. Run with: python3 benchmarks/bls.py [count]
+
+import hashlib
+import sys
+import time
+
+from pypbc import *
+from pypbc import bls
+
+params = Parameters(
+    "type a\n"
+    "q 8780710799663312522437781984754049815806883199414208211028653399266475630880222957078625179422662221423155858769582317459277713367317481324925129998224791\n"
+    "h 12016012264891146079388821366740534204802954401251311822919615131047207289359704531102844802183906537786776\n"
+    "r 730750818665451621361119245571504901405976559617\n"
+    "exp2 159\n"
+    "exp1 107\n"
+    "sign1 1\n"
+    "sign0 1\n"
+)
+
+
+class PythonBLS:
+    # the scheme as it is usually glued together in Python
+
+    def __init__(self, pairing, generator):
+        self.pairing = pairing
+        self.generator = generator
+
+    def hash(self, message):
+        return Element.from_hash(self.pairing, G1, hashlib.sha256(message).digest())
+
+    def keygen(self):
+        sk = Element.random(self.pairing, Zr)
+        return sk, self.generator ** sk
+
+    def sign(self, sk, message):
+        return self.hash(message) ** sk
+
+    def verify(self, pk, message, signature):
+        return self.pairing.apply(signature, self.generator) == self.pairing.apply(self.hash(message), pk)
+
+    def aggregate(self, signatures):
+        result = signatures[0]
+        for signature in signatures[1:]:
+            result = result * signature
+        return result
+
+    def fast_aggregate_verify(self, pks, message, signature):
+        return self.verify(self.aggregate(pks), message, signature)
+
+    def aggregate_verify(self, pks, messages, signature):
+        product = self.pairing.apply(self.hash(messages[0]), pks[0])
+        for pk, message in zip(pks[1:], messages[1:]):
+            product = product * self.pairing.apply(self.hash(message), pk)
+        return self.pairing.apply(signature, self.generator) == product
+
+
+def rate(label, count, function):
+    start = time.perf_counter()
+    function()
+    elapsed = time.perf_counter() - start
+    print(f"  {label:<24} {count / elapsed:10.1f} ops/s")
+    return elapsed
+
+
+def run(name, scheme, count):
+    print(name)
+    messages = [b"message %d" % i for i in range(count)]
+    keys = []
+    rate("keygen", count, lambda: keys.extend(scheme.keygen() for _ in range(count)))
+    pks = [pk for _, pk in keys]
+    sigs = []
+    rate("sign", count, lambda: sigs.extend(scheme.sign(sk, m) for (sk, _), m in zip(keys, messages)))
+    assert rate("verify", count, lambda: all(scheme.verify(pk, m, s) for pk, m, s in zip(pks, messages, sigs)))
+    shared = [scheme.sign(sk, b"shared") for sk, _ in keys]
+    rate("aggregate", count, lambda: scheme.aggregate(shared))
+    aggregate = scheme.aggregate(shared)
+    assert scheme.fast_aggregate_verify(pks, b"shared", aggregate)
+    rate("fast_aggregate_verify", count, lambda: scheme.fast_aggregate_verify(pks, b"shared", aggregate))
+    aggregate = scheme.aggregate(sigs)
+    assert scheme.aggregate_verify(pks, messages, aggregate)
+    rate("aggregate_verify", count, lambda: scheme.aggregate_verify(pks, messages, aggregate))
+    if hasattr(scheme, "batch_verify"):
+        assert scheme.batch_verify(pks, messages, sigs)
+        rate("batch_verify", count, lambda: scheme.batch_verify(pks, messages, sigs))
+
+
+def main():
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 100
+    pairing = Pairing(params)
+    generator = Element.random(pairing, G2)
+    run("python composition", PythonBLS(pairing, generator), count)
+    run("pypbc.bls", bls.Scheme(pairing, generator), count)
+
+
+if __name__ == "__main__":
+    main()
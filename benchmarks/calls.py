@@ -0,0 +1,57 @@
+#! /usr/bin/env python3
+
+# Per-call cost of the cheap entry points, where argument handling is a large share of the
+# work. Constructors are also timed through Type.__new__, which still builds an argument
+# tuple and parses it; run against an older build to compare the methods.
+# Run with: python3 benchmarks/calls.py [count]
+
+import sys
+import timeit
+
+from pypbc import *
+
+params = Parameters(
+    "type a\n"
+    "q 8780710799663312522437781984754049815806883199414208211028653399266475630880222957078625179422662221423155858769582317459277713367317481324925129998224791\n"
+    "h 12016012264891146079388821366740534204802954401251311822919615131047207289359704531102844802183906537786776\n"
+    "r 730750818665451621361119245571504901405976559617\n"
+    "exp2 159\n"
+    "exp1 107\n"
+    "sign1 1\n"
+    "sign0 1\n"
+)
+
+
+def cost(label, count, function):
+    # the best of a few repeats, in nanoseconds per call
+    best = min(timeit.repeat(function, number=count, repeat=5))
+    print(f"  {label:<40} {best / count * 1e9:10.1f} ns/call")
+
+
+def main():
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 100000
+    pairing = Pairing(params)
+    pairing.enable_cache()
+    g1 = Element.random(pairing, G1)
+    g2 = Element.random(pairing, G2)
+    zr = Element.from_int(pairing, 5)
+    data = zr.to_bytes()
+    pairing.apply(g1, g2)
+    print("classmethods")
+    cost("Element.zero(pairing, Zr)", count, lambda: Element.zero(pairing, Zr))
+    cost("Element.one(pairing, Zr)", count, lambda: Element.one(pairing, Zr))
+    cost("Element.random(pairing, Zr)", count, lambda: Element.random(pairing, Zr))
+    cost("Element.from_int(pairing, 5)", count, lambda: Element.from_int(pairing, 5))
+    cost("Element.from_bytes(pairing, Zr, data)", count, lambda: Element.from_bytes(pairing, Zr, data))
+    cost("Element.from_bytes(..., validate=False)", count, lambda: Element.from_bytes(pairing, Zr, data, validate=False))
+    print("methods")
+    cost("pairing.apply(g1, g2), cached", count, lambda: pairing.apply(g1, g2))
+    print("constructors")
+    cost("Element(pairing, Zr, '5')", count, lambda: Element(pairing, Zr, "5"))
+    cost("Element.__new__(Element, pairing, Zr, '5')", count, lambda: Element.__new__(Element, pairing, Zr, "5"))
+    cost("Exponent(5)", count, lambda: Exponent(5))
+    cost("Exponent.__new__(Exponent, 5)", count, lambda: Exponent.__new__(Exponent, 5))
+
+
+if __name__ == "__main__":
+    main()
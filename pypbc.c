@@ -1,5 +1,11 @@
 #include "pypbc.h"
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <time.h>
 
 /*******************************************************************************
 * pypbc.c                                                                      *
@@ -30,6 +36,13 @@ void mpz_init_from_pynum(mpz_t mpz_n, PyObject *py_n) {
     Py_DECREF(py_n_bytes);
 }
 
+// free a string made by mpz_get_str, with the allocator GMP made it with
+void mpz_free_str(char *str_n) {
+    void (*free_fn)(void *, size_t);
+    mp_get_memory_functions(NULL, NULL, &free_fn);
+    free_fn(str_n, strlen(str_n) + 1);
+}
+
 // get a Python number from a GMP integer
 PyObject *mpz_to_pynum(mpz_t mpz_n) {
     // convert the GMP integer to a C string
@@ -37,1172 +50,11534 @@ PyObject *mpz_to_pynum(mpz_t mpz_n) {
     // convert the C string to a Python number
     PyObject *py_n = PyLong_FromString(str_n, NULL, 10);
     // free the string
-    free(str_n);
+    mpz_free_str(str_n);
     return py_n;
 }
 
 /*******************************************************************************
-*                                    Params                                    *
+*                                  Allocator                                   *
 *******************************************************************************/
 
-PyDoc_STRVAR(Parameters__doc__,
-    "A representation of the parameters of an elliptic curve.\n"
-    "\n"
-    "There are three basic ways to instantiate a Parameters object:\n"
-    "\n"
-    "Parameters(string: str) -> Parameters\n"
-    "\n"
-    "These objects are essentially only used for creating Pairings.");
+// an opt-in pooled allocator for GMP and PBC, whose elements make many small allocations of a
+// few sizes (the limbs of the fields of a pairing and the structures around them); blocks are
+// carved from aligned chunks that each serve one size class, every thread keeps free lists of
+// its own, and a registry of the chunks tells the pooled blocks from those of the previous
+// allocators, so that the pool can be switched on and off at any time
 
-Parameters *Parameters_create(void) {
-    // allocate the object
-    Parameters *params = (Parameters *)ParametersType.tp_alloc(&ParametersType, 0);
-    // check if the object was allocated
-    if (!params) {
-        PyErr_SetString(PyExc_TypeError, "could not create Parameters object");
-        return NULL;
+#define POOL_GRAIN 16
+#define POOL_CLASSES 64 // blocks of up to 1 KiB, larger ones go to the previous allocators
+#define POOL_CHUNK (64 * 1024)
+#define POOL_SLOTS 65536 // the registry is kept at most half full, i.e. 2 GiB of chunks
+#define POOL_LOCAL_MAX 4096 // the blocks of a class a thread keeps before giving them back
+
+typedef struct PoolBlock {
+    struct PoolBlock *next;
+} PoolBlock;
+
+// the free lists of a thread, and the bytes it took from and gave to the pool
+typedef struct PoolThread {
+    struct PoolThread *prev;
+    struct PoolThread *next;
+    PoolBlock *lists[POOL_CLASSES];
+    int counts[POOL_CLASSES];
+    size_t taken;
+    size_t given;
+} PoolThread;
+
+static int pool_enabled;
+static pthread_key_t pool_key;
+static __thread PoolThread *pool_thread;
+
+// the rest is shared and guarded by the mutex, except for the registry, which is read
+// without it and only ever grows
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static PoolThread *pool_threads;
+static PoolBlock *pool_depot[POOL_CLASSES];
+static int pool_depot_counts[POOL_CLASSES];
+static size_t pool_retired; // bytes still in use that were taken by threads that exited
+static size_t pool_chunk_count;
+static uintptr_t pool_chunks[POOL_SLOTS];
+static unsigned char pool_chunk_classes[POOL_SLOTS];
+
+// the allocators of GMP before the pool was installed, PBC's are malloc and friends
+static void *(*pool_gmp_malloc_prev)(size_t);
+static void *(*pool_gmp_realloc_prev)(void *, size_t, size_t);
+static void (*pool_gmp_free_prev)(void *, size_t);
+
+static size_t pool_slot(uintptr_t chunk) {
+    return (size_t)((chunk / POOL_CHUNK * 0x9E3779B97F4A7C15ULL) >> 48) % POOL_SLOTS;
+}
+
+// the size class of a pooled block, or -1 for a block of the previous allocators
+static int pool_class_of(void *p) {
+    uintptr_t chunk = (uintptr_t)p & ~(uintptr_t)(POOL_CHUNK - 1);
+    if (!p) {
+        return -1;
+    }
+    for (size_t slot = pool_slot(chunk);; slot = (slot + 1) % POOL_SLOTS) {
+        uintptr_t found = __atomic_load_n(&pool_chunks[slot], __ATOMIC_ACQUIRE);
+        if (found == chunk) {
+            return pool_chunk_classes[slot];
+        }
+        if (found == 0) {
+            return -1;
+        }
     }
-    // set the ready flag to 0
-    params->ready = 0;
-    return params;
 }
 
-PyObject *Parameters_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
-    // required argument is the parameter string
-    char *string = NULL;
-    if (!PyArg_ParseTuple(args, "s", &string)) {
-        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected a string");
-        return NULL;
+static PoolThread *pool_thread_get(void) {
+    PoolThread *t = pool_thread;
+    if (t) {
+        return t;
     }
-    // create the object
-    Parameters *params = Parameters_create();
-    // initialize the parameters from a string
-    if (pbc_param_init_set_str(params->pbc_params, string)) {
-        PyErr_SetString(PyExc_ValueError, "could not parse parameters from string");
+    t = calloc(1, sizeof(PoolThread));
+    if (!t) {
         return NULL;
     }
-    // set the ready flag
-    params->ready = 1;
-    return (PyObject *)params;
+    pthread_mutex_lock(&pool_mutex);
+    t->next = pool_threads;
+    if (pool_threads) {
+        pool_threads->prev = t;
+    }
+    pool_threads = t;
+    pthread_mutex_unlock(&pool_mutex);
+    pthread_setspecific(pool_key, t);
+    pool_thread = t;
+    return t;
 }
 
-void Parameters_dealloc(Parameters *params) {
-    // clear the parameters if they're ready
-    if (params->ready) {
-        pbc_param_clear(params->pbc_params);
+// hand the free lists of an exiting thread over to the depot
+static void pool_thread_exit(void *p) {
+    PoolThread *t = p;
+    pthread_mutex_lock(&pool_mutex);
+    for (int cls = 0; cls < POOL_CLASSES; cls++) {
+        PoolBlock *block = t->lists[cls];
+        while (block) {
+            PoolBlock *next = block->next;
+            block->next = pool_depot[cls];
+            pool_depot[cls] = block;
+            block = next;
+        }
+        pool_depot_counts[cls] += t->counts[cls];
+    }
+    pool_retired += t->taken - t->given;
+    if (t->prev) {
+        t->prev->next = t->next;
+    } else {
+        pool_threads = t->next;
     }
-    // free the object
-    Py_TYPE(params)->tp_free((PyObject *)params);
+    if (t->next) {
+        t->next->prev = t->prev;
+    }
+    pthread_mutex_unlock(&pool_mutex);
+    pool_thread = NULL;
+    free(t);
 }
 
-PyObject *Parameters_str(PyObject *py_params) {
-    // cast the argument
-    Parameters *params = (Parameters *)py_params;
-    // declare a buffer
-    char buffer[4096];
-    // open a file in memory
-    FILE *fp = fmemopen((void *)buffer, sizeof(buffer), "w+");
-    // check if the file was opened
-    if (fp == NULL) {
-        PyErr_SetString(PyExc_IOError, "could not write parameters to buffer");
-        return NULL;
+// refill the free list of a class from the depot, or from a new chunk
+static PoolBlock *pool_refill(PoolThread *t, int cls) {
+    size_t size = (size_t)(cls + 1) * POOL_GRAIN;
+    pthread_mutex_lock(&pool_mutex);
+    PoolBlock *list = pool_depot[cls];
+    int count = pool_depot_counts[cls];
+    pool_depot[cls] = NULL;
+    pool_depot_counts[cls] = 0;
+    if (!list && pool_chunk_count < POOL_SLOTS / 2) {
+        unsigned char *chunk = aligned_alloc(POOL_CHUNK, POOL_CHUNK);
+        if (chunk) {
+            size_t slot = pool_slot((uintptr_t)chunk);
+            while (pool_chunks[slot]) {
+                slot = (slot + 1) % POOL_SLOTS;
+            }
+            pool_chunk_classes[slot] = cls;
+            __atomic_store_n(&pool_chunks[slot], (uintptr_t)chunk, __ATOMIC_RELEASE);
+            pool_chunk_count++;
+            for (size_t off = POOL_CHUNK / size * size; off >= size; count++) {
+                off -= size;
+                PoolBlock *block = (PoolBlock *)(chunk + off);
+                block->next = list;
+                list = block;
+            }
+        }
     }
-    // write the parameters to the buffer
-    pbc_param_out_str(fp, params->pbc_params);
-    // close the file
-    fclose(fp);
-    // return the buffer as a string
-    return PyUnicode_FromString(buffer);
+    pthread_mutex_unlock(&pool_mutex);
+    t->lists[cls] = list;
+    t->counts[cls] = count;
+    return list;
 }
 
-PyMemberDef Parameters_members[] = {
-    {NULL},
-};
-
-PyMethodDef Parameters_methods[] = {
-    {NULL},
-};
+// give the free list of a class back to the depot, so that other threads can use it
+static void pool_flush(PoolThread *t, int cls) {
+    PoolBlock *tail = t->lists[cls];
+    while (tail->next) {
+        tail = tail->next;
+    }
+    pthread_mutex_lock(&pool_mutex);
+    tail->next = pool_depot[cls];
+    pool_depot[cls] = t->lists[cls];
+    pool_depot_counts[cls] += t->counts[cls];
+    pthread_mutex_unlock(&pool_mutex);
+    t->lists[cls] = NULL;
+    t->counts[cls] = 0;
+}
 
-PyTypeObject ParametersType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    "pypbc.Parameters",                       /* tp_name */
-    sizeof(Parameters),                       /* tp_basicsize */
-    0,                                        /* tp_itemsize */
-    (destructor)Parameters_dealloc,           /* tp_dealloc */
-    0,                                        /* tp_print */
-    0,                                        /* tp_getattr */
-    0,                                        /* tp_setattr */
-    0,                                        /* tp_compare */
-    Parameters_str,                           /* tp_repr */
-    0,                                        /* tp_as_number */
-    0,                                        /* tp_as_sequence */
-    0,                                        /* tp_as_mapping */
-    0,                                        /* tp_hash */
-    0,                                        /* tp_call */
-    Parameters_str,                           /* tp_str */
-    0,                                        /* tp_getattro */
-    0,                                        /* tp_setattro */
-    0,                                        /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /* tp_flags */
-    Parameters__doc__,                        /* tp_doc */
-    0,                                        /* tp_traverse */
-    0,                                        /* tp_clear */
-    0,                                        /* tp_richcompare */
-    0,                                        /* tp_weaklistoffset */
-    0,                                        /* tp_iter */
-    0,                                        /* tp_iternext */
-    Parameters_methods,                       /* tp_methods */
-    Parameters_members,                       /* tp_members */
-    0,                                        /* tp_getset */
-    0,                                        /* tp_base */
-    0,                                        /* tp_dict */
-    0,                                        /* tp_descr_get */
-    0,                                        /* tp_descr_set */
-    0,                                        /* tp_dictoffset */
-    0,                                        /* tp_init */
-    0,                                        /* tp_alloc */
-    Parameters_new,                           /* tp_new */
-};
+// take a block from the pool, or return NULL if the pool is off, the size is not pooled or
+// memory runs out, leaving it to the previous allocators
+static void *pool_take(size_t size) {
+    if (!__atomic_load_n(&pool_enabled, __ATOMIC_RELAXED) || size == 0 || size > POOL_CLASSES * POOL_GRAIN) {
+        return NULL;
+    }
+    PoolThread *t = pool_thread_get();
+    if (!t) {
+        return NULL;
+    }
+    int cls = (int)((size - 1) / POOL_GRAIN);
+    PoolBlock *block = t->lists[cls];
+    if (!block && !(block = pool_refill(t, cls))) {
+        return NULL;
+    }
+    t->lists[cls] = block->next;
+    t->counts[cls]--;
+    // the counters are only read by pool_usage, which may run on another thread
+    __atomic_store_n(&t->taken, t->taken + (size_t)(cls + 1) * POOL_GRAIN, __ATOMIC_RELAXED);
+    return block;
+}
 
-/*******************************************************************************
-*                                   Pairings                                   *
-*******************************************************************************/
+// give a block back to the free list of its class on the calling thread
+static void pool_give(void *p, int cls) {
+    PoolBlock *block = p;
+    size_t size = (size_t)(cls + 1) * POOL_GRAIN;
+    PoolThread *t = pool_thread_get();
+    if (!t) {
+        pthread_mutex_lock(&pool_mutex);
+        block->next = pool_depot[cls];
+        pool_depot[cls] = block;
+        pool_depot_counts[cls]++;
+        pool_retired -= size;
+        pthread_mutex_unlock(&pool_mutex);
+        return;
+    }
+    block->next = t->lists[cls];
+    t->lists[cls] = block;
+    __atomic_store_n(&t->given, t->given + size, __ATOMIC_RELAXED);
+    if (++t->counts[cls] > POOL_LOCAL_MAX) {
+        pool_flush(t, cls);
+    }
+}
 
-PyDoc_STRVAR(Pairing__doc__,
-    "Represents a bilinear pairing, frequently referred to as e-hat.\n"
-    "\n"
-    "Basic usage:\n"
-    "\n"
-    "Pairing(params: Parameters) -> Pairing\n"
-    "\n"
-    "This object is used to apply the bilinear map to two elements.");
+static void *pool_gmp_malloc(size_t size) {
+    void *p = pool_take(size);
+    return p ? p : pool_gmp_malloc_prev(size);
+}
 
-Pairing *Pairing_create(void) {
-    // allocate the object
-    Pairing *pairing = (Pairing *)PairingType.tp_alloc(&PairingType, 0);
-    // check if the object was allocated
-    if (!pairing) {
-        PyErr_SetString(PyExc_TypeError, "could not create Pairing object");
-        return NULL;
+static void *pool_gmp_realloc(void *p, size_t old_size, size_t new_size) {
+    int cls = pool_class_of(p);
+    if (cls < 0) {
+        return pool_gmp_realloc_prev(p, old_size, new_size);
     }
-    // set the ready flag to 0
-    pairing->ready = 0;
-    return pairing;
+    // shrinking, or growing within the class, keeps the block
+    if (new_size <= (size_t)(cls + 1) * POOL_GRAIN) {
+        return p;
+    }
+    void *q = pool_gmp_malloc(new_size);
+    memcpy(q, p, old_size);
+    pool_give(p, cls);
+    return q;
 }
 
-PyObject *Pairing_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
-    // required argument is the parameters
-    PyObject *py_params;
-    if (!PyArg_ParseTuple(args, "O!", &ParametersType, &py_params)) {
-        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Parameters object");
-        return NULL;
+static void pool_gmp_free(void *p, size_t size) {
+    int cls = pool_class_of(p);
+    if (cls < 0) {
+        pool_gmp_free_prev(p, size);
+    } else {
+        pool_give(p, cls);
     }
-    // cast the argument
-    Parameters *params = (Parameters *)py_params;
-    // create the object
-    Pairing *pairing = Pairing_create();
-    // initialize the pairing with the parameters
-    pairing_init_pbc_param(pairing->pbc_pairing, params->pbc_params);
-    // set the ready flag
-    pairing->ready = 1;
-    return (PyObject *)pairing;
 }
 
-void Pairing_dealloc(Pairing *pairing) {
-    // clear the pairing if it's ready
-    if (pairing->ready) {
-        pairing_clear(pairing->pbc_pairing);
+// pbc's own allocators die when memory runs out, and so do these
+static void *pool_pbc_malloc(size_t size) {
+    void *p = pool_take(size);
+    if (!p && !(p = malloc(size)) && size) {
+        pbc_die("out of memory");
     }
-    // free the object
-    Py_TYPE(pairing)->tp_free((PyObject *)pairing);
+    return p;
 }
 
-PyObject *Pairing_apply(PyObject *py_pairing, PyObject *args) {
-    // we expect two elements
-    PyObject *py_lft;
-    PyObject *py_rgt;
-    if (!PyArg_ParseTuple(args, "O!O!", &ElementType, &py_lft, &ElementType, &py_rgt)) {
-        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected two Elements");
-        return NULL;
+static void *pool_pbc_realloc(void *p, size_t size) {
+    int cls = pool_class_of(p);
+    if (cls < 0) {
+        void *q = p ? realloc(p, size) : pool_pbc_malloc(size);
+        if (!q && size) {
+            pbc_die("out of memory");
+        }
+        return q;
     }
-    // declare the result element
-    Element *ele_res;
-    // cast the arguments
-    Pairing *pairing = (Pairing *)py_pairing;
-    Element *ele_lft = (Element *)py_lft;
-    Element *ele_rgt = (Element *)py_rgt;
-    // check the groups of the elements
-    if (ele_lft->pbc_element->field == pairing->pbc_pairing->G1 && ele_rgt->pbc_element->field == pairing->pbc_pairing->G2) {
-        // build the result element and initialize it with the pairing and group
-        ele_res = Element_create();
-        element_init_GT(ele_res->pbc_element, pairing->pbc_pairing);
-        ele_res->pairing = ele_lft->pairing;
-        // apply the pairing
-        pairing_apply(ele_res->pbc_element, ele_lft->pbc_element, ele_rgt->pbc_element, pairing->pbc_pairing);
-    } else if (ele_lft->pbc_element->field == pairing->pbc_pairing->G2 && ele_rgt->pbc_element->field == pairing->pbc_pairing->G1) {
-        // build the result element and initialize it with the pairing and group
-        ele_res = Element_create();
-        element_init_GT(ele_res->pbc_element, pairing->pbc_pairing);
-        ele_res->pairing = ele_lft->pairing;
-        // apply the pairing
-        pairing_apply(ele_res->pbc_element, ele_rgt->pbc_element, ele_lft->pbc_element, pairing->pbc_pairing);
+    size_t old_size = (size_t)(cls + 1) * POOL_GRAIN;
+    if (size <= old_size) {
+        return p;
+    }
+    void *q = pool_pbc_malloc(size);
+    memcpy(q, p, old_size);
+    pool_give(p, cls);
+    return q;
+}
+
+static void pool_pbc_free(void *p) {
+    int cls = pool_class_of(p);
+    if (cls < 0) {
+        free(p);
     } else {
-        PyErr_SetString(PyExc_ValueError, "only Elements in G1 and G2 can be paired");
-        return NULL;
+        pool_give(p, cls);
     }
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(ele_res->pairing);
-    ele_res->ready = 1;
-    return (PyObject *)ele_res;
 }
 
-PyObject *Pairing_order(PyObject *py_pairing) {
-    // cast the argument
-    Pairing *pairing = (Pairing *)py_pairing;
-    // return the r value
-    return mpz_to_pynum(pairing->pbc_pairing->r);
+// the pool is left consistent across fork, the child keeps the lists of its own thread only
+static void pool_atfork_prepare(void) {
+    pthread_mutex_lock(&pool_mutex);
 }
 
-PyObject *Pairing_is_symmetric(PyObject *py_pairing) {
-    // cast the argument
-    Pairing *pairing = (Pairing *)py_pairing;
-    // return whether the pairing is symmetric
-    if (pairing->pbc_pairing->G1 == pairing->pbc_pairing->G2) {
-        Py_RETURN_TRUE;
-    } else {
-        Py_RETURN_FALSE;
-    }
+static void pool_atfork_release(void) {
+    pthread_mutex_unlock(&pool_mutex);
 }
 
-PyMemberDef Pairing_members[] = {
-    {NULL},
-};
+static void pool_install(void) {
+    mp_get_memory_functions(&pool_gmp_malloc_prev, &pool_gmp_realloc_prev, &pool_gmp_free_prev);
+    pthread_key_create(&pool_key, pool_thread_exit);
+    pthread_atfork(pool_atfork_prepare, pool_atfork_release, pool_atfork_release);
+    mp_set_memory_functions(pool_gmp_malloc, pool_gmp_realloc, pool_gmp_free);
+    pbc_set_memory_functions(pool_pbc_malloc, pool_pbc_realloc, pool_pbc_free);
+}
 
-PyMethodDef Pairing_methods[] = {
-    {"apply", (PyCFunction)Pairing_apply, METH_VARARGS, "Applies the pairing."},
-    {"order", (PyCFunction)Pairing_order, METH_NOARGS, "Returns the order of the pairing."},
-    {"is_symmetric", (PyCFunction)Pairing_is_symmetric, METH_NOARGS, "Returns whether the pairing is symmetric."},
-    {NULL},
-};
+// switch the pool on or off, it is installed the first time it is switched on and stays
+// installed, so that the blocks it handed out can still be freed
+void pool_set_enabled(int enabled) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    if (enabled) {
+        pthread_once(&once, pool_install);
+    }
+    __atomic_store_n(&pool_enabled, enabled, __ATOMIC_RELAXED);
+}
 
-PyTypeObject PairingType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    "pypbc.Pairing",                          /* tp_name */
-    sizeof(Pairing),                          /* tp_basicsize */
-    0,                                        /* tp_itemsize */
-    (destructor)Pairing_dealloc,              /* tp_dealloc */
-    0,                                        /* tp_print */
-    0,                                        /* tp_getattr */
-    0,                                        /* tp_setattr */
-    0,                                        /* tp_reserved */
-    0,                                        /* tp_repr */
-    0,                                        /* tp_as_number */
-    0,                                        /* tp_as_sequence */
-    0,                                        /* tp_as_mapping */
-    0,                                        /* tp_hash */
-    0,                                        /* tp_call */
-    0,                                        /* tp_str */
-    0,                                        /* tp_getattro */
-    0,                                        /* tp_setattro */
-    0,                                        /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /* tp_flags */
-    Pairing__doc__,                           /* tp_doc */
-    0,                                        /* tp_traverse */
-    0,                                        /* tp_clear */
-    0,                                        /* tp_richcompare */
-    0,                                        /* tp_weaklistoffset */
-    0,                                        /* tp_iter */
-    0,                                        /* tp_iternext */
-    Pairing_methods,                          /* tp_methods */
-    Pairing_members,                          /* tp_members */
-    0,                                        /* tp_getset */
-    0,                                        /* tp_base */
-    0,                                        /* tp_dict */
-    0,                                        /* tp_descr_get */
-    0,                                        /* tp_descr_set */
-    0,                                        /* tp_dictoffset */
-    0,                                        /* tp_init */
-    0,                                        /* tp_alloc */
-    Pairing_new,                              /* tp_new */
-};
+void pool_usage(PoolUsage *usage) {
+    pthread_mutex_lock(&pool_mutex);
+    size_t in_use = pool_retired;
+    for (PoolThread *t = pool_threads; t; t = t->next) {
+        in_use += __atomic_load_n(&t->taken, __ATOMIC_RELAXED) - __atomic_load_n(&t->given, __ATOMIC_RELAXED);
+    }
+    usage->enabled = __atomic_load_n(&pool_enabled, __ATOMIC_RELAXED);
+    usage->chunks = pool_chunk_count;
+    usage->reserved = pool_chunk_count * POOL_CHUNK;
+    usage->in_use = in_use;
+    pthread_mutex_unlock(&pool_mutex);
+}
 
 /*******************************************************************************
-*                                   Elements                                   *
+*                                   Hashing                                    *
 *******************************************************************************/
 
-PyDoc_STRVAR(Element__doc__,
-    "Represents an element of a bilinear group.\n"
-    "\n"
-    "Basic usage:\n"
-    "\n"
-    "Element(pairing: Pairing, group: int, string: str) -> Element\n"
-    "\n"
-    "Most of the basic arithmetic operations apply. Please note that many of them\n"
-    "do not make sense between groups, and that not all of these are checked for.");
+// a self-contained SHA-256, used for parameter fingerprints and file checksums
 
-Element *Element_create(void) {
-    // allocate the object
-    Element *element = (Element *)ElementType.tp_alloc(&ElementType, 0);
-    // check if the object was allocated
-    if (!element) {
-        PyErr_SetString(PyExc_TypeError, "could not create Element object");
-        return NULL;
-    }
-    // set the ready flag to 0
-    element->ready = 0;
-    return element;
-}
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
 
-PyObject *Element_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
-    // required arguments are the pairing and the group
-    PyObject *py_pairing;
-    enum Group group;
-    char *string = NULL;
-    if (!PyArg_ParseTuple(args, "O!is", &PairingType, &py_pairing, &group, &string)) {
-        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, group, and string");
-        return NULL;
+#define SHA256_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(Sha256 *ctx, const unsigned char *block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 | (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
     }
-    // cast the arguments
-    Pairing *pairing = (Pairing *)py_pairing;
-    // build the result element and initialize it with the pairing and group
-    Element *element = Element_create();
-    switch (group) {
-    case G1: element_init_G1(element->pbc_element, pairing->pbc_pairing); break;
-    case G2: element_init_G2(element->pbc_element, pairing->pbc_pairing); break;
-    case GT: element_init_GT(element->pbc_element, pairing->pbc_pairing); break;
-    case Zr: element_init_Zr(element->pbc_element, pairing->pbc_pairing); break;
-    default: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "invalid group"); return NULL;
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = SHA256_ROTR(w[i - 15], 7) ^ SHA256_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = SHA256_ROTR(w[i - 2], 17) ^ SHA256_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
     }
-    element->pairing = pairing;
-    // set the element to the string
-    if (element_set_str(element->pbc_element, string, 10) == 0) {
-        PyErr_SetString(PyExc_ValueError, "could not parse element from string");
-        return NULL;
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (SHA256_ROTR(e, 6) ^ SHA256_ROTR(e, 11) ^ SHA256_ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (SHA256_ROTR(a, 2) ^ SHA256_ROTR(a, 13) ^ SHA256_ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
     }
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(element->pairing);
-    element->ready = 1;
-    return (PyObject *)element;
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
 }
 
-void Element_dealloc(Element *element) {
-    // clear the element and decrement the reference count on the pairing if it's ready
-    if (element->ready){
-        element_clear(element->pbc_element);
-        Py_DECREF(element->pairing);
-    }
-    // free the object
-    Py_TYPE(element)->tp_free((PyObject *)element);
+void sha256_init(Sha256 *ctx) {
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, iv, sizeof(iv));
+    ctx->length = 0;
+    ctx->used = 0;
 }
 
-PyObject *Element_from_int(PyObject *cls, PyObject *args) {
-    // required arguments are the pairing and the group
-    PyObject *py_pairing;
-    PyObject *py_val;
-    if (!PyArg_ParseTuple(args, "O!O!", &PairingType, &py_pairing, &PyLong_Type, &py_val)) {
-        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object and number");
-        return NULL;
+void sha256_update(Sha256 *ctx, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    ctx->length += size;
+    // fill up a pending partial block first
+    if (ctx->used) {
+        size_t take = 64 - ctx->used < size ? 64 - ctx->used : size;
+        memcpy(ctx->buffer + ctx->used, bytes, take);
+        ctx->used += take;
+        bytes += take;
+        size -= take;
+        if (ctx->used < 64) {
+            return;
+        }
+        sha256_block(ctx, ctx->buffer);
+        ctx->used = 0;
     }
-    // cast the arguments
-    Pairing *pairing = (Pairing *)py_pairing;
-    // convert the number to an mpz_t
-    mpz_t mpz_val;
-    mpz_init_from_pynum(mpz_val, py_val);
-    // build the result element and initialize it with the pairing and group
-    Element *element = Element_create();
-    element_init_Zr(element->pbc_element, pairing->pbc_pairing);
-    element->pairing = pairing;
-    // set the element to the number
-    element_set_mpz(element->pbc_element, mpz_val);
-    // clear the mpz_t
-    mpz_clear(mpz_val);
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(element->pairing);
-    element->ready = 1;
-    return (PyObject *)element;
+    for (; size >= 64; bytes += 64, size -= 64) {
+        sha256_block(ctx, bytes);
+    }
+    memcpy(ctx->buffer, bytes, size);
+    ctx->used = size;
 }
 
-PyObject *Element_zero(PyObject *cls, PyObject *args) {
-    // required arguments are the pairing and the group
-    PyObject *py_pairing;
-    enum Group group;
-    if (!PyArg_ParseTuple(args, "O!i", &PairingType, &py_pairing, &group)) {
-        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object and group");
-        return NULL;
+void sha256_final(Sha256 *ctx, unsigned char *digest) {
+    uint64_t bits = ctx->length * 8;
+    unsigned char pad[72] = {0x80};
+    size_t padding = (ctx->used < 56 ? 56 : 120) - ctx->used;
+    for (int i = 0; i < 8; i++) {
+        pad[padding + i] = (unsigned char)(bits >> (56 - 8 * i));
     }
-    // cast the arguments
+    sha256_update(ctx, pad, padding + 8);
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = (unsigned char)(ctx->state[i] >> 24);
+        digest[4 * i + 1] = (unsigned char)(ctx->state[i] >> 16);
+        digest[4 * i + 2] = (unsigned char)(ctx->state[i] >> 8);
+        digest[4 * i + 3] = (unsigned char)ctx->state[i];
+    }
+}
+
+void sha256(const void *data, size_t size, unsigned char *digest) {
+    Sha256 ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, size);
+    sha256_final(&ctx, digest);
+}
+
+// SHA-512, for expand_message_xmd with a wider digest
+
+static const uint64_t sha512_k[80] = {
+    0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538, 0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118,
+    0xd807aa98a3030242, 0x12835b0145706fbe, 0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235, 0xc19bf174cf692694,
+    0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65, 0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+    0x983e5152ee66dfab, 0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725, 0x06ca6351e003826f, 0x142929670a0e6e70,
+    0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed, 0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+    0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218, 0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8,
+    0x19a4c116b8d2d0c8, 0x1e376c085141ab53, 0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3,
+    0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec, 0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b,
+    0xca273eceea26619c, 0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6, 0x113f9804bef90dae, 0x1b710b35131c471b,
+    0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc, 0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817,
+};
+
+#define SHA512_ROTR(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+static void sha512_block(Sha512 *ctx, const unsigned char *block) {
+    uint64_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = 0;
+        for (int j = 0; j < 8; j++) {
+            w[i] = w[i] << 8 | block[8 * i + j];
+        }
+    }
+    for (int i = 16; i < 80; i++) {
+        uint64_t s0 = SHA512_ROTR(w[i - 15], 1) ^ SHA512_ROTR(w[i - 15], 8) ^ (w[i - 15] >> 7);
+        uint64_t s1 = SHA512_ROTR(w[i - 2], 19) ^ SHA512_ROTR(w[i - 2], 61) ^ (w[i - 2] >> 6);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint64_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    uint64_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+    for (int i = 0; i < 80; i++) {
+        uint64_t t1 = h + (SHA512_ROTR(e, 14) ^ SHA512_ROTR(e, 18) ^ SHA512_ROTR(e, 41)) + ((e & f) ^ (~e & g)) + sha512_k[i] + w[i];
+        uint64_t t2 = (SHA512_ROTR(a, 28) ^ SHA512_ROTR(a, 34) ^ SHA512_ROTR(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
+}
+
+void sha512_init(Sha512 *ctx) {
+    static const uint64_t iv[8] = {
+        0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+        0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179,
+    };
+    memcpy(ctx->state, iv, sizeof(iv));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+void sha512_update(Sha512 *ctx, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    ctx->length += size;
+    // fill up a pending partial block first
+    if (ctx->used) {
+        size_t take = 128 - ctx->used < size ? 128 - ctx->used : size;
+        memcpy(ctx->buffer + ctx->used, bytes, take);
+        ctx->used += take;
+        bytes += take;
+        size -= take;
+        if (ctx->used < 128) {
+            return;
+        }
+        sha512_block(ctx, ctx->buffer);
+        ctx->used = 0;
+    }
+    for (; size >= 128; bytes += 128, size -= 128) {
+        sha512_block(ctx, bytes);
+    }
+    memcpy(ctx->buffer, bytes, size);
+    ctx->used = size;
+}
+
+void sha512_final(Sha512 *ctx, unsigned char *digest) {
+    // the length field is 128 bits wide, the upper half is always zero here
+    uint64_t bits = ctx->length * 8;
+    unsigned char pad[144] = {0x80};
+    size_t padding = (ctx->used < 112 ? 112 : 240) - ctx->used;
+    for (int i = 0; i < 8; i++) {
+        pad[padding + 8 + i] = (unsigned char)(bits >> (56 - 8 * i));
+    }
+    sha512_update(ctx, pad, padding + 16);
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            digest[8 * i + j] = (unsigned char)(ctx->state[i] >> (56 - 8 * j));
+        }
+    }
+}
+
+// either hash behind one interface, the digest size tells them apart
+
+void hash_init(Hash *ctx, int digest_size) {
+    ctx->digest_size = digest_size;
+    if (digest_size == 64) {
+        sha512_init(&ctx->sha512);
+    } else {
+        sha256_init(&ctx->sha256);
+    }
+}
+
+void hash_update(Hash *ctx, const void *data, size_t size) {
+    if (ctx->digest_size == 64) {
+        sha512_update(&ctx->sha512, data, size);
+    } else {
+        sha256_update(&ctx->sha256, data, size);
+    }
+}
+
+void hash_final(Hash *ctx, unsigned char *digest) {
+    if (ctx->digest_size == 64) {
+        sha512_final(&ctx->sha512, digest);
+    } else {
+        sha256_final(&ctx->sha256, digest);
+    }
+}
+
+int hash_block_size(Hash *ctx) {
+    return ctx->digest_size == 64 ? 128 : 64;
+}
+
+// expand_message_xmd of RFC 9380, the context has already absorbed the zero block
+// Z_pad and the message, and dst is at most 255 bytes; size must be at most 255
+// digests, which the caller checks
+void expand_message_xmd(Hash *msg, const unsigned char *dst, size_t dst_size, unsigned char *out, size_t size) {
+    int digest_size = msg->digest_size;
+    unsigned char suffix[3] = {(unsigned char)(size >> 8), (unsigned char)size, 0};
+    unsigned char dst_length = (unsigned char)dst_size;
+    unsigned char b0[64], bi[64];
+    // b_0 = H(Z_pad || msg || I2OSP(size, 2) || I2OSP(0, 1) || DST_prime)
+    Hash ctx = *msg;
+    hash_update(&ctx, suffix, 3);
+    hash_update(&ctx, dst, dst_size);
+    hash_update(&ctx, &dst_length, 1);
+    hash_final(&ctx, b0);
+    // b_i = H(strxor(b_0, b_(i - 1)) || I2OSP(i, 1) || DST_prime), with b_0 standing in
+    // for b_(i - 1) at i = 1, where the xor is zero
+    memset(bi, 0, digest_size);
+    for (unsigned char i = 1; size > 0; i++) {
+        for (int j = 0; j < digest_size; j++) {
+            bi[j] ^= b0[j];
+        }
+        hash_init(&ctx, digest_size);
+        hash_update(&ctx, bi, digest_size);
+        hash_update(&ctx, &i, 1);
+        hash_update(&ctx, dst, dst_size);
+        hash_update(&ctx, &dst_length, 1);
+        hash_final(&ctx, bi);
+        size_t take = size < (size_t)digest_size ? size : (size_t)digest_size;
+        memcpy(out, bi, take);
+        out += take;
+        size -= take;
+    }
+}
+
+/*******************************************************************************
+*                                  Zr Engine                                   *
+*******************************************************************************/
+
+// PBC implements Zr with a generic Montgomery field that loops over a runtime
+// limb count and dispatches every operation through the field_t table. For the
+// common sizes of r (3, 4 and 8 limbs) we install our own field_t in place of
+// pairing->Zr whose kernels have the limb count fixed at compile time, and use
+// mulx/adx when the CPU has them. Anything that is not on the hot path (hashing,
+// random sampling, square roots, parsing and printing) is delegated to the
+// original PBC field, so the results are identical to PBC's.
+
+#if defined(__SIZEOF_INT128__) && GMP_LIMB_BITS == 64
+#define PYPBC_ZR_ENGINE
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PYPBC_ZR_ADX
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#define ZR_MAX_LIMBS 8
+
+typedef void (*zr_mul_fn)(mp_limb_t *z, const mp_limb_t *x, const mp_limb_t *y, const mp_limb_t *m, mp_limb_t inv);
+
+// the per-pairing state of the engine, stored in the data of the Zr field
+typedef struct {
+    int limbs;
+    mp_limb_t mod[ZR_MAX_LIMBS];
+    mp_limb_t inv;              // -mod^-1 mod 2^64
+    mp_limb_t one[ZR_MAX_LIMBS]; // R mod r, i.e. 1 in Montgomery form
+    mp_limb_t r2[ZR_MAX_LIMBS];  // R^2 mod r, used to convert into Montgomery form
+    zr_mul_fn mul;
+    field_ptr pbc_field;         // the original PBC implementation of Zr
+} ZrEngine;
+
+// CIOS Montgomery multiplication with a fixed number of limbs, portable version
+#define ZR_DEFINE_MUL(N)                                                                                       \
+static void zr_mul_##N(mp_limb_t *z, const mp_limb_t *x, const mp_limb_t *y, const mp_limb_t *m, mp_limb_t inv) { \
+    mp_limb_t t[N + 2] = {0};                                                                                  \
+    for (int i = 0; i < N; i++) {                                                                              \
+        unsigned __int128 c = 0;                                                                               \
+        for (int j = 0; j < N; j++) {                                                                          \
+            c += (unsigned __int128)x[j] * y[i] + t[j];                                                        \
+            t[j] = (mp_limb_t)c;                                                                               \
+            c >>= 64;                                                                                          \
+        }                                                                                                      \
+        c += t[N];                                                                                             \
+        t[N] = (mp_limb_t)c;                                                                                   \
+        t[N + 1] = (mp_limb_t)(c >> 64);                                                                       \
+        mp_limb_t u = t[0] * inv;                                                                              \
+        c = ((unsigned __int128)u * m[0] + t[0]) >> 64;                                                        \
+        for (int j = 1; j < N; j++) {                                                                          \
+            c += (unsigned __int128)u * m[j] + t[j];                                                           \
+            t[j - 1] = (mp_limb_t)c;                                                                           \
+            c >>= 64;                                                                                          \
+        }                                                                                                      \
+        c += t[N];                                                                                             \
+        t[N - 1] = (mp_limb_t)c;                                                                               \
+        t[N] = t[N + 1] + (mp_limb_t)(c >> 64);                                                                \
+    }                                                                                                          \
+    if (t[N] || mpn_cmp(t, m, N) >= 0) {                                                                       \
+        mpn_sub_n(z, t, m, N);                                                                                 \
+    } else {                                                                                                   \
+        for (int j = 0; j < N; j++) z[j] = t[j];                                                               \
+    }                                                                                                          \
+}
+
+ZR_DEFINE_MUL(3)
+ZR_DEFINE_MUL(4)
+ZR_DEFINE_MUL(8)
+
+#ifdef PYPBC_ZR_ADX
+// the same multiplication using mulx and two independent adcx/adox carry chains
+#define ZR_DEFINE_MUL_ADX(N)                                                                                   \
+__attribute__((target("bmi2,adx")))                                                                            \
+static void zr_mul_adx_##N(mp_limb_t *z, const mp_limb_t *x, const mp_limb_t *y, const mp_limb_t *m, mp_limb_t inv) { \
+    unsigned long long t[N + 2] = {0};                                                                         \
+    unsigned long long lo, hi;                                                                                 \
+    for (int i = 0; i < N; i++) {                                                                              \
+        unsigned char ca = 0, cb = 0;                                                                          \
+        for (int j = 0; j < N; j++) {                                                                          \
+            lo = _mulx_u64(x[j], y[i], &hi);                                                                   \
+            ca = _addcarryx_u64(ca, t[j], lo, &t[j]);                                                          \
+            cb = _addcarryx_u64(cb, t[j + 1], hi, &t[j + 1]);                                                  \
+        }                                                                                                      \
+        ca = _addcarryx_u64(ca, t[N], 0, &t[N]);                                                               \
+        t[N + 1] += (unsigned long long)ca + cb;                                                               \
+        unsigned long long u = t[0] * inv;                                                                     \
+        ca = 0, cb = 0;                                                                                        \
+        for (int j = 0; j < N; j++) {                                                                          \
+            lo = _mulx_u64(u, m[j], &hi);                                                                      \
+            ca = _addcarryx_u64(ca, t[j], lo, &t[j]);                                                          \
+            cb = _addcarryx_u64(cb, t[j + 1], hi, &t[j + 1]);                                                  \
+        }                                                                                                      \
+        ca = _addcarryx_u64(ca, t[N], 0, &t[N]);                                                               \
+        t[N + 1] += (unsigned long long)ca + cb;                                                               \
+        for (int j = 0; j <= N; j++) t[j] = t[j + 1];                                                          \
+        t[N + 1] = 0;                                                                                          \
+    }                                                                                                          \
+    if (t[N] || mpn_cmp((mp_limb_t *)t, m, N) >= 0) {                                                          \
+        mpn_sub_n(z, (mp_limb_t *)t, m, N);                                                                    \
+    } else {                                                                                                   \
+        for (int j = 0; j < N; j++) z[j] = t[j];                                                               \
+    }                                                                                                          \
+}
+
+ZR_DEFINE_MUL_ADX(3)
+ZR_DEFINE_MUL_ADX(4)
+ZR_DEFINE_MUL_ADX(8)
+
+// check whether the CPU supports mulx (BMI2) and adcx/adox (ADX)
+static int zr_cpu_has_adx(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    return (ebx & bit_BMI2) && (ebx & bit_ADX);
+}
+#endif
+
+// get the engine of a Zr element
+#define ZR_ENGINE(e) ((ZrEngine *)(e)->field->data)
+#define ZR_LIMBS(e) ((mp_limb_t *)(e)->data)
+
+// write a non-negative GMP integer below the modulus into a fixed number of limbs
+static void zr_limbs_from_mpz(mp_limb_t *a, int n, mpz_t z) {
+    memset(a, 0, n * sizeof(mp_limb_t));
+    mpz_export(a, NULL, -1, sizeof(mp_limb_t), 0, 0, z);
+}
+
+static void zr_init(element_ptr e) {
+    e->data = pbc_malloc(ZR_ENGINE(e)->limbs * sizeof(mp_limb_t));
+    memset(e->data, 0, ZR_ENGINE(e)->limbs * sizeof(mp_limb_t));
+}
+
+static void zr_clear(element_ptr e) {
+    pbc_free(e->data);
+}
+
+static void zr_set_mpz(element_ptr e, mpz_ptr z) {
+    ZrEngine *engine = ZR_ENGINE(e);
+    mp_limb_t a[ZR_MAX_LIMBS];
+    mpz_t t;
+    mpz_init(t);
+    mpz_mod(t, z, e->field->order);
+    zr_limbs_from_mpz(a, engine->limbs, t);
+    mpz_clear(t);
+    // convert into Montgomery form
+    engine->mul(ZR_LIMBS(e), a, engine->r2, engine->mod, engine->inv);
+}
+
+static void zr_set_si(element_ptr e, signed long int i) {
+    mpz_t z;
+    mpz_init_set_si(z, i);
+    zr_set_mpz(e, z);
+    mpz_clear(z);
+}
+
+static void zr_to_mpz(mpz_ptr z, element_ptr e) {
+    ZrEngine *engine = ZR_ENGINE(e);
+    mp_limb_t a[ZR_MAX_LIMBS] = {1};
+    // convert out of Montgomery form
+    engine->mul(a, ZR_LIMBS(e), a, engine->mod, engine->inv);
+    mpz_import(z, engine->limbs, -1, sizeof(mp_limb_t), 0, 0, a);
+}
+
+static void zr_set(element_ptr e, element_ptr a) {
+    memcpy(e->data, a->data, ZR_ENGINE(e)->limbs * sizeof(mp_limb_t));
+}
+
+static void zr_set0(element_ptr e) {
+    memset(e->data, 0, ZR_ENGINE(e)->limbs * sizeof(mp_limb_t));
+}
+
+static void zr_set1(element_ptr e) {
+    memcpy(e->data, ZR_ENGINE(e)->one, ZR_ENGINE(e)->limbs * sizeof(mp_limb_t));
+}
+
+static int zr_is0(element_ptr e) {
+    return mpn_zero_p(ZR_LIMBS(e), ZR_ENGINE(e)->limbs);
+}
+
+static int zr_is1(element_ptr e) {
+    return mpn_cmp(ZR_LIMBS(e), ZR_ENGINE(e)->one, ZR_ENGINE(e)->limbs) == 0;
+}
+
+static int zr_cmp(element_ptr a, element_ptr b) {
+    return mpn_cmp(ZR_LIMBS(a), ZR_LIMBS(b), ZR_ENGINE(a)->limbs) != 0;
+}
+
+static void zr_add(element_ptr n, element_ptr a, element_ptr b) {
+    ZrEngine *engine = ZR_ENGINE(n);
+    mp_limb_t carry = mpn_add_n(ZR_LIMBS(n), ZR_LIMBS(a), ZR_LIMBS(b), engine->limbs);
+    if (carry || mpn_cmp(ZR_LIMBS(n), engine->mod, engine->limbs) >= 0) {
+        mpn_sub_n(ZR_LIMBS(n), ZR_LIMBS(n), engine->mod, engine->limbs);
+    }
+}
+
+static void zr_sub(element_ptr n, element_ptr a, element_ptr b) {
+    ZrEngine *engine = ZR_ENGINE(n);
+    if (mpn_sub_n(ZR_LIMBS(n), ZR_LIMBS(a), ZR_LIMBS(b), engine->limbs)) {
+        mpn_add_n(ZR_LIMBS(n), ZR_LIMBS(n), engine->mod, engine->limbs);
+    }
+}
+
+static void zr_neg(element_ptr n, element_ptr a) {
+    ZrEngine *engine = ZR_ENGINE(n);
+    if (mpn_zero_p(ZR_LIMBS(a), engine->limbs)) {
+        zr_set0(n);
+    } else {
+        mpn_sub_n(ZR_LIMBS(n), engine->mod, ZR_LIMBS(a), engine->limbs);
+    }
+}
+
+static void zr_double(element_ptr n, element_ptr a) {
+    zr_add(n, a, a);
+}
+
+static void zr_halve(element_ptr n, element_ptr a) {
+    ZrEngine *engine = ZR_ENGINE(n);
+    mp_limb_t carry = 0;
+    // make the value even by adding the (odd) modulus, then shift it right
+    if (ZR_LIMBS(a)[0] & 1) {
+        carry = mpn_add_n(ZR_LIMBS(n), ZR_LIMBS(a), engine->mod, engine->limbs);
+    } else {
+        zr_set(n, a);
+    }
+    mpn_rshift(ZR_LIMBS(n), ZR_LIMBS(n), engine->limbs, 1);
+    ZR_LIMBS(n)[engine->limbs - 1] |= carry << (GMP_LIMB_BITS - 1);
+}
+
+static void zr_mul(element_ptr n, element_ptr a, element_ptr b) {
+    ZrEngine *engine = ZR_ENGINE(n);
+    engine->mul(ZR_LIMBS(n), ZR_LIMBS(a), ZR_LIMBS(b), engine->mod, engine->inv);
+}
+
+static void zr_square(element_ptr n, element_ptr a) {
+    ZrEngine *engine = ZR_ENGINE(n);
+    engine->mul(ZR_LIMBS(n), ZR_LIMBS(a), ZR_LIMBS(a), engine->mod, engine->inv);
+}
+
+static void zr_mul_mpz(element_ptr n, element_ptr a, mpz_ptr z) {
+    mp_limb_t b[ZR_MAX_LIMBS];
+    struct element_s e = {n->field, b};
+    zr_set_mpz(&e, z);
+    zr_mul(n, a, &e);
+}
+
+static void zr_mul_si(element_ptr n, element_ptr a, signed long int i) {
+    mp_limb_t b[ZR_MAX_LIMBS];
+    struct element_s e = {n->field, b};
+    zr_set_si(&e, i);
+    zr_mul(n, a, &e);
+}
+
+// zero has no inverse, the Python operations raise ZeroDivisionError before getting here and
+// the result is then zero rather than whatever mpz_invert leaves behind
+static void zr_invert(element_ptr n, element_ptr a) {
+    mpz_t z;
+    mpz_init(z);
+    zr_to_mpz(z, a);
+    if (!mpz_invert(z, z, n->field->order)) {
+        mpz_set_ui(z, 0);
+    }
+    zr_set_mpz(n, z);
+    mpz_clear(z);
+}
+
+static void zr_div(element_ptr n, element_ptr a, element_ptr b) {
+    mp_limb_t c[ZR_MAX_LIMBS];
+    struct element_s e = {n->field, c};
+    zr_invert(&e, b);
+    zr_mul(n, a, &e);
+}
+
+static void zr_pow_mpz(element_ptr n, element_ptr a, mpz_ptr z) {
+    ZrEngine *engine = ZR_ENGINE(n);
+    mp_limb_t base[ZR_MAX_LIMBS];
+    mp_limb_t acc[ZR_MAX_LIMBS];
+    struct element_s e = {n->field, base};
+    // negative exponents invert the base first
+    if (mpz_sgn(z) < 0) {
+        zr_invert(&e, a);
+    } else {
+        zr_set(&e, a);
+    }
+    // left-to-right square and multiply over the absolute value of the exponent
+    mpz_t k;
+    mpz_init(k);
+    mpz_abs(k, z);
+    memcpy(acc, engine->one, engine->limbs * sizeof(mp_limb_t));
+    for (long i = (long)mpz_sizeinbase(k, 2) - 1; i >= 0; i--) {
+        engine->mul(acc, acc, acc, engine->mod, engine->inv);
+        if (mpz_tstbit(k, i)) {
+            engine->mul(acc, acc, base, engine->mod, engine->inv);
+        }
+    }
+    mpz_clear(k);
+    memcpy(n->data, acc, engine->limbs * sizeof(mp_limb_t));
+}
+
+// the following operations are rare, so they go through the original PBC field
+
+// copy a Zr element into an element of the original PBC field
+static void zr_to_pbc(element_ptr out, element_ptr e) {
+    mpz_t z;
+    mpz_init(z);
+    zr_to_mpz(z, e);
+    element_set_mpz(out, z);
+    mpz_clear(z);
+}
+
+// copy an element of the original PBC field into a Zr element
+static void zr_from_pbc(element_ptr e, element_ptr in) {
+    mpz_t z;
+    mpz_init(z);
+    element_to_mpz(z, in);
+    zr_set_mpz(e, z);
+    mpz_clear(z);
+}
+
+static void zr_random(element_ptr e) {
+    element_t t;
+    element_init(t, ZR_ENGINE(e)->pbc_field);
+    element_random(t);
+    zr_from_pbc(e, t);
+    element_clear(t);
+}
+
+static void zr_from_hash(element_ptr e, void *data, int len) {
+    element_t t;
+    element_init(t, ZR_ENGINE(e)->pbc_field);
+    element_from_hash(t, data, len);
+    zr_from_pbc(e, t);
+    element_clear(t);
+}
+
+static int zr_is_sqr(element_ptr e) {
+    element_t t;
+    element_init(t, ZR_ENGINE(e)->pbc_field);
+    zr_to_pbc(t, e);
+    int result = element_is_sqr(t);
+    element_clear(t);
+    return result;
+}
+
+static void zr_sqrt(element_ptr n, element_ptr a) {
+    element_t t;
+    element_init(t, ZR_ENGINE(n)->pbc_field);
+    zr_to_pbc(t, a);
+    element_sqrt(t, t);
+    zr_from_pbc(n, t);
+    element_clear(t);
+}
+
+static int zr_sign(element_ptr e) {
+    element_t t;
+    element_init(t, ZR_ENGINE(e)->pbc_field);
+    zr_to_pbc(t, e);
+    int result = element_sign(t);
+    element_clear(t);
+    return result;
+}
+
+static int zr_set_str(element_ptr e, const char *s, int base) {
+    element_t t;
+    element_init(t, ZR_ENGINE(e)->pbc_field);
+    int result = element_set_str(t, s, base);
+    zr_from_pbc(e, t);
+    element_clear(t);
+    return result;
+}
+
+static size_t zr_out_str(FILE *stream, int base, element_ptr e) {
+    element_t t;
+    element_init(t, ZR_ENGINE(e)->pbc_field);
+    zr_to_pbc(t, e);
+    size_t result = element_out_str(stream, base, t);
+    element_clear(t);
+    return result;
+}
+
+static int zr_snprint(char *s, size_t n, element_ptr e) {
+    element_t t;
+    element_init(t, ZR_ENGINE(e)->pbc_field);
+    zr_to_pbc(t, e);
+    int result = element_snprint(s, n, t);
+    element_clear(t);
+    return result;
+}
+
+// Zr elements are encoded as fixed-length big-endian integers, as in PBC
+static int zr_length_in_bytes(element_ptr e) {
+    return e->field->fixed_length_in_bytes;
+}
+
+static int zr_to_bytes(unsigned char *data, element_ptr e) {
+    int size = e->field->fixed_length_in_bytes;
+    size_t count;
+    mpz_t z;
+    mpz_init(z);
+    zr_to_mpz(z, e);
+    count = (mpz_sizeinbase(z, 2) + 7) / 8;
+    memset(data, 0, size);
+    mpz_export(data + size - count, NULL, 1, 1, 1, 0, z);
+    mpz_clear(z);
+    return size;
+}
+
+static int zr_from_bytes(element_ptr e, unsigned char *data) {
+    int size = e->field->fixed_length_in_bytes;
+    mpz_t z;
+    mpz_init(z);
+    mpz_import(z, size, 1, 1, 1, 0, data);
+    zr_set_mpz(e, z);
+    mpz_clear(z);
+    return size;
+}
+
+static void zr_field_clear(field_ptr f) {
+    ZrEngine *engine = (ZrEngine *)f->data;
+    // release the original PBC field we kept around for the rare operations
+    field_clear(engine->pbc_field);
+    pbc_free(engine->pbc_field);
+    pbc_free(engine);
+}
+
+// replace the Zr field of a freshly initialized pairing with the engine, if r has a supported size
+int zr_engine_install(pairing_ptr pairing) {
+    field_ptr f = pairing->Zr;
+    int limbs = mpz_size(f->order);
+    // only the sizes we have specialized kernels for, and only before any element of Zr exists
+    if ((limbs != 3 && limbs != 4 && limbs != 8) || mpz_even_p(f->order) || f->nqr) {
+        return 0;
+    }
+    // set up the Montgomery constants
+    ZrEngine *engine = pbc_malloc(sizeof(ZrEngine));
+    memset(engine, 0, sizeof(ZrEngine));
+    engine->limbs = limbs;
+    zr_limbs_from_mpz(engine->mod, limbs, f->order);
+    mp_limb_t inv = engine->mod[0];
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - engine->mod[0] * inv;
+    }
+    engine->inv = -inv;
+    mpz_t z;
+    mpz_init(z);
+    mpz_setbit(z, limbs * GMP_LIMB_BITS);
+    mpz_mod(z, z, f->order);
+    zr_limbs_from_mpz(engine->one, limbs, z);
+    mpz_set_ui(z, 0);
+    mpz_setbit(z, 2 * limbs * GMP_LIMB_BITS);
+    mpz_mod(z, z, f->order);
+    zr_limbs_from_mpz(engine->r2, limbs, z);
+    mpz_clear(z);
+    // pick the multiplication kernel
+    switch (limbs) {
+    case 3: engine->mul = zr_mul_3; break;
+    case 4: engine->mul = zr_mul_4; break;
+    case 8: engine->mul = zr_mul_8; break;
+    }
+#ifdef PYPBC_ZR_ADX
+    if (zr_cpu_has_adx()) {
+        switch (limbs) {
+        case 3: engine->mul = zr_mul_adx_3; break;
+        case 4: engine->mul = zr_mul_adx_4; break;
+        case 8: engine->mul = zr_mul_adx_8; break;
+        }
+    }
+#endif
+    // move the original field out of the pairing, it keeps ownership of its own data
+    engine->pbc_field = pbc_malloc(sizeof(struct field_s));
+    memcpy(engine->pbc_field, f, sizeof(struct field_s));
+    // and build the new field in its place
+    field_init(f);
+    mpz_set(f->order, engine->pbc_field->order);
+    f->pairing = engine->pbc_field->pairing;
+    f->name = engine->pbc_field->name;
+    f->fixed_length_in_bytes = engine->pbc_field->fixed_length_in_bytes;
+    f->data = engine;
+    f->field_clear = zr_field_clear;
+    f->init = zr_init;
+    f->clear = zr_clear;
+    f->set_mpz = zr_set_mpz;
+    f->set_si = zr_set_si;
+    f->to_mpz = zr_to_mpz;
+    f->set = zr_set;
+    f->set0 = zr_set0;
+    f->set1 = zr_set1;
+    f->is0 = zr_is0;
+    f->is1 = zr_is1;
+    f->cmp = zr_cmp;
+    f->add = zr_add;
+    f->sub = zr_sub;
+    f->neg = zr_neg;
+    f->doub = zr_double;
+    f->halve = zr_halve;
+    f->mul = zr_mul;
+    f->square = zr_square;
+    f->mul_mpz = zr_mul_mpz;
+    f->mul_si = zr_mul_si;
+    f->invert = zr_invert;
+    f->div = zr_div;
+    f->pow_mpz = zr_pow_mpz;
+    f->random = zr_random;
+    f->from_hash = zr_from_hash;
+    f->is_sqr = zr_is_sqr;
+    f->sqrt = zr_sqrt;
+    f->sign = zr_sign;
+    f->set_str = zr_set_str;
+    f->out_str = zr_out_str;
+    f->snprint = zr_snprint;
+    f->length_in_bytes = zr_length_in_bytes;
+    f->to_bytes = zr_to_bytes;
+    f->from_bytes = zr_from_bytes;
+    return 1;
+}
+
+#else
+
+// no 128-bit arithmetic on this platform, Zr stays with PBC's implementation
+int zr_engine_install(pairing_ptr pairing) {
+    return 0;
+}
+
+#endif
+
+/*******************************************************************************
+*                                    Curves                                    *
+*******************************************************************************/
+
+// find q, a and b of y^2 = x^3 + ax + b when G1 is a curve over a prime field with
+// x and y as the byte representation, returns the size of one coordinate or 0
+int g1_curve_coefficients(pairing_ptr pairing, mpz_t q, mpz_t a, mpz_t b) {
+    int coord_bytes = 0;
+    element_t P, Q;
+    element_init_G1(P, pairing);
+    element_init_G1(Q, pairing);
+    element_random(P);
+    if (element_item_count(P) != 2 || element_item_count(element_item(P, 0)) != 0 || element_length_in_bytes(P) != 2 * element_length_in_bytes(element_item(P, 0))) {
+        goto done;
+    }
+    mpz_set(q, element_item(P, 0)->field->order);
+    if (mpz_even_p(q)) {
+        goto done;
+    }
+    coord_bytes = element_length_in_bytes(element_item(P, 0));
+    // recover a from two points with different x: y^2 - x^3 = ax + b
+    mpz_t x1, y1, x2, y2, t1, t2;
+    mpz_inits(x1, y1, x2, y2, t1, t2, NULL);
+    element_to_mpz(x1, element_item(P, 0));
+    element_to_mpz(y1, element_item(P, 1));
+    do {
+        element_random(Q);
+        element_to_mpz(x2, element_item(Q, 0));
+        element_to_mpz(y2, element_item(Q, 1));
+    } while (element_is0(Q) || mpz_cmp(x1, x2) == 0);
+    mpz_mul(a, x1, x1);
+    mpz_mul(a, a, x1);
+    mpz_mul(t1, y1, y1);
+    mpz_sub(t1, t1, a);
+    mpz_mul(a, x2, x2);
+    mpz_mul(a, a, x2);
+    mpz_mul(t2, y2, y2);
+    mpz_sub(t2, t2, a);
+    mpz_sub(b, t1, t2);
+    mpz_sub(t2, x1, x2);
+    mpz_mod(t2, t2, q);
+    mpz_invert(t2, t2, q);
+    mpz_mul(a, b, t2);
+    mpz_mod(a, a, q);
+    // then b from either point
+    mpz_submul(t1, a, x1);
+    mpz_mod(b, t1, q);
+    mpz_clears(x1, y1, x2, y2, t1, t2, NULL);
+done:
+    element_clear(P);
+    element_clear(Q);
+    return coord_bytes;
+}
+
+// Compressed points are x followed by one byte telling the sign of y. PBC takes a
+// general Tonelli-Shanks square root for every point; when q = 3 mod 4 (as for type
+// A pairings) the root of t is simply t^((q + 1) / 4), one exponentiation, so the
+// batch decoder takes that path and splits the points over several threads.
+
+struct G1Curve {
+    mpz_t q;
+    mpz_t a;
+    mpz_t b;
+    mpz_t root;      // (q + 1) / 4
+    int coord_bytes;
+};
+
+G1Curve *g1_curve_create(pairing_ptr pairing) {
+    G1Curve *c = PyMem_RawMalloc(sizeof(G1Curve));
+    if (!c) {
+        return NULL;
+    }
+    mpz_inits(c->q, c->a, c->b, c->root, NULL);
+    c->coord_bytes = g1_curve_coefficients(pairing, c->q, c->a, c->b);
+    // only q = 3 mod 4 has the simple square root
+    if (c->coord_bytes == 0 || mpz_fdiv_ui(c->q, 4) != 3) {
+        g1_curve_free(c);
+        return NULL;
+    }
+    mpz_add_ui(c->root, c->q, 1);
+    mpz_fdiv_q_2exp(c->root, c->root, 2);
+    return c;
+}
+
+void g1_curve_free(G1Curve *c) {
+    mpz_clears(c->q, c->a, c->b, c->root, NULL);
+    PyMem_RawFree(c);
+}
+
+// write v as a big-endian number of exactly size bytes
+static void mpz_to_be(unsigned char *data, size_t size, mpz_t v) {
+    size_t count = (mpz_sizeinbase(v, 2) + 7) / 8;
+    memset(data, 0, size - count);
+    mpz_export(data + size - count, NULL, 1, 1, 1, 0, v);
+}
+
+// decompress one point like element_from_bytes_compressed, x that is not on the curve gives the identity
+static void g1_curve_decompress(G1Curve *c, element_ptr out, const unsigned char *data, unsigned char *buffer, mpz_t x, mpz_t y, mpz_t t) {
+    mpz_import(x, c->coord_bytes, 1, 1, 1, 0, data);
+    mpz_mod(x, x, c->q);
+    // t = x^3 + ax + b
+    mpz_mul(t, x, x);
+    mpz_add(t, t, c->a);
+    mpz_mul(t, t, x);
+    mpz_add(t, t, c->b);
+    mpz_mod(t, t, c->q);
+    mpz_powm(y, t, c->root, c->q);
+    // the root is only right when t is a square
+    mpz_mul(x, y, y);
+    mpz_mod(x, x, c->q);
+    if (mpz_cmp(x, t) != 0) {
+        element_set1(out);
+        return;
+    }
+    // set the point from x and y, then pick the sign of y the same way PBC does
+    memcpy(buffer, data, c->coord_bytes);
+    mpz_to_be(buffer + c->coord_bytes, c->coord_bytes, y);
+    element_from_bytes(out, buffer);
+    int sign = element_sign(element_item(out, 1));
+    if (data[c->coord_bytes] ? sign < 0 : sign > 0) {
+        element_neg(out, out);
+    }
+}
+
+#define DECOMPRESS_MAX_THREADS 64
+
+typedef struct {
+    G1Curve *curve;
+    int (*decode)(element_ptr, unsigned char *);
+    element_ptr *outs;
+    const unsigned char *data;
+    int size;
+    Py_ssize_t begin;
+    Py_ssize_t end;
+} DecompressJob;
+
+static void *decompress_job_run(void *arg) {
+    DecompressJob *job = arg;
+    if (job->curve) {
+        unsigned char *buffer = PyMem_RawMalloc(2 * job->curve->coord_bytes);
+        if (buffer) {
+            mpz_t x, y, t;
+            mpz_inits(x, y, t, NULL);
+            for (Py_ssize_t i = job->begin; i < job->end; i++) {
+                g1_curve_decompress(job->curve, job->outs[i], job->data + i * job->size, buffer, x, y, t);
+            }
+            mpz_clears(x, y, t, NULL);
+            PyMem_RawFree(buffer);
+            return NULL;
+        }
+    }
+    // without the fast path, the decoder does the work
+    for (Py_ssize_t i = job->begin; i < job->end; i++) {
+        job->decode(job->outs[i], (unsigned char *)job->data + i * job->size);
+    }
+    return NULL;
+}
+
+// decompress count packed points of size bytes each, with the fast path of the curve when
+// given and with decode otherwise, which must be safe to call from several threads
+void decompress_batch(G1Curve *curve, int (*decode)(element_ptr, unsigned char *), element_ptr *outs, const unsigned char *data, int size, Py_ssize_t count, int threads) {
+    DecompressJob jobs[DECOMPRESS_MAX_THREADS];
+    pthread_t ids[DECOMPRESS_MAX_THREADS];
+    int started[DECOMPRESS_MAX_THREADS] = {0};
+    if (threads > count) {
+        threads = count;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > DECOMPRESS_MAX_THREADS) {
+        threads = DECOMPRESS_MAX_THREADS;
+    }
+    // split the points evenly, and run the first share on the calling thread
+    for (int k = 0; k < threads; k++) {
+        jobs[k].curve = curve;
+        jobs[k].decode = decode;
+        jobs[k].outs = outs;
+        jobs[k].data = data;
+        jobs[k].size = size;
+        jobs[k].begin = count * k / threads;
+        jobs[k].end = count * (k + 1) / threads;
+    }
+    for (int k = 1; k < threads; k++) {
+        started[k] = pthread_create(&ids[k], NULL, decompress_job_run, &jobs[k]) == 0;
+    }
+    decompress_job_run(&jobs[0]);
+    for (int k = 1; k < threads; k++) {
+        if (started[k]) {
+            pthread_join(ids[k], NULL);
+        } else {
+            decompress_job_run(&jobs[k]);
+        }
+    }
+}
+
+/*******************************************************************************
+*                                    Torus                                     *
+*******************************************************************************/
+
+// With embedding degree 2, GT is the subgroup of Fq[i] / (i^2 - v) whose elements
+// a + bi have norm a^2 - vb^2 = 1. Such an element is determined by the single
+// coordinate c = (1 + a) / b of the torus T2, and a + bi = (c^2 + v + 2ci) / (c^2 - v),
+// which halves the size of the encoding. The identity, where b = 0, is encoded as
+// c = 0, which no other element of norm 1 maps to.
+
+// find v by squaring i, returns the size of one coordinate, or 0 when GT has another
+// shape, in which case v is left uninitialized
+int gt_torus_setup(field_ptr gt, element_ptr v) {
+    element_t e;
+    element_init(e, gt);
+    int coord_bytes = 0;
+    if (element_item_count(e) == 2 && element_item_count(element_item(e, 0)) == 0) {
+        element_set0(element_item(e, 0));
+        element_set1(element_item(e, 1));
+        element_square(e, e);
+        element_init_same_as(v, element_item(e, 0));
+        element_set(v, element_item(e, 0));
+        coord_bytes = element_length_in_bytes(v);
+    }
+    element_clear(e);
+    return coord_bytes;
+}
+
+int gt_length_in_bytes_compressed(field_ptr gt) {
+    element_t v;
+    int coord_bytes = gt_torus_setup(gt, v);
+    if (coord_bytes) {
+        element_clear(v);
+    }
+    return coord_bytes;
+}
+
+// write c = (1 + a) / b, returns the size written, or -1 when the element is not unitary
+int gt_to_bytes_compressed(unsigned char *data, element_ptr e) {
+    element_t v, t, u;
+    int coord_bytes = gt_torus_setup(e->field, v);
+    if (!coord_bytes) {
+        return -1;
+    }
+    element_ptr a = element_item(e, 0);
+    element_ptr b = element_item(e, 1);
+    element_init_same_as(t, v);
+    element_init_same_as(u, v);
+    // check that a^2 - vb^2 = 1
+    element_square(t, b);
+    element_mul(t, t, v);
+    element_square(u, a);
+    element_sub(t, u, t);
+    int result = coord_bytes;
+    if (!element_is1(t)) {
+        result = -1;
+    } else if (element_is0(b)) {
+        // only the identity has b = 0 and a = 1, -1 is not in any subgroup of odd order
+        if (element_is1(a)) {
+            memset(data, 0, coord_bytes);
+        } else {
+            result = -1;
+        }
+    } else {
+        element_set1(t);
+        element_add(t, t, a);
+        element_invert(u, b);
+        element_mul(t, t, u);
+        element_to_bytes(data, t);
+    }
+    element_clear(v);
+    element_clear(t);
+    element_clear(u);
+    return result;
+}
+
+// set the element from c, returns the size read
+int gt_from_bytes_compressed(element_ptr e, unsigned char *data) {
+    element_t v, c, s, d;
+    int coord_bytes = gt_torus_setup(e->field, v);
+    element_init_same_as(c, v);
+    element_init_same_as(s, v);
+    element_init_same_as(d, v);
+    element_from_bytes(c, data);
+    if (element_is0(c)) {
+        element_set1(e);
+    } else {
+        // d = 1 / (c^2 - v), which exists because v is not a square
+        element_square(s, c);
+        element_sub(d, s, v);
+        element_invert(d, d);
+        // a = (c^2 + v) d, b = 2cd
+        element_add(s, s, v);
+        element_mul(element_item(e, 0), s, d);
+        element_double(s, c);
+        element_mul(element_item(e, 1), s, d);
+    }
+    element_clear(v);
+    element_clear(c);
+    element_clear(s);
+    element_clear(d);
+    return coord_bytes;
+}
+
+// The elements of norm 1 are the unitary ones, and pairing outputs always are. Their
+// inverse is the conjugate a - bi, and their square (2a^2 - 1) + 2abi takes one
+// multiplication and one squaring in Fq, so exponentiation can use signed digits
+// without any inversion.
+
+void gt_unitary_invert(element_ptr out, element_ptr e) {
+    element_set(out, e);
+    element_neg(element_item(out, 1), element_item(out, 1));
+}
+
+// square a unitary element in place, t is a temporary in Fq
+static void gt_unitary_square(element_ptr e, element_ptr t) {
+    element_ptr a = element_item(e, 0);
+    element_ptr b = element_item(e, 1);
+    element_mul(t, a, b);
+    element_double(b, t);
+    element_square(t, a);
+    element_double(t, t);
+    element_set1(a);
+    element_sub(a, t, a);
+}
+
+// raise a unitary element to the power given by its width-w NAF, least significant digit first
+void gt_unitary_pow(element_ptr out, element_ptr base, signed char *digits, Py_ssize_t length, int window) {
+    if (length == 0) {
+        element_set1(out);
+        return;
+    }
+    // the odd powers of the base and their conjugates
+    int half = 1 << (window - 2);
+    element_t table[64];
+    element_t acc, t;
+    element_init_same_as(acc, base);
+    element_init_same_as(t, element_item(base, 0));
+    element_set(acc, base);
+    gt_unitary_square(acc, t);
+    for (int i = 0; i < half; i++) {
+        element_init_same_as(table[i], base);
+        if (i == 0) {
+            element_set(table[i], base);
+        } else {
+            element_mul(table[i], table[i - 1], acc);
+        }
+        element_init_same_as(table[half + i], base);
+        gt_unitary_invert(table[half + i], table[i]);
+    }
+    // left to right over the digits, starting from the leading one
+    element_set(acc, digits[length - 1] > 0 ? table[(digits[length - 1] - 1) / 2] : table[half + (-digits[length - 1] - 1) / 2]);
+    for (Py_ssize_t i = length - 2; i >= 0; i--) {
+        gt_unitary_square(acc, t);
+        if (digits[i] > 0) {
+            element_mul(acc, acc, table[(digits[i] - 1) / 2]);
+        } else if (digits[i] < 0) {
+            element_mul(acc, acc, table[half + (-digits[i] - 1) / 2]);
+        }
+    }
+    element_set(out, acc);
+    // clean up
+    for (int i = 0; i < 2 * half; i++) {
+        element_clear(table[i]);
+    }
+    element_clear(acc);
+    element_clear(t);
+}
+
+// raise a unitary element with the given window, or with one picked from the size of the exponent when 0
+void gt_unitary_pow_mpz(element_ptr out, element_ptr base, mpz_t exp, int window) {
+    size_t bits = mpz_sizeinbase(exp, 2);
+    signed char *digits = PyMem_RawMalloc(bits + 1);
+    if (!digits) {
+        element_pow_mpz(out, base, exp);
+        return;
+    }
+    if (window < 2) {
+        window = naf_window(bits);
+    }
+    Py_ssize_t length = naf_recode(digits, exp, window);
+    gt_unitary_pow(out, base, digits, length, window);
+    PyMem_RawFree(digits);
+}
+
+/*******************************************************************************
+*                                 Miller Loop                                  *
+*******************************************************************************/
+
+// PBC only exposes the whole pairing. For type A pairings, the symmetric pairing of
+// y^2 = x^3 + x over Fq with q = 3 mod 4 into Fq[i] with i^2 = -1, we run the Miller
+// loop of f_r,P at the distorted point (-x, iy) of Q ourselves in affine coordinates.
+// The vertical lines take values in Fq, which the final exponentiation by
+// (q^2 - 1) / r sends to 1, so they are left out. Which argument is iterated and
+// whether the result is conjugated are found once by comparing with pairing_apply,
+// so the values match PBC's pairing whatever its conventions. So is the multiple of
+// the point the loop ends on: r, r - 1 and r + 1 give the same pairing in the
+// subgroup of order r but not outside it, so they are compared on a point outside.
+
+struct MillerCurve {
+    mpz_t q;
+    mpz_t r;
+    mpz_t cofactor; // (q + 1) / r, the part of the final exponent after q - 1
+    mpz_t length;   // the multiple of the iterated point the loop ends on
+    int swap;       // iterate on the second argument
+    int conjugate;  // conjugate the accumulated value
+};
+
+// f = f * (a + bi) in Fq[i], t and u are temporaries
+static void miller_mul(MillerCurve *m, mpz_t f0, mpz_t f1, mpz_t a, mpz_t b, mpz_t t, mpz_t u) {
+    mpz_mul(t, f0, a);
+    mpz_submul(t, f1, b);
+    mpz_mul(u, f0, b);
+    mpz_addmul(u, f1, a);
+    mpz_mod(f0, t, m->q);
+    mpz_mod(f1, u, m->q);
+}
+
+// T = 2T, giving the tangent at T as lambda and c = lambda xt - yt, 0 when it is vertical
+static int miller_double(MillerCurve *m, mpz_t xt, mpz_t yt, mpz_t lambda, mpz_t c, mpz_t t) {
+    if (mpz_sgn(yt) == 0) {
+        return 0;
+    }
+    mpz_mul(lambda, xt, xt);
+    mpz_mul_ui(lambda, lambda, 3);
+    mpz_add_ui(lambda, lambda, 1);
+    mpz_mul_2exp(t, yt, 1);
+    mpz_invert(t, t, m->q);
+    mpz_mul(lambda, lambda, t);
+    mpz_mod(lambda, lambda, m->q);
+    mpz_mul(c, lambda, xt);
+    mpz_sub(c, c, yt);
+    mpz_mod(c, c, m->q);
+    // x = lambda^2 - 2xt and y = lambda (xt - x) - yt = c - lambda x
+    mpz_mul(t, lambda, lambda);
+    mpz_submul_ui(t, xt, 2);
+    mpz_mod(xt, t, m->q);
+    mpz_set(yt, c);
+    mpz_submul(yt, lambda, xt);
+    mpz_mod(yt, yt, m->q);
+    return 1;
+}
+
+// T = T + P, giving the chord through T and P as lambda and c, 0 when it is vertical, as it
+// is for T = -P, which ends the loop
+static int miller_add(MillerCurve *m, mpz_t xt, mpz_t yt, mpz_t xp, mpz_t yp, mpz_t lambda, mpz_t c, mpz_t t) {
+    if (mpz_cmp(xt, xp) == 0) {
+        return 0;
+    }
+    mpz_sub(lambda, yp, yt);
+    mpz_sub(t, xp, xt);
+    mpz_invert(t, t, m->q);
+    mpz_mul(lambda, lambda, t);
+    mpz_mod(lambda, lambda, m->q);
+    mpz_mul(c, lambda, xt);
+    mpz_sub(c, c, yt);
+    mpz_mod(c, c, m->q);
+    mpz_mul(t, lambda, lambda);
+    mpz_sub(t, t, xt);
+    mpz_sub(t, t, xp);
+    mpz_mod(xt, t, m->q);
+    mpz_set(yt, c);
+    mpz_submul(yt, lambda, xt);
+    mpz_mod(yt, yt, m->q);
+    return 1;
+}
+
+// g = g times the line Y - yt - lambda (X - xt) at (-xq, i yq), which is lambda xq + c + i yq
+static void miller_line(MillerCurve *m, mpz_t g0, mpz_t g1, mpz_t lambda, mpz_t c, mpz_t xq, mpz_t yq, mpz_t l0, mpz_t t, mpz_t u) {
+    mpz_mul(l0, lambda, xq);
+    mpz_add(l0, l0, c);
+    miller_mul(m, g0, g1, l0, yq, t, u);
+}
+
+// g = g^2 in Fq[i]
+static void miller_square(MillerCurve *m, mpz_t g0, mpz_t g1, mpz_t t) {
+    mpz_mul(t, g0, g1);
+    mpz_mul(g0, g0, g0);
+    mpz_submul(g0, g1, g1);
+    mpz_mod(g0, g0, m->q);
+    mpz_mul_2exp(g1, t, 1);
+    mpz_mod(g1, g1, m->q);
+}
+
+// f = f * f_r,P(-xq, i yq), the points are given by their affine coordinates
+static void miller_accumulate(MillerCurve *m, mpz_t f0, mpz_t f1, mpz_t xp, mpz_t yp, mpz_t xq, mpz_t yq) {
+    mpz_t g0, g1, xt, yt, lambda, c, l0, t, u;
+    mpz_inits(g0, g1, xt, yt, lambda, c, l0, t, u, NULL);
+    mpz_set_ui(g0, 1);
+    mpz_set(xt, xp);
+    mpz_set(yt, yp);
+    for (size_t bit = mpz_sizeinbase(m->length, 2) - 1; bit-- > 0;) {
+        miller_square(m, g0, g1, t);
+        if (!miller_double(m, xt, yt, lambda, c, t)) {
+            break;
+        }
+        miller_line(m, g0, g1, lambda, c, xq, yq, l0, t, u);
+        if (!mpz_tstbit(m->length, bit)) {
+            continue;
+        }
+        if (!miller_add(m, xt, yt, xp, yp, lambda, c, t)) {
+            break;
+        }
+        miller_line(m, g0, g1, lambda, c, xq, yq, l0, t, u);
+    }
+    miller_mul(m, f0, f1, g0, g1, t, u);
+    mpz_clears(g0, g1, xt, yt, lambda, c, l0, t, u, NULL);
+}
+
+// multiply out by the Miller values of the pairs of G1 and G2 elements, out is in the field of GT
+void miller_loop(MillerCurve *m, element_ptr out, element_ptr *lefts, element_ptr *rights, Py_ssize_t count) {
+    mpz_t f0, f1, xp, yp, xq, yq;
+    mpz_inits(f0, f1, xp, yp, xq, yq, NULL);
+    mpz_set_ui(f0, 1);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        // the identity on either side contributes 1
+        if (element_is0(lefts[i]) || element_is0(rights[i])) {
+            continue;
+        }
+        element_ptr p = m->swap ? rights[i] : lefts[i];
+        element_ptr q = m->swap ? lefts[i] : rights[i];
+        element_to_mpz(xp, element_item(p, 0));
+        element_to_mpz(yp, element_item(p, 1));
+        element_to_mpz(xq, element_item(q, 0));
+        element_to_mpz(yq, element_item(q, 1));
+        miller_accumulate(m, f0, f1, xp, yp, xq, yq);
+    }
+    if (m->conjugate) {
+        mpz_sub(f1, m->q, f1);
+        mpz_mod(f1, f1, m->q);
+    }
+    // the value continues the one already in out
+    element_t value;
+    element_init_same_as(value, out);
+    element_set_mpz(element_item(value, 0), f0);
+    element_set_mpz(element_item(value, 1), f1);
+    element_mul(out, out, value);
+    element_clear(value);
+    mpz_clears(f0, f1, xp, yp, xq, yq, NULL);
+}
+
+// raise a Miller value to (q^2 - 1) / r: the power q - 1 is the conjugate divided by the
+// value, which is unitary, so the power (q + 1) / r takes the unitary exponentiation
+void miller_final_exponentiation(MillerCurve *m, element_ptr out, element_ptr value) {
+    element_t t;
+    element_init_same_as(t, value);
+    element_invert(t, value);
+    gt_unitary_invert(out, value);
+    element_mul(out, out, t);
+    gt_unitary_pow_mpz(out, out, m->cofactor, 0);
+    element_clear(t);
+}
+
+// set P to a random point of y^2 = x^3 + x outside the subgroup of order r, decoded from
+// its x coordinate since element_random multiplies by the cofactor, or return -1 without memory
+static int miller_point_outside(MillerCurve *m, element_ptr P) {
+    element_t x, rhs, t;
+    element_init_same_as(x, element_item(P, 0));
+    element_init_same_as(rhs, x);
+    element_init_same_as(t, P);
+    int size = element_length_in_bytes(x);
+    unsigned char *bytes = PyMem_RawMalloc(size);
+    int status = bytes ? 0 : -1;
+    if (bytes) {
+        do {
+            do {
+                element_random(x);
+                element_square(rhs, x);
+                element_mul(rhs, rhs, x);
+                element_add(rhs, rhs, x);
+            } while (element_is0(rhs) || !element_is_sqr(rhs));
+            element_to_bytes(bytes, x);
+            element_from_bytes_x_only(P, bytes);
+            element_pow_mpz(t, P, m->r);
+        } while (element_is0(t));
+        PyMem_RawFree(bytes);
+    }
+    element_clear(x);
+    element_clear(rhs);
+    element_clear(t);
+    return status;
+}
+
+MillerCurve *miller_curve_create(pairing_ptr pairing) {
+    if (pairing->G1 != pairing->G2) {
+        return NULL;
+    }
+    MillerCurve *m = PyMem_RawMalloc(sizeof(MillerCurve));
+    if (!m) {
+        return NULL;
+    }
+    mpz_inits(m->q, m->r, m->cofactor, m->length, NULL);
+    mpz_set(m->r, pairing->r);
+    // the curve must be y^2 = x^3 + x with q = 3 mod 4, and GT must have i^2 = -1
+    mpz_t a, b;
+    mpz_inits(a, b, NULL);
+    int coord_bytes = g1_curve_coefficients(pairing, m->q, a, b);
+    int shape = coord_bytes && mpz_cmp_ui(a, 1) == 0 && mpz_sgn(b) == 0 && mpz_fdiv_ui(m->q, 4) == 3;
+    element_t v;
+    if (shape && gt_torus_setup(pairing->GT, v)) {
+        element_to_mpz(a, v);
+        mpz_add_ui(a, a, 1);
+        shape = mpz_cmp(a, m->q) == 0;
+        element_clear(v);
+    } else {
+        shape = 0;
+    }
+    mpz_clears(a, b, NULL);
+    if (!shape) {
+        miller_curve_free(m);
+        return NULL;
+    }
+    mpz_add_ui(m->cofactor, m->q, 1);
+    mpz_divexact(m->cofactor, m->cofactor, m->r);
+    // find the conventions of PBC on one random pair, whose G1 side is outside the subgroup
+    element_t P, Q, expected, value;
+    element_init_G1(P, pairing);
+    element_init_G2(Q, pairing);
+    element_init_GT(expected, pairing);
+    element_init_GT(value, pairing);
+    if (miller_point_outside(m, P) < 0) {
+        element_clear(P);
+        element_clear(Q);
+        element_clear(expected);
+        element_clear(value);
+        miller_curve_free(m);
+        return NULL;
+    }
+    do {
+        element_random(Q);
+    } while (element_is0(Q));
+    pairing_apply(expected, P, Q, pairing);
+    element_ptr lefts[1] = {P};
+    element_ptr rights[1] = {Q};
+    int found = 0;
+    for (int mode = 0; mode < 12 && !found; mode++) {
+        m->swap = mode & 1;
+        m->conjugate = (mode >> 1) & 1;
+        mpz_set(m->length, m->r);
+        if (mode >> 2 == 1) {
+            mpz_sub_ui(m->length, m->length, 1);
+        } else if (mode >> 2 == 2) {
+            mpz_add_ui(m->length, m->length, 1);
+        }
+        element_set1(value);
+        miller_loop(m, value, lefts, rights, 1);
+        miller_final_exponentiation(m, value, value);
+        found = element_cmp(value, expected) == 0;
+    }
+    element_clear(P);
+    element_clear(Q);
+    element_clear(expected);
+    element_clear(value);
+    if (!found) {
+        miller_curve_free(m);
+        return NULL;
+    }
+    return m;
+}
+
+void miller_curve_free(MillerCurve *m) {
+    mpz_clears(m->q, m->r, m->cofactor, m->length, NULL);
+    PyMem_RawFree(m);
+}
+
+// PBC's pairings of types D and F, on MNT and BN curves, are Tate pairings whose loop runs
+// on the G1 argument over the bits of r. Their G2 is a twist E' of the curve over the field
+// Fqd of the coefficients of GT = Fqd[W] / (W^e - alpha), and the ate pairing runs its loop
+// on the G2 argument instead, on the twist, over the bits of t - 1, which has half the bits
+// of r on these curves. Its lines only depend on the G2 point, so they can be kept, and
+// their value at a point of G1 is y + s x W^i + c W^j, whose product with an element of GT
+// takes 2e multiplications in Fqd instead of e^2. PBC's pairing is a fixed power of the ate
+// pairing, -k / (t L) with L = ((t - 1)^k - 1) / r up to a power of q, so the lines are
+// those of that multiple of the G2 point; the power of q is found once by comparing with
+// pairing_apply, as are the twist and the places of the line in GT.
+
+struct AteCurve {
+    pairing_ptr pairing;
+    mpz_t loop;            // |t - 1|
+    int negative;          // t - 1 < 0, so the value is inverted
+    mpz_t scalar;          // the multiple of the G2 point whose ate pairing is PBC's pairing
+    int check_g1;          // G1 has a cofactor, so its points are checked to be of order r
+    int items;             // e
+    int slope_item;        // i, the power of W of the slope of a line
+    int const_item;        // j, the power of W of its constant
+    element_t a;           // the coefficient of x of the twist
+    element_t alpha;       // W^e
+    element_t slope_scale; // the factors of the slope and the constant of the twist in GT
+    element_t const_scale;
+};
+
+struct AteLines {
+    Py_ssize_t count;
+    unsigned char *tangent; // 0 for a chord, 1 for a tangent, 2 for the last squaring alone
+    element_t *coeffs;      // s = -lambda and c = lambda xt - yt of each line, scaled for GT
+};
+
+// T = 2T on the twist, giving the tangent at T as lambda and c = lambda xt - yt, 0 when it is
+// vertical
+static int ate_double(AteCurve *a, element_ptr xt, element_ptr yt, element_ptr lambda, element_ptr c, element_ptr t) {
+    if (element_is0(yt)) {
+        return 0;
+    }
+    element_square(lambda, xt);
+    element_double(t, lambda);
+    element_add(lambda, lambda, t);
+    element_add(lambda, lambda, a->a);
+    element_double(t, yt);
+    element_invert(t, t);
+    element_mul(lambda, lambda, t);
+    element_mul(c, lambda, xt);
+    element_sub(c, c, yt);
+    // x = lambda^2 - 2xt and y = c - lambda x
+    element_square(t, lambda);
+    element_sub(t, t, xt);
+    element_sub(xt, t, xt);
+    element_mul(t, lambda, xt);
+    element_sub(yt, c, t);
+    return 1;
+}
+
+// T = T + Q on the twist, giving the chord through T and Q as lambda and c, 0 when it is
+// vertical
+static int ate_add(element_ptr xt, element_ptr yt, element_ptr xq, element_ptr yq, element_ptr lambda, element_ptr c, element_ptr t) {
+    if (element_cmp(xt, xq) == 0) {
+        return 0;
+    }
+    element_sub(lambda, yq, yt);
+    element_sub(t, xq, xt);
+    element_invert(t, t);
+    element_mul(lambda, lambda, t);
+    element_mul(c, lambda, xt);
+    element_sub(c, c, yt);
+    element_square(t, lambda);
+    element_sub(t, t, xt);
+    element_sub(xt, t, xq);
+    element_mul(t, lambda, xt);
+    element_sub(yt, c, t);
+    return 1;
+}
+
+// the coefficients of a line in GT, from lambda and c on the twist
+static void ate_scale(AteCurve *a, element_ptr s, element_ptr c, element_ptr lambda, element_ptr constant) {
+    element_mul(s, lambda, a->slope_scale);
+    element_neg(s, s);
+    element_mul(c, constant, a->const_scale);
+}
+
+// the lines of the loop of a point of G2 of order r, or NULL without memory
+AteLines *ate_lines_create(AteCurve *a, element_ptr point) {
+    size_t bits = mpz_sizeinbase(a->loop, 2);
+    AteLines *lines = PyMem_RawMalloc(sizeof(AteLines));
+    unsigned char *tangent = PyMem_RawMalloc(2 * bits);
+    element_t *coeffs = PyMem_RawMalloc(4 * bits * sizeof(element_t));
+    if (!lines || !tangent || !coeffs) {
+        PyMem_RawFree(lines);
+        PyMem_RawFree(tangent);
+        PyMem_RawFree(coeffs);
+        return NULL;
+    }
+    lines->count = 0;
+    lines->tangent = tangent;
+    lines->coeffs = coeffs;
+    element_t q, xt, yt, lambda, c, t;
+    element_init_same_as(q, point);
+    element_pow_mpz(q, point, a->scalar);
+    element_ptr xq = element_item(q, 0);
+    element_ptr yq = element_item(q, 1);
+    element_init_same_as(xt, xq);
+    element_init_same_as(yt, xq);
+    element_init_same_as(lambda, xq);
+    element_init_same_as(c, xq);
+    element_init_same_as(t, xq);
+    element_set(xt, xq);
+    element_set(yt, yq);
+    for (size_t bit = bits - 1; bit-- > 0;) {
+        element_ptr s = coeffs[2 * lines->count];
+        element_ptr k = coeffs[2 * lines->count + 1];
+        element_init_same_as(s, xq);
+        element_init_same_as(k, xq);
+        if (!ate_double(a, xt, yt, lambda, c, t)) {
+            // the loop squares before it finds the vertical tangent
+            tangent[lines->count++] = 2;
+            break;
+        }
+        ate_scale(a, s, k, lambda, c);
+        tangent[lines->count++] = 1;
+        if (!mpz_tstbit(a->loop, bit)) {
+            continue;
+        }
+        s = coeffs[2 * lines->count];
+        k = coeffs[2 * lines->count + 1];
+        element_init_same_as(s, xq);
+        element_init_same_as(k, xq);
+        if (!ate_add(xt, yt, xq, yq, lambda, c, t)) {
+            element_clear(s);
+            element_clear(k);
+            break;
+        }
+        ate_scale(a, s, k, lambda, c);
+        tangent[lines->count++] = 0;
+    }
+    element_clear(q);
+    element_clear(xt);
+    element_clear(yt);
+    element_clear(lambda);
+    element_clear(c);
+    element_clear(t);
+    return lines;
+}
+
+void ate_lines_free(AteLines *lines) {
+    for (Py_ssize_t k = 0; k < 2 * lines->count; k++) {
+        element_clear(lines->coeffs[k]);
+    }
+    PyMem_RawFree(lines->tangent);
+    PyMem_RawFree(lines->coeffs);
+    PyMem_RawFree(lines);
+}
+
+// acc = acc + f v W^m for f in GT and v in Fqd, the powers of W past e - 1 coming back
+// multiplied by alpha; t and u are temporaries
+static void ate_mul_term(AteCurve *a, element_t *acc, element_ptr f, element_ptr v, int m, element_ptr t, element_ptr u) {
+    element_mul(u, v, a->alpha);
+    for (int j = 0; j < a->items; j++) {
+        int i = j + m < a->items ? j + m : j + m - a->items;
+        element_mul(t, element_item(f, j), j + m < a->items ? v : u);
+        element_add(acc[i], acc[i], t);
+    }
+}
+
+// f = f (y + s x W^i + c W^j), acc holds e + 3 temporaries of Fqd
+static void ate_mul_line(AteCurve *a, element_ptr f, element_ptr s, element_ptr c, mpz_t x, mpz_t y, element_t *acc) {
+    int e = a->items;
+    for (int j = 0; j < e; j++) {
+        element_mul_mpz(acc[j], element_item(f, j), y);
+    }
+    element_mul_mpz(acc[e + 2], s, x);
+    if (a->slope_item == a->const_item) {
+        element_add(acc[e + 2], acc[e + 2], c);
+    } else {
+        ate_mul_term(a, acc, f, c, a->const_item, acc[e], acc[e + 1]);
+    }
+    ate_mul_term(a, acc, f, acc[e + 2], a->slope_item, acc[e], acc[e + 1]);
+    for (int j = 0; j < e; j++) {
+        element_set(element_item(f, j), acc[j]);
+    }
+}
+
+// out = the product of the pairings of the points of G1, which the curve accepts, with the
+// G2 points of the lines, out is in GT; sets of the same shape, which is the case of all
+// points of order r, share one chain of squarings and all share the final exponentiation
+void ate_evaluate(AteCurve *a, element_ptr out, AteLines **lines, element_ptr *points, Py_ssize_t count) {
+    element_t g;
+    element_t acc[9];
+    element_init_same_as(g, out);
+    for (int j = 0; j < a->items + 3; j++) {
+        element_init_same_as(acc[j], a->alpha);
+    }
+    // the coordinates of the points are converted once, or line by line without memory
+    mpz_t x, y;
+    mpz_t *coords = count ? PyMem_RawMalloc(2 * count * sizeof(mpz_t)) : NULL;
+    mpz_inits(x, y, NULL);
+    for (Py_ssize_t i = 0; i < count && coords; i++) {
+        mpz_init(coords[2 * i]);
+        mpz_init(coords[2 * i + 1]);
+        element_to_mpz(coords[2 * i], element_item(points[i], 0));
+        element_to_mpz(coords[2 * i + 1], element_item(points[i], 1));
+    }
+    element_set1(out);
+    int shared = 1;
+    for (Py_ssize_t i = 1; i < count && shared; i++) {
+        shared = lines[i]->count == lines[0]->count && memcmp(lines[i]->tangent, lines[0]->tangent, lines[0]->count) == 0;
+    }
+    for (Py_ssize_t first = 0; first < count; first = shared ? count : first + 1) {
+        Py_ssize_t last = shared ? count : first + 1;
+        element_set1(g);
+        for (Py_ssize_t k = 0; k < lines[first]->count; k++) {
+            if (lines[first]->tangent[k]) {
+                element_square(g, g);
+            }
+            if (lines[first]->tangent[k] == 2) {
+                continue;
+            }
+            for (Py_ssize_t i = first; i < last; i++) {
+                if (coords) {
+                    ate_mul_line(a, g, lines[i]->coeffs[2 * k], lines[i]->coeffs[2 * k + 1], coords[2 * i], coords[2 * i + 1], acc);
+                } else {
+                    element_to_mpz(x, element_item(points[i], 0));
+                    element_to_mpz(y, element_item(points[i], 1));
+                    ate_mul_line(a, g, lines[i]->coeffs[2 * k], lines[i]->coeffs[2 * k + 1], x, y, acc);
+                }
+            }
+        }
+        element_mul(out, out, g);
+    }
+    if (a->negative) {
+        element_invert(out, out);
+    }
+    a->pairing->finalpow(out);
+    if (coords) {
+        for (Py_ssize_t i = 0; i < 2 * count; i++) {
+            mpz_clear(coords[i]);
+        }
+        PyMem_RawFree(coords);
+    }
+    mpz_clears(x, y, NULL);
+    for (int j = 0; j < a->items + 3; j++) {
+        element_clear(acc[j]);
+    }
+    element_clear(g);
+}
+
+// whether the ate pairing gives PBC's value at a point of G1, which it does for the points of
+// order r, that is all of them when G1 has no cofactor
+int ate_curve_accepts(AteCurve *a, element_ptr point) {
+    if (!a->check_g1) {
+        return 1;
+    }
+    element_t power;
+    element_init_same_as(power, point);
+    element_pow_mpz(power, point, a->pairing->r);
+    int member = element_is1(power);
+    element_clear(power);
+    return member;
+}
+
+// find where the twist of G2 sends the lines in GT from a point of G2: y^2 = x^3 + b / alpha
+// (then x W^2 and y W^3 are on the curve) or x^3 + b alpha (x / W^2 and y / W^3) for a sextic
+// twist, y^2 = x^3 + a s^2 x + b s^3 (x / s and y / s^(3/2)) with s = alpha or 1 / alpha for
+// a quadratic one
+static int ate_curve_twist(AteCurve *a, element_ptr point, mpz_t ca, mpz_t cb) {
+    element_ptr x = element_item(point, 0);
+    element_ptr y = element_item(point, 1);
+    element_t lhs, rhs, s, t, inverse;
+    element_init_same_as(lhs, x);
+    element_init_same_as(rhs, x);
+    element_init_same_as(s, x);
+    element_init_same_as(t, x);
+    element_init_same_as(inverse, x);
+    element_invert(inverse, a->alpha);
+    element_square(lhs, y);
+    element_square(t, x);
+    element_mul(t, t, x);
+    element_sub(lhs, lhs, t);
+    int found = 0;
+    for (int option = 0; option < 2 && !found; option++) {
+        element_set(s, option ? inverse : a->alpha);
+        if (a->items == 6) {
+            // y^2 - x^3 = b alpha^-1 or b alpha
+            element_set0(a->a);
+            element_mul_mpz(rhs, option ? a->alpha : inverse, cb);
+            found = mpz_sgn(ca) == 0 && element_cmp(lhs, rhs) == 0;
+            a->slope_item = option ? 5 : 1;
+            a->const_item = 3;
+            if (option) {
+                element_set(a->slope_scale, inverse);
+            } else {
+                element_set1(a->slope_scale);
+            }
+            element_set(a->const_scale, a->slope_scale);
+        } else {
+            // y^2 - x^3 = a s^2 x + b s^3
+            element_square(t, s);
+            element_mul_mpz(a->a, t, ca);
+            element_mul(t, t, s);
+            element_mul_mpz(rhs, t, cb);
+            element_mul(t, a->a, x);
+            element_add(rhs, rhs, t);
+            found = element_cmp(lhs, rhs) == 0;
+            // the line is y - lambda W / alpha x + c W / alpha^2 for s = alpha, and
+            // y - lambda W x + c alpha W for s = 1 / alpha
+            a->slope_item = 1;
+            a->const_item = 1;
+            if (option) {
+                element_set1(a->slope_scale);
+                element_set(a->const_scale, a->alpha);
+            } else {
+                element_set(a->slope_scale, inverse);
+                element_square(a->const_scale, inverse);
+            }
+        }
+    }
+    element_clear(lhs);
+    element_clear(rhs);
+    element_clear(s);
+    element_clear(t);
+    element_clear(inverse);
+    return found;
+}
+
+AteCurve *ate_curve_create(pairing_ptr pairing) {
+    if (pairing->G1 == pairing->G2 || !pairing->finalpow) {
+        return NULL;
+    }
+    // GT must be Fqd[W] / (W^e - alpha) with Fqd the field of the coordinates of G2
+    element_t w, P, Q, expected, value;
+    element_init_GT(w, pairing);
+    element_init_G1(P, pairing);
+    element_init_G2(Q, pairing);
+    do {
+        element_random(P);
+        element_random(Q);
+    } while (element_is0(P) || element_is0(Q));
+    int items = element_item_count(w);
+    if ((items != 2 && items != 6) || element_item_count(Q) != 2 || element_item(Q, 0)->field != element_item(w, 0)->field ||
+        element_item_count(element_item(w, 0)) < 2 || element_item_count(element_item(element_item(w, 0), 0)) != 0) {
+        element_clear(w);
+        element_clear(P);
+        element_clear(Q);
+        return NULL;
+    }
+    AteCurve *a = PyMem_RawMalloc(sizeof(AteCurve));
+    if (!a) {
+        element_clear(w);
+        element_clear(P);
+        element_clear(Q);
+        return NULL;
+    }
+    a->pairing = pairing;
+    a->items = items;
+    int k = items * element_item_count(element_item(w, 0));
+    mpz_inits(a->loop, a->scalar, NULL);
+    element_init_same_as(a->a, element_item(w, 0));
+    element_init_same_as(a->alpha, element_item(w, 0));
+    element_init_same_as(a->slope_scale, element_item(w, 0));
+    element_init_same_as(a->const_scale, element_item(w, 0));
+    element_init_GT(expected, pairing);
+    element_init_GT(value, pairing);
+    mpz_t q, ca, cb, t, n;
+    mpz_inits(q, ca, cb, t, n, NULL);
+    int found = 0;
+    AteLines *lines = NULL;
+    // alpha = W^e, with nothing else
+    for (int j = 0; j < items; j++) {
+        element_set0(element_item(w, j));
+    }
+    element_set1(element_item(w, 1));
+    element_set(value, w);
+    for (int j = 1; j < items; j++) {
+        element_mul(value, value, w);
+    }
+    int shape = 1;
+    for (int j = 1; j < items; j++) {
+        shape = shape && element_is0(element_item(value, j));
+    }
+    element_set(a->alpha, element_item(value, 0));
+    if (!shape || element_is0(a->alpha) || !g1_curve_coefficients(pairing, q, ca, cb) || mpz_cmp(element_item(element_item(w, 0), 0)->field->order, q) != 0 ||
+        !ate_curve_twist(a, Q, ca, cb)) {
+        goto done;
+    }
+    // t = q + 1 mod r, which is the trace when r > 4 sqrt(q), and G1 has (q + 1 - t) / r points of
+    // each order
+    mpz_add_ui(t, q, 1);
+    mpz_mod(t, t, pairing->r);
+    mpz_tdiv_q_2exp(n, pairing->r, 1);
+    if (mpz_cmp(t, n) > 0) {
+        mpz_sub(t, t, pairing->r);
+    }
+    mpz_mul(n, t, t);
+    mpz_submul_ui(n, q, 4);
+    if (mpz_sgn(n) > 0) {
+        goto done;
+    }
+    mpz_add_ui(n, q, 1);
+    mpz_sub(n, n, t);
+    if (!mpz_divisible_p(n, pairing->r)) {
+        goto done;
+    }
+    a->check_g1 = mpz_cmp(n, pairing->r) != 0;
+    mpz_sub_ui(a->loop, t, 1);
+    a->negative = mpz_sgn(a->loop) < 0;
+    mpz_abs(a->loop, a->loop);
+    if (mpz_cmp_ui(a->loop, 2) < 0) {
+        goto done;
+    }
+    // the multiple -k / (t L) of the G2 point, with L = ((t - 1)^k - 1) / r
+    mpz_sub_ui(n, t, 1);
+    mpz_pow_ui(n, n, k);
+    mpz_sub_ui(n, n, 1);
+    if (!mpz_divisible_p(n, pairing->r)) {
+        goto done;
+    }
+    mpz_divexact(n, n, pairing->r);
+    mpz_mul(n, n, t);
+    mpz_mod(n, n, pairing->r);
+    if (!mpz_invert(a->scalar, n, pairing->r)) {
+        goto done;
+    }
+    mpz_mul_si(a->scalar, a->scalar, -k);
+    mpz_mod(a->scalar, a->scalar, pairing->r);
+    // then the power of q on one random pair
+    pairing_apply(expected, P, Q, pairing);
+    lines = ate_lines_create(a, Q);
+    if (!lines || element_is1(expected)) {
+        goto done;
+    }
+    element_ptr points[1] = {P};
+    ate_evaluate(a, value, &lines, points, 1);
+    mpz_mod(q, q, pairing->r);
+    for (int i = 0; i < k && !found; i++) {
+        found = element_cmp(value, expected) == 0;
+        if (!found) {
+            element_pow_mpz(value, value, q);
+            mpz_mul(a->scalar, a->scalar, q);
+            mpz_mod(a->scalar, a->scalar, pairing->r);
+        }
+    }
+done:
+    if (lines) {
+        ate_lines_free(lines);
+    }
+    mpz_clears(q, ca, cb, t, n, NULL);
+    element_clear(w);
+    element_clear(P);
+    element_clear(Q);
+    element_clear(expected);
+    element_clear(value);
+    if (!found) {
+        ate_curve_free(a);
+        return NULL;
+    }
+    return a;
+}
+
+void ate_curve_free(AteCurve *a) {
+    mpz_clears(a->loop, a->scalar, NULL);
+    element_clear(a->a);
+    element_clear(a->alpha);
+    element_clear(a->slope_scale);
+    element_clear(a->const_scale);
+    PyMem_RawFree(a);
+}
+
+// the product of the pairings of in1[i] and in2[i], out is in GT; PBC's element_prod_pairing
+// gives 1 for the whole product as soon as one argument is the identity, so the pairs with
+// the identity on either side, which pair to 1, are left out before calling it
+void prod_pairing_nonzero(element_ptr out, element_t *in1, element_t *in2, Py_ssize_t count, pairing_ptr pairing) {
+    Py_ssize_t kept = 0;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        kept += !element_is0(in1[i]) && !element_is0(in2[i]);
+    }
+    element_t *lefts = in1;
+    element_t *rights = in2;
+    if (kept < count) {
+        // the remaining arguments are only read, so they are shared with the caller's
+        lefts = PyMem_RawMalloc((kept + 1) * sizeof(element_t));
+        rights = PyMem_RawMalloc((kept + 1) * sizeof(element_t));
+        for (Py_ssize_t i = 0, j = 0; lefts && rights && i < count; i++) {
+            if (!element_is0(in1[i]) && !element_is0(in2[i])) {
+                lefts[j][0] = in1[i][0];
+                rights[j][0] = in2[i][0];
+                j++;
+            }
+        }
+    }
+    element_set1(out);
+    if (lefts && rights) {
+        // element_prod_pairing takes an int count
+        element_t part;
+        element_init_GT(part, pairing);
+        for (Py_ssize_t first = 0; first < kept; first += INT_MAX) {
+            int chunk = kept - first < INT_MAX ? (int)(kept - first) : INT_MAX;
+            element_prod_pairing(part, lefts + first, rights + first, chunk);
+            element_mul(out, out, part);
+        }
+        element_clear(part);
+    } else {
+        // without memory for the remaining pairs, they are paired one by one
+        element_t part;
+        element_init_GT(part, pairing);
+        for (Py_ssize_t i = 0; i < count; i++) {
+            pairing_apply(part, in1[i], in2[i], pairing);
+            element_mul(out, out, part);
+        }
+        element_clear(part);
+    }
+    if (lefts != in1) {
+        PyMem_RawFree(lefts);
+        PyMem_RawFree(rights);
+    }
+}
+
+/*******************************************************************************
+*                                    Lanes                                     *
+*******************************************************************************/
+
+// Independent exponentiations in G1 only share the curve, so we can run several
+// of them side by side in SIMD lanes. Field elements are kept in Montgomery form
+// split into radix 2^52 limbs (AVX-512 IFMA, 8 lanes) or radix 2^26 limbs (AVX2
+// and the portable fallback, 4 lanes), stored limb-major so that limb j of all
+// lanes is one vector. The points use Jacobian coordinates on y^2 = x^3 + ax + b,
+// which covers G1 of type A and type F pairings (and any other G1 over a prime
+// field). Lanes that hit an exceptional case of the addition formula are
+// recomputed with PBC, so the results are always identical to Element_pow.
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PYPBC_LANES_X86
+#include <immintrin.h>
+#endif
+
+#define LANE_MAX_WORDS 160 // 20 limbs of 52 bits in 8 lanes, or 40 limbs of 26 bits in 4 lanes
+#define LANE_MAX_LANES 8
+#define LANE_WINDOW 4
+
+typedef struct LaneField LaneField;
+
+struct LaneField {
+    int lanes;                    // number of values processed together
+    int limbs;                    // limbs per value
+    int radix;                    // bits per limb
+    uint64_t mask;                // 2^radix - 1
+    uint64_t inv;                 // -q^-1 mod 2^radix
+    uint64_t mod[LANE_MAX_WORDS]; // q, one limb per entry
+    void (*mul)(uint64_t *z, const uint64_t *x, const uint64_t *y, const LaneField *f);
+};
+
+// propagate the carries of an unreduced value below 2q held in r, subtract q if needed and store it in lane l
+static void lane_reduce_one(uint64_t *z, const uint64_t *r, int l, const LaneField *f) {
+    int n = f->limbs, lanes = f->lanes;
+    uint64_t s[LANE_MAX_WORDS], d[LANE_MAX_WORDS];
+    uint64_t carry = 0;
+    for (int j = 0; j < n; j++) {
+        uint64_t v = r[j] + carry;
+        s[j] = v & f->mask;
+        carry = v >> f->radix;
+    }
+    int64_t borrow = 0;
+    for (int j = 0; j < n; j++) {
+        int64_t v = (int64_t)s[j] - (int64_t)f->mod[j] - borrow;
+        borrow = v < 0;
+        d[j] = (uint64_t)v & f->mask;
+    }
+    // the value is at least q if it overflowed the limbs or the subtraction did not borrow
+    const uint64_t *res = (carry || !borrow) ? d : s;
+    for (int j = 0; j < n; j++) {
+        z[j * lanes + l] = res[j];
+    }
+}
+
+// the same for all lanes of a vector in limb-major layout
+static void lane_reduce(uint64_t *z, const uint64_t *t, const LaneField *f) {
+    uint64_t r[LANE_MAX_WORDS];
+    for (int l = 0; l < f->lanes; l++) {
+        for (int j = 0; j < f->limbs; j++) {
+            r[j] = t[j * f->lanes + l];
+        }
+        lane_reduce_one(z, r, l, f);
+    }
+}
+
+// portable Montgomery multiplication, radix 2^26 so the products fit in 64 bits
+static void lane_mul_scalar(uint64_t *z, const uint64_t *x, const uint64_t *y, const LaneField *f) {
+    int n = f->limbs, lanes = f->lanes;
+    for (int l = 0; l < lanes; l++) {
+        uint64_t t[LANE_MAX_WORDS] = {0};
+        for (int i = 0; i < n; i++) {
+            uint64_t yi = y[i * lanes + l];
+            for (int j = 0; j < n; j++) {
+                t[j] += x[j * lanes + l] * yi;
+            }
+            uint64_t u = (t[0] * f->inv) & f->mask;
+            for (int j = 0; j < n; j++) {
+                t[j] += u * f->mod[j];
+            }
+            // the lowest limb is now divisible by the radix, shift it out
+            t[1] += t[0] >> f->radix;
+            for (int j = 0; j < n - 1; j++) {
+                t[j] = t[j + 1];
+            }
+            t[n - 1] = 0;
+        }
+        lane_reduce_one(z, t, l, f);
+    }
+}
+
+#ifdef PYPBC_LANES_X86
+// the same multiplication on 4 lanes at once with AVX2
+__attribute__((target("avx2")))
+static void lane_mul_avx2(uint64_t *z, const uint64_t *x, const uint64_t *y, const LaneField *f) {
+    int n = f->limbs;
+    __m256i t[LANE_MAX_WORDS / 4];
+    __m256i mask = _mm256_set1_epi64x(f->mask);
+    __m256i inv = _mm256_set1_epi64x(f->inv);
+    uint64_t out[LANE_MAX_WORDS];
+    for (int j = 0; j < n; j++) {
+        t[j] = _mm256_setzero_si256();
+    }
+    for (int i = 0; i < n; i++) {
+        __m256i yi = _mm256_loadu_si256((const __m256i *)(y + i * 4));
+        for (int j = 0; j < n; j++) {
+            __m256i xj = _mm256_loadu_si256((const __m256i *)(x + j * 4));
+            t[j] = _mm256_add_epi64(t[j], _mm256_mul_epu32(xj, yi));
+        }
+        __m256i u = _mm256_and_si256(_mm256_mul_epu32(t[0], inv), mask);
+        for (int j = 0; j < n; j++) {
+            t[j] = _mm256_add_epi64(t[j], _mm256_mul_epu32(u, _mm256_set1_epi64x(f->mod[j])));
+        }
+        t[1] = _mm256_add_epi64(t[1], _mm256_srli_epi64(t[0], 26));
+        for (int j = 0; j < n - 1; j++) {
+            t[j] = t[j + 1];
+        }
+        t[n - 1] = _mm256_setzero_si256();
+    }
+    for (int j = 0; j < n; j++) {
+        _mm256_storeu_si256((__m256i *)(out + j * 4), t[j]);
+    }
+    lane_reduce(z, out, f);
+}
+
+// radix 2^52 on 8 lanes with the AVX-512 IFMA 52-bit multiply-accumulate instructions
+__attribute__((target("avx512f,avx512ifma")))
+static void lane_mul_ifma(uint64_t *z, const uint64_t *x, const uint64_t *y, const LaneField *f) {
+    int n = f->limbs;
+    __m512i t[LANE_MAX_WORDS / 8 + 1];
+    __m512i zero = _mm512_setzero_si512();
+    __m512i inv = _mm512_set1_epi64(f->inv);
+    uint64_t out[LANE_MAX_WORDS];
+    for (int j = 0; j <= n; j++) {
+        t[j] = zero;
+    }
+    for (int i = 0; i < n; i++) {
+        __m512i yi = _mm512_loadu_si512(y + i * 8);
+        for (int j = 0; j < n; j++) {
+            __m512i xj = _mm512_loadu_si512(x + j * 8);
+            t[j] = _mm512_madd52lo_epu64(t[j], xj, yi);
+            t[j + 1] = _mm512_madd52hi_epu64(t[j + 1], xj, yi);
+        }
+        __m512i u = _mm512_madd52lo_epu64(zero, t[0], inv);
+        for (int j = 0; j < n; j++) {
+            __m512i mj = _mm512_set1_epi64(f->mod[j]);
+            t[j] = _mm512_madd52lo_epu64(t[j], u, mj);
+            t[j + 1] = _mm512_madd52hi_epu64(t[j + 1], u, mj);
+        }
+        t[1] = _mm512_add_epi64(t[1], _mm512_srli_epi64(t[0], 52));
+        for (int j = 0; j < n; j++) {
+            t[j] = t[j + 1];
+        }
+        t[n] = zero;
+    }
+    for (int j = 0; j < n; j++) {
+        _mm512_storeu_si512(out + j * 8, t[j]);
+    }
+    lane_reduce(z, out, f);
+}
+#endif
+
+static void lane_add(uint64_t *z, const uint64_t *x, const uint64_t *y, const LaneField *f) {
+    uint64_t r[LANE_MAX_WORDS];
+    for (int l = 0; l < f->lanes; l++) {
+        for (int j = 0; j < f->limbs; j++) {
+            r[j] = x[j * f->lanes + l] + y[j * f->lanes + l];
+        }
+        lane_reduce_one(z, r, l, f);
+    }
+}
+
+static void lane_sub(uint64_t *z, const uint64_t *x, const uint64_t *y, const LaneField *f) {
+    int n = f->limbs, lanes = f->lanes;
+    for (int l = 0; l < lanes; l++) {
+        uint64_t r[LANE_MAX_WORDS];
+        int64_t borrow = 0;
+        for (int j = 0; j < n; j++) {
+            int64_t v = (int64_t)x[j * lanes + l] - (int64_t)y[j * lanes + l] - borrow;
+            borrow = v < 0;
+            r[j] = (uint64_t)v & f->mask;
+        }
+        // add q back if the difference was negative
+        if (borrow) {
+            uint64_t carry = 0;
+            for (int j = 0; j < n; j++) {
+                uint64_t v = r[j] + f->mod[j] + carry;
+                r[j] = v & f->mask;
+                carry = v >> f->radix;
+            }
+        }
+        for (int j = 0; j < n; j++) {
+            z[j * lanes + l] = r[j];
+        }
+    }
+}
+
+static int lane_is0(const uint64_t *x, int l, const LaneField *f) {
+    for (int j = 0; j < f->limbs; j++) {
+        if (x[j * f->lanes + l]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void lane_copy(uint64_t *z, const uint64_t *x, int l, const LaneField *f) {
+    for (int j = 0; j < f->limbs; j++) {
+        z[j * f->lanes + l] = x[j * f->lanes + l];
+    }
+}
+
+// the curve y^2 = x^3 + ax + b of G1, b is never needed by the formulas
+struct G1Lanes {
+    LaneField field;
+    mpz_t q;
+    mpz_t rinv;                 // R^-1 mod q, to convert out of Montgomery form
+    uint64_t a[LANE_MAX_WORDS]; // a in Montgomery form, in every lane
+    int a_is0;
+    int coord_bytes;            // size of one coordinate in the byte representation
+};
+
+// load a number below q into lane l, converting it into Montgomery form
+static void g1_lanes_load(G1Lanes *g, uint64_t *x, int l, mpz_t v) {
+    LaneField *f = &g->field;
+    mpz_t t;
+    mpz_init(t);
+    mpz_mul_2exp(t, v, f->limbs * f->radix);
+    mpz_mod(t, t, g->q);
+    for (int j = 0; j < f->limbs; j++) {
+        x[j * f->lanes + l] = mpz_get_ui(t) & f->mask;
+        mpz_fdiv_q_2exp(t, t, f->radix);
+    }
+    mpz_clear(t);
+}
+
+// read lane l back into a number below q
+static void g1_lanes_store(G1Lanes *g, mpz_t v, const uint64_t *x, int l) {
+    LaneField *f = &g->field;
+    mpz_set_ui(v, 0);
+    for (int j = f->limbs - 1; j >= 0; j--) {
+        mpz_mul_2exp(v, v, f->radix);
+        mpz_add_ui(v, v, x[j * f->lanes + l]);
+    }
+    mpz_mul(v, v, g->rinv);
+    mpz_mod(v, v, g->q);
+}
+
+// Jacobian doubling (dbl-2007-bl), the outputs may alias the inputs
+static void g1_lanes_double(G1Lanes *g, uint64_t *X3, uint64_t *Y3, uint64_t *Z3, const uint64_t *X1, const uint64_t *Y1, const uint64_t *Z1) {
+    LaneField *f = &g->field;
+    uint64_t XX[LANE_MAX_WORDS], YY[LANE_MAX_WORDS], YYYY[LANE_MAX_WORDS], ZZ[LANE_MAX_WORDS];
+    uint64_t S[LANE_MAX_WORDS], M[LANE_MAX_WORDS], T[LANE_MAX_WORDS];
+    f->mul(XX, X1, X1, f);
+    f->mul(YY, Y1, Y1, f);
+    f->mul(YYYY, YY, YY, f);
+    f->mul(ZZ, Z1, Z1, f);
+    // S = 2((X1 + YY)^2 - XX - YYYY)
+    lane_add(S, X1, YY, f);
+    f->mul(S, S, S, f);
+    lane_sub(S, S, XX, f);
+    lane_sub(S, S, YYYY, f);
+    lane_add(S, S, S, f);
+    // M = 3XX + a ZZ^2
+    lane_add(M, XX, XX, f);
+    lane_add(M, M, XX, f);
+    if (!g->a_is0) {
+        f->mul(T, ZZ, ZZ, f);
+        f->mul(T, T, g->a, f);
+        lane_add(M, M, T, f);
+    }
+    // Z3 = (Y1 + Z1)^2 - YY - ZZ
+    lane_add(T, Y1, Z1, f);
+    f->mul(T, T, T, f);
+    lane_sub(T, T, YY, f);
+    lane_sub(Z3, T, ZZ, f);
+    // X3 = M^2 - 2S
+    f->mul(T, M, M, f);
+    lane_sub(T, T, S, f);
+    lane_sub(X3, T, S, f);
+    // Y3 = M(S - X3) - 8YYYY
+    lane_sub(T, S, X3, f);
+    f->mul(T, M, T, f);
+    lane_add(YYYY, YYYY, YYYY, f);
+    lane_add(YYYY, YYYY, YYYY, f);
+    lane_add(YYYY, YYYY, YYYY, f);
+    lane_sub(Y3, T, YYYY, f);
+}
+
+// Jacobian addition (add-2007-bl), flags the lanes where both inputs have the same x
+static void g1_lanes_add(G1Lanes *g, uint64_t *X3, uint64_t *Y3, uint64_t *Z3, const uint64_t *X1, const uint64_t *Y1, const uint64_t *Z1, const uint64_t *X2, const uint64_t *Y2, const uint64_t *Z2, int *degenerate) {
+    LaneField *f = &g->field;
+    uint64_t Z1Z1[LANE_MAX_WORDS], Z2Z2[LANE_MAX_WORDS], U1[LANE_MAX_WORDS], U2[LANE_MAX_WORDS];
+    uint64_t S1[LANE_MAX_WORDS], S2[LANE_MAX_WORDS], H[LANE_MAX_WORDS], I[LANE_MAX_WORDS];
+    uint64_t J[LANE_MAX_WORDS], R[LANE_MAX_WORDS], V[LANE_MAX_WORDS], T[LANE_MAX_WORDS];
+    f->mul(Z1Z1, Z1, Z1, f);
+    f->mul(Z2Z2, Z2, Z2, f);
+    f->mul(U1, X1, Z2Z2, f);
+    f->mul(U2, X2, Z1Z1, f);
+    f->mul(S1, Y1, Z2, f);
+    f->mul(S1, S1, Z2Z2, f);
+    f->mul(S2, Y2, Z1, f);
+    f->mul(S2, S2, Z1Z1, f);
+    lane_sub(H, U2, U1, f);
+    for (int l = 0; l < f->lanes; l++) {
+        degenerate[l] = lane_is0(H, l, f);
+    }
+    // I = (2H)^2, J = H I, R = 2(S2 - S1), V = U1 I
+    lane_add(I, H, H, f);
+    f->mul(I, I, I, f);
+    f->mul(J, H, I, f);
+    lane_sub(R, S2, S1, f);
+    lane_add(R, R, R, f);
+    f->mul(V, U1, I, f);
+    // Z3 = ((Z1 + Z2)^2 - Z1Z1 - Z2Z2) H, kept aside until the inputs are no longer needed
+    lane_add(T, Z1, Z2, f);
+    f->mul(T, T, T, f);
+    lane_sub(T, T, Z1Z1, f);
+    lane_sub(T, T, Z2Z2, f);
+    f->mul(T, T, H, f);
+    // X3 = R^2 - J - 2V
+    f->mul(X3, R, R, f);
+    lane_sub(X3, X3, J, f);
+    lane_sub(X3, X3, V, f);
+    lane_sub(X3, X3, V, f);
+    // Y3 = R(V - X3) - 2 S1 J
+    lane_sub(V, V, X3, f);
+    f->mul(V, R, V, f);
+    f->mul(S1, S1, J, f);
+    lane_add(S1, S1, S1, f);
+    lane_sub(Y3, V, S1, f);
+    memcpy(Z3, T, f->limbs * f->lanes * sizeof(uint64_t));
+}
+
+// pick the widest backend the CPU supports
+static void lane_field_init(LaneField *f, mpz_t q) {
+    f->lanes = 4;
+    f->radix = 26;
+    f->mul = lane_mul_scalar;
+#ifdef PYPBC_LANES_X86
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma")) {
+        f->lanes = 8;
+        f->radix = 52;
+        f->mul = lane_mul_ifma;
+    } else if (__builtin_cpu_supports("avx2")) {
+        f->mul = lane_mul_avx2;
+    }
+#endif
+    f->mask = ((uint64_t)1 << f->radix) - 1;
+    f->limbs = (mpz_sizeinbase(q, 2) + f->radix - 1) / f->radix;
+    // -q^-1 mod 2^radix by Newton iteration
+    uint64_t q0 = mpz_get_ui(q);
+    uint64_t inv = q0;
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - q0 * inv;
+    }
+    f->inv = -inv & f->mask;
+    mpz_t t;
+    mpz_init_set(t, q);
+    for (int j = 0; j < f->limbs; j++) {
+        f->mod[j] = mpz_get_ui(t) & f->mask;
+        mpz_fdiv_q_2exp(t, t, f->radix);
+    }
+    mpz_clear(t);
+}
+
+G1Lanes *g1_lanes_create(pairing_ptr pairing) {
+    G1Lanes *g = NULL;
+    mpz_t q, a, b;
+    mpz_inits(q, a, b, NULL);
+    // G1 must be a curve over a prime field, with x and y as the byte representation
+    int coord_bytes = g1_curve_coefficients(pairing, q, a, b);
+    if (coord_bytes == 0 || mpz_sizeinbase(q, 2) > 40 * 26) {
+        goto done;
+    }
+    g = PyMem_RawMalloc(sizeof(G1Lanes));
+    if (!g) {
+        goto done;
+    }
+    memset(g, 0, sizeof(G1Lanes));
+    mpz_init_set(g->q, q);
+    lane_field_init(&g->field, g->q);
+    if (g->field.limbs * g->field.lanes > LANE_MAX_WORDS) {
+        mpz_clear(g->q);
+        PyMem_RawFree(g);
+        g = NULL;
+        goto done;
+    }
+    g->coord_bytes = coord_bytes;
+    mpz_init(g->rinv);
+    mpz_setbit(g->rinv, g->field.limbs * g->field.radix);
+    mpz_invert(g->rinv, g->rinv, g->q);
+    g->a_is0 = mpz_sgn(a) == 0;
+    for (int l = 0; l < g->field.lanes; l++) {
+        g1_lanes_load(g, g->a, l, a);
+    }
+done:
+    mpz_clears(q, a, b, NULL);
+    return g;
+}
+
+void g1_lanes_free(G1Lanes *g) {
+    mpz_clear(g->q);
+    mpz_clear(g->rinv);
+    PyMem_RawFree(g);
+}
+
+// raise up to one lane-width of G1 points to non-negative exponents, the results must be initialized in G1
+static void g1_lanes_pow_chunk(G1Lanes *g, element_ptr *outs, element_ptr *bases, mpz_t *exps, int count, uint64_t *table) {
+    LaneField *f = &g->field;
+    int words = f->limbs * f->lanes;
+    int lanes = f->lanes;
+    int active[LANE_MAX_LANES] = {0};
+    int tainted[LANE_MAX_LANES] = {0};
+    int inf[LANE_MAX_LANES];
+    int degenerate[LANE_MAX_LANES];
+    size_t bits = 0;
+    mpz_t x, y, z;
+    mpz_inits(x, y, z, NULL);
+    // the table holds 1P..15P for every lane, as X, Y, Z blocks of words each
+    #define LANE_ENTRY(k, c) (table + ((k) * 3 + (c)) * words)
+    uint64_t *one = LANE_ENTRY(0, 0);
+    mpz_set_ui(x, 1);
+    for (int l = 0; l < lanes; l++) {
+        g1_lanes_load(g, one, l, x);
+    }
+    // load the bases, the trivial lanes are left to PBC
+    for (int l = 0; l < lanes; l++) {
+        if (l < count && !element_is0(bases[l]) && mpz_sgn(exps[l]) > 0) {
+            element_to_mpz(x, element_item(bases[l], 0));
+            element_to_mpz(y, element_item(bases[l], 1));
+            active[l] = 1;
+            if (mpz_sizeinbase(exps[l], 2) > bits) {
+                bits = mpz_sizeinbase(exps[l], 2);
+            }
+        } else {
+            mpz_set_ui(x, 0);
+            mpz_set_ui(y, 1);
+        }
+        g1_lanes_load(g, LANE_ENTRY(1, 0), l, x);
+        g1_lanes_load(g, LANE_ENTRY(1, 1), l, y);
+        lane_copy(LANE_ENTRY(1, 2), one, l, f);
+    }
+    // fill the table
+    g1_lanes_double(g, LANE_ENTRY(2, 0), LANE_ENTRY(2, 1), LANE_ENTRY(2, 2), LANE_ENTRY(1, 0), LANE_ENTRY(1, 1), LANE_ENTRY(1, 2));
+    for (int k = 3; k < 1 << LANE_WINDOW; k++) {
+        g1_lanes_add(g, LANE_ENTRY(k, 0), LANE_ENTRY(k, 1), LANE_ENTRY(k, 2), LANE_ENTRY(k - 1, 0), LANE_ENTRY(k - 1, 1), LANE_ENTRY(k - 1, 2), LANE_ENTRY(1, 0), LANE_ENTRY(1, 1), LANE_ENTRY(1, 2), degenerate);
+        for (int l = 0; l < lanes; l++) {
+            tainted[l] |= degenerate[l];
+        }
+    }
+    // fixed-window exponentiation, all lanes share the doublings
+    uint64_t X[LANE_MAX_WORDS], Y[LANE_MAX_WORDS], Z[LANE_MAX_WORDS];
+    uint64_t SX[LANE_MAX_WORDS], SY[LANE_MAX_WORDS], SZ[LANE_MAX_WORDS];
+    uint64_t TX[LANE_MAX_WORDS], TY[LANE_MAX_WORDS], TZ[LANE_MAX_WORDS];
+    memset(X, 0, sizeof(X));
+    memset(Y, 0, sizeof(Y));
+    memset(Z, 0, sizeof(Z));
+    for (int l = 0; l < lanes; l++) {
+        inf[l] = 1;
+    }
+    for (long w = ((long)bits + LANE_WINDOW - 1) / LANE_WINDOW - 1; w >= 0; w--) {
+        for (int i = 0; i < LANE_WINDOW; i++) {
+            g1_lanes_double(g, X, Y, Z, X, Y, Z);
+        }
+        // gather the table entry of every lane
+        int digits[LANE_MAX_LANES];
+        for (int l = 0; l < lanes; l++) {
+            digits[l] = 0;
+            if (active[l]) {
+                for (int i = LANE_WINDOW - 1; i >= 0; i--) {
+                    digits[l] = digits[l] << 1 | mpz_tstbit(exps[l], w * LANE_WINDOW + i);
+                }
+            }
+            int k = digits[l] ? digits[l] : 1;
+            lane_copy(TX, LANE_ENTRY(k, 0), l, f);
+            lane_copy(TY, LANE_ENTRY(k, 1), l, f);
+            lane_copy(TZ, LANE_ENTRY(k, 2), l, f);
+        }
+        g1_lanes_add(g, SX, SY, SZ, X, Y, Z, TX, TY, TZ, degenerate);
+        // keep the sum only in the lanes that needed it
+        for (int l = 0; l < lanes; l++) {
+            if (!digits[l]) {
+                continue;
+            }
+            if (inf[l]) {
+                lane_copy(X, TX, l, f);
+                lane_copy(Y, TY, l, f);
+                lane_copy(Z, TZ, l, f);
+                inf[l] = 0;
+            } else if (degenerate[l]) {
+                tainted[l] = 1;
+            } else {
+                lane_copy(X, SX, l, f);
+                lane_copy(Y, SY, l, f);
+                lane_copy(Z, SZ, l, f);
+            }
+        }
+    }
+    #undef LANE_ENTRY
+    // convert back to affine coordinates, and let PBC redo the lanes we could not handle
+    unsigned char *buffer = PyMem_RawMalloc(2 * g->coord_bytes);
+    for (int l = 0; l < count; l++) {
+        if (!active[l] || tainted[l] || !buffer) {
+            element_pow_mpz(outs[l], bases[l], exps[l]);
+            continue;
+        }
+        if (inf[l]) {
+            element_set0(outs[l]);
+            continue;
+        }
+        g1_lanes_store(g, x, X, l);
+        g1_lanes_store(g, y, Y, l);
+        g1_lanes_store(g, z, Z, l);
+        // Z = 0 is absorbing in both formulas, so a lane that went through the point at infinity
+        // mid-ladder, e.g. an exponent of at least the order, ends with Z = 0 whatever the
+        // true result is, and goes to PBC as well
+        if (mpz_sgn(z) == 0) {
+            element_pow_mpz(outs[l], bases[l], exps[l]);
+            continue;
+        }
+        mpz_invert(z, z, g->q);
+        mpz_mul(y, y, z);
+        mpz_mul(z, z, z);
+        mpz_mul(x, x, z);
+        mpz_mul(y, y, z);
+        mpz_mod(x, x, g->q);
+        mpz_mod(y, y, g->q);
+        memset(buffer, 0, 2 * g->coord_bytes);
+        mpz_export(buffer + g->coord_bytes - (mpz_sizeinbase(x, 2) + 7) / 8, NULL, 1, 1, 1, 0, x);
+        mpz_export(buffer + 2 * g->coord_bytes - (mpz_sizeinbase(y, 2) + 7) / 8, NULL, 1, 1, 1, 0, y);
+        element_from_bytes(outs[l], buffer);
+    }
+    PyMem_RawFree(buffer);
+    mpz_clears(x, y, z, NULL);
+}
+
+// raise many G1 points to non-negative exponents, one lane-width at a time
+int g1_lanes_pow(G1Lanes *g, element_ptr *outs, element_ptr *bases, mpz_t *exps, Py_ssize_t count) {
+    uint64_t *table = PyMem_RawMalloc((1 << LANE_WINDOW) * 3 * LANE_MAX_WORDS * sizeof(uint64_t));
+    if (!table) {
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < count; i += g->field.lanes) {
+        int chunk = count - i < g->field.lanes ? count - i : g->field.lanes;
+        g1_lanes_pow_chunk(g, outs + i, bases + i, exps + i, chunk, table);
+    }
+    PyMem_RawFree(table);
+    return 0;
+}
+
+/*******************************************************************************
+*                                    Caches                                    *
+*******************************************************************************/
+
+// take a lock of an object, waiting for it with the GIL released only if another thread
+// holds it, which may be busy with long work (e.g. hashing) or, on a free-threaded build,
+// with anything at all
+void lock_acquire(PyThread_type_lock lock) {
+    if (!PyThread_acquire_lock(lock, NOWAIT_LOCK)) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+// a bounded lru map from bytes to bytes, the entries are chained in buckets and
+// linked from the most to the least recently used, all accesses hold the lock
+// but never call back into python while holding it
+
+int cache_init(Cache *cache) {
+    cache->lock = PyThread_allocate_lock();
+    cache->capacity = 0;
+    cache->size = 0;
+    cache->buckets_size = 0;
+    cache->buckets = NULL;
+    cache->head = NULL;
+    cache->tail = NULL;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    return cache->lock ? 0 : -1;
+}
+
+// unlink the least recently used entry and return it, the caller releases it
+CacheEntry *cache_pop_lru(Cache *cache) {
+    CacheEntry *entry = cache->tail;
+    // remove it from the list
+    cache->tail = entry->prev;
+    if (cache->tail) {
+        cache->tail->next = NULL;
+    } else {
+        cache->head = NULL;
+    }
+    // remove it from its bucket
+    CacheEntry **link = &cache->buckets[entry->hash & (cache->buckets_size - 1)];
+    while (*link != entry) {
+        link = &(*link)->chain;
+    }
+    *link = entry->chain;
+    cache->size--;
+    return entry;
+}
+
+// release a chain of entries linked through next, must be called without the lock
+void cache_release(CacheEntry *entry) {
+    while (entry) {
+        CacheEntry *next = entry->next;
+        Py_DECREF(entry->key);
+        Py_DECREF(entry->value);
+        PyMem_RawFree(entry);
+        entry = next;
+    }
+}
+
+PyObject *cache_get(Cache *cache, PyObject *key) {
+    Py_hash_t hash = PyObject_Hash(key);
+    Py_ssize_t size = PyBytes_GET_SIZE(key);
+    PyObject *value = NULL;
+    PyThread_acquire_lock(cache->lock, WAIT_LOCK);
+    if (cache->capacity > 0) {
+        // look the key up in its bucket
+        CacheEntry *entry = cache->buckets ? cache->buckets[hash & (cache->buckets_size - 1)] : NULL;
+        while (entry && !(entry->hash == hash && PyBytes_GET_SIZE(entry->key) == size && memcmp(PyBytes_AS_STRING(entry->key), PyBytes_AS_STRING(key), size) == 0)) {
+            entry = entry->chain;
+        }
+        if (entry) {
+            // move it to the front of the list
+            if (entry != cache->head) {
+                entry->prev->next = entry->next;
+                if (entry->next) {
+                    entry->next->prev = entry->prev;
+                } else {
+                    cache->tail = entry->prev;
+                }
+                entry->prev = NULL;
+                entry->next = cache->head;
+                cache->head->prev = entry;
+                cache->head = entry;
+            }
+            value = entry->value;
+            Py_INCREF(value);
+            cache->hits++;
+        } else {
+            cache->misses++;
+        }
+    }
+    PyThread_release_lock(cache->lock);
+    return value;
+}
+
+void cache_put(Cache *cache, PyObject *key, PyObject *value) {
+    Py_hash_t hash = PyObject_Hash(key);
+    CacheEntry *entry = PyMem_RawMalloc(sizeof(CacheEntry));
+    if (!entry) {
+        return;
+    }
+    Py_INCREF(key);
+    Py_INCREF(value);
+    entry->hash = hash;
+    entry->key = key;
+    entry->value = value;
+    CacheEntry *evicted = NULL;
+    PyThread_acquire_lock(cache->lock, WAIT_LOCK);
+    if (cache->capacity > 0) {
+        // grow the buckets to keep the chains short
+        if (cache->size >= cache->buckets_size) {
+            Py_ssize_t buckets_size = cache->buckets_size ? cache->buckets_size * 2 : 16;
+            CacheEntry **buckets = PyMem_RawCalloc(buckets_size, sizeof(CacheEntry *));
+            if (buckets) {
+                for (CacheEntry *e = cache->head; e; e = e->next) {
+                    e->chain = buckets[e->hash & (buckets_size - 1)];
+                    buckets[e->hash & (buckets_size - 1)] = e;
+                }
+                PyMem_RawFree(cache->buckets);
+                cache->buckets = buckets;
+                cache->buckets_size = buckets_size;
+            }
+        }
+    }
+    if (cache->capacity > 0 && cache->buckets) {
+        // make room for the new entry
+        while (cache->size >= cache->capacity) {
+            CacheEntry *old = cache_pop_lru(cache);
+            old->next = evicted;
+            evicted = old;
+            cache->evictions++;
+        }
+        // insert it at the front of the list, a concurrent insertion of the
+        // same key only leaves a stale duplicate that ages out
+        entry->chain = cache->buckets[hash & (cache->buckets_size - 1)];
+        cache->buckets[hash & (cache->buckets_size - 1)] = entry;
+        entry->prev = NULL;
+        entry->next = cache->head;
+        if (cache->head) {
+            cache->head->prev = entry;
+        } else {
+            cache->tail = entry;
+        }
+        cache->head = entry;
+        cache->size++;
+    } else {
+        entry->next = evicted;
+        evicted = entry;
+    }
+    PyThread_release_lock(cache->lock);
+    cache_release(evicted);
+}
+
+void cache_resize(Cache *cache, Py_ssize_t capacity) {
+    CacheEntry *evicted = NULL;
+    PyThread_acquire_lock(cache->lock, WAIT_LOCK);
+    cache->capacity = capacity;
+    while (cache->size > capacity) {
+        CacheEntry *old = cache_pop_lru(cache);
+        old->next = evicted;
+        evicted = old;
+    }
+    PyThread_release_lock(cache->lock);
+    cache_release(evicted);
+}
+
+void cache_clear(Cache *cache) {
+    CacheEntry *evicted;
+    PyThread_acquire_lock(cache->lock, WAIT_LOCK);
+    // detach the whole list and reset the counters
+    evicted = cache->head;
+    cache->head = NULL;
+    cache->tail = NULL;
+    cache->size = 0;
+    if (cache->buckets) {
+        memset(cache->buckets, 0, cache->buckets_size * sizeof(CacheEntry *));
+    }
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    PyThread_release_lock(cache->lock);
+    cache_release(evicted);
+}
+
+void cache_free(Cache *cache) {
+    if (!cache->lock) {
+        return;
+    }
+    cache_clear(cache);
+    PyMem_RawFree(cache->buckets);
+    PyThread_free_lock(cache->lock);
+}
+
+/*******************************************************************************
+*                                    Async                                     *
+*******************************************************************************/
+
+// a pool of native workers runs the jobs of the *_async methods; every event loop gets a
+// channel whose finished jobs are collected by a reader on a self-pipe, which is written
+// only when the list of finished jobs becomes non-empty, so a burst of completions wakes
+// the loop once
+
+#define ASYNC_MAX_THREADS 64
+
+// the status of a job whose worker did not survive a fork
+#define ASYNC_LOST -2
+
+static pthread_mutex_t async_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_cond = PTHREAD_COND_INITIALIZER;
+static AsyncJob *async_head = NULL;
+static AsyncJob *async_tail = NULL;
+static int async_threads = 0;
+// the job each worker is running, and the live channels, both under async_mutex
+static AsyncJob *async_running[ASYNC_MAX_THREADS];
+static AsyncChannel *async_channels = NULL;
+
+// push a job to the finished ones of its channel, with the channel locked
+static int async_push_done(AsyncJob *job) {
+    AsyncChannel *channel = (AsyncChannel *)job->channel;
+    int wake = channel->done == NULL;
+    job->next = channel->done;
+    channel->done = job;
+    return wake;
+}
+
+static void async_complete(AsyncJob *job, int worker) {
+    AsyncChannel *channel = (AsyncChannel *)job->channel;
+    // the job leaves the worker and reaches its channel at once, so a fork sees it in one place
+    pthread_mutex_lock(&async_mutex);
+    async_running[worker] = NULL;
+    pthread_mutex_lock(&channel->mutex);
+    int wake = async_push_done(job);
+    pthread_mutex_unlock(&channel->mutex);
+    pthread_mutex_unlock(&async_mutex);
+    if (wake) {
+        // a full pipe already holds a wakeup, so a failed write loses nothing
+        ssize_t written = write(channel->fds[1], "", 1);
+        (void)written;
+    }
+}
+
+static void *async_worker(void *arg) {
+    int worker = (int)(intptr_t)arg;
+    for (;;) {
+        pthread_mutex_lock(&async_mutex);
+        while (!async_head) {
+            pthread_cond_wait(&async_cond, &async_mutex);
+        }
+        AsyncJob *job = async_head;
+        async_head = job->next;
+        if (!async_head) {
+            async_tail = NULL;
+        }
+        async_running[worker] = job;
+        pthread_mutex_unlock(&async_mutex);
+        job->status = job->run(job);
+        async_complete(job, worker);
+    }
+    return NULL;
+}
+
+// start the workers on first use, one per processor, with the queue locked
+static int async_start(void) {
+    if (async_threads) {
+        return 0;
+    }
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = processors < 1 ? 1 : processors > ASYNC_MAX_THREADS ? ASYNC_MAX_THREADS : (int)processors;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (int i = 0; i < threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, async_worker, (void *)(intptr_t)i) != 0) {
+            break;
+        }
+        async_threads++;
+    }
+    pthread_attr_destroy(&attr);
+    if (!async_threads) {
+        PyErr_SetString(PyExc_RuntimeError, "could not start the worker threads");
+        return -1;
+    }
+    return 0;
+}
+
+// the forking thread takes the queue and every channel, so the child gets them in a
+// consistent state, and holds the locks it has to release
+void async_atfork_prepare(void) {
+    pthread_mutex_lock(&async_mutex);
+    for (AsyncChannel *channel = async_channels; channel; channel = channel->next) {
+        pthread_mutex_lock(&channel->mutex);
+    }
+}
+
+void async_atfork_parent(void) {
+    for (AsyncChannel *channel = async_channels; channel; channel = channel->next) {
+        pthread_mutex_unlock(&channel->mutex);
+    }
+    pthread_mutex_unlock(&async_mutex);
+}
+
+// the workers do not survive a fork, so the child starts its own on first use; the jobs that
+// were queued or running are failed through their channels, which get pipes of their own on
+// the same descriptors, so that the child neither steals nor sends the wakeups of the parent
+void async_atfork_child(void) {
+    AsyncJob *lost = async_head;
+    for (int i = 0; i < async_threads; i++) {
+        if (async_running[i]) {
+            async_running[i]->next = lost;
+            lost = async_running[i];
+            async_running[i] = NULL;
+        }
+    }
+    while (lost) {
+        AsyncJob *job = lost;
+        lost = job->next;
+        job->status = ASYNC_LOST;
+        async_push_done(job);
+    }
+    for (AsyncChannel *channel = async_channels; channel; channel = channel->next) {
+        int fds[2];
+        if (pipe(fds) == 0) {
+            for (int i = 0; i < 2; i++) {
+                fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+                dup2(fds[i], channel->fds[i]);
+                close(fds[i]);
+            }
+        }
+        if (channel->done) {
+            ssize_t written = write(channel->fds[1], "", 1);
+            (void)written;
+        }
+        pthread_mutex_unlock(&channel->mutex);
+    }
+    pthread_cond_init(&async_cond, NULL);
+    async_head = NULL;
+    async_tail = NULL;
+    async_threads = 0;
+    pthread_mutex_unlock(&async_mutex);
+}
+
+static void async_free(AsyncJob *job) {
+    job->clear(job);
+    Py_XDECREF(job->future);
+    Py_XDECREF(job->channel);
+    PyMem_Free(job);
+}
+
+// complete a future with the result, or with the raised exception if the result is NULL,
+// unless it was cancelled in the meantime, steals the result
+static void async_resolve(PyObject *future, PyObject *result) {
+    PyObject *exc_type = NULL;
+    PyObject *exc_value = NULL;
+    PyObject *exc_traceback = NULL;
+    if (!result) {
+        PyErr_Fetch(&exc_type, &exc_value, &exc_traceback);
+        PyErr_NormalizeException(&exc_type, &exc_value, &exc_traceback);
+        if (exc_traceback) {
+            PyException_SetTraceback(exc_value, exc_traceback);
+        }
+    }
+    PyObject *done = PyObject_CallMethod(future, "done", NULL);
+    int is_done = done ? PyObject_IsTrue(done) : -1;
+    Py_XDECREF(done);
+    if (is_done == 0) {
+        PyObject *status = result ? PyObject_CallMethod(future, "set_result", "O", result) : PyObject_CallMethod(future, "set_exception", "O", exc_value);
+        is_done = status ? 1 : -1;
+        Py_XDECREF(status);
+    }
+    if (is_done < 0) {
+        PyErr_WriteUnraisable(future);
+    }
+    Py_XDECREF(result);
+    Py_XDECREF(exc_type);
+    Py_XDECREF(exc_value);
+    Py_XDECREF(exc_traceback);
+}
+
+// return the running loop, raising RuntimeError outside of one; asyncio is looked up in
+// sys.modules on every call rather than kept, since each interpreter has its own
+PyObject *async_loop(void) {
+    PyObject *asyncio = PyImport_ImportModule("asyncio");
+    if (!asyncio) {
+        return NULL;
+    }
+    PyObject *loop = PyObject_CallMethod(asyncio, "get_running_loop", NULL);
+    Py_DECREF(asyncio);
+    return loop;
+}
+
+// return the channel of a loop, creating it and registering its reader on first use
+static PyObject *async_channel(ModuleState *state, PyObject *loop) {
+    PyObject *channel = PyObject_GetItem(state->async_channels, loop);
+    if (channel || !PyErr_ExceptionMatches(PyExc_KeyError)) {
+        return channel;
+    }
+    PyErr_Clear();
+    channel = AsyncChannel_create(state);
+    if (!channel) {
+        return NULL;
+    }
+    PyObject *drain = PyObject_GetAttrString(channel, "_drain");
+    PyObject *status = drain ? PyObject_CallMethod(loop, "add_reader", "iO", ((AsyncChannel *)channel)->fds[0], drain) : NULL;
+    Py_XDECREF(drain);
+    if (!status || PyObject_SetItem(state->async_channels, loop, channel) < 0) {
+        Py_XDECREF(status);
+        Py_DECREF(channel);
+        return NULL;
+    }
+    Py_DECREF(status);
+    return channel;
+}
+
+// queue a job on the pool and return a future of the running loop that it completes, the
+// job must be allocated with PyMem_Malloc and is released if it cannot be queued
+PyObject *async_submit(ModuleState *state, AsyncJob *job) {
+    job->future = NULL;
+    job->channel = NULL;
+    PyObject *loop = async_loop();
+    if (loop) {
+        job->channel = async_channel(state, loop);
+    }
+    if (job->channel) {
+        job->future = PyObject_CallMethod(loop, "create_future", NULL);
+    }
+    Py_XDECREF(loop);
+    if (!job->future) {
+        async_free(job);
+        return NULL;
+    }
+    // the loop runs on this thread, so the job cannot be drained before we return
+    PyObject *future = job->future;
+    Py_INCREF(future);
+    pthread_mutex_lock(&async_mutex);
+    if (async_start() < 0) {
+        pthread_mutex_unlock(&async_mutex);
+        async_free(job);
+        Py_DECREF(future);
+        return NULL;
+    }
+    job->next = NULL;
+    if (async_tail) {
+        async_tail->next = job;
+    } else {
+        async_head = job;
+    }
+    async_tail = job;
+    pthread_cond_signal(&async_cond);
+    pthread_mutex_unlock(&async_mutex);
+    return future;
+}
+
+// return a future of the running loop that already holds the result, steals the result
+PyObject *async_resolved(PyObject *result) {
+    if (!result) {
+        return NULL;
+    }
+    PyObject *loop = async_loop();
+    PyObject *future = loop ? PyObject_CallMethod(loop, "create_future", NULL) : NULL;
+    Py_XDECREF(loop);
+    if (future) {
+        PyObject *status = PyObject_CallMethod(future, "set_result", "O", result);
+        if (!status) {
+            Py_CLEAR(future);
+        }
+        Py_XDECREF(status);
+    }
+    Py_DECREF(result);
+    return future;
+}
+
+PyObject *AsyncChannel_create(ModuleState *state) {
+    // allocate the object
+    AsyncChannel *channel = (AsyncChannel *)state->AsyncChannelType->tp_alloc(state->AsyncChannelType, 0);
+    if (!channel) {
+        return NULL;
+    }
+    channel->ready = 0;
+    channel->done = NULL;
+    // both ends of the pipe are non-blocking, and are not inherited by child processes
+    if (pipe(channel->fds) < 0) {
+        Py_DECREF(channel);
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(channel->fds[i], F_SETFL, fcntl(channel->fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(channel->fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    pthread_mutex_init(&channel->mutex, NULL);
+    // register the channel for forks
+    pthread_mutex_lock(&async_mutex);
+    channel->prev = NULL;
+    channel->next = async_channels;
+    if (async_channels) {
+        async_channels->prev = channel;
+    }
+    async_channels = channel;
+    pthread_mutex_unlock(&async_mutex);
+    channel->ready = 1;
+    return (PyObject *)channel;
+}
+
+void AsyncChannel_dealloc(AsyncChannel *channel) {
+    // pending jobs hold a reference to the channel, so none are left here
+    if (channel->ready) {
+        pthread_mutex_lock(&async_mutex);
+        if (channel->prev) {
+            channel->prev->next = channel->next;
+        } else {
+            async_channels = channel->next;
+        }
+        if (channel->next) {
+            channel->next->prev = channel->prev;
+        }
+        pthread_mutex_unlock(&async_mutex);
+        close(channel->fds[0]);
+        close(channel->fds[1]);
+        pthread_mutex_destroy(&channel->mutex);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(channel);
+    type->tp_free((PyObject *)channel);
+    Py_DECREF(type);
+}
+
+PyObject *AsyncChannel_drain(PyObject *py_channel) {
+    // cast the argument
+    AsyncChannel *channel = (AsyncChannel *)py_channel;
+    // empty the pipe before taking the jobs, so a job finished after that writes a new wakeup
+    char buffer[64];
+    while (read(channel->fds[0], buffer, sizeof(buffer)) > 0) {
+    }
+    pthread_mutex_lock(&channel->mutex);
+    AsyncJob *jobs = channel->done;
+    channel->done = NULL;
+    pthread_mutex_unlock(&channel->mutex);
+    // the jobs were pushed in reverse order of completion
+    AsyncJob *ordered = NULL;
+    while (jobs) {
+        AsyncJob *next = jobs->next;
+        jobs->next = ordered;
+        ordered = jobs;
+        jobs = next;
+    }
+    while (ordered) {
+        AsyncJob *job = ordered;
+        ordered = job->next;
+        PyObject *result;
+        if (job->status == ASYNC_LOST) {
+            PyErr_SetString(PyExc_RuntimeError, "the worker running the job did not survive a fork");
+            result = NULL;
+        } else {
+            result = job->status < 0 ? PyErr_NoMemory() : job->finish(job);
+        }
+        async_resolve(job->future, result);
+        async_free(job);
+    }
+    Py_RETURN_NONE;
+}
+
+PyMethodDef AsyncChannel_methods[] = {
+    {"_drain", (PyCFunction)AsyncChannel_drain, METH_NOARGS, "Completes the futures of the finished jobs."},
+    {NULL},
+};
+
+PyType_Slot AsyncChannel_slots[] = {
+    {Py_tp_dealloc, AsyncChannel_dealloc},
+    {Py_tp_methods, AsyncChannel_methods},
+    {0, NULL},
+};
+
+PyType_Spec AsyncChannel_spec = {
+    "pypbc._AsyncChannel",                                                             /* name */
+    sizeof(AsyncChannel),                                                              /* basicsize */
+    0,                                                                                 /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    AsyncChannel_slots,                                                                /* slots */
+};
+
+/*******************************************************************************
+*                                  Arguments                                   *
+*******************************************************************************/
+
+// the entry points take their arguments as METH_FASTCALL arrays and check them by hand,
+// which skips building a tuple and running the format parser on every call; the helpers
+// return -1 on a mismatch and leave the message to the caller
+
+// bind the positional and keyword arguments to the slots of the keywords, in order, leaving
+// missing optional ones NULL
+int args_bind(PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames, const char *const *keywords, Py_ssize_t required, PyObject **slots) {
+    Py_ssize_t total = 0;
+    while (keywords[total]) {
+        total++;
+    }
+    if (nargs > total) {
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < total; i++) {
+        slots[i] = i < nargs ? args[i] : NULL;
+    }
+    // keywords must name a parameter that is not already bound
+    Py_ssize_t nkwargs = kwnames ? PyTuple_GET_SIZE(kwnames) : 0;
+    for (Py_ssize_t i = 0; i < nkwargs; i++) {
+        PyObject *name = PyTuple_GET_ITEM(kwnames, i);
+        Py_ssize_t j = 0;
+        while (j < total && PyUnicode_CompareWithASCIIString(name, keywords[j]) != 0) {
+            j++;
+        }
+        if (j == total || slots[j]) {
+            return -1;
+        }
+        slots[j] = args[nargs + i];
+    }
+    for (Py_ssize_t i = 0; i < required; i++) {
+        if (!slots[i]) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// read a C int, accepting anything with __index__
+int args_int(PyObject *arg, int *value) {
+    long result = PyLong_AsLong(arg);
+    if (result == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+    if (result < INT_MIN || result > INT_MAX) {
+        return -1;
+    }
+    *value = (int)result;
+    return 0;
+}
+
+// read a group, out of range values are caught when the field is looked up
+int args_group(PyObject *arg, enum Group *group) {
+    int value;
+    if (args_int(arg, &value) < 0) {
+        return -1;
+    }
+    *group = value;
+    return 0;
+}
+
+// read a size, accepting anything with __index__
+int args_ssize(PyObject *arg, Py_ssize_t *value) {
+    *value = PyNumber_AsSsize_t(arg, PyExc_OverflowError);
+    return *value == -1 && PyErr_Occurred() ? -1 : 0;
+}
+
+// read a flag by its truth value
+int args_bool(PyObject *arg, int *value) {
+    *value = PyObject_IsTrue(arg);
+    return *value < 0 ? -1 : 0;
+}
+
+/*******************************************************************************
+*                                    Params                                    *
+*******************************************************************************/
+
+PyDoc_STRVAR(Parameters__doc__,
+    "A representation of the parameters of an elliptic curve.\n"
+    "\n"
+    "There are three basic ways to instantiate a Parameters object:\n"
+    "\n"
+    "Parameters(string: str) -> Parameters\n"
+    "\n"
+    "These objects are essentially only used for creating Pairings.");
+
+Parameters *Parameters_create(PyTypeObject *type) {
+    // allocate the object
+    Parameters *params = (Parameters *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!params) {
+        PyErr_SetString(PyExc_TypeError, "could not create Parameters object");
+        return NULL;
+    }
+    // set the ready flag to 0
+    params->ready = 0;
+    return params;
+}
+
+PyObject *Parameters_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    // required argument is the parameter string
+    char *string = NULL;
+    if (!PyArg_ParseTuple(args, "s", &string)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected a string");
+        return NULL;
+    }
+    // create the object
+    Parameters *params = Parameters_create(type);
+    if (!params) {
+        return NULL;
+    }
+    // initialize the parameters from a string
+    if (pbc_param_init_set_str(params->pbc_params, string)) {
+        PyErr_SetString(PyExc_ValueError, "could not parse parameters from string");
+        return NULL;
+    }
+    // set the ready flag
+    params->ready = 1;
+    return (PyObject *)params;
+}
+
+void Parameters_dealloc(Parameters *params) {
+    // clear the parameters if they're ready
+    if (params->ready) {
+        pbc_param_clear(params->pbc_params);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(params);
+    type->tp_free((PyObject *)params);
+    Py_DECREF(type);
+}
+
+// write the parameters to a buffer as text, returns the length or -1
+// write the parameters to a buffer that grows as needed, to be released with free, or return NULL
+char *Parameters_to_buffer(pbc_param_ptr pbc_params, size_t *length) {
+    // open a file in memory
+    char *buffer = NULL;
+    FILE *fp = open_memstream(&buffer, length);
+    // check if the file was opened
+    if (fp == NULL) {
+        return NULL;
+    }
+    // write the parameters to the buffer, which is only complete once the file is closed
+    pbc_param_out_str(fp, pbc_params);
+    if (fclose(fp) != 0) {
+        free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+PyObject *Parameters_str(PyObject *py_params) {
+    // cast the argument
+    Parameters *params = (Parameters *)py_params;
+    // write the parameters to a buffer
+    size_t length;
+    char *buffer = Parameters_to_buffer(params->pbc_params, &length);
+    if (!buffer) {
+        PyErr_SetString(PyExc_IOError, "could not write parameters to buffer");
+        return NULL;
+    }
+    // return the buffer as a string
+    PyObject *result = PyUnicode_FromStringAndSize(buffer, length);
+    free(buffer);
+    return result;
+}
+
+PyMemberDef Parameters_members[] = {
+    {NULL},
+};
+
+PyMethodDef Parameters_methods[] = {
+    {NULL},
+};
+
+PyType_Slot Parameters_slots[] = {
+    {Py_tp_dealloc, Parameters_dealloc},
+    {Py_tp_repr, Parameters_str},
+    {Py_tp_str, Parameters_str},
+    {Py_tp_doc, (void *)Parameters__doc__},
+    {Py_tp_methods, Parameters_methods},
+    {Py_tp_members, Parameters_members},
+    {Py_tp_new, Parameters_new},
+    {0, NULL},
+};
+
+PyType_Spec Parameters_spec = {
+    "pypbc.Parameters",                                                  /* name */
+    sizeof(Parameters),                                                  /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    Parameters_slots,                                                    /* slots */
+};
+
+/*******************************************************************************
+*                                   Pairings                                   *
+*******************************************************************************/
+
+PyDoc_STRVAR(Pairing__doc__,
+    "Represents a bilinear pairing, frequently referred to as e-hat.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "Pairing(params: Parameters) -> Pairing\n"
+    "\n"
+    "This object is used to apply the bilinear map to two elements.");
+
+Pairing *Pairing_create(PyTypeObject *type, ModuleState *state) {
+    // allocate the object
+    Pairing *pairing = (Pairing *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!pairing) {
+        PyErr_SetString(PyExc_TypeError, "could not create Pairing object");
+        return NULL;
+    }
+    // set the ready flag to 0, the lanes and the curves are built on first use
+    pairing->ready = 0;
+    pairing->state = state;
+    pairing->g1_lanes = NULL;
+    pairing->g1_lanes_tried = 0;
+    pairing->g1_curve = NULL;
+    pairing->g1_curve_tried = 0;
+    pairing->miller_curve = NULL;
+    pairing->miller_curve_tried = 0;
+    pairing->ate_curve = NULL;
+    pairing->ate_curve_tried = 0;
+    tuning_defaults(&pairing->tuning);
+    pairing->factors = NULL;
+    pairing->factor_count = 0;
+    // the cache starts disabled
+    int status = cache_init(&pairing->cache);
+    pairing->lock = PyThread_allocate_lock();
+    if (status < 0 || !pairing->lock) {
+        Py_DECREF(pairing);
+        PyErr_SetString(PyExc_MemoryError, "could not allocate the pairing locks");
+        return NULL;
+    }
+    return pairing;
+}
+
+PyObject *Pairing_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    // required argument is the parameters, the factorization of the order and autotuning are optional
+    static char *keywords[] = {"params", "factors", "autotune", NULL};
+    PyObject *py_params;
+    PyObject *py_factors = Py_None;
+    int autotune = 0;
+    ModuleState *state = pypbc_state(type);
+    if (!state) {
+        return NULL;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|Op", keywords, state->ParametersType, &py_params, &py_factors, &autotune)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Parameters object, optional factors and autotune flag");
+        return NULL;
+    }
+    // cast the argument
+    Parameters *params = (Parameters *)py_params;
+    // the parameters are fingerprinted, so that saved data can be matched to them
+    size_t length;
+    char *buffer = Parameters_to_buffer(params->pbc_params, &length);
+    if (!buffer) {
+        PyErr_SetString(PyExc_IOError, "could not write parameters to buffer");
+        return NULL;
+    }
+    // create the object
+    Pairing *pairing = Pairing_create(type, state);
+    if (!pairing) {
+        free(buffer);
+        return NULL;
+    }
+    // initialize the pairing with the parameters
+    pairing_init_pbc_param(pairing->pbc_pairing, params->pbc_params);
+    sha256(buffer, length, pairing->fingerprint);
+    free(buffer);
+    // switch Zr to the fixed-limb engine when the order has a supported size
+    zr_engine_install(pairing->pbc_pairing);
+    // pairing outputs are unitary, which matters when GT is quadratic
+    pairing->gt_unitary = gt_length_in_bytes_compressed(pairing->pbc_pairing->GT) != 0;
+    // pbc finds the non-residue used by square roots on first use and races doing so, so the
+    // coordinate fields of G1 and G2 get theirs now, while nothing else can see the pairing
+    for (int i = 0; i < 2; i++) {
+        element_t probe;
+        element_init(probe, i ? pairing->pbc_pairing->G2 : pairing->pbc_pairing->G1);
+        field_get_nqr(element_item(probe, 0)->field);
+        element_clear(probe);
+    }
+    // set the ready flag
+    pairing->ready = 1;
+    // keep the factorization of the order when the caller trusts us with it
+    if (py_factors != Py_None && Pairing_set_factors(pairing, py_factors) < 0) {
+        Py_DECREF(pairing);
+        return NULL;
+    }
+    // time the algorithms on the host when asked to
+    if (autotune) {
+        Pairing_autotune_run(pairing, 3);
+    }
+    return (PyObject *)pairing;
+}
+
+// store the prime factors of the order, they must be distinct primes that multiply to it
+int Pairing_set_factors(Pairing *pairing, PyObject *py_factors) {
+    PyObject *factors = PySequence_Fast(py_factors, "the factors must be a sequence of integers");
+    if (!factors) {
+        return -1;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(factors);
+    pairing->factors = PyMem_Malloc((count + 1) * sizeof(mpz_t));
+    if (!pairing->factors) {
+        Py_DECREF(factors);
+        PyErr_NoMemory();
+        return -1;
+    }
+    mpz_t product;
+    mpz_init_set_ui(product, 1);
+    const char *problem = NULL;
+    for (Py_ssize_t i = 0; i < count && !problem; i++) {
+        PyObject *py_factor = PySequence_Fast_GET_ITEM(factors, i);
+        if (!PyLong_Check(py_factor)) {
+            problem = "the factors must be integers";
+            break;
+        }
+        mpz_init_from_pynum(pairing->factors[i], py_factor);
+        pairing->factor_count++;
+        if (mpz_probab_prime_p(pairing->factors[i], 25) == 0) {
+            problem = "the factors must be primes";
+        } else if (mpz_divisible_p(product, pairing->factors[i])) {
+            problem = "the factors must be distinct";
+        }
+        mpz_mul(product, product, pairing->factors[i]);
+    }
+    if (!problem && mpz_cmp(product, pairing->pbc_pairing->r) != 0) {
+        problem = "the factors must multiply to the order of the pairing";
+    }
+    mpz_clear(product);
+    Py_DECREF(factors);
+    if (problem) {
+        PyErr_SetString(PyExc_ValueError, problem);
+        return -1;
+    }
+    return 0;
+}
+
+void Pairing_dealloc(Pairing *pairing) {
+    // clear the pairing if it's ready
+    if (pairing->ready) {
+        if (pairing->g1_lanes) {
+            g1_lanes_free(pairing->g1_lanes);
+        }
+        if (pairing->g1_curve) {
+            g1_curve_free(pairing->g1_curve);
+        }
+        if (pairing->miller_curve) {
+            miller_curve_free(pairing->miller_curve);
+        }
+        if (pairing->ate_curve) {
+            ate_curve_free(pairing->ate_curve);
+        }
+        pairing_clear(pairing->pbc_pairing);
+    }
+    for (int i = 0; i < pairing->factor_count; i++) {
+        mpz_clear(pairing->factors[i]);
+    }
+    PyMem_Free(pairing->factors);
+    cache_free(&pairing->cache);
+    if (pairing->lock) {
+        PyThread_free_lock(pairing->lock);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(pairing);
+    type->tp_free((PyObject *)pairing);
+    Py_DECREF(type);
+}
+
+// the lanes and the curves are built on first use, at most once and under the lock of the
+// pairing, since the threads of a free-threaded build may ask for them at the same time
+G1Lanes *Pairing_g1_lanes(Pairing *pairing) {
+    lock_acquire(pairing->lock);
+    if (!pairing->g1_lanes_tried) {
+        pairing->g1_lanes = g1_lanes_create(pairing->pbc_pairing);
+        pairing->g1_lanes_tried = 1;
+    }
+    G1Lanes *lanes = pairing->g1_lanes;
+    PyThread_release_lock(pairing->lock);
+    return lanes;
+}
+
+G1Curve *Pairing_g1_curve(Pairing *pairing) {
+    lock_acquire(pairing->lock);
+    if (!pairing->g1_curve_tried) {
+        pairing->g1_curve = g1_curve_create(pairing->pbc_pairing);
+        pairing->g1_curve_tried = 1;
+    }
+    G1Curve *curve = pairing->g1_curve;
+    PyThread_release_lock(pairing->lock);
+    return curve;
+}
+
+MillerCurve *Pairing_miller_curve(Pairing *pairing) {
+    lock_acquire(pairing->lock);
+    if (!pairing->miller_curve_tried) {
+        pairing->miller_curve = miller_curve_create(pairing->pbc_pairing);
+        pairing->miller_curve_tried = 1;
+    }
+    MillerCurve *curve = pairing->miller_curve;
+    PyThread_release_lock(pairing->lock);
+    return curve;
+}
+
+AteCurve *Pairing_ate_curve(Pairing *pairing) {
+    lock_acquire(pairing->lock);
+    if (!pairing->ate_curve_tried) {
+        pairing->ate_curve = ate_curve_create(pairing->pbc_pairing);
+        pairing->ate_curve_tried = 1;
+    }
+    AteCurve *curve = pairing->ate_curve;
+    PyThread_release_lock(pairing->lock);
+    return curve;
+}
+
+// check the operands of a pairing and build its result, which is complete unless pending is
+// set, in which case pairing_apply(result, in1, in2) is still to be computed before handing
+// the result to Pairing_apply_end, possibly on another thread
+Element *Pairing_apply_begin(Pairing *pairing, PyObject *py_lft, PyObject *py_rgt, element_ptr *in1, element_ptr *in2, PyObject **key, int *pending) {
+    // cast the arguments
+    Element *ele_lft = (Element *)py_lft;
+    Element *ele_rgt = (Element *)py_rgt;
+    // check the groups of the elements, and put the one in G1 first
+    if (ele_lft->pbc_element->field == pairing->pbc_pairing->G1 && ele_rgt->pbc_element->field == pairing->pbc_pairing->G2) {
+        *in1 = ele_lft->pbc_element;
+        *in2 = ele_rgt->pbc_element;
+    } else if (ele_lft->pbc_element->field == pairing->pbc_pairing->G2 && ele_rgt->pbc_element->field == pairing->pbc_pairing->G1) {
+        *in1 = ele_rgt->pbc_element;
+        *in2 = ele_lft->pbc_element;
+    } else {
+        PyErr_SetString(PyExc_ValueError, "only Elements in G1 and G2 can be paired");
+        return NULL;
+    }
+    // build the result element and initialize it with the pairing and group
+    Element *ele_res = Element_create(pairing);
+    if (!ele_res) {
+        return NULL;
+    }
+    element_init_GT(ele_res->pbc_element, pairing->pbc_pairing);
+    ele_res->pairing = pairing;
+    ele_res->unitary = pairing->gt_unitary;
+    // elements of different prime subgroups always pair to 1, and elements of the same one pair into it
+    int orthogonal = ele_lft->subgroup && ele_rgt->subgroup && ele_lft->subgroup != ele_rgt->subgroup;
+    ele_res->subgroup = ele_lft->subgroup == ele_rgt->subgroup ? ele_lft->subgroup : 0;
+    // the cache key is a tag followed by both operands
+    PyObject *value = NULL;
+    *key = NULL;
+    *pending = 0;
+    if (!orthogonal && pairing->cache.capacity > 0) {
+        int len1 = element_length_in_bytes(*in1);
+        int len2 = element_length_in_bytes(*in2);
+        *key = PyBytes_FromStringAndSize(NULL, 1 + len1 + len2);
+        if (*key) {
+            unsigned char *buffer = (unsigned char *)PyBytes_AS_STRING(*key);
+            buffer[0] = 'p';
+            element_to_bytes(buffer + 1, *in1);
+            element_to_bytes(buffer + 1 + len1, *in2);
+            value = cache_get(&pairing->cache, *key);
+        } else {
+            PyErr_Clear();
+        }
+    }
+    if (orthogonal) {
+        element_set1(ele_res->pbc_element);
+    } else if (value) {
+        // reuse the cached result
+        element_from_bytes(ele_res->pbc_element, (unsigned char *)PyBytes_AS_STRING(value));
+        Py_DECREF(value);
+        Py_CLEAR(*key);
+    } else {
+        *pending = 1;
+    }
+    return ele_res;
+}
+
+// finish the result of Pairing_apply_begin, storing a computed pairing in the cache
+PyObject *Pairing_apply_end(Pairing *pairing, Element *ele_res, PyObject *key) {
+    if (key) {
+        Pairing_cache_store(pairing, key, ele_res->pbc_element);
+        Py_DECREF(key);
+    }
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+PyObject *Pairing_apply(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect two elements
+    ModuleState *state = ((Pairing *)py_pairing)->state;
+    if (nargs != 2 || !PyObject_TypeCheck(args[0], state->ElementType) || !PyObject_TypeCheck(args[1], state->ElementType)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected two Elements");
+        return NULL;
+    }
+    PyObject *py_lft = args[0];
+    PyObject *py_rgt = args[1];
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    element_ptr in1;
+    element_ptr in2;
+    PyObject *key;
+    int pending;
+    Element *ele_res = Pairing_apply_begin(pairing, py_lft, py_rgt, &in1, &in2, &key, &pending);
+    if (!ele_res) {
+        return NULL;
+    }
+    if (pending) {
+        // apply the pairing
+        pairing_apply(ele_res->pbc_element, in1, in2, pairing->pbc_pairing);
+    }
+    return Pairing_apply_end(pairing, ele_res, key);
+}
+
+// a pairing computed on the worker pool
+typedef struct {
+    AsyncJob job;
+    Pairing *pairing;
+    PyObject *py_lft;
+    PyObject *py_rgt;
+    element_ptr in1;
+    element_ptr in2;
+    Element *ele_res;
+    PyObject *key;
+} ApplyJob;
+
+static int ApplyJob_run(AsyncJob *job) {
+    ApplyJob *apply = (ApplyJob *)job;
+    pairing_apply(apply->ele_res->pbc_element, apply->in1, apply->in2, apply->pairing->pbc_pairing);
+    return 0;
+}
+
+static PyObject *ApplyJob_finish(AsyncJob *job) {
+    ApplyJob *apply = (ApplyJob *)job;
+    PyObject *result = Pairing_apply_end(apply->pairing, apply->ele_res, apply->key);
+    apply->ele_res = NULL;
+    apply->key = NULL;
+    return result;
+}
+
+static void ApplyJob_clear(AsyncJob *job) {
+    ApplyJob *apply = (ApplyJob *)job;
+    if (apply->ele_res) {
+        element_clear(apply->ele_res->pbc_element);
+        Py_DECREF(apply->ele_res);
+    }
+    Py_XDECREF(apply->key);
+    Py_DECREF(apply->py_lft);
+    Py_DECREF(apply->py_rgt);
+}
+
+PyObject *Pairing_apply_async(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect two elements
+    ModuleState *state = ((Pairing *)py_pairing)->state;
+    if (nargs != 2 || !PyObject_TypeCheck(args[0], state->ElementType) || !PyObject_TypeCheck(args[1], state->ElementType)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected two Elements");
+        return NULL;
+    }
+    PyObject *py_lft = args[0];
+    PyObject *py_rgt = args[1];
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    element_ptr in1;
+    element_ptr in2;
+    PyObject *key;
+    int pending;
+    Element *ele_res = Pairing_apply_begin(pairing, py_lft, py_rgt, &in1, &in2, &key, &pending);
+    if (!ele_res) {
+        return NULL;
+    }
+    // cached and trivial results are ready at once
+    if (!pending) {
+        return async_resolved(Pairing_apply_end(pairing, ele_res, key));
+    }
+    ApplyJob *apply = PyMem_Malloc(sizeof(ApplyJob));
+    if (!apply) {
+        element_clear(ele_res->pbc_element);
+        Py_DECREF(ele_res);
+        Py_XDECREF(key);
+        return PyErr_NoMemory();
+    }
+    apply->job.run = ApplyJob_run;
+    apply->job.finish = ApplyJob_finish;
+    apply->job.clear = ApplyJob_clear;
+    apply->pairing = pairing;
+    apply->py_lft = py_lft;
+    apply->py_rgt = py_rgt;
+    apply->in1 = in1;
+    apply->in2 = in2;
+    apply->ele_res = ele_res;
+    apply->key = key;
+    // the operands keep the pairing alive until the job is released
+    Py_INCREF(py_lft);
+    Py_INCREF(py_rgt);
+    return async_submit(pairing->state, &apply->job);
+}
+
+// store the serialized element under the key, silently skipping it if memory runs out
+void Pairing_cache_store(Pairing *pairing, PyObject *key, element_ptr element) {
+    PyObject *value = PyBytes_FromStringAndSize(NULL, element_length_in_bytes(element));
+    if (!value) {
+        PyErr_Clear();
+        return;
+    }
+    element_to_bytes((unsigned char *)PyBytes_AS_STRING(value), element);
+    cache_put(&pairing->cache, key, value);
+    Py_DECREF(value);
+}
+
+PyObject *Pairing_enable_cache(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // optional argument is the capacity
+    static const char *const keywords[] = {"capacity", NULL};
+    PyObject *slots[1];
+    Py_ssize_t capacity = 1024;
+    if (args_bind(args, nargs, kwnames, keywords, 0, slots) < 0 || (slots[0] && args_ssize(slots[0], &capacity) < 0)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected an optional capacity");
+        return NULL;
+    }
+    if (capacity < 0) {
+        PyErr_SetString(PyExc_ValueError, "the capacity must not be negative");
+        return NULL;
+    }
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    // set the capacity, evicting the least recently used entries beyond it
+    cache_resize(&pairing->cache, capacity);
+    Py_RETURN_NONE;
+}
+
+PyObject *Pairing_disable_cache(PyObject *py_pairing) {
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    // drop all the entries, but keep the statistics
+    cache_resize(&pairing->cache, 0);
+    Py_RETURN_NONE;
+}
+
+PyObject *Pairing_cache_info(PyObject *py_pairing) {
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    // take a consistent snapshot of the statistics
+    Cache *cache = &pairing->cache;
+    PyThread_acquire_lock(cache->lock, WAIT_LOCK);
+    unsigned long long hits = cache->hits;
+    unsigned long long misses = cache->misses;
+    unsigned long long evictions = cache->evictions;
+    Py_ssize_t size = cache->size;
+    Py_ssize_t capacity = cache->capacity;
+    PyThread_release_lock(cache->lock);
+    return Py_BuildValue("{s:K,s:K,s:K,s:n,s:n}", "hits", hits, "misses", misses, "evictions", evictions, "size", size, "capacity", capacity);
+}
+
+PyObject *Pairing_cache_clear(PyObject *py_pairing) {
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    // drop all the entries and reset the statistics
+    cache_clear(&pairing->cache);
+    Py_RETURN_NONE;
+}
+
+// convert an exponent given as an Element of Zr, an Exponent or an integer to an mpz, which must be initialized
+int Pairing_exponent_to_mpz(Pairing *pairing, mpz_t mpz_exp, PyObject *py_exp) {
+    if (Exponent_check(py_exp)) {
+        mpz_set(mpz_exp, ((Exponent *)py_exp)->value);
+    } else if (Element_check(py_exp)) {
+        Element *ele_exp = (Element *)py_exp;
+        if (ele_exp->pbc_element->field != pairing->pbc_pairing->Zr) {
+            PyErr_SetString(PyExc_TypeError, "if the exponent is an Element, it must be in Zr");
+            return -1;
+        }
+        element_to_mpz(mpz_exp, ele_exp->pbc_element);
+    } else if (PyLong_Check(py_exp)) {
+        mpz_clear(mpz_exp);
+        mpz_init_from_pynum(mpz_exp, py_exp);
+    } else {
+        PyErr_SetString(PyExc_TypeError, "the exponent must be an Element, an Exponent or an integer");
+        return -1;
+    }
+    return 0;
+}
+
+// convert a sequence of exponents to integers reduced modulo the order, returns NULL with an
+// exception if one of them is not an exponent
+mpz_t *Pairing_scalars(Pairing *pairing, PyObject *py_values, Py_ssize_t *count) {
+    PyObject *values = PySequence_Fast(py_values, "expected a sequence of Elements of Zr or integers");
+    if (!values) {
+        return NULL;
+    }
+    *count = PySequence_Fast_GET_SIZE(values);
+    mpz_t *scalars = PyMem_Malloc((*count ? *count : 1) * sizeof(mpz_t));
+    if (!scalars) {
+        Py_DECREF(values);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < *count; i++) {
+        mpz_init(scalars[i]);
+        if (Pairing_exponent_to_mpz(pairing, scalars[i], PySequence_Fast_GET_ITEM(values, i)) < 0) {
+            mpz_array_free(scalars, i + 1);
+            Py_DECREF(values);
+            return NULL;
+        }
+        mpz_mod(scalars[i], scalars[i], pairing->pbc_pairing->r);
+    }
+    Py_DECREF(values);
+    return scalars;
+}
+
+// clear and free an array of integers
+void mpz_array_free(mpz_t *scalars, Py_ssize_t count) {
+    for (Py_ssize_t i = 0; i < count; i++) {
+        mpz_clear(scalars[i]);
+    }
+    PyMem_Free(scalars);
+}
+
+PyObject *Pairing_batch_pow(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect a sequence of bases and either a sequence of exponents or a single one
+    if (nargs != 2) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected bases and exponents");
+        return NULL;
+    }
+    PyObject *py_bases = args[0];
+    PyObject *py_exps = args[1];
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    // get the bases and the exponents as fast sequences
+    PyObject *bases = PySequence_Fast(py_bases, "the bases must be a sequence of Elements");
+    if (!bases) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(bases);
+    PyObject *exps = NULL;
+    if (!PyLong_Check(py_exps) && !Element_check(py_exps) && !Exponent_check(py_exps)) {
+        exps = PySequence_Fast(py_exps, "the exponents must be an Element, an Exponent, an integer or a sequence of them");
+        if (!exps) {
+            Py_DECREF(bases);
+            return NULL;
+        }
+        if (PySequence_Fast_GET_SIZE(exps) != count) {
+            PyErr_SetString(PyExc_ValueError, "the number of bases and exponents must be the same");
+            Py_DECREF(bases);
+            Py_DECREF(exps);
+            return NULL;
+        }
+    }
+    // allocate the working arrays
+    PyObject *result = PyList_New(count);
+    element_ptr *ins = PyMem_Malloc((count + 1) * sizeof(element_ptr));
+    element_ptr *outs = PyMem_Malloc((count + 1) * sizeof(element_ptr));
+    mpz_t *mpz_exps = PyMem_Malloc((count + 1) * sizeof(mpz_t));
+    Exponent **recoded = PyMem_Malloc((count + 1) * sizeof(Exponent *));
+    char *unitary = PyMem_Malloc(count + 1);
+    Py_ssize_t ready = 0;
+    if (!result || !ins || !outs || !mpz_exps || !recoded || !unitary) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    // check the bases and convert the exponents
+    field_ptr field = NULL;
+    for (; ready < count; ready++) {
+        PyObject *py_base = PySequence_Fast_GET_ITEM(bases, ready);
+        PyObject *py_exp = exps ? PySequence_Fast_GET_ITEM(exps, ready) : py_exps;
+        mpz_init(mpz_exps[ready]);
+        if (!Element_check(py_base) || ((Element *)py_base)->pairing != pairing) {
+            PyErr_SetString(PyExc_TypeError, "the bases must be Elements of this pairing");
+            ready++;
+            goto error;
+        }
+        ins[ready] = ((Element *)py_base)->pbc_element;
+        unitary[ready] = ((Element *)py_base)->unitary;
+        if (field && ins[ready]->field != field) {
+            PyErr_SetString(PyExc_ValueError, "all bases must be in the same group");
+            ready++;
+            goto error;
+        }
+        field = ins[ready]->field;
+        recoded[ready] = Exponent_check(py_exp) ? (Exponent *)py_exp : NULL;
+        if (Pairing_exponent_to_mpz(pairing, mpz_exps[ready], py_exp) < 0) {
+            ready++;
+            goto error;
+        }
+    }
+    // build the result elements
+    for (Py_ssize_t i = 0; i < count; i++) {
+        Element *ele_res = Element_create(pairing);
+        if (!ele_res) {
+            goto error;
+        }
+        element_init_same_as(ele_res->pbc_element, ins[i]);
+        ele_res->pairing = pairing;
+        ele_res->unitary = unitary[i];
+        Py_INCREF(ele_res->pairing);
+        ele_res->ready = 1;
+        outs[i] = ele_res->pbc_element;
+        PyList_SET_ITEM(result, i, (PyObject *)ele_res);
+    }
+    // G1 goes through the SIMD lanes when the curve allows it
+    G1Lanes *lanes = count && field == pairing->pbc_pairing->G1 ? Pairing_g1_lanes(pairing) : NULL;
+    int status = 0;
+    Tuning tuning;
+    tuning_load(&tuning, &pairing->tuning);
+    Py_BEGIN_ALLOW_THREADS
+    if (lanes) {
+        status = g1_lanes_pow(lanes, outs, ins, mpz_exps, count);
+    } else {
+        for (Py_ssize_t i = 0; i < count; i++) {
+            if (unitary[i] && recoded[i]) {
+                gt_unitary_pow(outs[i], ins[i], recoded[i]->digits, recoded[i]->length, recoded[i]->window);
+            } else if (unitary[i]) {
+                gt_unitary_pow_mpz(outs[i], ins[i], mpz_exps[i], tuning.gt_window);
+            } else if (recoded[i]) {
+                Exponent_apply(outs[i], ins[i], recoded[i]);
+            } else {
+                element_pow_mpz(outs[i], ins[i], mpz_exps[i]);
+            }
+        }
+    }
+    Py_END_ALLOW_THREADS
+    if (status < 0) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    // clean up
+    for (Py_ssize_t i = 0; i < count; i++) {
+        mpz_clear(mpz_exps[i]);
+    }
+    PyMem_Free(ins);
+    PyMem_Free(outs);
+    PyMem_Free(mpz_exps);
+    PyMem_Free(recoded);
+    PyMem_Free(unitary);
+    Py_DECREF(bases);
+    Py_XDECREF(exps);
+    return result;
+error:
+    for (Py_ssize_t i = 0; i < ready; i++) {
+        mpz_clear(mpz_exps[i]);
+    }
+    PyMem_Free(ins);
+    PyMem_Free(outs);
+    PyMem_Free(mpz_exps);
+    PyMem_Free(recoded);
+    PyMem_Free(unitary);
+    Py_XDECREF(result);
+    Py_DECREF(bases);
+    Py_XDECREF(exps);
+    return NULL;
+}
+
+// hold a sequence of elements of the pairing in a tuple, so they stay alive while the GIL is
+// released, and get the G1 lanes if the elements need them
+PyObject *Pairing_validate_collect(Pairing *pairing, PyObject *py_elements, G1Lanes **lanes) {
+    PyObject *elements = PySequence_Tuple(py_elements);
+    if (!elements) {
+        return NULL;
+    }
+    Py_ssize_t count = PyTuple_GET_SIZE(elements);
+    int has_g1 = 0;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject *py_element = PyTuple_GET_ITEM(elements, i);
+        if (!Element_check(py_element) || ((Element *)py_element)->pairing != pairing) {
+            PyErr_SetString(PyExc_TypeError, "the elements must be Elements of this pairing");
+            Py_DECREF(elements);
+            return NULL;
+        }
+        if (((Element *)py_element)->pbc_element->field == pairing->pbc_pairing->G1) {
+            has_g1 = 1;
+        }
+    }
+    // G1 goes through the SIMD lanes when the curve allows it
+    *lanes = has_g1 ? Pairing_g1_lanes(pairing) : NULL;
+    return elements;
+}
+
+// check which of the elements lie in the subgroup of order r, without the GIL, returns -1 if
+// memory runs out
+int Pairing_validate_elements(Pairing *pairing, G1Lanes *lanes, element_ptr *elements, Py_ssize_t count, signed char *valid) {
+    Py_ssize_t lane_count = 0;
+    if (lanes) {
+        for (Py_ssize_t i = 0; i < count; i++) {
+            if (elements[i]->field == pairing->pbc_pairing->G1) {
+                lane_count++;
+            }
+        }
+    }
+    // allocate the working arrays
+    element_ptr *ins = PyMem_RawMalloc((lane_count + 1) * sizeof(element_ptr));
+    element_ptr *outs = PyMem_RawMalloc((lane_count + 1) * sizeof(element_ptr));
+    element_t *powers = PyMem_RawMalloc((lane_count + 1) * sizeof(element_t));
+    mpz_t *mpz_exps = PyMem_RawMalloc((lane_count + 1) * sizeof(mpz_t));
+    Py_ssize_t *indices = PyMem_RawMalloc((lane_count + 1) * sizeof(Py_ssize_t));
+    if (!ins || !outs || !powers || !mpz_exps || !indices) {
+        PyMem_RawFree(ins);
+        PyMem_RawFree(outs);
+        PyMem_RawFree(powers);
+        PyMem_RawFree(mpz_exps);
+        PyMem_RawFree(indices);
+        return -1;
+    }
+    // the elements of G1 are raised to r - 1, since P^(r - 1) * P is 1 exactly when P^r is,
+    // and an exponent of r would make the last addition of every lane a degenerate one
+    Py_ssize_t j = 0;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        valid[i] = 0;
+        if (lane_count && elements[i]->field == pairing->pbc_pairing->G1) {
+            ins[j] = elements[i];
+            element_init_same_as(powers[j], elements[i]);
+            outs[j] = powers[j];
+            mpz_init(mpz_exps[j]);
+            mpz_sub_ui(mpz_exps[j], pairing->pbc_pairing->r, 1);
+            indices[j] = i;
+            valid[i] = -1;
+            j++;
+        }
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        if (valid[i] == 0) {
+            valid[i] = Pairing_in_subgroup(pairing, elements[i]);
+        }
+    }
+    int status = 0;
+    if (lane_count) {
+        status = g1_lanes_pow(lanes, outs, ins, mpz_exps, lane_count);
+        for (j = 0; status == 0 && j < lane_count; j++) {
+            element_mul(powers[j], powers[j], ins[j]);
+            valid[indices[j]] = element_is1(powers[j]);
+        }
+    }
+    // clean up
+    for (j = 0; j < lane_count; j++) {
+        element_clear(powers[j]);
+        mpz_clear(mpz_exps[j]);
+    }
+    PyMem_RawFree(ins);
+    PyMem_RawFree(outs);
+    PyMem_RawFree(powers);
+    PyMem_RawFree(mpz_exps);
+    PyMem_RawFree(indices);
+    return status;
+}
+
+// collect the indices of the invalid elements
+PyObject *Pairing_validate_result(signed char *valid, Py_ssize_t count) {
+    PyObject *result = PyList_New(0);
+    for (Py_ssize_t i = 0; result && i < count; i++) {
+        if (!valid[i]) {
+            PyObject *py_index = PyLong_FromSsize_t(i);
+            if (!py_index || PyList_Append(result, py_index) < 0) {
+                Py_CLEAR(result);
+            }
+            Py_XDECREF(py_index);
+        }
+    }
+    return result;
+}
+
+PyObject *Pairing_validate_batch(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect a sequence of elements
+    if (nargs != 1) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected a sequence of Elements");
+        return NULL;
+    }
+    PyObject *py_elements = args[0];
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    G1Lanes *lanes;
+    PyObject *elements = Pairing_validate_collect(pairing, py_elements, &lanes);
+    if (!elements) {
+        return NULL;
+    }
+    Py_ssize_t count = PyTuple_GET_SIZE(elements);
+    // allocate the working arrays
+    element_ptr *ptrs = PyMem_Malloc((count + 1) * sizeof(element_ptr));
+    signed char *valid = PyMem_Malloc(count + 1);
+    if (!ptrs || !valid) {
+        PyMem_Free(ptrs);
+        PyMem_Free(valid);
+        Py_DECREF(elements);
+        return PyErr_NoMemory();
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        ptrs[i] = ((Element *)PyTuple_GET_ITEM(elements, i))->pbc_element;
+    }
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = Pairing_validate_elements(pairing, lanes, ptrs, count, valid);
+    Py_END_ALLOW_THREADS
+    PyObject *result = status < 0 ? PyErr_NoMemory() : Pairing_validate_result(valid, count);
+    // clean up
+    PyMem_Free(ptrs);
+    PyMem_Free(valid);
+    Py_DECREF(elements);
+    return result;
+}
+
+// a batch validation run on the worker pool
+typedef struct {
+    AsyncJob job;
+    Pairing *pairing;
+    G1Lanes *lanes;
+    PyObject *elements;
+    Py_ssize_t count;
+    element_ptr *ptrs;
+    signed char *valid;
+} ValidateJob;
+
+static int ValidateJob_run(AsyncJob *job) {
+    ValidateJob *validate = (ValidateJob *)job;
+    return Pairing_validate_elements(validate->pairing, validate->lanes, validate->ptrs, validate->count, validate->valid);
+}
+
+static PyObject *ValidateJob_finish(AsyncJob *job) {
+    ValidateJob *validate = (ValidateJob *)job;
+    return Pairing_validate_result(validate->valid, validate->count);
+}
+
+static void ValidateJob_clear(AsyncJob *job) {
+    ValidateJob *validate = (ValidateJob *)job;
+    PyMem_Free(validate->ptrs);
+    PyMem_Free(validate->valid);
+    Py_DECREF(validate->elements);
+    Py_DECREF(validate->pairing);
+}
+
+PyObject *Pairing_validate_batch_async(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect a sequence of elements
+    if (nargs != 1) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected a sequence of Elements");
+        return NULL;
+    }
+    PyObject *py_elements = args[0];
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    G1Lanes *lanes;
+    PyObject *elements = Pairing_validate_collect(pairing, py_elements, &lanes);
+    if (!elements) {
+        return NULL;
+    }
+    Py_ssize_t count = PyTuple_GET_SIZE(elements);
+    // allocate the job and its working arrays
+    ValidateJob *validate = PyMem_Malloc(sizeof(ValidateJob));
+    element_ptr *ptrs = PyMem_Malloc((count + 1) * sizeof(element_ptr));
+    signed char *valid = PyMem_Malloc(count + 1);
+    if (!validate || !ptrs || !valid) {
+        PyMem_Free(validate);
+        PyMem_Free(ptrs);
+        PyMem_Free(valid);
+        Py_DECREF(elements);
+        return PyErr_NoMemory();
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        ptrs[i] = ((Element *)PyTuple_GET_ITEM(elements, i))->pbc_element;
+    }
+    validate->job.run = ValidateJob_run;
+    validate->job.finish = ValidateJob_finish;
+    validate->job.clear = ValidateJob_clear;
+    validate->pairing = pairing;
+    validate->lanes = lanes;
+    validate->elements = elements;
+    validate->count = count;
+    validate->ptrs = ptrs;
+    validate->valid = valid;
+    Py_INCREF(pairing);
+    return async_submit(pairing->state, &validate->job);
+}
+
+// split an element whose order divides the product of the factors lo to hi - 1 into its
+// components in their prime subgroups, raising it to the idempotent of the first half of
+// the factors and dividing for the second half, so n factors take log n exponentiations
+void Pairing_project_range(Pairing *pairing, element_ptr *outs, element_ptr element, int lo, int hi) {
+    if (hi - lo == 1) {
+        element_set(outs[lo], element);
+        return;
+    }
+    int mid = (lo + hi) / 2;
+    // the idempotent is 1 modulo the first half and 0 modulo the second
+    mpz_t first, second, idempotent;
+    mpz_init_set_ui(first, 1);
+    mpz_init_set_ui(second, 1);
+    mpz_init(idempotent);
+    for (int i = lo; i < hi; i++) {
+        mpz_mul(i < mid ? first : second, i < mid ? first : second, pairing->factors[i]);
+    }
+    mpz_invert(idempotent, second, first);
+    mpz_mul(idempotent, idempotent, second);
+    element_t lft, rgt;
+    element_init_same_as(lft, element);
+    element_init_same_as(rgt, element);
+    element_pow_mpz(lft, element, idempotent);
+    element_div(rgt, element, lft);
+    Pairing_project_range(pairing, outs, lft, lo, mid);
+    Pairing_project_range(pairing, outs, rgt, mid, hi);
+    element_clear(lft);
+    element_clear(rgt);
+    mpz_clears(first, second, idempotent, NULL);
+}
+
+PyObject *Pairing_project(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required argument is the element, the index of the subgroup is optional
+    static const char *const keywords[] = {"element", "index", NULL};
+    PyObject *slots[2];
+    ModuleState *state = ((Pairing *)py_pairing)->state;
+    if (args_bind(args, nargs, kwnames, keywords, 1, slots) < 0 || !PyObject_TypeCheck(slots[0], state->ElementType)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected an Element and an optional index");
+        return NULL;
+    }
+    PyObject *py_element = slots[0];
+    PyObject *py_index = slots[1] ? slots[1] : Py_None;
+    // cast the arguments
+    Pairing *pairing = (Pairing *)py_pairing;
+    Element *element = (Element *)py_element;
+    if (!pairing->factor_count) {
+        PyErr_SetString(PyExc_ValueError, "the pairing was not given the factors of its order");
+        return NULL;
+    }
+    if (element->pairing != pairing || element->pbc_element->field == pairing->pbc_pairing->Zr) {
+        PyErr_SetString(PyExc_ValueError, "only Elements in G1, G2 or GT of this pairing can be projected");
+        return NULL;
+    }
+    int index = -1;
+    if (py_index != Py_None) {
+        long value = PyLong_AsLong(py_index);
+        if (value == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+        if (value > INT_MAX) {
+            PyErr_SetString(PyExc_OverflowError, "the index of the subgroup does not fit in a C int");
+            return NULL;
+        }
+        if (value < 0 || value >= pairing->factor_count) {
+            PyErr_SetString(PyExc_IndexError, "the index of the subgroup is out of range");
+            return NULL;
+        }
+        index = (int)value;
+    }
+    // build the result elements
+    int count = index < 0 ? pairing->factor_count : 1;
+    Element *results[count];
+    element_ptr outs[pairing->factor_count];
+    for (int i = 0; i < count; i++) {
+        results[i] = Element_create(pairing);
+        if (!results[i]) {
+            while (i--) {
+                Py_DECREF(results[i]);
+            }
+            return NULL;
+        }
+        element_init_same_as(results[i]->pbc_element, element->pbc_element);
+        results[i]->pairing = pairing;
+        results[i]->unitary = element->unitary;
+        results[i]->subgroup = (index < 0 ? i : index) + 1;
+        Py_INCREF(results[i]->pairing);
+        results[i]->ready = 1;
+        outs[i] = results[i]->pbc_element;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    if (index < 0) {
+        Pairing_project_range(pairing, outs, element->pbc_element, 0, pairing->factor_count);
+    } else {
+        // a single component takes the idempotent of its factor
+        mpz_t cofactor, idempotent;
+        mpz_init(cofactor);
+        mpz_init(idempotent);
+        mpz_divexact(cofactor, pairing->pbc_pairing->r, pairing->factors[index]);
+        mpz_invert(idempotent, cofactor, pairing->factors[index]);
+        mpz_mul(idempotent, idempotent, cofactor);
+        element_pow_mpz(outs[0], element->pbc_element, idempotent);
+        mpz_clears(cofactor, idempotent, NULL);
+    }
+    Py_END_ALLOW_THREADS
+    if (index >= 0) {
+        return (PyObject *)results[0];
+    }
+    PyObject *result = PyList_New(count);
+    if (!result) {
+        for (int i = 0; i < count; i++) {
+            Py_DECREF(results[i]);
+        }
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        PyList_SET_ITEM(result, i, (PyObject *)results[i]);
+    }
+    return result;
+}
+
+PyObject *Pairing_factors(PyObject *py_pairing) {
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    // return the factors as a list, which is empty when they were not given
+    PyObject *result = PyList_New(pairing->factor_count);
+    for (int i = 0; result && i < pairing->factor_count; i++) {
+        PyObject *py_factor = mpz_to_pynum(pairing->factors[i]);
+        if (!py_factor) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyList_SET_ITEM(result, i, py_factor);
+    }
+    return result;
+}
+
+PyObject *Pairing_order(PyObject *py_pairing) {
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    // return the r value
+    return mpz_to_pynum(pairing->pbc_pairing->r);
+}
+
+PyObject *Pairing_fingerprint(PyObject *py_pairing) {
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    // return the SHA-256 digest of the parameters
+    return PyBytes_FromStringAndSize((char *)pairing->fingerprint, sizeof(pairing->fingerprint));
+}
+
+// get the field of a group of the pairing, or NULL if the group is invalid
+field_ptr Pairing_field(Pairing *pairing, enum Group group) {
+    switch (group) {
+    case G1: return pairing->pbc_pairing->G1;
+    case G2: return pairing->pbc_pairing->G2;
+    case GT: return pairing->pbc_pairing->GT;
+    case Zr: return pairing->pbc_pairing->Zr;
+    default: return NULL;
+    }
+}
+
+// get the group of a field of the pairing, or -1 if it is not one of them
+int Pairing_group(Pairing *pairing, field_ptr field) {
+    // G1 comes first, so that symmetric pairings report G1 rather than G2
+    if (field == pairing->pbc_pairing->G1) {
+        return G1;
+    } else if (field == pairing->pbc_pairing->G2) {
+        return G2;
+    } else if (field == pairing->pbc_pairing->GT) {
+        return GT;
+    } else if (field == pairing->pbc_pairing->Zr) {
+        return Zr;
+    }
+    return -1;
+}
+
+// check that an element is in the subgroup of order r, elements of Zr always are
+int Pairing_in_subgroup(Pairing *pairing, element_ptr element) {
+    if (element->field == pairing->pbc_pairing->Zr) {
+        return 1;
+    }
+    element_t power;
+    element_init_same_as(power, element);
+    element_pow_mpz(power, element, pairing->pbc_pairing->r);
+    int member = element_is1(power);
+    element_clear(power);
+    return member;
+}
+
+PyObject *Pairing_is_symmetric(PyObject *py_pairing) {
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    // return whether the pairing is symmetric
+    if (pairing->pbc_pairing->G1 == pairing->pbc_pairing->G2) {
+        Py_RETURN_TRUE;
+    } else {
+        Py_RETURN_FALSE;
+    }
+}
+
+PyMemberDef Pairing_members[] = {
+    {NULL},
+};
+
+PyMethodDef Pairing_methods[] = {
+    {"apply", (PyCFunction)(void (*)(void))Pairing_apply, METH_FASTCALL, "Applies the pairing."},
+    {"apply_lazy", (PyCFunction)(void (*)(void))Pairing_apply_lazy, METH_FASTCALL, "Returns the pairing of the given Elements as a lazy expression."},
+    {"apply_async", (PyCFunction)(void (*)(void))Pairing_apply_async, METH_FASTCALL, "Returns a future of the pairing of the given Elements, computed on the worker pool."},
+    {"miller_loop", (PyCFunction)(void (*)(void))Pairing_miller_loop, METH_FASTCALL, "Returns the product of the Miller loops of the given pairs, before the final exponentiation."},
+    {"final_exponentiation", (PyCFunction)Pairing_final_exponentiation, METH_O, "Raises a MillerValue to the final exponent, giving the product of its pairings."},
+    {"prepare", (PyCFunction)Pairing_prepare, METH_O, "Returns an Element of G2 with the lines of its Miller loop precomputed."},
+    {"apply_product", (PyCFunction)(void (*)(void))Pairing_apply_product, METH_FASTCALL, "Returns the product of the pairings of the given pairs, with a single final exponentiation."},
+    {"batch_pow", (PyCFunction)(void (*)(void))Pairing_batch_pow, METH_FASTCALL, "Raises many Elements of one group to the given exponents."},
+    {"to_array", (PyCFunction)(void (*)(void))Pairing_to_array, METH_FASTCALL, "Returns the Elements of one group as an array of bytes with one row per Element."},
+    {"from_array", (PyCFunction)(void (*)(void))Pairing_from_array, METH_FASTCALL | METH_KEYWORDS, "Returns the Elements of an array of bytes with one row per Element."},
+    {"to_int_array", (PyCFunction)(void (*)(void))Pairing_to_int_array, METH_FASTCALL | METH_KEYWORDS, "Returns the Elements of Zr as an array of 64-bit limbs with one row per Element."},
+    {"from_int_array", (PyCFunction)(void (*)(void))Pairing_from_int_array, METH_FASTCALL, "Returns the Elements of Zr of an array of integers, or of rows of 64-bit limbs."},
+    {"validate_batch", (PyCFunction)(void (*)(void))Pairing_validate_batch, METH_FASTCALL, "Returns the indices of the Elements that are not in the subgroup of order r, raising each to r."},
+    {"validate_batch_async", (PyCFunction)(void (*)(void))Pairing_validate_batch_async, METH_FASTCALL, "Returns a future of the indices of the Elements that are not in the subgroup of order r, computed on the worker pool."},
+    {"order", (PyCFunction)Pairing_order, METH_NOARGS, "Returns the order of the pairing."},
+    {"factors", (PyCFunction)Pairing_factors, METH_NOARGS, "Returns the prime factors of the order the pairing was given."},
+    {"project", (PyCFunction)(void (*)(void))Pairing_project, METH_FASTCALL | METH_KEYWORDS, "Returns the components of an Element in the prime subgroups, or the one with the given index."},
+    {"is_symmetric", (PyCFunction)Pairing_is_symmetric, METH_NOARGS, "Returns whether the pairing is symmetric."},
+    {"fingerprint", (PyCFunction)Pairing_fingerprint, METH_NOARGS, "Returns the SHA-256 digest of the parameters of the pairing."},
+    {"enable_cache", (PyCFunction)(void (*)(void))Pairing_enable_cache, METH_FASTCALL | METH_KEYWORDS, "Caches the results of apply and Element.from_hash, keeping at most capacity entries."},
+    {"disable_cache", (PyCFunction)Pairing_disable_cache, METH_NOARGS, "Disables the cache and drops its entries."},
+    {"cache_info", (PyCFunction)Pairing_cache_info, METH_NOARGS, "Returns the hits, misses, evictions, size and capacity of the cache."},
+    {"cache_clear", (PyCFunction)Pairing_cache_clear, METH_NOARGS, "Drops the entries of the cache and resets its statistics."},
+    {"autotune", (PyCFunction)(void (*)(void))Pairing_autotune, METH_FASTCALL | METH_KEYWORDS, "Times the algorithms of the pairing on the host, switches to the fastest and returns the profile."},
+    {"tuning", (PyCFunction)Pairing_tuning, METH_NOARGS, "Returns the tuning profile of the pairing."},
+    {"set_tuning", (PyCFunction)Pairing_set_tuning, METH_O, "Loads a tuning profile returned by tuning or autotune."},
+    {NULL},
+};
+
+PyType_Slot Pairing_slots[] = {
+    {Py_tp_dealloc, Pairing_dealloc},
+    {Py_tp_doc, (void *)Pairing__doc__},
+    {Py_tp_methods, Pairing_methods},
+    {Py_tp_members, Pairing_members},
+    {Py_tp_new, Pairing_new},
+    {0, NULL},
+};
+
+PyType_Spec Pairing_spec = {
+    "pypbc.Pairing",                                                     /* name */
+    sizeof(Pairing),                                                     /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    Pairing_slots,                                                       /* slots */
+};
+
+/*******************************************************************************
+*                                   Elements                                   *
+*******************************************************************************/
+
+PyDoc_STRVAR(Element__doc__,
+    "Represents an element of a bilinear group.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "Element(pairing: Pairing, group: int, string: str) -> Element\n"
+    "\n"
+    "Most of the basic arithmetic operations apply. Please note that many of them\n"
+    "do not make sense between groups, and that not all of these are checked for.");
+
+Element *Element_create(Pairing *pairing) {
+    // allocate the object from the Element type of the module the pairing belongs to
+    PyTypeObject *type = pairing->state->ElementType;
+    Element *element = (Element *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!element) {
+        PyErr_SetString(PyExc_TypeError, "could not create Element object");
+        return NULL;
+    }
+    // set the ready flag to 0, nothing is known about the element yet
+    element->ready = 0;
+    element->unitary = 0;
+    element->subgroup = 0;
+    return element;
+}
+
+// create an element of the group, initialized but not yet ready
+Element *Element_create_in(Pairing *pairing, enum Group group) {
+    field_ptr field = Pairing_field(pairing, group);
+    if (!field) {
+        PyErr_SetString(PyExc_ValueError, "invalid group");
+        return NULL;
+    }
+    Element *element = Element_create(pairing);
+    if (!element) {
+        return NULL;
+    }
+    element_init(element->pbc_element, field);
+    element->pairing = pairing;
+    return element;
+}
+
+// build an element of the group from its decimal string
+PyObject *Element_from_str(Pairing *pairing, enum Group group, const char *string) {
+    // build the result element and initialize it with the pairing and group
+    Element *element = Element_create_in(pairing, group);
+    if (!element) {
+        return NULL;
+    }
+    // set the element to the string
+    if (element_set_str(element->pbc_element, (char *)string, 10) == 0) {
+        element_clear(element->pbc_element);
+        Py_DECREF(element);
+        PyErr_SetString(PyExc_ValueError, "could not parse element from string");
+        return NULL;
+    }
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(element->pairing);
+    element->ready = 1;
+    return (PyObject *)element;
+}
+
+PyObject *Element_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    // required arguments are the pairing and the group
+    PyObject *py_pairing;
+    enum Group group;
+    char *string = NULL;
+    ModuleState *state = pypbc_state(type);
+    if (!state) {
+        return NULL;
+    }
+    if (!PyArg_ParseTuple(args, "O!is", state->PairingType, &py_pairing, &group, &string)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, group, and string");
+        return NULL;
+    }
+    return Element_from_str((Pairing *)py_pairing, group, string);
+}
+
+// calls to the Element type itself skip tp_new and its argument tuple, subclasses still go
+// through Element_new since the vectorcall slot is not inherited
+PyObject *Element_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames) {
+    // required arguments are the pairing, the group and the string
+    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+    enum Group group;
+    const char *string = NULL;
+    Py_ssize_t size;
+    ModuleState *state = pypbc_state((PyTypeObject *)type);
+    if (!state) {
+        return NULL;
+    }
+    if ((kwnames && PyTuple_GET_SIZE(kwnames)) || nargs != 3 || !PyObject_TypeCheck(args[0], state->PairingType) || args_group(args[1], &group) < 0 ||
+        !PyUnicode_Check(args[2]) || !(string = PyUnicode_AsUTF8AndSize(args[2], &size)) || strlen(string) != (size_t)size) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, group, and string");
+        return NULL;
+    }
+    return Element_from_str((Pairing *)args[0], group, string);
+}
+
+void Element_dealloc(Element *element) {
+    // clear the element and decrement the reference count on the pairing if it's ready
+    if (element->ready){
+        element_clear(element->pbc_element);
+        Py_DECREF(element->pairing);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(element);
+    type->tp_free((PyObject *)element);
+    Py_DECREF(type);
+}
+
+PyObject *Element_from_int(PyObject *cls, PyObject *const *args, Py_ssize_t nargs) {
+    // required arguments are the pairing and the number
+    ModuleState *state = pypbc_state((PyTypeObject *)cls);
+    if (!state) {
+        return NULL;
+    }
+    if (nargs != 2 || !PyObject_TypeCheck(args[0], state->PairingType) || !PyLong_Check(args[1])) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object and number");
+        return NULL;
+    }
+    // cast the arguments
+    Pairing *pairing = (Pairing *)args[0];
+    // convert the number to an mpz_t
+    mpz_t mpz_val;
+    mpz_init_from_pynum(mpz_val, args[1]);
+    // build the result element and initialize it with the pairing and group
+    Element *element = Element_create_in(pairing, Zr);
+    if (!element) {
+        mpz_clear(mpz_val);
+        return NULL;
+    }
+    // set the element to the number
+    element_set_mpz(element->pbc_element, mpz_val);
+    // clear the mpz_t
+    mpz_clear(mpz_val);
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(element->pairing);
+    element->ready = 1;
+    return (PyObject *)element;
+}
+
+// check the pairing and group arguments of zero, one and random, and build the element
+Element *Element_create_from_args(PyObject *cls, PyObject *const *args, Py_ssize_t nargs) {
+    enum Group group;
+    ModuleState *state = pypbc_state((PyTypeObject *)cls);
+    if (!state) {
+        return NULL;
+    }
+    if (nargs != 2 || !PyObject_TypeCheck(args[0], state->PairingType) || args_group(args[1], &group) < 0) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object and group");
+        return NULL;
+    }
+    return Element_create_in((Pairing *)args[0], group);
+}
+
+PyObject *Element_zero(PyObject *cls, PyObject *const *args, Py_ssize_t nargs) {
+    // required arguments are the pairing and the group
+    Element *element = Element_create_from_args(cls, args, nargs);
+    if (!element) {
+        return NULL;
+    }
+    // set the element to 0
+    element_set0(element->pbc_element);
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(element->pairing);
+    element->ready = 1;
+    return (PyObject *)element;
+}
+
+PyObject *Element_one(PyObject *cls, PyObject *const *args, Py_ssize_t nargs) {
+    // required arguments are the pairing and the group
+    Element *element = Element_create_from_args(cls, args, nargs);
+    if (!element) {
+        return NULL;
+    }
+    // set the element to 1, which is unitary in GT
+    element_set1(element->pbc_element);
+    element->unitary = element->pbc_element->field == element->pairing->pbc_pairing->GT && element->pairing->gt_unitary;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(element->pairing);
+    element->ready = 1;
+    return (PyObject *)element;
+}
+
+PyObject *Element_random(PyObject *cls, PyObject *const *args, Py_ssize_t nargs) {
+    // required arguments are the pairing and the group
+    Element *element = Element_create_from_args(cls, args, nargs);
+    if (!element) {
+        return NULL;
+    }
+    // make the element random
+    element_random(element->pbc_element);
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(element->pairing);
+    element->ready = 1;
+    return (PyObject *)element;
+}
+
+PyObject *Element_from_hash(PyObject *cls, PyObject *const *args, Py_ssize_t nargs) {
+    // required arguments are the pairing, the group and the bytes
+    enum Group group;
+    ModuleState *state = pypbc_state((PyTypeObject *)cls);
+    if (!state) {
+        return NULL;
+    }
+    if (nargs != 3 || !PyObject_TypeCheck(args[0], state->PairingType) || args_group(args[1], &group) < 0 || !PyBytes_Check(args[2])) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, group, and bytes");
+        return NULL;
+    }
+    // cast the arguments
+    Pairing *pairing = (Pairing *)args[0];
+    PyObject *py_bytes = args[2];
+    // build the result element and initialize it with the pairing and group
+    Element *element = Element_create_in(pairing, group);
+    if (!element) {
+        return NULL;
+    }
+    // convert the bytes to an element
+    int size = PyBytes_Size(py_bytes);
+    unsigned char *bytes = (unsigned char *)PyBytes_AsString(py_bytes);
+    // the cache key is a tag and the group followed by the bytes
+    PyObject *key = NULL;
+    PyObject *value = NULL;
+    if (pairing->cache.capacity > 0) {
+        key = PyBytes_FromStringAndSize(NULL, 2 + size);
+        if (key) {
+            unsigned char *buffer = (unsigned char *)PyBytes_AS_STRING(key);
+            buffer[0] = 'h';
+            buffer[1] = group;
+            memcpy(buffer + 2, bytes, size);
+            value = cache_get(&pairing->cache, key);
+        } else {
+            PyErr_Clear();
+        }
+    }
+    if (value) {
+        // reuse the cached element
+        element_from_bytes(element->pbc_element, (unsigned char *)PyBytes_AS_STRING(value));
+        Py_DECREF(value);
+    } else {
+        element_from_hash(element->pbc_element, bytes, size);
+        if (key) {
+            Pairing_cache_store(pairing, key, element->pbc_element);
+        }
+    }
+    Py_XDECREF(key);
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(element->pairing);
+    element->ready = 1;
+    return (PyObject *)element;
+}
+
+// check that a freshly decoded element encodes back to the same bytes and lies in the
+// subgroup of order r, the round trip rejects non-canonical encodings as well as points
+// off the curve, which PBC silently decodes to the identity
+int Element_check_decoded(Element *element, unsigned char *bytes, Py_ssize_t size, int (*encode)(unsigned char *, element_ptr)) {
+    // encode the element again and compare the bytes
+    unsigned char *buffer = PyMem_Malloc(size);
+    if (!buffer) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    encode(buffer, element->pbc_element);
+    int canonical = memcmp(buffer, bytes, size) == 0;
+    PyMem_Free(buffer);
+    if (!canonical) {
+        PyErr_SetString(PyExc_ValueError, "the bytes do not encode a valid element");
+        return -1;
+    }
+    // check the order of the element
+    int member;
+    Py_BEGIN_ALLOW_THREADS
+    member = Pairing_in_subgroup(element->pairing, element->pbc_element);
+    Py_END_ALLOW_THREADS
+    if (!member) {
+        PyErr_SetString(PyExc_ValueError, "the element is not in the subgroup of order r");
+        return -1;
+    }
+    // r divides q + 1, so the elements of order r in a quadratic GT are unitary
+    if (element->pbc_element->field == element->pairing->pbc_pairing->GT) {
+        element->unitary = element->pairing->gt_unitary;
+    }
+    return 0;
+}
+
+// check the arguments shared by the from_bytes constructors, the pairing, the group, the
+// bytes and an optional validation flag
+int Element_from_bytes_args(PyObject *cls, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames, Pairing **pairing, enum Group *group, PyObject **py_bytes, int *validate) {
+    static const char *const keywords[] = {"pairing", "type", "data", "validate", NULL};
+    PyObject *slots[4];
+    ModuleState *state = pypbc_state((PyTypeObject *)cls);
+    if (!state) {
+        return -1;
+    }
+    *validate = 0;
+    if (args_bind(args, nargs, kwnames, keywords, 3, slots) < 0 || !PyObject_TypeCheck(slots[0], state->PairingType) ||
+        args_group(slots[1], group) < 0 || !PyBytes_Check(slots[2]) || (slots[3] && args_bool(slots[3], validate) < 0)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, group, and bytes");
+        return -1;
+    }
+    *pairing = (Pairing *)slots[0];
+    *py_bytes = slots[2];
+    return 0;
+}
+
+PyObject *Element_from_bytes(PyObject *cls, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required arguments are the pairing, the group and the bytes, validation is optional
+    Pairing *pairing;
+    enum Group group;
+    PyObject *py_bytes;
+    int validate;
+    if (Element_from_bytes_args(cls, args, nargs, kwnames, &pairing, &group, &py_bytes, &validate) < 0) {
+        return NULL;
+    }
+    // build the result element and initialize it with the pairing and group
+    Element *element = Element_create_in(pairing, group);
+    if (!element) {
+        return NULL;
+    }
+    // check the size of the bytes
+    if (PyBytes_Size(py_bytes) != element_length_in_bytes(element->pbc_element)) {
+        element_clear(element->pbc_element);
+        Py_DECREF(element);
+        PyErr_SetString(PyExc_ValueError, "invalid number of bytes");
+        return NULL;
+    }
+    // convert the bytes to an element
+    unsigned char *bytes = (unsigned char *)PyBytes_AsString(py_bytes);
+    element_from_bytes(element->pbc_element, bytes);
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(element->pairing);
+    element->ready = 1;
+    // check the encoding and the subgroup if asked to
+    if (validate && Element_check_decoded(element, bytes, PyBytes_Size(py_bytes), element_to_bytes) < 0) {
+        Py_DECREF(element);
+        return NULL;
+    }
+    return (PyObject *)element;
+}
+
+PyObject *Element_from_bytes_compressed(PyObject *cls, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required arguments are the pairing, the group and the bytes, validation is optional
+    Pairing *pairing;
+    enum Group group;
+    PyObject *py_bytes;
+    int validate;
+    if (Element_from_bytes_args(cls, args, nargs, kwnames, &pairing, &group, &py_bytes, &validate) < 0) {
+        return NULL;
+    }
+    // build the result element and initialize it with the pairing and group
+    Element *element = Element_create(pairing);
+    switch (group) {
+    case G1: element_init_G1(element->pbc_element, pairing->pbc_pairing); break;
+    case G2: element_init_G2(element->pbc_element, pairing->pbc_pairing); break;
+    case GT: element_init_GT(element->pbc_element, pairing->pbc_pairing); break;
+    case Zr: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "only Elements in G1, G2 or GT can be created from compressed bytes"); return NULL;
+    default: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "invalid group"); return NULL;
+    }
+    element->pairing = pairing;
+    // elements of GT are decompressed from the torus
+    int gt = group == GT;
+    int size = gt ? gt_length_in_bytes_compressed(element->pbc_element->field) : element_length_in_bytes_compressed(element->pbc_element);
+    if (gt && !size) {
+        Py_DECREF(element);
+        PyErr_SetString(PyExc_TypeError, "Elements in GT can only be compressed when the embedding degree is 2");
+        return NULL;
+    }
+    // check the size of the bytes
+    if (PyBytes_Size(py_bytes) != size) {
+        Py_DECREF(element);
+        PyErr_SetString(PyExc_ValueError, "invalid number of bytes");
+        return NULL;
+    }
+    // convert the bytes to an element
+    unsigned char *bytes = (unsigned char *)PyBytes_AsString(py_bytes);
+    if (gt) {
+        gt_from_bytes_compressed(element->pbc_element, bytes);
+        element->unitary = 1;
+    } else {
+        element_from_bytes_compressed(element->pbc_element, bytes);
+    }
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(element->pairing);
+    element->ready = 1;
+    // check the encoding and the subgroup if asked to
+    if (validate && Element_check_decoded(element, bytes, size, gt ? gt_to_bytes_compressed : element_to_bytes_compressed) < 0) {
+        Py_DECREF(element);
+        return NULL;
+    }
+    return (PyObject *)element;
+}
+
+PyObject *Element_from_bytes_compressed_batch(PyObject *cls, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required arguments are the pairing, the group and the packed bytes, the thread count is optional
+    static const char *const keywords[] = {"pairing", "type", "data", "threads", NULL};
+    PyObject *slots[4];
+    enum Group group;
+    Py_buffer data;
+    int threads = 0;
+    ModuleState *state = pypbc_state((PyTypeObject *)cls);
+    if (!state) {
+        return NULL;
+    }
+    if (args_bind(args, nargs, kwnames, keywords, 3, slots) < 0 || !PyObject_TypeCheck(slots[0], state->PairingType) || args_group(slots[1], &group) < 0 ||
+        (slots[3] && args_int(slots[3], &threads) < 0) || PyObject_GetBuffer(slots[2], &data, PyBUF_SIMPLE) < 0) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, group, bytes and an optional thread count");
+        return NULL;
+    }
+    // cast the arguments
+    Pairing *pairing = (Pairing *)slots[0];
+    field_ptr field = group == G1 || group == G2 || group == GT ? Pairing_field(pairing, group) : NULL;
+    if (!field) {
+        PyBuffer_Release(&data);
+        PyErr_SetString(PyExc_ValueError, "only Elements in G1, G2 or GT can be created from compressed bytes");
+        return NULL;
+    }
+    // elements of GT are decompressed from the torus
+    int size;
+    int (*decode)(element_ptr, unsigned char *);
+    if (group == GT) {
+        size = gt_length_in_bytes_compressed(field);
+        decode = gt_from_bytes_compressed;
+        if (!size) {
+            PyBuffer_Release(&data);
+            PyErr_SetString(PyExc_TypeError, "Elements in GT can only be compressed when the embedding degree is 2");
+            return NULL;
+        }
+    } else {
+        element_t probe;
+        element_init(probe, field);
+        size = element_length_in_bytes_compressed(probe);
+        element_clear(probe);
+        decode = element_from_bytes_compressed;
+    }
+    // check the size of the bytes
+    if (data.len % size != 0) {
+        PyBuffer_Release(&data);
+        PyErr_SetString(PyExc_ValueError, "invalid number of bytes");
+        return NULL;
+    }
+    Py_ssize_t count = data.len / size;
+    // the fast path needs the curve of G1
+    G1Curve *curve = field == pairing->pbc_pairing->G1 ? Pairing_g1_curve(pairing) : NULL;
+    // by default use every processor, but give each thread a fair share of points
+    if (threads <= 0) {
+        Tuning tuning;
+        tuning_load(&tuning, &pairing->tuning);
+        threads = tuning_threads(&tuning, count);
+    }
+    // PBC caches a random non-residue in the field on its first square root, so
+    // its own decompression can't be shared between threads
+    if (!curve && group != GT) {
+        threads = 1;
+    }
+    // build the result elements
+    PyObject *result = PyList_New(count);
+    element_ptr *outs = PyMem_Malloc((count + 1) * sizeof(element_ptr));
+    if (!result || !outs) {
+        Py_XDECREF(result);
+        PyMem_Free(outs);
+        PyBuffer_Release(&data);
+        return PyErr_NoMemory();
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        Element *element = Element_create(pairing);
+        if (!element) {
+            Py_DECREF(result);
+            PyMem_Free(outs);
+            PyBuffer_Release(&data);
+            return NULL;
+        }
+        element_init(element->pbc_element, field);
+        element->pairing = pairing;
+        element->unitary = group == GT;
+        Py_INCREF(element->pairing);
+        element->ready = 1;
+        outs[i] = element->pbc_element;
+        PyList_SET_ITEM(result, i, (PyObject *)element);
+    }
+    // decompress the points
+    Py_BEGIN_ALLOW_THREADS
+    decompress_batch(curve, decode, outs, data.buf, size, count, threads);
+    Py_END_ALLOW_THREADS
+    PyMem_Free(outs);
+    PyBuffer_Release(&data);
+    return result;
+}
+
+PyObject *Element_from_bytes_x_only(PyObject *cls, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required arguments are the pairing, the group and the bytes, validation is optional
+    Pairing *pairing;
+    enum Group group;
+    PyObject *py_bytes;
+    int validate;
+    if (Element_from_bytes_args(cls, args, nargs, kwnames, &pairing, &group, &py_bytes, &validate) < 0) {
+        return NULL;
+    }
+    // build the result element and initialize it with the pairing and group
+    Element *element = Element_create(pairing);
+    switch (group) {
+    case G1: element_init_G1(element->pbc_element, pairing->pbc_pairing); break;
+    case G2: element_init_G2(element->pbc_element, pairing->pbc_pairing); break;
+    case GT:
+    case Zr: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "only Elements in G1 or G2 can be created from x-only bytes"); return NULL;
+    default: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "invalid group"); return NULL;
+    }
+    element->pairing = pairing;
+    // check the size of the bytes
+    if (PyBytes_Size(py_bytes) != element_length_in_bytes_x_only(element->pbc_element)) {
+        Py_DECREF(element);
+        PyErr_SetString(PyExc_ValueError, "invalid number of bytes");
+        return NULL;
+    }
+    // convert the bytes to an element
+    unsigned char *bytes = (unsigned char *)PyBytes_AsString(py_bytes);
+    element_from_bytes_x_only(element->pbc_element, bytes);
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(element->pairing);
+    element->ready = 1;
+    // check the encoding and the subgroup if asked to
+    if (validate && Element_check_decoded(element, bytes, PyBytes_Size(py_bytes), element_to_bytes_x_only) < 0) {
+        Py_DECREF(element);
+        return NULL;
+    }
+    return (PyObject *)element;
+}
+
+PyObject *Element_to_bytes(PyObject *py_element) {
+    // cast the argument
+    Element *element = (Element *)py_element;
+    // get the size of the buffer and allocate it
+    int size = element_length_in_bytes(element->pbc_element);
+    unsigned char buffer[size];
+    // convert the element to bytes
+    element_to_bytes(buffer, element->pbc_element);
+    // return the buffer as a bytes object
+    return PyBytes_FromStringAndSize((char *)buffer, size);
+}
+
+Py_hash_t Element_hash(PyObject *py_element) {
+    // cast the argument
+    Element *element = (Element *)py_element;
+    // get the size of the buffer and allocate it
+    int size = element_length_in_bytes(element->pbc_element);
+    unsigned char buffer[size];
+    // convert the element to bytes
+    element_to_bytes(buffer, element->pbc_element);
+    // initialize the hash
+    Py_uhash_t hash = 14695981039346656037U;
+    // iterate over the string
+    for (Py_ssize_t i = 0; i < size; i++) {
+        hash ^= (Py_uhash_t)buffer[i];
+        hash *= 1099511628211U;
+    }
+    // add the pointer to the hash
+    Py_uhash_t ptr = (Py_uhash_t)element->pbc_element->field;
+    hash ^= ptr >> 4 | ptr << (8 * sizeof(ptr) - 4);
+    // check if the hash is invalid
+    if (hash == (Py_uhash_t)-1) {
+        hash = (Py_uhash_t)-2;
+    }
+    // return the hash
+    return (Py_hash_t)hash;
+}
+
+PyObject *Element_to_bytes_compressed(PyObject *py_element) {
+    // cast the argument
+    Element *element = (Element *)py_element;
+    // elements of GT are compressed to the torus
+    if (element->pbc_element->field == element->pairing->pbc_pairing->GT) {
+        int size = gt_length_in_bytes_compressed(element->pbc_element->field);
+        if (!size) {
+            PyErr_SetString(PyExc_TypeError, "Elements in GT can only be compressed when the embedding degree is 2");
+            return NULL;
+        }
+        unsigned char buffer[size];
+        if (gt_to_bytes_compressed(buffer, element->pbc_element) < 0) {
+            PyErr_SetString(PyExc_ValueError, "only Elements in GT of norm 1, such as pairing outputs, can be compressed");
+            return NULL;
+        }
+        return PyBytes_FromStringAndSize((char *)buffer, size);
+    }
+    // make sure the element is in G1 or G2
+    if (element->pbc_element->field != element->pairing->pbc_pairing->G1 && element->pbc_element->field != element->pairing->pbc_pairing->G2) {
+        PyErr_SetString(PyExc_TypeError, "only Elements in G1, G2 or GT can be converted to compressed bytes");
+        return NULL;
+    }
+    // get the size of the buffer and allocate it
+    int size = element_length_in_bytes_compressed(element->pbc_element);
+    unsigned char buffer[size];
+    // convert the element to compressed bytes
+    element_to_bytes_compressed(buffer, element->pbc_element);
+    // return the buffer as a bytes object
+    return PyBytes_FromStringAndSize((char *)buffer, size);
+}
+
+PyObject *Element_to_bytes_x_only(PyObject *py_element) {
+    // cast the argument
+    Element *element = (Element *)py_element;
+    // make sure the element is in G1 or G2
+    if (element->pbc_element->field != element->pairing->pbc_pairing->G1 && element->pbc_element->field != element->pairing->pbc_pairing->G2) {
+        PyErr_SetString(PyExc_TypeError, "only Elements in G1 or G2 can be converted to x-only bytes");
+        return NULL;
+    }
+    // get the size of the buffer and allocate it
+    int size = element_length_in_bytes_x_only(element->pbc_element);
+    unsigned char buffer[size];
+    // convert the element to x-only bytes
+    element_to_bytes_x_only(buffer, element->pbc_element);
+    // return the buffer as a bytes object
+    return PyBytes_FromStringAndSize((char *)buffer, size);
+}
+
+PyObject *Element_add(PyObject *py_lft, PyObject *py_rgt) {
+    // check the type of arguments
+    if (!Element_check(py_lft) || !Element_check(py_rgt)) {
+        PyErr_SetString(PyExc_TypeError, "operands must be Elements");
+        return NULL;
+    }
+    // declare the result element
+    Element *ele_res;
+    // convert both objects to Elements
+    Element *ele_lft = (Element *)py_lft;
+    Element *ele_rgt = (Element *)py_rgt;
+    // make sure they're in the same ring
+    if (ele_lft->pbc_element->field != ele_rgt->pbc_element->field) {
+        PyErr_SetString(PyExc_ValueError, "only Elements in the same group can be added");
+        return NULL;
+    }
+    // build and initialize the result element to the same group as the left element
+    ele_res = Element_create(ele_lft->pairing);
+    element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
+    ele_res->pairing = ele_lft->pairing;
+    // add the two elements
+    element_add(ele_res->pbc_element, ele_lft->pbc_element, ele_rgt->pbc_element);
+    ele_res->unitary = ele_lft->unitary && ele_rgt->unitary;
+    ele_res->subgroup = ele_lft->subgroup == ele_rgt->subgroup ? ele_lft->subgroup : 0;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+PyObject *Element_sub(PyObject *py_lft, PyObject *py_rgt) {
+    // check the type of arguments
+    if (!Element_check(py_lft) || !Element_check(py_rgt)) {
+        PyErr_SetString(PyExc_TypeError, "operands must be Elements");
+        return NULL;
+    }
+    // declare the result element
+    Element *ele_res;
+    // convert both objects to Elements
+    Element *ele_lft = (Element *)py_lft;
+    Element *ele_rgt = (Element *)py_rgt;
+    // make sure they're in the same ring
+    if (ele_lft->pbc_element->field != ele_rgt->pbc_element->field) {
+        PyErr_SetString(PyExc_ValueError, "only Elements in the same group can be subtracted");
+        return NULL;
+    }
+    // build and initialize the result element to the same group as the left element
+    ele_res = Element_create(ele_lft->pairing);
+    element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
+    ele_res->pairing = ele_lft->pairing;
+    // subtract the two elements, in GT a unitary element is subtracted through its conjugate
+    if (ele_rgt->unitary) {
+        gt_unitary_invert(ele_res->pbc_element, ele_rgt->pbc_element);
+        element_mul(ele_res->pbc_element, ele_lft->pbc_element, ele_res->pbc_element);
+    } else {
+        element_sub(ele_res->pbc_element, ele_lft->pbc_element, ele_rgt->pbc_element);
+    }
+    ele_res->unitary = ele_lft->unitary && ele_rgt->unitary;
+    ele_res->subgroup = ele_lft->subgroup == ele_rgt->subgroup ? ele_lft->subgroup : 0;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+PyObject *Element_div(PyObject *py_lft, PyObject *py_rgt) {
+    // quotients with lazy expressions are lazy
+    if (Expr_check(py_lft) || Expr_check(py_rgt)) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+    // check the type of arguments
+    if (!Element_check(py_lft) || !Element_check(py_rgt)) {
+        PyErr_SetString(PyExc_TypeError, "operands must be Elements");
+        return NULL;
+    }
+    // declare the result element
+    Element *ele_res;
+    // convert both objects to Elements
+    Element *ele_lft = (Element *)py_lft;
+    Element *ele_rgt = (Element *)py_rgt;
+    // make sure they're in the same ring or one is in Zr
+    if (ele_lft->pbc_element->field != ele_rgt->pbc_element->field) {
+        PyErr_SetString(PyExc_ValueError, "only Elements in the same group can be divided");
+        return NULL;
+    }
+    // zero has no inverse in Zr
+    if (ele_rgt->pbc_element->field == ele_rgt->pairing->pbc_pairing->Zr && element_is0(ele_rgt->pbc_element)) {
+        PyErr_SetString(PyExc_ZeroDivisionError, "division by zero");
+        return NULL;
+    }
+    // build and initialize the result element to the same group as the left element
+    ele_res = Element_create(ele_lft->pairing);
+    element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
+    ele_res->pairing = ele_lft->pairing;
+    // divide the two elements, in GT a unitary divisor is inverted by conjugation
+    if (ele_rgt->unitary) {
+        gt_unitary_invert(ele_res->pbc_element, ele_rgt->pbc_element);
+        element_mul(ele_res->pbc_element, ele_lft->pbc_element, ele_res->pbc_element);
+    } else {
+        element_div(ele_res->pbc_element, ele_lft->pbc_element, ele_rgt->pbc_element);
+    }
+    ele_res->unitary = ele_lft->unitary && ele_rgt->unitary;
+    ele_res->subgroup = ele_lft->subgroup == ele_rgt->subgroup ? ele_lft->subgroup : 0;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+PyObject *Element_pow(PyObject *py_lft, PyObject *py_rgt, PyObject *py_mod) {
+    // check the type of the first argument
+    if (!Element_check(py_lft)) {
+        PyErr_SetString(PyExc_TypeError, "the base must be an Element");
+        return NULL;
+    }
+    // declare the result element
+    Element *ele_res;
+    // convert the first argument to an Element
+    Element *ele_lft = (Element *)py_lft;
+    // check the type of the second argument
+    if (Element_check(py_rgt)) {
+        // convert the second argument to an Element
+        Element *ele_rgt = (Element *)py_rgt;
+        // make sure the second element is in Zr
+        if (ele_rgt->pbc_element->field == ele_lft->pairing->pbc_pairing->Zr && (ele_lft->pbc_element->field == ele_lft->pairing->pbc_pairing->Zr || ele_lft->pbc_element->field->pairing)) {
+            // build and initialize the result element to the same group as the left element
+            ele_res = Element_create(ele_lft->pairing);
+            if (!ele_res) {
+                return NULL;
+            }
+            element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
+            ele_res->pairing = ele_lft->pairing;
+            // raise the element to the power, taking the fast paths when something is known about it
+            if (ele_lft->unitary || ele_lft->subgroup) {
+                mpz_t mpz_rgt;
+                mpz_init(mpz_rgt);
+                element_to_mpz(mpz_rgt, ele_rgt->pbc_element);
+                Element_raise(ele_res, ele_lft, mpz_rgt);
+                mpz_clear(mpz_rgt);
+            } else {
+                element_pow_zn(ele_res->pbc_element, ele_lft->pbc_element, ele_rgt->pbc_element);
+            }
+        } else {
+            PyErr_SetString(PyExc_TypeError, "if the exponent is an Element, it must be in Zr and the base must be in Zr, G1, G2, or GT");
+            return NULL;
+        }
+    } else if (Exponent_check(py_rgt)) {
+        // negative powers invert the base, and zero has no inverse in Zr
+        if (mpz_sgn(((Exponent *)py_rgt)->value) < 0 && ele_lft->pbc_element->field == ele_lft->pairing->pbc_pairing->Zr && element_is0(ele_lft->pbc_element)) {
+            PyErr_SetString(PyExc_ZeroDivisionError, "zero cannot be raised to a negative power");
+            return NULL;
+        }
+        // build and initialize the result element to the same group as the left element
+        ele_res = Element_create(ele_lft->pairing);
+        if (!ele_res) {
+            return NULL;
+        }
+        element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
+        ele_res->pairing = ele_lft->pairing;
+        // raise the element to the precomputed power
+        Element_raise_recoded(ele_res, ele_lft, (Exponent *)py_rgt);
+    } else if (PyLong_Check(py_rgt)) {
+        // convert it to an mpz
+        mpz_t mpz_lft;
+        mpz_init_from_pynum(mpz_lft, py_rgt);
+        // negative powers invert the base, and zero has no inverse in Zr
+        if (mpz_sgn(mpz_lft) < 0 && ele_lft->pbc_element->field == ele_lft->pairing->pbc_pairing->Zr && element_is0(ele_lft->pbc_element)) {
+            mpz_clear(mpz_lft);
+            PyErr_SetString(PyExc_ZeroDivisionError, "zero cannot be raised to a negative power");
+            return NULL;
+        }
+        // build and initialize the result element to the same group as the left element
+        ele_res = Element_create(ele_lft->pairing);
+        if (!ele_res) {
+            mpz_clear(mpz_lft);
+            return NULL;
+        }
+        element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
+        ele_res->pairing = ele_lft->pairing;
+        // raise the element to the power
+        Element_raise(ele_res, ele_lft, mpz_lft);
+        // clean up the mpz
+        mpz_clear(mpz_lft);
+    } else {
+        PyErr_SetString(PyExc_TypeError, "the exponent must be an Element, an Exponent or an integer");
+        return NULL;
+    }
+    // powers stay unitary and in the same subgroup
+    ele_res->unitary = ele_lft->unitary;
+    ele_res->subgroup = ele_lft->subgroup;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+// a power computed on the worker pool, the exponent is either precomputed or an integer
+typedef struct {
+    AsyncJob job;
+    Element *ele_base;
+    Element *ele_res;
+    Exponent *exponent;
+    mpz_t mpz_exp;
+} PowJob;
+
+static int PowJob_run(AsyncJob *job) {
+    PowJob *pow = (PowJob *)job;
+    if (pow->exponent) {
+        Element_raise_recoded(pow->ele_res, pow->ele_base, pow->exponent);
+    } else {
+        Element_raise(pow->ele_res, pow->ele_base, pow->mpz_exp);
+    }
+    return 0;
+}
+
+static PyObject *PowJob_finish(AsyncJob *job) {
+    PowJob *pow = (PowJob *)job;
+    Element *ele_res = pow->ele_res;
+    pow->ele_res = NULL;
+    // powers stay unitary and in the same subgroup
+    ele_res->unitary = pow->ele_base->unitary;
+    ele_res->subgroup = pow->ele_base->subgroup;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+static void PowJob_clear(AsyncJob *job) {
+    PowJob *pow = (PowJob *)job;
+    if (pow->ele_res) {
+        element_clear(pow->ele_res->pbc_element);
+        Py_DECREF(pow->ele_res);
+    }
+    Py_DECREF(pow->ele_base);
+    Py_XDECREF(pow->exponent);
+    mpz_clear(pow->mpz_exp);
+}
+
+PyObject *Element_pow_async(PyObject *py_base, PyObject *py_exp) {
+    // cast the argument
+    Element *ele_base = (Element *)py_base;
+    // allocate the job and convert the exponent, unless it is precomputed
+    PowJob *pow = PyMem_Malloc(sizeof(PowJob));
+    if (!pow) {
+        return PyErr_NoMemory();
+    }
+    mpz_init(pow->mpz_exp);
+    pow->exponent = NULL;
+    if (Exponent_check(py_exp)) {
+        pow->exponent = (Exponent *)py_exp;
+        Py_INCREF(py_exp);
+    } else if (Pairing_exponent_to_mpz(ele_base->pairing, pow->mpz_exp, py_exp) < 0) {
+        mpz_clear(pow->mpz_exp);
+        PyMem_Free(pow);
+        return NULL;
+    }
+    // build and initialize the result element to the same group as the base
+    pow->ele_res = Element_create(ele_base->pairing);
+    if (!pow->ele_res) {
+        Py_XDECREF(pow->exponent);
+        mpz_clear(pow->mpz_exp);
+        PyMem_Free(pow);
+        return NULL;
+    }
+    element_init_same_as(pow->ele_res->pbc_element, ele_base->pbc_element);
+    pow->ele_res->pairing = ele_base->pairing;
+    pow->ele_base = ele_base;
+    Py_INCREF(py_base);
+    pow->job.run = PowJob_run;
+    pow->job.finish = PowJob_finish;
+    pow->job.clear = PowJob_clear;
+    return async_submit(ele_base->pairing->state, &pow->job);
+}
+
+// raise an element to an integer power, an element of a known prime subgroup only needs the
+// exponent modulo the order of the subgroup, which is reduced in place, and a unitary element
+// of GT takes signed digits
+void Element_raise(Element *ele_res, Element *ele_base, mpz_t mpz_exp) {
+    if (ele_base->subgroup) {
+        mpz_mod(mpz_exp, mpz_exp, ele_base->pairing->factors[ele_base->subgroup - 1]);
+    }
+    if (ele_base->unitary) {
+        Tuning tuning;
+        tuning_load(&tuning, &ele_base->pairing->tuning);
+        gt_unitary_pow_mpz(ele_res->pbc_element, ele_base->pbc_element, mpz_exp, tuning.gt_window);
+    } else {
+        element_pow_mpz(ele_res->pbc_element, ele_base->pbc_element, mpz_exp);
+    }
+    ele_res->unitary = ele_base->unitary;
+    ele_res->subgroup = ele_base->subgroup;
+}
+
+// raise an element to a precomputed exponent, using its signed digits unless the element is
+// in a known prime subgroup, where a shorter exponent beats the recoding
+void Element_raise_recoded(Element *ele_res, Element *ele_base, Exponent *exponent) {
+    if (ele_base->subgroup) {
+        mpz_t mpz_exp;
+        mpz_init_set(mpz_exp, exponent->value);
+        Element_raise(ele_res, ele_base, mpz_exp);
+        mpz_clear(mpz_exp);
+    } else if (ele_base->unitary) {
+        gt_unitary_pow(ele_res->pbc_element, ele_base->pbc_element, exponent->digits, exponent->length, exponent->window);
+    } else {
+        Exponent_apply(ele_res->pbc_element, ele_base->pbc_element, exponent);
+    }
+}
+
+// multiply an element by an integer, which for an element of G1, G2 or GT is a power
+void Element_mul_mpz(Element *ele_res, Element *ele_arg, mpz_t mpz_arg) {
+    if (ele_arg->unitary || ele_arg->subgroup) {
+        Element_raise(ele_res, ele_arg, mpz_arg);
+    } else {
+        element_mul_mpz(ele_res->pbc_element, ele_arg->pbc_element, mpz_arg);
+    }
+}
+
+// multiply an element of G1, G2 or GT by an element of Zr
+void Element_mul_zn(Element *ele_res, Element *ele_arg, Element *ele_zn) {
+    if (ele_arg->unitary || ele_arg->subgroup) {
+        mpz_t mpz_zn;
+        mpz_init(mpz_zn);
+        element_to_mpz(mpz_zn, ele_zn->pbc_element);
+        Element_raise(ele_res, ele_arg, mpz_zn);
+        mpz_clear(mpz_zn);
+    } else {
+        element_mul_zn(ele_res->pbc_element, ele_arg->pbc_element, ele_zn->pbc_element);
+    }
+}
+
+PyObject *Element_mul(PyObject *py_lft, PyObject *py_rgt) {
+    // declare the result element
+    Element *ele_res;
+    // check the type of arguments
+    if (Element_check(py_lft) && Element_check(py_rgt)) {
+        // convert both objects to Elements
+        Element *ele_lft = (Element *)py_lft;
+        Element *ele_rgt = (Element *)py_rgt;
+        // make sure they're in the same ring or one is in Zr
+        if (ele_lft->pbc_element->field == ele_rgt->pbc_element->field) {
+            // build and initialize the result element to the same group as the left element
+            ele_res = Element_create(ele_lft->pairing);
+            if (!ele_res) {
+                return NULL;
+            }
+            element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
+            ele_res->pairing = ele_lft->pairing;
+            // multiply the two elements
+            element_mul(ele_res->pbc_element, ele_lft->pbc_element, ele_rgt->pbc_element);
+            ele_res->unitary = ele_lft->unitary && ele_rgt->unitary;
+            ele_res->subgroup = ele_lft->subgroup == ele_rgt->subgroup ? ele_lft->subgroup : 0;
+        } else if (ele_rgt->pbc_element->field == ele_lft->pairing->pbc_pairing->Zr && ele_lft->pbc_element->field->pairing) {
+            // build and initialize the result element to the same group as the left element
+            ele_res = Element_create(ele_lft->pairing);
+            if (!ele_res) {
+                return NULL;
+            }
+            element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
+            ele_res->pairing = ele_lft->pairing;
+            // multiply the two elements
+            Element_mul_zn(ele_res, ele_lft, ele_rgt);
+        } else if (ele_lft->pbc_element->field == ele_rgt->pairing->pbc_pairing->Zr && ele_rgt->pbc_element->field->pairing) {
+            // build and initialize the result element to the same group as the right element
+            ele_res = Element_create(ele_rgt->pairing);
+            if (!ele_res) {
+                return NULL;
+            }
+            element_init_same_as(ele_res->pbc_element, ele_rgt->pbc_element);
+            ele_res->pairing = ele_rgt->pairing;
+            // multiply the two elements
+            Element_mul_zn(ele_res, ele_rgt, ele_lft);
+        } else {
+            PyErr_SetString(PyExc_ValueError, "only Elements in the same group can be multiplied, or one must be in Zr and the other in G1, G2, or GT");
+            return NULL;
+        }
+    } else if (PyLong_Check(py_rgt)) {
+        // convert the left object to an Element
+        Element *ele_lft = (Element *)py_lft;
+        // convert the right object to an mpz
+        mpz_t mpz_rgt;
+        mpz_init_from_pynum(mpz_rgt, py_rgt);
+        // build and initialize the result element to the same group as the left element
+        ele_res = Element_create(ele_lft->pairing);
+        if (!ele_res) {
+            mpz_clear(mpz_rgt);
+            return NULL;
+        }
+        element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
+        ele_res->pairing = ele_lft->pairing;
+        // multiply the two elements
+        Element_mul_mpz(ele_res, ele_lft, mpz_rgt);
+        // clean up the mpz
+        mpz_clear(mpz_rgt);
+    } else if (PyLong_Check(py_lft)) {
+        // convert the right object to an Element
+        Element *ele_rgt = (Element *)py_rgt;
+        // convert the left object to an mpz
+        mpz_t mpz_lft;
+        mpz_init_from_pynum(mpz_lft, py_lft);
+        // build and initialize the result element to the same group as the right element
+        ele_res = Element_create(ele_rgt->pairing);
+        if (!ele_res) {
+            mpz_clear(mpz_lft);
+            return NULL;
+        }
+        element_init_same_as(ele_res->pbc_element, ele_rgt->pbc_element);
+        ele_res->pairing = ele_rgt->pairing;
+        // multiply the two elements
+        Element_mul_mpz(ele_res, ele_rgt, mpz_lft);
+        // clean up the mpz
+        mpz_clear(mpz_lft);
+    } else if (Expr_check(py_lft) || Expr_check(py_rgt)) {
+        // products with lazy expressions are lazy
+        Py_RETURN_NOTIMPLEMENTED;
+    } else {
+        PyErr_SetString(PyExc_TypeError, "operands must be Elements or integers");
+        return NULL;
+    }
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+PyObject *Element_neg(PyObject *py_arg) {
+    // declare the result element
+    Element *ele_res;
+    // cast the argument
+    Element *ele_arg = (Element *)py_arg;
+    // build and initialize the result element to the same group as the argument
+    ele_res = Element_create(ele_arg->pairing);
+    element_init_same_as(ele_res->pbc_element, ele_arg->pbc_element);
+    ele_res->pairing = ele_arg->pairing;
+    // negate the element, which in GT is inverting it
+    if (ele_arg->unitary) {
+        gt_unitary_invert(ele_res->pbc_element, ele_arg->pbc_element);
+    } else {
+        element_neg(ele_res->pbc_element, ele_arg->pbc_element);
+    }
+    ele_res->unitary = ele_arg->unitary;
+    ele_res->subgroup = ele_arg->subgroup;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+PyObject *Element_invert(PyObject *py_arg) {
+    // declare the result element
+    Element *ele_res;
+    // cast the argument
+    Element *ele_arg = (Element *)py_arg;
+    // zero has no inverse in Zr
+    if (ele_arg->pbc_element->field == ele_arg->pairing->pbc_pairing->Zr && element_is0(ele_arg->pbc_element)) {
+        PyErr_SetString(PyExc_ZeroDivisionError, "zero has no inverse");
+        return NULL;
+    }
+    // build and initialize the result element to the same group as the argument
+    ele_res = Element_create(ele_arg->pairing);
+    element_init_same_as(ele_res->pbc_element, ele_arg->pbc_element);
+    ele_res->pairing = ele_arg->pairing;
+    // invert the element, the inverse of a unitary element is its conjugate
+    if (ele_arg->unitary) {
+        gt_unitary_invert(ele_res->pbc_element, ele_arg->pbc_element);
+    } else {
+        element_invert(ele_res->pbc_element, ele_arg->pbc_element);
+    }
+    ele_res->unitary = ele_arg->unitary;
+    ele_res->subgroup = ele_arg->subgroup;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+PyObject *Element_cmp(PyObject *py_lft, PyObject *py_rgt, int op) {
+    // check the type of arguments
+    if (!Element_check(py_lft) || !Element_check(py_rgt)) {
+        PyErr_SetString(PyExc_TypeError, "operands must be Elements");
+        return NULL;
+    }
+    // convert both objects to Elements
+    Element *ele_lft = (Element *)py_lft;
+    Element *ele_rgt = (Element *)py_rgt;
+    // make sure they're in the same ring
+    if (ele_lft->pbc_element->field != ele_rgt->pbc_element->field) {
+        PyErr_SetString(PyExc_ValueError, "only Elements in the same group can be compared");
+        return NULL;
+    }
+    // compare the two elements
+    switch (op) {
+    case Py_EQ:
+        if (element_cmp(ele_lft->pbc_element, ele_rgt->pbc_element)) {
+            Py_RETURN_FALSE;
+        } else {
+            Py_RETURN_TRUE;
+        }
+    case Py_NE:
+        if (element_cmp(ele_lft->pbc_element, ele_rgt->pbc_element)) {
+            Py_RETURN_TRUE;
+        } else {
+            Py_RETURN_FALSE;
+        }
+    default:
+        PyErr_SetString(PyExc_ValueError, "only == and != comparisons are supported");
+        return NULL;
+    }
+}
+
+PyObject *Element_is0(PyObject *py_element) {
+    // cast the argument
+    Element *element = (Element *)py_element;
+    // check if the element is 0
+    if (element_is0(element->pbc_element)) {
+        Py_RETURN_TRUE;
+    } else {
+        Py_RETURN_FALSE;
+    }
+}
+
+PyObject *Element_is1(PyObject *py_element) {
+    // cast the argument
+    Element *element = (Element *)py_element;
+    // check if the element is 1
+    if (element_is1(element->pbc_element)) {
+        Py_RETURN_TRUE;
+    } else {
+        Py_RETURN_FALSE;
+    }
+}
+
+Py_ssize_t Element_len(PyObject *py_element) {
+    // cast the argument
+    Element *element = (Element *)py_element;
+    // check the size of the element
+    Py_ssize_t sz_c = element_item_count(element->pbc_element);
+    // check if the element is in Zr
+    if (sz_c == 0) {
+        PyErr_SetString(PyExc_TypeError, "Element is not dimensioned");
+        return -1;
+    }
+    // return the length of the element
+    return sz_c;
+}
+
+PyObject *Element_item(PyObject *py_element, Py_ssize_t sz_i) {
+    // cast the argument
+    Element *element = (Element *)py_element;
+    // check the size of the element
+    Py_ssize_t sz_c = element_item_count(element->pbc_element);
+    // check if the element is in Zr
+    if (sz_c == 0) {
+        PyErr_SetString(PyExc_ValueError, "Element is not dimensioned");
+        return NULL;
+    }
+    // check if the index is in range
+    if (sz_i < 0 || sz_i >= sz_c) {
+        PyErr_SetString(PyExc_IndexError, "index out of range");
+        return NULL;
+    }
+    // get the item
+    element_ptr item = element_item(element->pbc_element, sz_i);
+    // build the result element
+    Element *ele_res = Element_create(element->pairing);
+    element_init_same_as(ele_res->pbc_element, item);
+    ele_res->pairing = element->pairing;
+    // set the item
+    element_set(ele_res->pbc_element, item);
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+PyObject *Element_int(PyObject *py_element) {
+    // cast the argument
+    Element *element = (Element *)py_element;
+    // check the size of the element
+    Py_ssize_t sz_c = element_item_count(element->pbc_element);
+    // check if the element is in Zr
+    if (sz_c != 0) {
+        PyErr_SetString(PyExc_ValueError, "cannot convert multidimensional point to int");
+        return NULL;
+    }
+    // allocate an mpz
+    mpz_t mpz_int;
+    mpz_init(mpz_int);
+    // convert the element to an mpz
+    element_to_mpz(mpz_int, element->pbc_element);
+    // convert the mpz to a Python integer
+    PyObject *py_int = mpz_to_pynum(mpz_int);
+    // clean up the mpz
+    mpz_clear(mpz_int);
+    return py_int;
+}
+
+PyObject *Element_str(PyObject *py_element) {
+    // cast the argument
+    Element *element = (Element *)py_element;
+    // allocate a buffer
+    char buffer[4096];
+    // convert the element to a string
+    int size = element_snprint(buffer, sizeof(buffer), element->pbc_element);
+    // return the string
+    return PyUnicode_FromStringAndSize(buffer, size);
+}
+
+PyObject *Element_order(PyObject *py_element) {
+    // cast the argument
+    Element *element = (Element *)py_element;
+    // convert the mpz to a Python integer
+    return mpz_to_pynum(element->pbc_element->field->order);
+}
+
+PyMemberDef Element_members[] = {
+    {NULL},
+};
+
+PyMethodDef Element_methods[] = {
+    {"zero", (PyCFunction)(void (*)(void))Element_zero, METH_FASTCALL | METH_CLASS, "Creates an element representing the additive identity for its group."},
+    {"one", (PyCFunction)(void (*)(void))Element_one, METH_FASTCALL | METH_CLASS, "Creates an element representing the multiplicative identity for its group."},
+    {"random", (PyCFunction)(void (*)(void))Element_random, METH_FASTCALL | METH_CLASS, "Creates a random element from the given group."},
+    {"from_int", (PyCFunction)(void (*)(void))Element_from_int, METH_FASTCALL | METH_CLASS, "Creates an element in Zr from the given integer."},
+    {"from_hash", (PyCFunction)(void (*)(void))Element_from_hash, METH_FASTCALL | METH_CLASS, "Creates an Element from the given hash value."},
+    {"from_bytes", (PyCFunction)(void (*)(void))Element_from_bytes, METH_FASTCALL | METH_KEYWORDS | METH_CLASS, "Creates an element from a byte string, validate checks the subgroup with one exponentiation by r."},
+    {"from_bytes_compressed", (PyCFunction)(void (*)(void))Element_from_bytes_compressed, METH_FASTCALL | METH_KEYWORDS | METH_CLASS, "Creates an element from a byte string using the compressed format."},
+    {"from_bytes_compressed_batch", (PyCFunction)(void (*)(void))Element_from_bytes_compressed_batch, METH_FASTCALL | METH_KEYWORDS | METH_CLASS, "Creates a list of elements from packed byte strings using the compressed format."},
+    {"from_bytes_x_only", (PyCFunction)(void (*)(void))Element_from_bytes_x_only, METH_FASTCALL | METH_KEYWORDS | METH_CLASS, "Creates an element from a byte string using the x-only format."},
+    {"to_bytes", (PyCFunction)Element_to_bytes, METH_NOARGS, "Converts the element to a byte string."},
+    {"to_bytes_x_only", (PyCFunction)Element_to_bytes_x_only, METH_NOARGS, "Converts the element to a byte string using the x-only format."},
+    {"to_bytes_compressed", (PyCFunction)Element_to_bytes_compressed, METH_NOARGS, "Converts the element to a byte string using the compressed format."},
+    {"is0", (PyCFunction)Element_is0, METH_NOARGS, "Returns True if the element is additive identity."},
+    {"is1", (PyCFunction)Element_is1, METH_NOARGS, "Returns True if the element is multiplicative identity."},
+    {"order", (PyCFunction)Element_order, METH_NOARGS, "Returns the order of the element."},
+    {"lazy", (PyCFunction)Element_lazy, METH_NOARGS, "Returns the element as a lazy expression."},
+    {"pow_async", (PyCFunction)Element_pow_async, METH_O, "Returns a future of the element raised to the given exponent, computed on the worker pool."},
+    {NULL},
+};
+
+
+
+PyType_Slot Element_slots[] = {
+    {Py_tp_dealloc, Element_dealloc},
+    {Py_tp_repr, Element_str},
+    {Py_tp_str, Element_str},
+    {Py_tp_hash, Element_hash},
+    {Py_tp_richcompare, Element_cmp},
+    {Py_tp_doc, (void *)Element__doc__},
+    {Py_tp_methods, Element_methods},
+    {Py_tp_members, Element_members},
+    {Py_tp_new, Element_new},
+    {Py_nb_add, Element_add},
+    {Py_nb_subtract, Element_sub},
+    {Py_nb_multiply, Element_mul},
+    {Py_nb_power, Element_pow},
+    {Py_nb_negative, Element_neg},
+    {Py_nb_invert, Element_invert},
+    {Py_nb_int, Element_int},
+    {Py_nb_true_divide, Element_div},
+    {Py_sq_length, Element_len},
+    {Py_sq_item, Element_item},
+    {0, NULL},
+};
+
+PyType_Spec Element_spec = {
+    "pypbc.Element",                                                     /* name */
+    sizeof(Element),                                                     /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    Element_slots,                                                       /* slots */
+};
+
+/*******************************************************************************
+*                                  Exponents                                   *
+*******************************************************************************/
+
+PyDoc_STRVAR(Exponent__doc__,
+    "A precomputed exponent, for raising many Elements to the same power.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "Exponent(value: Element | int) -> Exponent\n"
+    "\n"
+    "The value is converted once and recoded into width-w non-adjacent form,\n"
+    "which Element.__pow__ and Pairing.batch_pow then reuse on every call.");
+
+Exponent *Exponent_create(PyTypeObject *type) {
+    // allocate the object
+    Exponent *exponent = (Exponent *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!exponent) {
+        PyErr_SetString(PyExc_TypeError, "could not create Exponent object");
+        return NULL;
+    }
+    // set the ready flag to 0
+    exponent->ready = 0;
+    exponent->digits = NULL;
+    return exponent;
+}
+
+// the window width for an exponent of the given size, like PBC picks for its own windows
+int naf_window(size_t bits) {
+    return bits < 80 ? 3 : bits < 240 ? 4 : bits < 700 ? 5 : 6;
+}
+
+// recode a number into width-w NAF, least significant digit first, digits must have room
+// for one more digit than the number has bits, returns the number of digits
+Py_ssize_t naf_recode(signed char *digits, mpz_t value, int window) {
+    long full = 1L << window;
+    long half = 1L << (window - 1);
+    int sign = mpz_sgn(value) < 0 ? -1 : 1;
+    mpz_t k;
+    mpz_init(k);
+    mpz_abs(k, value);
+    Py_ssize_t length = 0;
+    while (mpz_sgn(k) > 0) {
+        long digit = 0;
+        if (mpz_odd_p(k)) {
+            // take the signed residue modulo 2^w, so the next w - 1 digits are zero
+            digit = mpz_fdiv_ui(k, full);
+            if (digit >= half) {
+                digit -= full;
+            }
+            if (digit > 0) {
+                mpz_sub_ui(k, k, digit);
+            } else {
+                mpz_add_ui(k, k, -digit);
+            }
+        }
+        digits[length++] = (signed char)(sign * digit);
+        mpz_fdiv_q_2exp(k, k, 1);
+    }
+    mpz_clear(k);
+    return length;
+}
+
+// recode the exponent into width-w NAF, least significant digit first
+int Exponent_recode(Exponent *exponent) {
+    size_t bits = mpz_sizeinbase(exponent->value, 2);
+    exponent->window = naf_window(bits);
+    exponent->digits = PyMem_Malloc(bits + 1);
+    if (!exponent->digits) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    exponent->length = naf_recode(exponent->digits, exponent->value, exponent->window);
+    return 0;
+}
+
+PyObject *Exponent_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    // required argument is the value
+    PyObject *py_val;
+    if (!PyArg_ParseTuple(args, "O", &py_val)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected an Element or an integer");
+        return NULL;
+    }
+    return Exponent_from_value(type, py_val);
+}
+
+// calls to the Exponent type itself skip tp_new and its argument tuple
+PyObject *Exponent_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames) {
+    // required argument is the value
+    if ((kwnames && PyTuple_GET_SIZE(kwnames)) || PyVectorcall_NARGS(nargsf) != 1) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected an Element or an integer");
+        return NULL;
+    }
+    return Exponent_from_value((PyTypeObject *)type, args[0]);
+}
+
+// build an exponent from an Element of Zr or an integer
+PyObject *Exponent_from_value(PyTypeObject *type, PyObject *py_val) {
+    // create the object
+    Exponent *exponent = Exponent_create(type);
+    if (!exponent) {
+        return NULL;
+    }
+    // convert the value to an mpz
+    if (Element_check(py_val)) {
+        Element *element = (Element *)py_val;
+        if (element->pbc_element->field != element->pairing->pbc_pairing->Zr) {
+            Py_DECREF(exponent);
+            PyErr_SetString(PyExc_TypeError, "if the value is an Element, it must be in Zr");
+            return NULL;
+        }
+        mpz_init(exponent->value);
+        element_to_mpz(exponent->value, element->pbc_element);
+    } else if (PyLong_Check(py_val)) {
+        mpz_init_from_pynum(exponent->value, py_val);
+    } else {
+        Py_DECREF(exponent);
+        PyErr_SetString(PyExc_TypeError, "the value must be an Element or an integer");
+        return NULL;
+    }
+    // set the ready flag, then recode the value
+    exponent->ready = 1;
+    if (Exponent_recode(exponent) < 0) {
+        Py_DECREF(exponent);
+        return NULL;
+    }
+    return (PyObject *)exponent;
+}
+
+void Exponent_dealloc(Exponent *exponent) {
+    // clear the value and the digits if they're ready
+    if (exponent->ready) {
+        mpz_clear(exponent->value);
+        PyMem_Free(exponent->digits);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(exponent);
+    type->tp_free((PyObject *)exponent);
+    Py_DECREF(type);
+}
+
+// raise an element to a recoded exponent, the result must be initialized in the same group
+void Exponent_apply(element_ptr out, element_ptr base, Exponent *exponent) {
+    // Zr has no use for the recoding
+    if (!base->field->pairing) {
+        element_pow_mpz(out, base, exponent->value);
+        return;
+    }
+    if (exponent->length == 0) {
+        element_set1(out);
+        return;
+    }
+    // the odd powers of the base and their inverses
+    int half = 1 << (exponent->window - 2);
+    element_t table[64];
+    element_t acc;
+    element_init_same_as(acc, base);
+    element_square(acc, base);
+    for (int i = 0; i < half; i++) {
+        element_init_same_as(table[i], base);
+        if (i == 0) {
+            element_set(table[i], base);
+        } else {
+            element_mul(table[i], table[i - 1], acc);
+        }
+    }
+    for (int i = 0; i < half; i++) {
+        element_init_same_as(table[half + i], base);
+        element_invert(table[half + i], table[i]);
+    }
+    // left to right over the digits, starting from the leading one
+    for (Py_ssize_t i = exponent->length - 1; i >= 0; i--) {
+        int digit = exponent->digits[i];
+        if (i == exponent->length - 1) {
+            element_set(acc, digit > 0 ? table[(digit - 1) / 2] : table[half + (-digit - 1) / 2]);
+            continue;
+        }
+        element_square(acc, acc);
+        if (digit > 0) {
+            element_mul(acc, acc, table[(digit - 1) / 2]);
+        } else if (digit < 0) {
+            element_mul(acc, acc, table[half + (-digit - 1) / 2]);
+        }
+    }
+    element_set(out, acc);
+    // clean up
+    for (int i = 0; i < 2 * half; i++) {
+        element_clear(table[i]);
+    }
+    element_clear(acc);
+}
+
+PyObject *Exponent_int(PyObject *py_exponent) {
+    // cast the argument
+    Exponent *exponent = (Exponent *)py_exponent;
+    // convert the mpz to a Python integer
+    return mpz_to_pynum(exponent->value);
+}
+
+PyObject *Exponent_repr(PyObject *py_exponent) {
+    // cast the argument
+    Exponent *exponent = (Exponent *)py_exponent;
+    // format the value
+    char *str_n = mpz_get_str(NULL, 10, exponent->value);
+    PyObject *py_str = PyUnicode_FromFormat("Exponent(%s)", str_n);
+    mpz_free_str(str_n);
+    return py_str;
+}
+
+PyObject *Exponent_window(PyObject *py_exponent) {
+    // cast the argument
+    Exponent *exponent = (Exponent *)py_exponent;
+    // return the window width of the recoding
+    return PyLong_FromLong(exponent->window);
+}
+
+PyMemberDef Exponent_members[] = {
+    {NULL},
+};
+
+PyMethodDef Exponent_methods[] = {
+    {"window", (PyCFunction)Exponent_window, METH_NOARGS, "Returns the window width of the NAF recoding."},
+    {NULL},
+};
+
+
+PyType_Slot Exponent_slots[] = {
+    {Py_tp_dealloc, Exponent_dealloc},
+    {Py_tp_repr, Exponent_repr},
+    {Py_tp_doc, (void *)Exponent__doc__},
+    {Py_tp_methods, Exponent_methods},
+    {Py_tp_members, Exponent_members},
+    {Py_tp_new, Exponent_new},
+    {Py_nb_int, Exponent_int},
+    {Py_nb_index, Exponent_int},
+    {0, NULL},
+};
+
+PyType_Spec Exponent_spec = {
+    "pypbc.Exponent",                                                    /* name */
+    sizeof(Exponent),                                                    /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    Exponent_slots,                                                      /* slots */
+};
+
+/*******************************************************************************
+*                                  Fixed Bases                                 *
+*******************************************************************************/
+
+PyDoc_STRVAR(FixedBase__doc__,
+    "A precomputed table for raising one Element to many exponents.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "FixedBase(base: Element, window: int = 4) -> FixedBase\n"
+    "FixedBase.load(pairing: Pairing, path: str, verify: bool = True) -> FixedBase\n"
+    "\n"
+    "The table holds base^(d * 2^(window * i)) for every window i and digit d, so\n"
+    "an exponentiation is one multiplication per window and no squarings. Tables\n"
+    "can be saved to a file and loaded back with mmap, in which case all the\n"
+    "processes that load the same file share one read-only copy.");
+
+// the header of a saved table, all integers are little-endian
+#define TABLE_MAGIC "PYPBCTBL"
+#define TABLE_VERSION 1
+#define TABLE_HEADER_SIZE 128
+
+void le32_store(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+uint32_t le32_load(const unsigned char *p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        v |= (uint32_t)p[i] << (8 * i);
+    }
+    return v;
+}
+
+void le64_store(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+uint64_t le64_load(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v |= (uint64_t)p[i] << (8 * i);
+    }
+    return v;
+}
+
+FixedBase *FixedBase_create(PyTypeObject *type) {
+    // allocate the object
+    FixedBase *fixed = (FixedBase *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!fixed) {
+        PyErr_SetString(PyExc_TypeError, "could not create FixedBase object");
+        return NULL;
+    }
+    // set the ready flag to 0
+    fixed->ready = 0;
+    fixed->table = NULL;
+    fixed->mapping = NULL;
+    return fixed;
+}
+
+PyObject *FixedBase_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    // required argument is the base, the window width is optional
+    static char *keywords[] = {"base", "window", NULL};
+    PyObject *py_base;
+    int window = 4;
+    ModuleState *state = pypbc_state(type);
+    if (!state) {
+        return NULL;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|i", keywords, state->ElementType, &py_base, &window)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected an Element and an optional window width");
+        return NULL;
+    }
+    // cast the argument
+    Element *base = (Element *)py_base;
+    int group = Pairing_group(base->pairing, base->pbc_element->field);
+    if (group != G1 && group != G2 && group != GT) {
+        PyErr_SetString(PyExc_ValueError, "only Elements in G1, G2 or GT can be used as fixed bases");
+        return NULL;
+    }
+    if (window < 1 || window > 8) {
+        PyErr_SetString(PyExc_ValueError, "the window width must be between 1 and 8");
+        return NULL;
+    }
+    // create the object
+    FixedBase *fixed = FixedBase_create(type);
+    if (!fixed) {
+        return NULL;
+    }
+    fixed->pairing = base->pairing;
+    fixed->group = group;
+    fixed->window = window;
+    fixed->windows = (mpz_sizeinbase(base->pairing->pbc_pairing->r, 2) + window - 1) / window;
+    fixed->entry_size = element_length_in_bytes(base->pbc_element);
+    fixed->table_size = (size_t)fixed->windows * ((1 << window) - 1) * fixed->entry_size;
+    fixed->table = PyMem_Malloc(fixed->table_size);
+    if (!fixed->table) {
+        Py_DECREF(fixed);
+        return PyErr_NoMemory();
+    }
+    Py_INCREF(fixed->pairing);
+    fixed->ready = 1;
+    // fill the table, window by window
+    element_t cur, acc;
+    element_init_same_as(cur, base->pbc_element);
+    element_init_same_as(acc, base->pbc_element);
+    element_set(cur, base->pbc_element);
+    unsigned char *entry = fixed->table;
+    Py_BEGIN_ALLOW_THREADS
+    for (int i = 0; i < fixed->windows; i++) {
+        // cur is base^(2^(window * i)), the entries are its multiples
+        element_set(acc, cur);
+        for (int d = 1; d < 1 << window; d++) {
+            if (d > 1) {
+                element_mul(acc, acc, cur);
+            }
+            element_to_bytes(entry, acc);
+            entry += fixed->entry_size;
+        }
+        element_mul(cur, acc, cur);
+    }
+    Py_END_ALLOW_THREADS
+    element_clear(cur);
+    element_clear(acc);
+    return (PyObject *)fixed;
+}
+
+void FixedBase_dealloc(FixedBase *fixed) {
+    // release the table and decrement the reference count on the pairing if it's ready
+    if (fixed->ready) {
+        if (fixed->mapping) {
+            munmap(fixed->mapping, fixed->mapping_size);
+        } else {
+            PyMem_Free(fixed->table);
+        }
+        Py_DECREF(fixed->pairing);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(fixed);
+    type->tp_free((PyObject *)fixed);
+    Py_DECREF(type);
+}
+
+// raise the base to an exponent reduced modulo the order into an initialized element, which
+// needs no GIL
+void FixedBase_apply(FixedBase *fixed, element_ptr out, mpz_t mpz_exp) {
+    element_t entry;
+    element_init_same_as(entry, out);
+    // multiply the entries selected by the digits of the exponent
+    element_set1(out);
+    for (int i = 0; i < fixed->windows; i++) {
+        int digit = 0;
+        for (int j = fixed->window - 1; j >= 0; j--) {
+            digit = digit << 1 | mpz_tstbit(mpz_exp, i * fixed->window + j);
+        }
+        if (digit) {
+            element_from_bytes(entry, fixed->table + ((size_t)i * ((1 << fixed->window) - 1) + digit - 1) * fixed->entry_size);
+            element_mul(out, out, entry);
+        }
+    }
+    element_clear(entry);
+}
+
+PyObject *FixedBase_pow(PyObject *py_fixed, PyObject *py_exp) {
+    // cast the argument
+    FixedBase *fixed = (FixedBase *)py_fixed;
+    // convert the exponent and reduce it modulo the group order
+    mpz_t mpz_exp;
+    mpz_init(mpz_exp);
+    if (Pairing_exponent_to_mpz(fixed->pairing, mpz_exp, py_exp) < 0) {
+        mpz_clear(mpz_exp);
+        return NULL;
+    }
+    mpz_mod(mpz_exp, mpz_exp, fixed->pairing->pbc_pairing->r);
+    // build the result element and initialize it with the pairing and group
+    Element *ele_res = Element_create(fixed->pairing);
+    element_init(ele_res->pbc_element, Pairing_field(fixed->pairing, fixed->group));
+    ele_res->pairing = fixed->pairing;
+    Py_BEGIN_ALLOW_THREADS
+    FixedBase_apply(fixed, ele_res->pbc_element, mpz_exp);
+    Py_END_ALLOW_THREADS
+    mpz_clear(mpz_exp);
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+PyObject *FixedBase_save(PyObject *py_fixed, PyObject *const *args, Py_ssize_t nargs) {
+    // required argument is the path
+    PyObject *py_path;
+    if (nargs != 1) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected a path");
+        return NULL;
+    }
+    if (!PyUnicode_FSConverter(args[0], &py_path)) {
+        return NULL;
+    }
+    // cast the argument
+    FixedBase *fixed = (FixedBase *)py_fixed;
+    // build the header
+    unsigned char header[TABLE_HEADER_SIZE] = {0};
+    memcpy(header, TABLE_MAGIC, 8);
+    le32_store(header + 8, TABLE_VERSION);
+    le32_store(header + 12, fixed->group);
+    le32_store(header + 16, fixed->window);
+    le32_store(header + 20, fixed->windows);
+    le32_store(header + 24, fixed->entry_size);
+    le64_store(header + 32, fixed->table_size);
+    memcpy(header + 40, fixed->pairing->fingerprint, 32);
+    sha256(fixed->table, fixed->table_size, header + 72);
+    // write the header and the table
+    FILE *fp = fopen(PyBytes_AsString(py_path), "wb");
+    Py_DECREF(py_path);
+    if (fp == NULL) {
+        return PyErr_SetFromErrno(PyExc_IOError);
+    }
+    int failed = fwrite(header, 1, sizeof(header), fp) != sizeof(header) || fwrite(fixed->table, 1, fixed->table_size, fp) != fixed->table_size;
+    failed |= fclose(fp) != 0;
+    if (failed) {
+        return PyErr_SetFromErrno(PyExc_IOError);
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *FixedBase_load(PyObject *cls, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required arguments are the pairing and the path
+    static const char *const keywords[] = {"pairing", "path", "verify", NULL};
+    PyObject *slots[3];
+    PyObject *py_path;
+    int verify = 1;
+    ModuleState *state = pypbc_state((PyTypeObject *)cls);
+    if (!state) {
+        return NULL;
+    }
+    if (args_bind(args, nargs, kwnames, keywords, 2, slots) < 0 || !PyObject_TypeCheck(slots[0], state->PairingType) || (slots[2] && args_bool(slots[2], &verify) < 0)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, a path and an optional verify flag");
+        return NULL;
+    }
+    if (!PyUnicode_FSConverter(slots[1], &py_path)) {
+        return NULL;
+    }
+    // cast the arguments
+    Pairing *pairing = (Pairing *)slots[0];
+    // map the whole file
+    int fd = open(PyBytes_AsString(py_path), O_RDONLY);
+    Py_DECREF(py_path);
+    if (fd < 0) {
+        return PyErr_SetFromErrno(PyExc_IOError);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return PyErr_SetFromErrno(PyExc_IOError);
+    }
+    if (st.st_size < TABLE_HEADER_SIZE) {
+        close(fd);
+        PyErr_SetString(PyExc_ValueError, "the file is too short to hold a table");
+        return NULL;
+    }
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return PyErr_SetFromErrno(PyExc_IOError);
+    }
+    // check the header against the pairing
+    unsigned char *header = mapping;
+    const char *problem = NULL;
+    int group = le32_load(header + 12);
+    int window = le32_load(header + 16);
+    int windows = le32_load(header + 20);
+    int entry_size = le32_load(header + 24);
+    uint64_t table_size = le64_load(header + 32);
+    if (memcmp(header, TABLE_MAGIC, 8) != 0) {
+        problem = "the file is not a saved table";
+    } else if (le32_load(header + 8) != TABLE_VERSION) {
+        problem = "unsupported table version";
+    } else if (memcmp(header + 40, pairing->fingerprint, 32) != 0) {
+        problem = "the table was saved with different parameters";
+    } else if ((group != G1 && group != G2 && group != GT) || window < 1 || window > 8) {
+        problem = "the table header is corrupted";
+    } else if (windows != (int)((mpz_sizeinbase(pairing->pbc_pairing->r, 2) + window - 1) / window)) {
+        problem = "the table header is corrupted";
+    } else if (table_size != (uint64_t)windows * ((1 << window) - 1) * entry_size || table_size != (uint64_t)st.st_size - TABLE_HEADER_SIZE) {
+        problem = "the table has the wrong size";
+    }
+    // the entries must have the size of an element of the group
+    if (!problem) {
+        element_t probe;
+        element_init(probe, Pairing_field(pairing, group));
+        if (entry_size != element_length_in_bytes(probe)) {
+            problem = "the table header is corrupted";
+        }
+        element_clear(probe);
+    }
+    // check the table itself against the checksum
+    if (!problem && verify) {
+        unsigned char digest[32];
+        Py_BEGIN_ALLOW_THREADS
+        sha256(header + TABLE_HEADER_SIZE, table_size, digest);
+        Py_END_ALLOW_THREADS
+        if (memcmp(digest, header + 72, 32) != 0) {
+            problem = "the table does not match its checksum";
+        }
+    }
+    if (problem) {
+        munmap(mapping, st.st_size);
+        PyErr_SetString(PyExc_ValueError, problem);
+        return NULL;
+    }
+    // create the object over the mapping
+    FixedBase *fixed = FixedBase_create((PyTypeObject *)cls);
+    if (!fixed) {
+        munmap(mapping, st.st_size);
+        return NULL;
+    }
+    fixed->pairing = pairing;
+    fixed->group = group;
+    fixed->window = window;
+    fixed->windows = windows;
+    fixed->entry_size = entry_size;
+    fixed->table_size = table_size;
+    fixed->table = header + TABLE_HEADER_SIZE;
+    fixed->mapping = mapping;
+    fixed->mapping_size = st.st_size;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(fixed->pairing);
+    fixed->ready = 1;
+    return (PyObject *)fixed;
+}
+
+PyObject *FixedBase_base(PyObject *py_fixed) {
+    // cast the argument
+    FixedBase *fixed = (FixedBase *)py_fixed;
+    // the first entry is the base itself
+    Element *ele_res = Element_create(fixed->pairing);
+    element_init(ele_res->pbc_element, Pairing_field(fixed->pairing, fixed->group));
+    ele_res->pairing = fixed->pairing;
+    element_from_bytes(ele_res->pbc_element, fixed->table);
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+PyObject *FixedBase_is_mapped(PyObject *py_fixed) {
+    // cast the argument
+    FixedBase *fixed = (FixedBase *)py_fixed;
+    // return whether the table lives in a mapped file
+    if (fixed->mapping) {
+        Py_RETURN_TRUE;
+    } else {
+        Py_RETURN_FALSE;
+    }
+}
+
+PyMemberDef FixedBase_members[] = {
+    {NULL},
+};
+
+PyMethodDef FixedBase_methods[] = {
+    {"load", (PyCFunction)(void (*)(void))FixedBase_load, METH_FASTCALL | METH_KEYWORDS | METH_CLASS, "Loads a saved table by mapping the file into memory."},
+    {"save", (PyCFunction)(void (*)(void))FixedBase_save, METH_FASTCALL, "Saves the table to a file."},
+    {"pow", (PyCFunction)FixedBase_pow, METH_O, "Raises the base to the given exponent."},
+    {"base", (PyCFunction)FixedBase_base, METH_NOARGS, "Returns the base of the table."},
+    {"is_mapped", (PyCFunction)FixedBase_is_mapped, METH_NOARGS, "Returns whether the table lives in a mapped file."},
+    {NULL},
+};
+
+PyType_Slot FixedBase_slots[] = {
+    {Py_tp_dealloc, FixedBase_dealloc},
+    {Py_tp_doc, (void *)FixedBase__doc__},
+    {Py_tp_methods, FixedBase_methods},
+    {Py_tp_members, FixedBase_members},
+    {Py_tp_new, FixedBase_new},
+    {0, NULL},
+};
+
+PyType_Spec FixedBase_spec = {
+    "pypbc.FixedBase",                                                   /* name */
+    sizeof(FixedBase),                                                   /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    FixedBase_slots,                                                     /* slots */
+};
+
+/*******************************************************************************
+*                                Element Files                                 *
+*******************************************************************************/
+
+PyDoc_STRVAR(ElementWriter__doc__,
+    "A buffered writer of Elements of one group to a file of fixed-size records.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "ElementWriter(pairing: Pairing, path: str, group: int) -> ElementWriter\n"
+    "\n"
+    "The file starts with a header holding the fingerprint of the pairing, the group,\n"
+    "the number of records and their checksum, which are written by close().");
+
+PyDoc_STRVAR(ElementReader__doc__,
+    "A reader of the Elements of a file written by ElementWriter.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "ElementReader(pairing: Pairing, path: str, validate: bool = False) -> ElementReader\n"
+    "\n"
+    "The file is mapped into memory and its records are decoded on access, by index\n"
+    "or in chunks, so that opening even a very large file is immediate.");
+
+// the header of an element file, all integers are little-endian
+#define ELEMENTS_MAGIC "PYPBCELM"
+#define ELEMENTS_VERSION 1
+#define ELEMENTS_HEADER_SIZE 128
+
+// the records are serialized into a buffer of this size before they are written
+#define ELEMENTS_BUFFER_SIZE (1 << 20)
+
+static void ElementFile_header(unsigned char *header, Pairing *pairing, enum Group group, int record_size, uint64_t count, unsigned char *checksum) {
+    memset(header, 0, ELEMENTS_HEADER_SIZE);
+    memcpy(header, ELEMENTS_MAGIC, 8);
+    le32_store(header + 8, ELEMENTS_VERSION);
+    le32_store(header + 12, group);
+    le32_store(header + 16, record_size);
+    le64_store(header + 24, count);
+    memcpy(header + 40, pairing->fingerprint, 32);
+    memcpy(header + 72, checksum, 32);
+}
+
+ElementWriter *ElementWriter_create(PyTypeObject *type) {
+    // allocate the object
+    ElementWriter *writer = (ElementWriter *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!writer) {
+        PyErr_SetString(PyExc_TypeError, "could not create ElementWriter object");
+        return NULL;
+    }
+    // set the ready flag to 0
+    writer->ready = 0;
+    writer->lock = PyThread_allocate_lock();
+    if (!writer->lock) {
+        Py_DECREF(writer);
+        PyErr_SetString(PyExc_MemoryError, "could not allocate the writer lock");
+        return NULL;
+    }
+    return writer;
+}
+
+PyObject *ElementWriter_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    // required arguments are the pairing, the path and the group
+    static char *keywords[] = {"pairing", "path", "group", NULL};
+    PyObject *py_pairing;
+    PyObject *py_path;
+    enum Group group;
+    ModuleState *state = pypbc_state(type);
+    if (!state) {
+        return NULL;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O&i", keywords, state->PairingType, &py_pairing, PyUnicode_FSConverter, &py_path, &group)) {
+        return NULL;
+    }
+    // cast the arguments
+    Pairing *pairing = (Pairing *)py_pairing;
+    if (group != G1 && group != G2 && group != GT && group != Zr) {
+        Py_DECREF(py_path);
+        PyErr_SetString(PyExc_ValueError, "invalid group");
+        return NULL;
+    }
+    // create the object
+    ElementWriter *writer = ElementWriter_create(type);
+    if (!writer) {
+        Py_DECREF(py_path);
+        return NULL;
+    }
+    writer->pairing = pairing;
+    writer->group = group;
+    Py_INCREF(pairing);
+    element_t probe;
+    element_init(probe, Pairing_field(pairing, group));
+    writer->record_size = element_length_in_bytes(probe);
+    element_clear(probe);
+    writer->buffer = PyMem_Malloc(ELEMENTS_BUFFER_SIZE);
+    if (!writer->buffer) {
+        Py_DECREF(py_path);
+        Py_DECREF(writer);
+        return PyErr_NoMemory();
+    }
+    sha256_init(&writer->checksum);
+    // the header is written again by close, until then it records no elements
+    unsigned char header[ELEMENTS_HEADER_SIZE];
+    unsigned char zero[32] = {0};
+    ElementFile_header(header, pairing, group, writer->record_size, 0, zero);
+    writer->fp = fopen(PyBytes_AsString(py_path), "wb");
+    Py_DECREF(py_path);
+    if (writer->fp == NULL || fwrite(header, 1, sizeof(header), writer->fp) != sizeof(header)) {
+        PyErr_SetFromErrno(PyExc_IOError);
+        Py_DECREF(writer);
+        return NULL;
+    }
+    writer->ready = 1;
+    return (PyObject *)writer;
+}
+
+// write out the buffered records with the GIL released, the lock must be held
+static int ElementWriter_flush_locked(ElementWriter *writer) {
+    int failed;
+    Py_BEGIN_ALLOW_THREADS
+    sha256_update(&writer->checksum, writer->buffer, writer->used);
+    failed = fwrite(writer->buffer, 1, writer->used, writer->fp) != writer->used;
+    Py_END_ALLOW_THREADS
+    writer->used = 0;
+    if (failed) {
+        PyErr_SetFromErrno(PyExc_IOError);
+        return -1;
+    }
+    return 0;
+}
+
+// write out the records and the final header and close the file, the lock must be held
+static int ElementWriter_close_locked(ElementWriter *writer) {
+    if (!writer->fp) {
+        return 0;
+    }
+    int failed = ElementWriter_flush_locked(writer) < 0;
+    unsigned char checksum[32];
+    unsigned char header[ELEMENTS_HEADER_SIZE];
+    sha256_final(&writer->checksum, checksum);
+    ElementFile_header(header, writer->pairing, writer->group, writer->record_size, writer->count, checksum);
+    if (!failed && (fseek(writer->fp, 0, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), writer->fp) != sizeof(header))) {
+        PyErr_SetFromErrno(PyExc_IOError);
+        failed = 1;
+    }
+    if (fclose(writer->fp) != 0 && !failed) {
+        PyErr_SetFromErrno(PyExc_IOError);
+        failed = 1;
+    }
+    writer->fp = NULL;
+    return failed ? -1 : 0;
+}
+
+void ElementWriter_dealloc(ElementWriter *writer) {
+    // close the file if it's still open, errors can only be reported as unraisable
+    if (writer->ready && writer->fp && ElementWriter_close_locked(writer) < 0) {
+        PyErr_WriteUnraisable((PyObject *)writer);
+    }
+    if (writer->fp) {
+        fclose(writer->fp);
+    }
+    PyMem_Free(writer->buffer);
+    Py_XDECREF(writer->pairing);
+    if (writer->lock) {
+        PyThread_free_lock(writer->lock);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(writer);
+    type->tp_free((PyObject *)writer);
+    Py_DECREF(type);
+}
+
+// append one element, the lock must be held
+static int ElementWriter_write_locked(ElementWriter *writer, PyObject *py_element) {
+    if (!writer->fp) {
+        PyErr_SetString(PyExc_ValueError, "the writer is closed");
+        return -1;
+    }
+    // the element must be in the group of the file, under the same parameters
+    Element *element = Element_check(py_element) ? (Element *)py_element : NULL;
+    if (!element || Pairing_group(element->pairing, element->pbc_element->field) != (int)writer->group || memcmp(element->pairing->fingerprint, writer->pairing->fingerprint, 32) != 0) {
+        PyErr_SetString(PyExc_ValueError, "only Elements of the group of the file, under its parameters, can be written");
+        return -1;
+    }
+    if (writer->used + writer->record_size > ELEMENTS_BUFFER_SIZE && ElementWriter_flush_locked(writer) < 0) {
+        return -1;
+    }
+    element_to_bytes(writer->buffer + writer->used, element->pbc_element);
+    writer->used += writer->record_size;
+    writer->count++;
+    return 0;
+}
+
+PyObject *ElementWriter_write(PyObject *py_writer, PyObject *py_element) {
+    // cast the argument
+    ElementWriter *writer = (ElementWriter *)py_writer;
+    lock_acquire(writer->lock);
+    int status = ElementWriter_write_locked(writer, py_element);
+    PyThread_release_lock(writer->lock);
+    if (status < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *ElementWriter_write_many(PyObject *py_writer, PyObject *py_elements) {
+    // cast the argument
+    ElementWriter *writer = (ElementWriter *)py_writer;
+    PyObject *iterator = PyObject_GetIter(py_elements);
+    if (!iterator) {
+        return NULL;
+    }
+    // the lock is taken per element, since the iterator may run arbitrary code
+    PyObject *py_element;
+    while ((py_element = PyIter_Next(iterator))) {
+        lock_acquire(writer->lock);
+        int status = ElementWriter_write_locked(writer, py_element);
+        PyThread_release_lock(writer->lock);
+        Py_DECREF(py_element);
+        if (status < 0) {
+            break;
+        }
+    }
+    Py_DECREF(iterator);
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *ElementWriter_flush(PyObject *py_writer) {
+    // cast the argument
+    ElementWriter *writer = (ElementWriter *)py_writer;
+    lock_acquire(writer->lock);
+    int status = 0;
+    if (!writer->fp) {
+        PyErr_SetString(PyExc_ValueError, "the writer is closed");
+        status = -1;
+    } else if (ElementWriter_flush_locked(writer) < 0 || fflush(writer->fp) != 0) {
+        if (!PyErr_Occurred()) {
+            PyErr_SetFromErrno(PyExc_IOError);
+        }
+        status = -1;
+    }
+    PyThread_release_lock(writer->lock);
+    if (status < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *ElementWriter_close(PyObject *py_writer) {
+    // cast the argument
+    ElementWriter *writer = (ElementWriter *)py_writer;
+    lock_acquire(writer->lock);
+    int status = ElementWriter_close_locked(writer);
+    PyThread_release_lock(writer->lock);
+    if (status < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *ElementWriter_enter(PyObject *py_writer) {
+    return Py_NewRef(py_writer);
+}
+
+PyObject *ElementWriter_exit(PyObject *py_writer, PyObject *const *args, Py_ssize_t nargs) {
+    return ElementWriter_close(py_writer);
+}
+
+PyObject *ElementWriter_count(PyObject *py_writer) {
+    // cast the argument
+    ElementWriter *writer = (ElementWriter *)py_writer;
+    lock_acquire(writer->lock);
+    uint64_t count = writer->count;
+    PyThread_release_lock(writer->lock);
+    return PyLong_FromUnsignedLongLong(count);
+}
+
+PyMemberDef ElementWriter_members[] = {
+    {NULL},
+};
+
+PyMethodDef ElementWriter_methods[] = {
+    {"write", (PyCFunction)ElementWriter_write, METH_O, "Appends an Element to the file."},
+    {"write_many", (PyCFunction)ElementWriter_write_many, METH_O, "Appends the Elements of an iterable to the file."},
+    {"flush", (PyCFunction)ElementWriter_flush, METH_NOARGS, "Writes out the buffered Elements."},
+    {"close", (PyCFunction)ElementWriter_close, METH_NOARGS, "Writes out the buffered Elements and the header and closes the file."},
+    {"count", (PyCFunction)ElementWriter_count, METH_NOARGS, "Returns the number of Elements written so far."},
+    {"__enter__", (PyCFunction)ElementWriter_enter, METH_NOARGS, "Returns the writer."},
+    {"__exit__", (PyCFunction)(void (*)(void))ElementWriter_exit, METH_FASTCALL, "Closes the writer."},
+    {NULL},
+};
+
+PyType_Slot ElementWriter_slots[] = {
+    {Py_tp_dealloc, ElementWriter_dealloc},
+    {Py_tp_doc, (void *)ElementWriter__doc__},
+    {Py_tp_methods, ElementWriter_methods},
+    {Py_tp_members, ElementWriter_members},
+    {Py_tp_new, ElementWriter_new},
+    {0, NULL},
+};
+
+PyType_Spec ElementWriter_spec = {
+    "pypbc.ElementWriter",                                               /* name */
+    sizeof(ElementWriter),                                               /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    ElementWriter_slots,                                                 /* slots */
+};
+
+ElementReader *ElementReader_create(PyTypeObject *type) {
+    // allocate the object
+    ElementReader *reader = (ElementReader *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!reader) {
+        PyErr_SetString(PyExc_TypeError, "could not create ElementReader object");
+        return NULL;
+    }
+    // set the ready flag to 0
+    reader->ready = 0;
+    return reader;
+}
+
+PyObject *ElementReader_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    // required arguments are the pairing and the path, validation is optional
+    static char *keywords[] = {"pairing", "path", "validate", NULL};
+    PyObject *py_pairing;
+    PyObject *py_path;
+    int validate = 0;
+    ModuleState *state = pypbc_state(type);
+    if (!state) {
+        return NULL;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O&|p", keywords, state->PairingType, &py_pairing, PyUnicode_FSConverter, &py_path, &validate)) {
+        return NULL;
+    }
+    // cast the arguments
+    Pairing *pairing = (Pairing *)py_pairing;
+    // map the whole file
+    int fd = open(PyBytes_AsString(py_path), O_RDONLY);
+    Py_DECREF(py_path);
+    if (fd < 0) {
+        return PyErr_SetFromErrno(PyExc_IOError);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return PyErr_SetFromErrno(PyExc_IOError);
+    }
+    if (st.st_size < ELEMENTS_HEADER_SIZE) {
+        close(fd);
+        PyErr_SetString(PyExc_ValueError, "the file is too short to hold elements");
+        return NULL;
+    }
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return PyErr_SetFromErrno(PyExc_IOError);
+    }
+    // check the header against the pairing
+    unsigned char *header = mapping;
+    const char *problem = NULL;
+    int group = le32_load(header + 12);
+    int record_size = le32_load(header + 16);
+    uint64_t count = le64_load(header + 24);
+    if (memcmp(header, ELEMENTS_MAGIC, 8) != 0) {
+        problem = "the file is not an element file";
+    } else if (le32_load(header + 8) != ELEMENTS_VERSION) {
+        problem = "unsupported element file version";
+    } else if (memcmp(header + 40, pairing->fingerprint, 32) != 0) {
+        problem = "the file was written with different parameters";
+    } else if (group != G1 && group != G2 && group != GT && group != Zr) {
+        problem = "the file header is corrupted";
+    }
+    if (!problem) {
+        element_t probe;
+        element_init(probe, Pairing_field(pairing, group));
+        if (record_size != element_length_in_bytes(probe)) {
+            problem = "the file header is corrupted";
+        } else if (count > (uint64_t)(st.st_size - ELEMENTS_HEADER_SIZE) / record_size || count * record_size != (uint64_t)st.st_size - ELEMENTS_HEADER_SIZE) {
+            problem = "the file has the wrong size, it may not have been closed";
+        }
+        element_clear(probe);
+    }
+    if (problem) {
+        munmap(mapping, st.st_size);
+        PyErr_SetString(PyExc_ValueError, problem);
+        return NULL;
+    }
+    // the records are read in order most of the time
+    madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+    // create the object over the mapping
+    ElementReader *reader = ElementReader_create(type);
+    if (!reader) {
+        munmap(mapping, st.st_size);
+        return NULL;
+    }
+    reader->pairing = pairing;
+    reader->group = group;
+    reader->record_size = record_size;
+    reader->count = count;
+    reader->validate = validate;
+    reader->records = header + ELEMENTS_HEADER_SIZE;
+    reader->mapping = mapping;
+    reader->mapping_size = st.st_size;
+    // the records are exported as a read-only array of one row per element
+    reader->shape[0] = count;
+    reader->shape[1] = record_size;
+    reader->strides[0] = record_size;
+    reader->strides[1] = 1;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(reader->pairing);
+    reader->ready = 1;
+    return (PyObject *)reader;
+}
+
+void ElementReader_dealloc(ElementReader *reader) {
+    // unmap the file and decrement the reference count on the pairing if it's ready
+    if (reader->ready) {
+        munmap(reader->mapping, reader->mapping_size);
+        Py_DECREF(reader->pairing);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(reader);
+    type->tp_free((PyObject *)reader);
+    Py_DECREF(type);
+}
+
+// build a list of count ready elements of the field and fill outs with their PBC elements,
+// so that they can be computed without the GIL
+PyObject *Pairing_element_list(Pairing *pairing, field_ptr field, Py_ssize_t count, element_ptr *outs) {
+    PyObject *list = PyList_New(count);
+    if (!list) {
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        Element *element = Element_create(pairing);
+        if (!element) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        element_init(element->pbc_element, field);
+        element->pairing = pairing;
+        Py_INCREF(element->pairing);
+        element->ready = 1;
+        PyList_SET_ITEM(list, i, (PyObject *)element);
+        outs[i] = element->pbc_element;
+    }
+    return list;
+}
+
+// decode packed records of the field into a list, with the GIL released while decoding
+PyObject *Pairing_decode_records(Pairing *pairing, field_ptr field, unsigned char *records, int record_size, Py_ssize_t count, int validate) {
+    element_ptr *outs = PyMem_Malloc((count ? count : 1) * sizeof(element_ptr));
+    if (!outs) {
+        return PyErr_NoMemory();
+    }
+    // build the elements first, so that no object is created without the GIL
+    PyObject *list = Pairing_element_list(pairing, field, count, outs);
+    if (!list) {
+        PyMem_Free(outs);
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t i = 0; i < count; i++) {
+        element_from_bytes(outs[i], records + (size_t)i * record_size);
+    }
+    Py_END_ALLOW_THREADS
+    PyMem_Free(outs);
+    // check the encodings and the subgroup if asked to
+    for (Py_ssize_t i = 0; i < count && validate; i++) {
+        Element *element = (Element *)PyList_GET_ITEM(list, i);
+        if (Element_check_decoded(element, records + (size_t)i * record_size, record_size, element_to_bytes) < 0) {
+            Py_DECREF(list);
+            return NULL;
+        }
+    }
+    return list;
+}
+
+// decode the records from start on into a list
+PyObject *ElementReader_decode(ElementReader *reader, Py_ssize_t start, Py_ssize_t count) {
+    field_ptr field = Pairing_field(reader->pairing, reader->group);
+    unsigned char *records = reader->records + (size_t)start * reader->record_size;
+    return Pairing_decode_records(reader->pairing, field, records, reader->record_size, count, reader->validate);
+}
+
+Py_ssize_t ElementReader_len(PyObject *py_reader) {
+    return ((ElementReader *)py_reader)->count;
+}
+
+PyObject *ElementReader_item(PyObject *py_reader, Py_ssize_t index) {
+    // cast the argument
+    ElementReader *reader = (ElementReader *)py_reader;
+    // negative indices were already adjusted by the sequence protocol
+    if (index < 0 || index >= reader->count) {
+        PyErr_SetString(PyExc_IndexError, "element index out of range");
+        return NULL;
+    }
+    PyObject *list = ElementReader_decode(reader, index, 1);
+    if (!list) {
+        return NULL;
+    }
+    PyObject *element = Py_NewRef(PyList_GET_ITEM(list, 0));
+    Py_DECREF(list);
+    return element;
+}
+
+PyObject *ElementReader_read(PyObject *py_reader, PyObject *const *args, Py_ssize_t nargs) {
+    // the start and the number of records are optional
+    Py_ssize_t start = 0;
+    Py_ssize_t count = -1;
+    if (nargs > 2 || (nargs > 0 && args_ssize(args[0], &start) < 0) || (nargs > 1 && args_ssize(args[1], &count) < 0)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected an optional start and count");
+        return NULL;
+    }
+    // cast the argument
+    ElementReader *reader = (ElementReader *)py_reader;
+    if (start < 0 || start > reader->count) {
+        PyErr_SetString(PyExc_IndexError, "start index out of range");
+        return NULL;
+    }
+    if (count < 0 || count > reader->count - start) {
+        count = reader->count - start;
+    }
+    return ElementReader_decode(reader, start, count);
+}
+
+PyObject *ElementReader_chunks(PyObject *py_reader, PyObject *const *args, Py_ssize_t nargs) {
+    // the chunk size is optional
+    Py_ssize_t size = 1024;
+    if (nargs > 1 || (nargs > 0 && args_ssize(args[0], &size) < 0)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected an optional chunk size");
+        return NULL;
+    }
+    if (size < 1) {
+        PyErr_SetString(PyExc_ValueError, "the chunk size must be positive");
+        return NULL;
+    }
+    // cast the argument
+    ElementReader *reader = (ElementReader *)py_reader;
+    PyTypeObject *type = reader->pairing->state->ElementChunksType;
+    ElementChunks *chunks = (ElementChunks *)type->tp_alloc(type, 0);
+    if (!chunks) {
+        return NULL;
+    }
+    chunks->reader = (ElementReader *)Py_NewRef(py_reader);
+    chunks->position = 0;
+    chunks->size = size;
+    return (PyObject *)chunks;
+}
+
+// export the mapped records without copying them, as a (count, record_size) array of bytes
+int ElementReader_getbuffer(PyObject *py_reader, Py_buffer *view, int flags) {
+    // cast the argument
+    ElementReader *reader = (ElementReader *)py_reader;
+    if (flags & PyBUF_WRITABLE) {
+        view->obj = NULL;
+        PyErr_SetString(PyExc_BufferError, "the records of an element file are read-only");
+        return -1;
+    }
+    view->buf = reader->records;
+    view->obj = Py_NewRef(py_reader);
+    view->len = (Py_ssize_t)reader->count * reader->record_size;
+    view->readonly = 1;
+    view->itemsize = 1;
+    view->format = flags & PyBUF_FORMAT ? "B" : NULL;
+    // without a shape the consumer sees the records as one run of bytes
+    view->ndim = flags & PyBUF_ND ? 2 : 1;
+    view->shape = flags & PyBUF_ND ? reader->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? reader->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+PyObject *ElementReader_verify(PyObject *py_reader) {
+    // cast the argument
+    ElementReader *reader = (ElementReader *)py_reader;
+    // check the records against the checksum of the header
+    unsigned char digest[32];
+    Py_BEGIN_ALLOW_THREADS
+    sha256(reader->records, (size_t)reader->count * reader->record_size, digest);
+    Py_END_ALLOW_THREADS
+    return PyBool_FromLong(memcmp(digest, (unsigned char *)reader->mapping + 72, 32) == 0);
+}
+
+PyMemberDef ElementReader_members[] = {
+    {"group", T_INT, offsetof(ElementReader, group), READONLY, "The group of the Elements of the file."},
+    {NULL},
+};
+
+PyMethodDef ElementReader_methods[] = {
+    {"read", (PyCFunction)(void (*)(void))ElementReader_read, METH_FASTCALL, "Returns a list of count Elements from start on, or all the rest."},
+    {"chunks", (PyCFunction)(void (*)(void))ElementReader_chunks, METH_FASTCALL, "Returns an iterator over lists of at most size Elements."},
+    {"verify", (PyCFunction)ElementReader_verify, METH_NOARGS, "Returns whether the records match the checksum of the file."},
+    {NULL},
+};
+
+PyType_Slot ElementReader_slots[] = {
+    {Py_tp_dealloc, ElementReader_dealloc},
+    {Py_tp_doc, (void *)ElementReader__doc__},
+    {Py_tp_methods, ElementReader_methods},
+    {Py_tp_members, ElementReader_members},
+    {Py_tp_new, ElementReader_new},
+    {Py_sq_length, ElementReader_len},
+    {Py_sq_item, ElementReader_item},
+    {Py_bf_getbuffer, ElementReader_getbuffer},
+    {0, NULL},
+};
+
+PyType_Spec ElementReader_spec = {
+    "pypbc.ElementReader",                                               /* name */
+    sizeof(ElementReader),                                               /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    ElementReader_slots,                                                 /* slots */
+};
+
+void ElementChunks_dealloc(ElementChunks *chunks) {
+    Py_XDECREF(chunks->reader);
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(chunks);
+    type->tp_free((PyObject *)chunks);
+    Py_DECREF(type);
+}
+
+PyObject *ElementChunks_next(PyObject *py_chunks) {
+    // cast the argument
+    ElementChunks *chunks = (ElementChunks *)py_chunks;
+    ElementReader *reader = chunks->reader;
+    if (chunks->position >= reader->count) {
+        return NULL;
+    }
+    Py_ssize_t count = reader->count - chunks->position < chunks->size ? reader->count - chunks->position : chunks->size;
+    PyObject *list = ElementReader_decode(reader, chunks->position, count);
+    if (list) {
+        chunks->position += count;
+    }
+    return list;
+}
+
+PyType_Slot ElementChunks_slots[] = {
+    {Py_tp_dealloc, ElementChunks_dealloc},
+    {Py_tp_iter, PyObject_SelfIter},
+    {Py_tp_iternext, ElementChunks_next},
+    {0, NULL},
+};
+
+PyType_Spec ElementChunks_spec = {
+    "pypbc._ElementChunks",                                                            /* name */
+    sizeof(ElementChunks),                                                             /* basicsize */
+    0,                                                                                 /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    ElementChunks_slots,                                                               /* slots */
+};
+
+/*******************************************************************************
+*                                    Arrays                                    *
+*******************************************************************************/
+
+// NumPy and other array libraries exchange elements through the buffer protocol: exports are
+// memoryviews over packed storage with one row per element, imports read any C-contiguous
+// buffer in place, and the conversions run with the GIL released
+
+ArrayBuffer *ArrayBuffer_create(ModuleState *state, int ndim, Py_ssize_t rows, Py_ssize_t width, Py_ssize_t itemsize, char format) {
+    // the dimensions may come from the caller, so their product must not wrap around
+    if (rows < 0 || width < 0 || itemsize < 1 || (rows && width > (PY_SSIZE_T_MAX - 1) / itemsize / rows)) {
+        PyErr_SetString(PyExc_OverflowError, "the array is too large");
+        return NULL;
+    }
+    // allocate the object
+    PyTypeObject *type = state->ArrayBufferType;
+    ArrayBuffer *buffer = (ArrayBuffer *)type->tp_alloc(type, 0);
+    if (!buffer) {
+        return NULL;
+    }
+    // allocate the storage, at least one byte so that empty arrays have an address
+    buffer->data = PyMem_Calloc(rows * width * itemsize + 1, 1);
+    if (!buffer->data) {
+        Py_DECREF(buffer);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    buffer->ndim = ndim;
+    buffer->shape[0] = rows;
+    buffer->shape[1] = width;
+    buffer->strides[0] = ndim == 2 ? width * itemsize : itemsize;
+    buffer->strides[1] = itemsize;
+    buffer->itemsize = itemsize;
+    buffer->format[0] = format;
+    buffer->format[1] = '\0';
+    return buffer;
+}
+
+void ArrayBuffer_dealloc(ArrayBuffer *buffer) {
+    PyMem_Free(buffer->data);
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(buffer);
+    type->tp_free((PyObject *)buffer);
+    Py_DECREF(type);
+}
+
+int ArrayBuffer_getbuffer(PyObject *py_buffer, Py_buffer *view, int flags) {
+    // cast the argument
+    ArrayBuffer *buffer = (ArrayBuffer *)py_buffer;
+    // the rows are C-contiguous, so every request can be served
+    view->buf = buffer->data;
+    view->obj = Py_NewRef(py_buffer);
+    view->len = buffer->shape[0] * (buffer->ndim == 2 ? buffer->shape[1] : 1) * buffer->itemsize;
+    view->readonly = 0;
+    view->itemsize = buffer->itemsize;
+    view->format = flags & PyBUF_FORMAT ? buffer->format : NULL;
+    // without a shape the consumer sees the array as one run of items
+    view->ndim = flags & PyBUF_ND ? buffer->ndim : 1;
+    view->shape = flags & PyBUF_ND ? buffer->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? buffer->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+// the Elements of a sequence as a tuple, checking that they belong to the pairing and share
+// one field, which is NULL for an empty sequence
+PyObject *Pairing_array_elements(Pairing *pairing, PyObject *py_elements, field_ptr *field) {
+    PyObject *elements = PySequence_Tuple(py_elements);
+    if (!elements) {
+        return NULL;
+    }
+    *field = NULL;
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(elements); i++) {
+        PyObject *py_element = PyTuple_GET_ITEM(elements, i);
+        if (!PyObject_TypeCheck(py_element, pairing->state->ElementType) || ((Element *)py_element)->pairing != pairing) {
+            PyErr_SetString(PyExc_TypeError, "the elements must be Elements of this pairing");
+            Py_DECREF(elements);
+            return NULL;
+        }
+        field_ptr element_field = ((Element *)py_element)->pbc_element->field;
+        if (*field && element_field != *field) {
+            PyErr_SetString(PyExc_ValueError, "the elements must all be in the same group");
+            Py_DECREF(elements);
+            return NULL;
+        }
+        *field = element_field;
+    }
+    return elements;
+}
+
+// the PBC elements of a tuple of Elements
+element_ptr *Pairing_array_pointers(PyObject *elements) {
+    Py_ssize_t count = PyTuple_GET_SIZE(elements);
+    element_ptr *ins = PyMem_Malloc((count ? count : 1) * sizeof(element_ptr));
+    if (!ins) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        ins[i] = ((Element *)PyTuple_GET_ITEM(elements, i))->pbc_element;
+    }
+    return ins;
+}
+
+// a memoryview over the packed storage, which it keeps alive
+PyObject *ArrayBuffer_view(ArrayBuffer *buffer) {
+    PyObject *view = PyMemoryView_FromObject((PyObject *)buffer);
+    Py_DECREF(buffer);
+    return view;
+}
+
+PyObject *Pairing_to_array(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect a sequence of elements
+    if (nargs != 1) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected a sequence of Elements");
+        return NULL;
+    }
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    field_ptr field;
+    PyObject *elements = Pairing_array_elements(pairing, args[0], &field);
+    if (!elements) {
+        return NULL;
+    }
+    Py_ssize_t count = PyTuple_GET_SIZE(elements);
+    int width = 0;
+    if (count) {
+        width = element_length_in_bytes(((Element *)PyTuple_GET_ITEM(elements, 0))->pbc_element);
+    }
+    element_ptr *ins = Pairing_array_pointers(elements);
+    ArrayBuffer *buffer = ins ? ArrayBuffer_create(pairing->state, 2, count, width, 1, 'B') : NULL;
+    if (!buffer) {
+        PyMem_Free(ins);
+        Py_DECREF(elements);
+        return NULL;
+    }
+    // the elements are immutable, so they can be serialized without the GIL
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t i = 0; i < count; i++) {
+        element_to_bytes(buffer->data + (size_t)i * width, ins[i]);
+    }
+    Py_END_ALLOW_THREADS
+    PyMem_Free(ins);
+    Py_DECREF(elements);
+    return ArrayBuffer_view(buffer);
+}
+
+PyObject *Pairing_from_array(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required arguments are the group and the array, validation is optional
+    static const char *const keywords[] = {"type", "data", "validate", NULL};
+    PyObject *slots[3];
+    enum Group group;
+    int validate = 0;
+    if (args_bind(args, nargs, kwnames, keywords, 2, slots) < 0 || args_group(slots[0], &group) < 0 || (slots[2] && args_bool(slots[2], &validate) < 0)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected a group, an array and an optional validate flag");
+        return NULL;
+    }
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    field_ptr field = Pairing_field(pairing, group);
+    if (!field) {
+        PyErr_SetString(PyExc_ValueError, "invalid group");
+        return NULL;
+    }
+    element_t probe;
+    element_init(probe, field);
+    int width = element_length_in_bytes(probe);
+    element_clear(probe);
+    // the array is read in place, as bytes in rows of one element
+    Py_buffer data;
+    if (PyObject_GetBuffer(slots[1], &data, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) {
+        return NULL;
+    }
+    if (data.itemsize != 1 || (data.ndim == 2 && data.shape[1] != width) || data.ndim > 2 || data.len % width != 0) {
+        PyBuffer_Release(&data);
+        PyErr_SetString(PyExc_ValueError, "the array must hold bytes in rows of the length of an element");
+        return NULL;
+    }
+    PyObject *result = Pairing_decode_records(pairing, field, data.buf, width, data.len / width, validate);
+    PyBuffer_Release(&data);
+    return result;
+}
+
+// the number of 64-bit limbs of the order of Zr
+Py_ssize_t Pairing_zr_limbs(Pairing *pairing) {
+    return (mpz_sizeinbase(pairing->pbc_pairing->r, 2) + 63) / 64;
+}
+
+PyObject *Pairing_to_int_array(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required argument is the sequence of elements, the number of limbs is optional
+    static const char *const keywords[] = {"elements", "limbs", NULL};
+    PyObject *slots[2];
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    Py_ssize_t limbs = Pairing_zr_limbs(pairing);
+    if (args_bind(args, nargs, kwnames, keywords, 1, slots) < 0 || (slots[1] && args_ssize(slots[1], &limbs) < 0)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected a sequence of Elements and an optional number of limbs");
+        return NULL;
+    }
+    if (limbs < 1) {
+        PyErr_SetString(PyExc_ValueError, "the number of limbs must be positive");
+        return NULL;
+    }
+    field_ptr field;
+    PyObject *elements = Pairing_array_elements(pairing, slots[0], &field);
+    if (!elements) {
+        return NULL;
+    }
+    if (field && field != pairing->pbc_pairing->Zr) {
+        Py_DECREF(elements);
+        PyErr_SetString(PyExc_ValueError, "only Elements in Zr can be converted to integers");
+        return NULL;
+    }
+    Py_ssize_t count = PyTuple_GET_SIZE(elements);
+    element_ptr *ins = Pairing_array_pointers(elements);
+    ArrayBuffer *buffer = ins ? ArrayBuffer_create(pairing->state, limbs == 1 ? 1 : 2, count, limbs, sizeof(uint64_t), 'Q') : NULL;
+    if (!buffer) {
+        PyMem_Free(ins);
+        Py_DECREF(elements);
+        return NULL;
+    }
+    // every value is written as limbs in native byte order, the least significant first
+    int overflow = 0;
+    Py_BEGIN_ALLOW_THREADS
+    mpz_t value;
+    mpz_init(value);
+    for (Py_ssize_t i = 0; i < count && !overflow; i++) {
+        element_to_mpz(value, ins[i]);
+        if ((mpz_sizeinbase(value, 2) + 63) / 64 > (size_t)limbs) {
+            overflow = 1;
+        } else {
+            mpz_export(buffer->data + (size_t)i * limbs * sizeof(uint64_t), NULL, -1, sizeof(uint64_t), 0, 0, value);
+        }
+    }
+    mpz_clear(value);
+    Py_END_ALLOW_THREADS
+    PyMem_Free(ins);
+    Py_DECREF(elements);
+    if (overflow) {
+        Py_DECREF(buffer);
+        PyErr_SetString(PyExc_OverflowError, "an element does not fit in the given number of limbs");
+        return NULL;
+    }
+    return ArrayBuffer_view(buffer);
+}
+
+// widen an integer item to 64 bits, sign-extending it if it is signed; items may be unaligned
+uint64_t array_item(unsigned char *item, Py_ssize_t size, int is_signed) {
+    int8_t s8; int16_t s16; int32_t s32;
+    uint8_t u8; uint16_t u16; uint32_t u32; uint64_t u64;
+    switch (size) {
+    case 1: memcpy(&s8, item, 1); memcpy(&u8, item, 1); return is_signed ? (uint64_t)(int64_t)s8 : u8;
+    case 2: memcpy(&s16, item, 2); memcpy(&u16, item, 2); return is_signed ? (uint64_t)(int64_t)s16 : u16;
+    case 4: memcpy(&s32, item, 4); memcpy(&u32, item, 4); return is_signed ? (uint64_t)(int64_t)s32 : u32;
+    default: memcpy(&u64, item, 8); return u64;
+    }
+}
+
+PyObject *Pairing_from_int_array(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect an array of integers, or of rows of 64-bit limbs
+    if (nargs != 1) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected an array of integers");
+        return NULL;
+    }
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    Py_buffer data;
+    if (PyObject_GetBuffer(args[0], &data, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) {
+        return NULL;
+    }
+    // the integers must be in native byte order
+    const char *format = data.format ? data.format : "B";
+    if (*format == '@' || *format == '=' || *format == (PY_LITTLE_ENDIAN ? '<' : '>')) {
+        format++;
+    }
+    int is_signed = format[0] && strchr("bhilqn", format[0]);
+    int is_unsigned = format[0] && strchr("BHILQN", format[0]);
+    int valid = (is_signed || is_unsigned) && !format[1] && (data.itemsize == 1 || data.itemsize == 2 || data.itemsize == 4 || data.itemsize == 8);
+    // rows must be unsigned 64-bit limbs
+    if (data.ndim == 2) {
+        valid = valid && is_unsigned && data.itemsize == 8;
+    } else if (data.ndim > 2) {
+        valid = 0;
+    }
+    if (!valid) {
+        PyBuffer_Release(&data);
+        PyErr_SetString(PyExc_ValueError, "the array must hold integers in native byte order, or rows of unsigned 64-bit limbs");
+        return NULL;
+    }
+    Py_ssize_t limbs = data.ndim == 2 ? data.shape[1] : 1;
+    Py_ssize_t count = limbs ? data.len / data.itemsize / limbs : 0;
+    element_ptr *outs = PyMem_Malloc((count ? count : 1) * sizeof(element_ptr));
+    if (!outs) {
+        PyBuffer_Release(&data);
+        return PyErr_NoMemory();
+    }
+    // build the elements first, so that no object is created without the GIL
+    PyObject *list = Pairing_element_list(pairing, pairing->pbc_pairing->Zr, count, outs);
+    if (!list) {
+        PyMem_Free(outs);
+        PyBuffer_Release(&data);
+        return NULL;
+    }
+    // every value is reduced modulo the order
+    Py_BEGIN_ALLOW_THREADS
+    mpz_t value;
+    mpz_init(value);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        unsigned char *item = (unsigned char *)data.buf + (size_t)i * limbs * data.itemsize;
+        if (data.ndim == 2) {
+            mpz_import(value, limbs, -1, sizeof(uint64_t), 0, 0, item);
+        } else {
+            uint64_t magnitude = array_item(item, data.itemsize, is_signed);
+            int negative = 0;
+            if (is_signed && (int64_t)magnitude < 0) {
+                negative = 1;
+                magnitude = -magnitude;
+            }
+            mpz_import(value, 1, -1, sizeof(uint64_t), 0, 0, &magnitude);
+            if (negative) {
+                mpz_neg(value, value);
+            }
+        }
+        mpz_mod(value, value, pairing->pbc_pairing->r);
+        element_set_mpz(outs[i], value);
+    }
+    mpz_clear(value);
+    Py_END_ALLOW_THREADS
+    PyMem_Free(outs);
+    PyBuffer_Release(&data);
+    return list;
+}
+
+PyType_Slot ArrayBuffer_slots[] = {
+    {Py_tp_dealloc, ArrayBuffer_dealloc},
+    {Py_bf_getbuffer, ArrayBuffer_getbuffer},
+    {0, NULL},
+};
+
+PyType_Spec ArrayBuffer_spec = {
+    "pypbc._ArrayBuffer",                                                              /* name */
+    sizeof(ArrayBuffer),                                                               /* basicsize */
+    0,                                                                                 /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    ArrayBuffer_slots,                                                                 /* slots */
+};
+
+/*******************************************************************************
+*                                Hash To Group                                 *
+*******************************************************************************/
+
+PyDoc_STRVAR(HashToGroup__doc__,
+    "A streaming hash of a message to an Element.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "HashToGroup(pairing: Pairing, group: int, dst: bytes, hash: str = \"sha256\") -> HashToGroup\n"
+    "\n"
+    "The message is fed in pieces with update(), then finalize() expands it with\n"
+    "expand_message_xmd of RFC 9380 under the domain separation tag dst, and maps\n"
+    "the uniform bytes to the group. Large pieces are hashed with the GIL released.");
+
+// pieces shorter than this are hashed without releasing the GIL, as in hashlib
+#define HASH_GIL_MINSIZE 2048
+
+// the extra bytes hashed for every field element, so that reducing them modulo the
+// field order leaves a negligible bias
+#define HASH_SECURITY_BYTES 16
+
+HashToGroup *HashToGroup_create(PyTypeObject *type) {
+    // allocate the object
+    HashToGroup *hasher = (HashToGroup *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!hasher) {
+        PyErr_SetString(PyExc_TypeError, "could not create HashToGroup object");
+        return NULL;
+    }
+    // set the ready flag to 0
+    hasher->ready = 0;
+    hasher->lock = PyThread_allocate_lock();
+    if (!hasher->lock) {
+        Py_DECREF(hasher);
+        PyErr_SetString(PyExc_MemoryError, "could not allocate the hasher lock");
+        return NULL;
+    }
+    return hasher;
+}
+
+PyObject *HashToGroup_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    // required arguments are the pairing, the group and the tag, the hash is optional
+    static char *keywords[] = {"pairing", "group", "dst", "hash", NULL};
+    PyObject *py_pairing;
+    enum Group group;
+    Py_buffer dst;
+    const char *hash_name = "sha256";
+    ModuleState *state = pypbc_state(type);
+    if (!state) {
+        return NULL;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!iy*|s", keywords, state->PairingType, &py_pairing, &group, &dst, &hash_name)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, group, domain separation tag and an optional hash name");
+        return NULL;
+    }
+    // cast the arguments
+    Pairing *pairing = (Pairing *)py_pairing;
+    int digest_size;
+    if (strcmp(hash_name, "sha256") == 0) {
+        digest_size = 32;
+    } else if (strcmp(hash_name, "sha512") == 0) {
+        digest_size = 64;
+    } else {
+        PyBuffer_Release(&dst);
+        PyErr_SetString(PyExc_ValueError, "the hash must be \"sha256\" or \"sha512\"");
+        return NULL;
+    }
+    if (group != G1 && group != G2 && group != GT && group != Zr) {
+        PyBuffer_Release(&dst);
+        PyErr_SetString(PyExc_ValueError, "invalid group");
+        return NULL;
+    }
+    if (dst.len == 0) {
+        PyBuffer_Release(&dst);
+        PyErr_SetString(PyExc_ValueError, "the domain separation tag must not be empty");
+        return NULL;
+    }
+    // create the object
+    HashToGroup *hasher = HashToGroup_create(type);
+    if (!hasher) {
+        PyBuffer_Release(&dst);
+        return NULL;
+    }
+    hasher->pairing = pairing;
+    hasher->group = group;
+    // tags longer than 255 bytes are replaced by their hash, as RFC 9380 prescribes
+    Hash ctx;
+    hash_init(&ctx, digest_size);
+    if (dst.len > 255) {
+        hash_update(&ctx, "H2C-OVERSIZE-DST-", 17);
+        hash_update(&ctx, dst.buf, dst.len);
+        hash_final(&ctx, hasher->dst);
+        hasher->dst_size = digest_size;
+    } else {
+        memcpy(hasher->dst, dst.buf, dst.len);
+        hasher->dst_size = dst.len;
+    }
+    PyBuffer_Release(&dst);
+    // the message is preceded by a zero block
+    unsigned char z_pad[128] = {0};
+    hash_init(&hasher->hash, digest_size);
+    hash_update(&hasher->hash, z_pad, hash_block_size(&hasher->hash));
+    // find the prime field under the group: the field itself for Zr, the field of the
+    // x-coordinate for G1 and G2, and the field of the coordinates for GT; PBC truncates
+    // the input of from_hash to the size of that field, so the uniform bytes are reduced
+    // modulo its order first, other fields (e.g. G2 over an extension) get the bytes as-is
+    element_t probe;
+    element_init(probe, Pairing_field(pairing, group));
+    element_ptr leaf = probe;
+    if (group != GT && element_item_count(probe) == 2) {
+        leaf = element_item(probe, 0);
+    }
+    if (element_item_count(leaf) == 0) {
+        hasher->base = leaf->field;
+        hasher->items = 1;
+    } else if (element_item_count(leaf) == 2 && element_item_count(element_item(leaf, 0)) == 0) {
+        hasher->base = element_item(leaf, 0)->field;
+        hasher->items = 2;
+    } else {
+        hasher->base = NULL;
+        hasher->items = 0;
+    }
+    if (hasher->items) {
+        hasher->item_size = (mpz_sizeinbase(hasher->base->order, 2) + 7) / 8;
+        hasher->uniform_size = hasher->items * (hasher->item_size + HASH_SECURITY_BYTES);
+    } else {
+        hasher->item_size = 0;
+        hasher->uniform_size = element_length_in_bytes(probe) + HASH_SECURITY_BYTES;
+    }
+    element_clear(probe);
+    if (hasher->uniform_size > 255 * digest_size) {
+        Py_DECREF(hasher);
+        PyErr_SetString(PyExc_ValueError, "the group is too large for expand_message_xmd with this hash");
+        return NULL;
+    }
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(hasher->pairing);
+    hasher->ready = 1;
+    return (PyObject *)hasher;
+}
+
+void HashToGroup_dealloc(HashToGroup *hasher) {
+    // decrement the reference count on the pairing if it's ready
+    if (hasher->ready) {
+        Py_DECREF(hasher->pairing);
+    }
+    if (hasher->lock) {
+        PyThread_free_lock(hasher->lock);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(hasher);
+    type->tp_free((PyObject *)hasher);
+    Py_DECREF(type);
+}
+
+PyObject *HashToGroup_update(PyObject *py_hasher, PyObject *py_data) {
+    // cast the argument
+    HashToGroup *hasher = (HashToGroup *)py_hasher;
+    // borrow the bytes of the buffer without copying them
+    Py_buffer view;
+    if (PyObject_GetBuffer(py_data, &view, PyBUF_SIMPLE) < 0) {
+        PyErr_SetString(PyExc_TypeError, "expected a bytes-like object");
+        return NULL;
+    }
+    if (view.len >= HASH_GIL_MINSIZE) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(hasher->lock, WAIT_LOCK);
+        hash_update(&hasher->hash, view.buf, view.len);
+        PyThread_release_lock(hasher->lock);
+        Py_END_ALLOW_THREADS
+    } else {
+        lock_acquire(hasher->lock);
+        hash_update(&hasher->hash, view.buf, view.len);
+        PyThread_release_lock(hasher->lock);
+    }
+    PyBuffer_Release(&view);
+    Py_RETURN_NONE;
+}
+
+PyObject *HashToGroup_copy(PyObject *py_hasher) {
+    // cast the argument
+    HashToGroup *hasher = (HashToGroup *)py_hasher;
+    // create the object with the same settings
+    HashToGroup *copy = HashToGroup_create(Py_TYPE(hasher));
+    if (!copy) {
+        return NULL;
+    }
+    copy->pairing = hasher->pairing;
+    copy->group = hasher->group;
+    memcpy(copy->dst, hasher->dst, hasher->dst_size);
+    copy->dst_size = hasher->dst_size;
+    copy->base = hasher->base;
+    copy->items = hasher->items;
+    copy->item_size = hasher->item_size;
+    copy->uniform_size = hasher->uniform_size;
+    // copy the state of the hash
+    lock_acquire(hasher->lock);
+    copy->hash = hasher->hash;
+    PyThread_release_lock(hasher->lock);
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(copy->pairing);
+    copy->ready = 1;
+    return (PyObject *)copy;
+}
+
+// map a finished hash to an element of the group of the hasher, out must be initialized
+void HashToGroup_map(HashToGroup *hasher, Hash *ctx, element_ptr out) {
+    unsigned char uniform[255 * 64];
+    expand_message_xmd(ctx, hasher->dst, hasher->dst_size, uniform, hasher->uniform_size);
+    // reduce every chunk modulo the order of the base field, in place
+    int size = hasher->uniform_size;
+    if (hasher->items) {
+        mpz_t value;
+        mpz_init(value);
+        int chunk = hasher->item_size + HASH_SECURITY_BYTES;
+        for (int i = 0; i < hasher->items; i++) {
+            mpz_import(value, chunk, 1, 1, 1, 0, uniform + i * chunk);
+            mpz_mod(value, value, hasher->base->order);
+            // write the residue big-endian over the start of the chunk, which was read already
+            unsigned char *dst = uniform + i * hasher->item_size;
+            size_t count = mpz_sgn(value) ? (mpz_sizeinbase(value, 2) + 7) / 8 : 0;
+            memset(dst, 0, hasher->item_size - count);
+            mpz_export(dst + hasher->item_size - count, NULL, 1, 1, 1, 0, value);
+        }
+        mpz_clear(value);
+        size = hasher->items * hasher->item_size;
+    }
+    element_from_hash(out, uniform, size);
+}
+
+PyObject *HashToGroup_finalize(PyObject *py_hasher) {
+    // cast the argument
+    HashToGroup *hasher = (HashToGroup *)py_hasher;
+    // expand a snapshot of the hash, so the hasher can still be updated afterwards
+    lock_acquire(hasher->lock);
+    Hash ctx = hasher->hash;
+    PyThread_release_lock(hasher->lock);
+    // build the result element and map the hash to the group
+    Element *element = Element_create(hasher->pairing);
+    element_init(element->pbc_element, Pairing_field(hasher->pairing, hasher->group));
+    element->pairing = hasher->pairing;
+    HashToGroup_map(hasher, &ctx, element->pbc_element);
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(element->pairing);
+    element->ready = 1;
+    return (PyObject *)element;
+}
+
+PyMemberDef HashToGroup_members[] = {
+    {NULL},
+};
+
+PyMethodDef HashToGroup_methods[] = {
+    {"update", (PyCFunction)HashToGroup_update, METH_O, "Feeds the bytes of a buffer into the hash."},
+    {"copy", (PyCFunction)HashToGroup_copy, METH_NOARGS, "Returns a copy of the hasher."},
+    {"finalize", (PyCFunction)HashToGroup_finalize, METH_NOARGS, "Maps the message hashed so far to an Element."},
+    {NULL},
+};
+
+PyType_Slot HashToGroup_slots[] = {
+    {Py_tp_dealloc, HashToGroup_dealloc},
+    {Py_tp_doc, (void *)HashToGroup__doc__},
+    {Py_tp_methods, HashToGroup_methods},
+    {Py_tp_members, HashToGroup_members},
+    {Py_tp_new, HashToGroup_new},
+    {0, NULL},
+};
+
+PyType_Spec HashToGroup_spec = {
+    "pypbc.HashToGroup",                                                 /* name */
+    sizeof(HashToGroup),                                                 /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    HashToGroup_slots,                                                   /* slots */
+};
+
+/*******************************************************************************
+*                                 Expressions                                  *
+*******************************************************************************/
+
+PyDoc_STRVAR(Expr__doc__,
+    "A lazily evaluated product of powers of Elements and pairings.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "Expr(element: Element) -> Expr\n"
+    "\n"
+    "Expressions are built with *, / and ** from Element.lazy() and Pairing.apply_lazy(),\n"
+    "and mixed with Elements of the same group. Nothing is computed until evaluate(),\n"
+    "which raises the powers with one multi-exponentiation and the pairings with one\n"
+    "multi-pairing.");
+
+Expr *Expr_create(ModuleState *state, Pairing *pairing, field_ptr field, Py_ssize_t count) {
+    // allocate the object
+    Expr *expr = (Expr *)state->ExprType->tp_alloc(state->ExprType, 0);
+    // check if the object was allocated
+    if (!expr) {
+        PyErr_SetString(PyExc_TypeError, "could not create Expr object");
+        return NULL;
+    }
+    // set the ready flag to 0, the terms are filled in by the caller
+    expr->ready = 0;
+    expr->count = 0;
+    expr->terms = PyMem_Malloc((count ? count : 1) * sizeof(ExprTerm));
+    if (!expr->terms) {
+        Py_DECREF(expr);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    expr->pairing = pairing;
+    expr->field = field;
+    Py_INCREF(pairing);
+    return expr;
+}
+
+// append a term to an expression whose terms were allocated by Expr_create
+void Expr_push(Expr *expr, PyObject *lft, PyObject *rgt, mpz_t exp) {
+    ExprTerm *term = &expr->terms[expr->count++];
+    term->lft = lft;
+    term->rgt = rgt;
+    Py_INCREF(lft);
+    Py_XINCREF(rgt);
+    mpz_init_set(term->exp, exp);
+}
+
+// an expression made of a single element, which must be in G1, G2 or GT
+Expr *Expr_from_element(Element *element) {
+    if (element->pbc_element->field == element->pairing->pbc_pairing->Zr) {
+        PyErr_SetString(PyExc_ValueError, "only Elements in G1, G2 or GT can be lazy");
+        return NULL;
+    }
+    Expr *expr = Expr_create(element->pairing->state, element->pairing, element->pbc_element->field, 1);
+    if (!expr) {
+        return NULL;
+    }
+    mpz_t one;
+    mpz_init_set_ui(one, 1);
+    Expr_push(expr, (PyObject *)element, NULL, one);
+    mpz_clear(one);
+    expr->ready = 1;
+    return expr;
+}
+
+PyObject *Expr_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    // we expect an element
+    PyObject *py_element;
+    ModuleState *state = pypbc_state(type);
+    if (!state) {
+        return NULL;
+    }
+    if (!PyArg_ParseTuple(args, "O!", state->ElementType, &py_element)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected an Element");
+        return NULL;
+    }
+    return (PyObject *)Expr_from_element((Element *)py_element);
+}
+
+// calls to the Expr type itself skip tp_new and its argument tuple
+PyObject *Expr_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames) {
+    // we expect an element
+    ModuleState *state = pypbc_state((PyTypeObject *)type);
+    if (!state) {
+        return NULL;
+    }
+    if ((kwnames && PyTuple_GET_SIZE(kwnames)) || PyVectorcall_NARGS(nargsf) != 1 || !PyObject_TypeCheck(args[0], state->ElementType)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected an Element");
+        return NULL;
+    }
+    return (PyObject *)Expr_from_element((Element *)args[0]);
+}
+
+void Expr_dealloc(Expr *expr) {
+    // release the terms
+    for (Py_ssize_t i = 0; i < expr->count; i++) {
+        Py_DECREF(expr->terms[i].lft);
+        Py_XDECREF(expr->terms[i].rgt);
+        mpz_clear(expr->terms[i].exp);
+    }
+    PyMem_Free(expr->terms);
+    Py_XDECREF(expr->pairing);
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(expr);
+    type->tp_free((PyObject *)expr);
+    Py_DECREF(type);
+}
+
+PyObject *Element_lazy(PyObject *py_element) {
+    return (PyObject *)Expr_from_element((Element *)py_element);
+}
+
+PyObject *Pairing_apply_lazy(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect two elements
+    ModuleState *state = ((Pairing *)py_pairing)->state;
+    if (nargs != 2 || !PyObject_TypeCheck(args[0], state->ElementType) || !PyObject_TypeCheck(args[1], state->ElementType)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected two Elements");
+        return NULL;
+    }
+    PyObject *py_lft = args[0];
+    PyObject *py_rgt = args[1];
+    // cast the arguments
+    Pairing *pairing = (Pairing *)py_pairing;
+    Element *ele_lft = (Element *)py_lft;
+    Element *ele_rgt = (Element *)py_rgt;
+    // check the groups of the elements, and put the one in G1 first
+    if (ele_lft->pbc_element->field == pairing->pbc_pairing->G2 && ele_rgt->pbc_element->field == pairing->pbc_pairing->G1) {
+        PyObject *swap = py_lft;
+        py_lft = py_rgt;
+        py_rgt = swap;
+    } else if (ele_lft->pbc_element->field != pairing->pbc_pairing->G1 || ele_rgt->pbc_element->field != pairing->pbc_pairing->G2) {
+        PyErr_SetString(PyExc_ValueError, "only Elements in G1 and G2 can be paired");
+        return NULL;
+    }
+    Expr *expr = Expr_create(state, pairing, pairing->pbc_pairing->GT, 1);
+    if (!expr) {
+        return NULL;
+    }
+    mpz_t one;
+    mpz_init_set_ui(one, 1);
+    Expr_push(expr, py_lft, py_rgt, one);
+    mpz_clear(one);
+    expr->ready = 1;
+    return (PyObject *)expr;
+}
+
+// convert an operand of an expression, elements of G1, G2 and GT become expressions of their
+// own; returns NULL without an exception for operands of other types, e.g. Elements of Zr
+static Expr *Expr_operand(PyObject *obj) {
+    if (Expr_check(obj)) {
+        Py_INCREF(obj);
+        return (Expr *)obj;
+    }
+    if (Element_check(obj) && ((Element *)obj)->pbc_element->field != ((Element *)obj)->pairing->pbc_pairing->Zr) {
+        return Expr_from_element((Element *)obj);
+    }
+    return NULL;
+}
+
+// the product of two expressions, the terms of the right one are raised to the sign
+static PyObject *Expr_combine(PyObject *py_lft, PyObject *py_rgt, int sign) {
+    Expr *lft = Expr_operand(py_lft);
+    if (!lft) {
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+    Expr *rgt = Expr_operand(py_rgt);
+    if (!rgt) {
+        Py_DECREF(lft);
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+    Expr *expr = NULL;
+    if (lft->field != rgt->field) {
+        PyErr_SetString(PyExc_ValueError, "only Expressions in the same group can be multiplied or divided");
+    } else if ((expr = Expr_create(lft->pairing->state, lft->pairing, lft->field, lft->count + rgt->count))) {
+        for (Py_ssize_t i = 0; i < lft->count; i++) {
+            Expr_push(expr, lft->terms[i].lft, lft->terms[i].rgt, lft->terms[i].exp);
+        }
+        for (Py_ssize_t i = 0; i < rgt->count; i++) {
+            Expr_push(expr, rgt->terms[i].lft, rgt->terms[i].rgt, rgt->terms[i].exp);
+            if (sign < 0) {
+                mpz_neg(expr->terms[expr->count - 1].exp, expr->terms[expr->count - 1].exp);
+            }
+        }
+        expr->ready = 1;
+    }
+    Py_DECREF(lft);
+    Py_DECREF(rgt);
+    return (PyObject *)expr;
+}
+
+PyObject *Expr_mul(PyObject *py_lft, PyObject *py_rgt) {
+    return Expr_combine(py_lft, py_rgt, 1);
+}
+
+PyObject *Expr_div(PyObject *py_lft, PyObject *py_rgt) {
+    return Expr_combine(py_lft, py_rgt, -1);
+}
+
+// raise every term of an expression to the same integer power
+static PyObject *Expr_scale(Expr *base, mpz_t mpz_exp) {
+    Expr *expr = Expr_create(base->pairing->state, base->pairing, base->field, base->count);
+    if (!expr) {
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < base->count; i++) {
+        Expr_push(expr, base->terms[i].lft, base->terms[i].rgt, base->terms[i].exp);
+        mpz_mul(expr->terms[i].exp, expr->terms[i].exp, mpz_exp);
+    }
+    expr->ready = 1;
+    return (PyObject *)expr;
+}
+
+PyObject *Expr_pow(PyObject *py_lft, PyObject *py_rgt, PyObject *py_mod) {
+    if (!Expr_check(py_lft)) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+    Expr *base = (Expr *)py_lft;
+    // the exponent is an integer, an Element of Zr or an Exponent
+    mpz_t mpz_exp;
+    mpz_init(mpz_exp);
+    if (Pairing_exponent_to_mpz(base->pairing, mpz_exp, py_rgt) < 0) {
+        mpz_clear(mpz_exp);
+        return NULL;
+    }
+    PyObject *result = Expr_scale(base, mpz_exp);
+    mpz_clear(mpz_exp);
+    return result;
+}
+
+PyObject *Expr_invert(PyObject *py_arg) {
+    mpz_t mpz_exp;
+    mpz_init_set_si(mpz_exp, -1);
+    PyObject *result = Expr_scale((Expr *)py_arg, mpz_exp);
+    mpz_clear(mpz_exp);
+    return result;
+}
+
+PyObject *Expr_terms(PyObject *py_expr) {
+    return PyLong_FromSsize_t(((Expr *)py_expr)->count);
+}
+
+// the product of the bases raised to the exponents, which are positive, with one chain of
+// squarings shared by all bases (Straus' method), each base gets a table of 2^window powers
+void Expr_multi_pow(element_ptr out, element_ptr *bases, mpz_t *exps, Py_ssize_t count, int window) {
+    const int size = 1 << window;
+    element_t *table = (size_t)count <= PY_SSIZE_T_MAX / size / sizeof(element_t) ? PyMem_RawMalloc(count * size * sizeof(element_t)) : NULL;
+    if (!table) {
+        // without memory for the tables, the powers are taken one by one
+        element_t power;
+        element_init_same_as(power, out);
+        element_set1(out);
+        for (Py_ssize_t i = 0; i < count; i++) {
+            element_pow_mpz(power, bases[i], exps[i]);
+            element_mul(out, out, power);
+        }
+        element_clear(power);
+        return;
+    }
+    size_t bits = 0;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        // the table of a base holds its powers 0 to 2^w - 1
+        element_t *powers = table + i * size;
+        element_init_same_as(powers[0], out);
+        element_set1(powers[0]);
+        element_init_same_as(powers[1], out);
+        element_set(powers[1], bases[i]);
+        for (int d = 2; d < size; d++) {
+            element_init_same_as(powers[d], out);
+            element_mul(powers[d], powers[d - 1], bases[i]);
+        }
+        size_t length = mpz_sizeinbase(exps[i], 2);
+        if (length > bits) {
+            bits = length;
+        }
+    }
+    element_set1(out);
+    for (size_t step = (bits + window - 1) / window; step-- > 0;) {
+        for (int k = 0; k < window; k++) {
+            element_square(out, out);
+        }
+        for (Py_ssize_t i = 0; i < count; i++) {
+            int digit = 0;
+            for (int k = window - 1; k >= 0; k--) {
+                digit = digit << 1 | mpz_tstbit(exps[i], step * window + k);
+            }
+            if (digit) {
+                element_mul(out, out, table[i * size + digit]);
+            }
+        }
+    }
+    for (Py_ssize_t i = 0; i < count * size; i++) {
+        element_clear(table[i]);
+    }
+    PyMem_RawFree(table);
+}
+
+// evaluate the terms without the GIL, the powers of elements with one multi-exponentiation
+// and the pairings with one multi-pairing, whose G1 arguments absorb their exponents
+static void Expr_compute(Expr *expr, element_ptr out, element_ptr *bases, mpz_t *exps, element_t *in1, element_t *in2, int unitary) {
+    Pairing *pairing = expr->pairing;
+    Py_ssize_t powers = 0;
+    Py_ssize_t pairs = 0;
+    element_t product;
+    element_init_same_as(product, out);
+    element_set1(out);
+    for (Py_ssize_t i = 0; i < expr->count; i++) {
+        ExprTerm *term = &expr->terms[i];
+        mpz_mod(exps[i], term->exp, pairing->pbc_pairing->r);
+        if (mpz_sgn(exps[i]) == 0) {
+            continue;
+        }
+        Element *ele_lft = (Element *)term->lft;
+        if (term->rgt) {
+            element_init_same_as(in1[pairs], ele_lft->pbc_element);
+            element_pow_mpz(in1[pairs], ele_lft->pbc_element, exps[i]);
+            // the G2 argument is only read, so it is shared with its element
+            in2[pairs][0] = *((Element *)term->rgt)->pbc_element;
+            pairs++;
+        } else if (mpz_cmp_ui(exps[i], 1) == 0) {
+            element_mul(out, out, ele_lft->pbc_element);
+        } else {
+            bases[powers] = ele_lft->pbc_element;
+            mpz_swap(exps[powers], exps[i]);
+            powers++;
+        }
+    }
+    Tuning tuning;
+    tuning_load(&tuning, &pairing->tuning);
+    if (powers == 1 && unitary) {
+        gt_unitary_pow_mpz(product, bases[0], exps[0], tuning.gt_window);
+        element_mul(out, out, product);
+    } else if (powers == 1) {
+        element_pow_mpz(product, bases[0], exps[0]);
+        element_mul(out, out, product);
+    } else if (powers > 1) {
+        Expr_multi_pow(product, bases, exps, powers, tuning.multi_pow_window);
+        element_mul(out, out, product);
+    }
+    if (pairs) {
+        prod_pairing_nonzero(product, in1, in2, pairs, pairing->pbc_pairing);
+        element_mul(out, out, product);
+    }
+    for (Py_ssize_t i = 0; i < pairs; i++) {
+        element_clear(in1[i]);
+    }
+    element_clear(product);
+}
+
+PyObject *Expr_evaluate(PyObject *py_expr) {
+    // cast the argument
+    Expr *expr = (Expr *)py_expr;
+    Pairing *pairing = expr->pairing;
+    Py_ssize_t count = expr->count;
+    // the result is unitary or in a prime subgroup only if all the terms are
+    int unitary = 1;
+    int subgroup = -1;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        Element *ele_lft = (Element *)expr->terms[i].lft;
+        Element *ele_rgt = (Element *)expr->terms[i].rgt;
+        int term_unitary = ele_rgt ? pairing->gt_unitary : ele_lft->unitary;
+        int term_subgroup = !ele_rgt || ele_lft->subgroup == ele_rgt->subgroup ? ele_lft->subgroup : 0;
+        unitary = unitary && term_unitary;
+        subgroup = subgroup < 0 || subgroup == term_subgroup ? term_subgroup : 0;
+    }
+    // the scratch space of the evaluation
+    element_ptr *bases = PyMem_Malloc((count ? count : 1) * sizeof(element_ptr));
+    mpz_t *exps = PyMem_Malloc((count ? count : 1) * sizeof(mpz_t));
+    element_t *in1 = PyMem_Malloc((count ? count : 1) * sizeof(element_t));
+    element_t *in2 = PyMem_Malloc((count ? count : 1) * sizeof(element_t));
+    if (!bases || !exps || !in1 || !in2) {
+        PyMem_Free(bases);
+        PyMem_Free(exps);
+        PyMem_Free(in1);
+        PyMem_Free(in2);
+        return PyErr_NoMemory();
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        mpz_init(exps[i]);
+    }
+    // build the result element and initialize it with the group of the expression
+    Element *ele_res = Element_create(pairing);
+    if (ele_res) {
+        element_init(ele_res->pbc_element, expr->field);
+        ele_res->pairing = pairing;
+        Py_BEGIN_ALLOW_THREADS
+        Expr_compute(expr, ele_res->pbc_element, bases, exps, in1, in2, unitary);
+        Py_END_ALLOW_THREADS
+        ele_res->unitary = unitary;
+        ele_res->subgroup = subgroup < 0 ? 0 : subgroup;
+        // increment the reference count on the pairing and set the ready flag
+        Py_INCREF(ele_res->pairing);
+        ele_res->ready = 1;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        mpz_clear(exps[i]);
+    }
+    PyMem_Free(bases);
+    PyMem_Free(exps);
+    PyMem_Free(in1);
+    PyMem_Free(in2);
+    return (PyObject *)ele_res;
+}
+
+PyMemberDef Expr_members[] = {
+    {NULL},
+};
+
+PyMethodDef Expr_methods[] = {
+    {"evaluate", (PyCFunction)Expr_evaluate, METH_NOARGS, "Computes the Element of the expression."},
+    {"terms", (PyCFunction)Expr_terms, METH_NOARGS, "Returns the number of powers and pairings in the expression."},
+    {NULL},
+};
+
+PyType_Slot Expr_slots[] = {
+    {Py_tp_dealloc, Expr_dealloc},
+    {Py_tp_doc, (void *)Expr__doc__},
+    {Py_tp_methods, Expr_methods},
+    {Py_tp_members, Expr_members},
+    {Py_tp_new, Expr_new},
+    {Py_nb_multiply, Expr_mul},
+    {Py_nb_power, Expr_pow},
+    {Py_nb_invert, Expr_invert},
+    {Py_nb_true_divide, Expr_div},
+    {0, NULL},
+};
+
+PyType_Spec Expr_spec = {
+    "pypbc.Expr",                                                        /* name */
+    sizeof(Expr),                                                        /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    Expr_slots,                                                          /* slots */
+};
+
+/*******************************************************************************
+*                                   Matrices                                   *
+*******************************************************************************/
+
+PyDoc_STRVAR(ZrMatrix__doc__,
+    "Represents a matrix over Zr, e.g. the share-generating matrix of a linear secret sharing scheme.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "ZrMatrix(pairing: Pairing, rows: Sequence[Sequence[Element | int]]) -> ZrMatrix\n"
+    "\n"
+    "The entries are packed as canonical limbs, products with vectors accumulate\n"
+    "unreduced and reduce once per row, and all the work is done with the GIL released.");
+
+ZrMatrix *ZrMatrix_create(PyTypeObject *type) {
+    // allocate the object
+    ZrMatrix *matrix = (ZrMatrix *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!matrix) {
+        PyErr_SetString(PyExc_TypeError, "could not create ZrMatrix object");
+        return NULL;
+    }
+    // set the ready flag to 0
+    matrix->ready = 0;
+    return matrix;
+}
+
+// pack an integer of Zr into the limbs of an entry
+static void ZrMatrix_pack(mp_limb_t *entry, int limbs, mpz_t value) {
+    size_t size = mpz_size(value);
+    memcpy(entry, mpz_limbs_read(value), size * sizeof(mp_limb_t));
+    memset(entry + size, 0, (limbs - size) * sizeof(mp_limb_t));
+}
+
+PyObject *ZrMatrix_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    // required arguments are the pairing and the rows
+    static char *keywords[] = {"pairing", "rows", NULL};
+    PyObject *py_pairing;
+    PyObject *py_rows;
+    ModuleState *state = pypbc_state(type);
+    if (!state) {
+        return NULL;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O", keywords, state->PairingType, &py_pairing, &py_rows)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object and rows of Elements of Zr or integers");
+        return NULL;
+    }
+    // cast the arguments
+    Pairing *pairing = (Pairing *)py_pairing;
+    PyObject *rows = PySequence_Fast(py_rows, "the rows must be a sequence of sequences of Elements of Zr or integers");
+    if (!rows) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(rows);
+    if (count == 0) {
+        Py_DECREF(rows);
+        PyErr_SetString(PyExc_ValueError, "the matrix must have at least one row");
+        return NULL;
+    }
+    // every entry takes as many limbs as the order
+    int limbs = (int)mpz_size(pairing->pbc_pairing->r);
+    ZrMatrix *matrix = ZrMatrix_create(type);
+    if (!matrix) {
+        Py_DECREF(rows);
+        return NULL;
+    }
+    matrix->data = NULL;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        Py_ssize_t cols;
+        mpz_t *values = Pairing_scalars(pairing, PySequence_Fast_GET_ITEM(rows, i), &cols);
+        if (!values) {
+            break;
+        }
+        if (i == 0) {
+            matrix->cols = cols;
+            matrix->data = cols ? PyMem_Malloc((size_t)count * cols * limbs * sizeof(mp_limb_t)) : NULL;
+            if (!matrix->data) {
+                mpz_array_free(values, cols);
+                PyErr_SetString(cols ? PyExc_MemoryError : PyExc_ValueError, cols ? "could not allocate the matrix" : "the matrix must have at least one column");
+                break;
+            }
+        } else if (cols != matrix->cols) {
+            mpz_array_free(values, cols);
+            PyErr_SetString(PyExc_ValueError, "all the rows must have the same length");
+            break;
+        }
+        for (Py_ssize_t j = 0; j < cols; j++) {
+            ZrMatrix_pack(matrix->data + (i * cols + j) * limbs, limbs, values[j]);
+        }
+        mpz_array_free(values, cols);
+    }
+    Py_DECREF(rows);
+    if (PyErr_Occurred()) {
+        PyMem_Free(matrix->data);
+        Py_DECREF(matrix);
+        return NULL;
+    }
+    matrix->pairing = pairing;
+    matrix->rows = count;
+    matrix->limbs = limbs;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(pairing);
+    matrix->ready = 1;
+    return (PyObject *)matrix;
+}
+
+void ZrMatrix_dealloc(ZrMatrix *matrix) {
+    // free the entries if they're ready
+    if (matrix->ready) {
+        PyMem_Free(matrix->data);
+        Py_DECREF(matrix->pairing);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(matrix);
+    type->tp_free((PyObject *)matrix);
+    Py_DECREF(type);
+}
+
+// a read-only integer view of an entry, which needs no allocation
+static mpz_srcptr ZrMatrix_entry(ZrMatrix *matrix, Py_ssize_t i, Py_ssize_t j, mpz_t view) {
+    return mpz_roinit_n(view, matrix->data + (i * matrix->cols + j) * matrix->limbs, matrix->limbs);
+}
+
+// the dot product of a packed row with a packed vector: the products of 2n limbs are added
+// up in an accumulator of 2n + 1 limbs, which holds the sums of up to 2^64 of them, and the
+// sum is reduced by the order once; zero entries, common in access structures, are skipped
+static void ZrMatrix_dot(const mp_limb_t *row, const mp_limb_t *vector, Py_ssize_t cols, int limbs, const mp_limb_t *order, mp_limb_t *scratch, mpz_t out) {
+    mp_limb_t *acc = scratch;
+    mp_limb_t *product = acc + 2 * limbs + 1;
+    mp_limb_t *quotient = product + 2 * limbs;
+    mp_limb_t *remainder = quotient + limbs + 2;
+    memset(acc, 0, (2 * limbs + 1) * sizeof(mp_limb_t));
+    for (Py_ssize_t j = 0; j < cols; j++) {
+        const mp_limb_t *entry = row + j * limbs;
+        const mp_limb_t *value = vector + j * limbs;
+        if (mpn_zero_p(entry, limbs) || mpn_zero_p(value, limbs)) {
+            continue;
+        }
+        mpn_mul_n(product, entry, value, limbs);
+        acc[2 * limbs] += mpn_add_n(acc, acc, product, 2 * limbs);
+    }
+    mpn_tdiv_qr(quotient, remainder, 0, acc, 2 * limbs + 1, order, limbs);
+    mpz_t view;
+    mpz_set(out, mpz_roinit_n(view, remainder, limbs));
+}
+
+PyObject *ZrMatrix_mul_vector(PyObject *py_matrix, PyObject *py_vector) {
+    // cast the argument
+    ZrMatrix *matrix = (ZrMatrix *)py_matrix;
+    Pairing *pairing = matrix->pairing;
+    int limbs = matrix->limbs;
+    Py_ssize_t cols;
+    mpz_t *values = Pairing_scalars(pairing, py_vector, &cols);
+    if (!values) {
+        return NULL;
+    }
+    if (cols != matrix->cols) {
+        mpz_array_free(values, cols);
+        PyErr_SetString(PyExc_ValueError, "the vector must have as many entries as the matrix has columns");
+        return NULL;
+    }
+    // the vector is packed like the rows, with the scratch space of the dot products after it
+    mp_limb_t *vector = PyMem_Malloc(((size_t)cols * limbs + 6 * limbs + 3) * sizeof(mp_limb_t));
+    element_ptr *outs = vector ? PyMem_Malloc(matrix->rows * sizeof(element_ptr)) : NULL;
+    PyObject *list = outs ? Pairing_element_list(pairing, pairing->pbc_pairing->Zr, matrix->rows, outs) : PyErr_NoMemory();
+    if (list) {
+        for (Py_ssize_t j = 0; j < cols; j++) {
+            ZrMatrix_pack(vector + j * limbs, limbs, values[j]);
+        }
+        Py_BEGIN_ALLOW_THREADS
+        const mp_limb_t *order = mpz_limbs_read(pairing->pbc_pairing->r);
+        mpz_t value;
+        mpz_init(value);
+        for (Py_ssize_t i = 0; i < matrix->rows; i++) {
+            ZrMatrix_dot(matrix->data + i * cols * limbs, vector, cols, limbs, order, vector + cols * limbs, value);
+            element_set_mpz(outs[i], value);
+        }
+        mpz_clear(value);
+        Py_END_ALLOW_THREADS
+    }
+    PyMem_Free(outs);
+    PyMem_Free(vector);
+    mpz_array_free(values, cols);
+    return list;
+}
+
+// solve sum_i w_i row_i = target over the given rows by Gauss-Jordan elimination of the
+// transposed system, one equation per column; the free unknowns are set to 0, and the
+// result is -1 when the target is not spanned by the rows; needs no GIL
+static int ZrMatrix_solve(ZrMatrix *matrix, Py_ssize_t *indices, Py_ssize_t count, mpz_t *target, mpz_t *solution) {
+    mpz_ptr r = matrix->pairing->pbc_pairing->r;
+    Py_ssize_t eqs = matrix->cols;
+    Py_ssize_t width = count + 1;
+    mpz_t *system = PyMem_RawMalloc(eqs * width * sizeof(mpz_t));
+    Py_ssize_t *pivots = PyMem_RawMalloc((eqs ? eqs : 1) * sizeof(Py_ssize_t));
+    if (!system || !pivots) {
+        PyMem_RawFree(system);
+        PyMem_RawFree(pivots);
+        return -2;
+    }
+    // the row of equation j holds column j of the selected rows, then the target
+    mpz_t view;
+    for (Py_ssize_t j = 0; j < eqs; j++) {
+        for (Py_ssize_t i = 0; i < count; i++) {
+            mpz_init_set(system[j * width + i], ZrMatrix_entry(matrix, indices[i], j, view));
+        }
+        mpz_init_set(system[j * width + count], target[j]);
+    }
+    mpz_t factor;
+    mpz_init(factor);
+    Py_ssize_t rank = 0;
+    for (Py_ssize_t c = 0; c < count && rank < eqs; c++) {
+        Py_ssize_t p = rank;
+        while (p < eqs && mpz_sgn(system[p * width + c]) == 0) {
+            p++;
+        }
+        if (p == eqs) {
+            continue;
+        }
+        for (Py_ssize_t k = c; k < width; k++) {
+            mpz_swap(system[p * width + k], system[rank * width + k]);
+        }
+        // scale the pivot row to 1, then clear the column in every other row
+        mpz_t *pivot = system + rank * width;
+        mpz_invert(factor, pivot[c], r);
+        for (Py_ssize_t k = c; k < width; k++) {
+            mpz_mul(pivot[k], pivot[k], factor);
+            mpz_mod(pivot[k], pivot[k], r);
+        }
+        for (Py_ssize_t q = 0; q < eqs; q++) {
+            mpz_t *row = system + q * width;
+            if (q == rank || mpz_sgn(row[c]) == 0) {
+                continue;
+            }
+            mpz_set(factor, row[c]);
+            for (Py_ssize_t k = c; k < width; k++) {
+                mpz_submul(row[k], factor, pivot[k]);
+                mpz_mod(row[k], row[k], r);
+            }
+        }
+        pivots[rank++] = c;
+    }
+    mpz_clear(factor);
+    // the equations left without a pivot must have a zero target
+    int status = 0;
+    for (Py_ssize_t q = rank; q < eqs && status == 0; q++) {
+        status = mpz_sgn(system[q * width + count]) ? -1 : 0;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        mpz_set_ui(solution[i], 0);
+    }
+    for (Py_ssize_t q = 0; q < rank && status == 0; q++) {
+        mpz_set(solution[pivots[q]], system[q * width + count]);
+    }
+    for (Py_ssize_t k = 0; k < eqs * width; k++) {
+        mpz_clear(system[k]);
+    }
+    PyMem_RawFree(system);
+    PyMem_RawFree(pivots);
+    return status;
+}
+
+PyObject *ZrMatrix_reconstruction(PyObject *py_matrix, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required argument is the indices of the rows, the target defaults to (1, 0, ..., 0)
+    static const char *const keywords[] = {"rows", "target", NULL};
+    PyObject *slots[2];
+    if (args_bind(args, nargs, kwnames, keywords, 1, slots) < 0) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected row indices and an optional target vector");
+        return NULL;
+    }
+    // cast the argument
+    ZrMatrix *matrix = (ZrMatrix *)py_matrix;
+    Pairing *pairing = matrix->pairing;
+    PyObject *rows = PySequence_Fast(slots[0], "the rows must be a sequence of indices");
+    if (!rows) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(rows);
+    Py_ssize_t *indices = PyMem_Malloc((count ? count : 1) * sizeof(Py_ssize_t));
+    if (!indices) {
+        Py_DECREF(rows);
+        return PyErr_NoMemory();
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        if (args_ssize(PySequence_Fast_GET_ITEM(rows, i), &indices[i]) < 0 || indices[i] < 0 || indices[i] >= matrix->rows) {
+            PyMem_Free(indices);
+            Py_DECREF(rows);
+            PyErr_SetString(PyExc_IndexError, "the rows must be indices of rows of the matrix");
+            return NULL;
+        }
+    }
+    Py_DECREF(rows);
+    Py_ssize_t cols = matrix->cols;
+    mpz_t *target;
+    if (slots[1] && slots[1] != Py_None) {
+        target = Pairing_scalars(pairing, slots[1], &cols);
+        if (target && cols != matrix->cols) {
+            mpz_array_free(target, cols);
+            PyErr_SetString(PyExc_ValueError, "the target must have as many entries as the matrix has columns");
+            target = NULL;
+        }
+    } else {
+        target = PyMem_Malloc(cols * sizeof(mpz_t));
+        for (Py_ssize_t j = 0; target && j < cols; j++) {
+            mpz_init_set_ui(target[j], j == 0);
+        }
+        if (!target) {
+            PyErr_NoMemory();
+        }
+    }
+    if (!target) {
+        PyMem_Free(indices);
+        return NULL;
+    }
+    mpz_t *solution = PyMem_Malloc((count ? count : 1) * sizeof(mpz_t));
+    if (!solution) {
+        mpz_array_free(target, cols);
+        PyMem_Free(indices);
+        return PyErr_NoMemory();
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        mpz_init(solution[i]);
+    }
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = ZrMatrix_solve(matrix, indices, count, target, solution);
+    Py_END_ALLOW_THREADS
+    PyObject *list = NULL;
+    if (status == -2) {
+        PyErr_NoMemory();
+    } else if (status == -1) {
+        // the rows do not satisfy the access structure
+        Py_INCREF(Py_None);
+        list = Py_None;
+    } else {
+        element_ptr *outs = PyMem_Malloc((count ? count : 1) * sizeof(element_ptr));
+        list = outs ? Pairing_element_list(pairing, pairing->pbc_pairing->Zr, count, outs) : PyErr_NoMemory();
+        for (Py_ssize_t i = 0; list && i < count; i++) {
+            element_set_mpz(outs[i], solution[i]);
+        }
+        PyMem_Free(outs);
+    }
+    mpz_array_free(solution, count);
+    mpz_array_free(target, cols);
+    PyMem_Free(indices);
+    return list;
+}
+
+PyObject *ZrMatrix_to_list(PyObject *py_matrix) {
+    // cast the argument
+    ZrMatrix *matrix = (ZrMatrix *)py_matrix;
+    Pairing *pairing = matrix->pairing;
+    PyObject *list = PyList_New(matrix->rows);
+    element_ptr *outs = list ? PyMem_Malloc(matrix->cols * sizeof(element_ptr)) : NULL;
+    if (list && !outs) {
+        Py_CLEAR(list);
+        PyErr_NoMemory();
+    }
+    mpz_t view;
+    for (Py_ssize_t i = 0; list && i < matrix->rows; i++) {
+        PyObject *row = Pairing_element_list(pairing, pairing->pbc_pairing->Zr, matrix->cols, outs);
+        if (!row) {
+            Py_CLEAR(list);
+            break;
+        }
+        for (Py_ssize_t j = 0; j < matrix->cols; j++) {
+            element_set_mpz(outs[j], (mpz_ptr)ZrMatrix_entry(matrix, i, j, view));
+        }
+        PyList_SET_ITEM(list, i, row);
+    }
+    PyMem_Free(outs);
+    return list;
+}
+
+PyObject *ZrMatrix_shape(PyObject *py_matrix) {
+    ZrMatrix *matrix = (ZrMatrix *)py_matrix;
+    return Py_BuildValue("(nn)", matrix->rows, matrix->cols);
+}
+
+PyMemberDef ZrMatrix_members[] = {
+    {NULL},
+};
+
+PyMethodDef ZrMatrix_methods[] = {
+    {"shape", (PyCFunction)ZrMatrix_shape, METH_NOARGS, "Returns the numbers of rows and columns of the matrix."},
+    {"to_list", (PyCFunction)ZrMatrix_to_list, METH_NOARGS, "Returns the rows of the matrix as lists of Elements of Zr."},
+    {"mul_vector", (PyCFunction)ZrMatrix_mul_vector, METH_O, "Returns the product of the matrix with a vector."},
+    {"reconstruction", (PyCFunction)(void (*)(void))ZrMatrix_reconstruction, METH_FASTCALL | METH_KEYWORDS, "Returns the coefficients that combine the given rows into the target, or None."},
+    {NULL},
+};
+
+PyType_Slot ZrMatrix_slots[] = {
+    {Py_tp_dealloc, ZrMatrix_dealloc},
+    {Py_tp_doc, (void *)ZrMatrix__doc__},
+    {Py_tp_methods, ZrMatrix_methods},
+    {Py_tp_members, ZrMatrix_members},
+    {Py_tp_new, ZrMatrix_new},
+    {0, NULL},
+};
+
+PyType_Spec ZrMatrix_spec = {
+    "pypbc.ZrMatrix",                                                    /* name */
+    sizeof(ZrMatrix),                                                    /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    ZrMatrix_slots,                                                      /* slots */
+};
+
+/*******************************************************************************
+*                                Miller Values                                 *
+*******************************************************************************/
+
+PyDoc_STRVAR(MillerValue__doc__,
+    "Represents the product of Miller loops of a pairing, before the final exponentiation.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "value = pairing.miller_loop(lefts, rights)\n"
+    "pairing.final_exponentiation(value * other) -> Element\n"
+    "\n"
+    "The values of several workers can be serialized, multiplied on one node and\n"
+    "exponentiated once there, which gives the product of all their pairings.");
+
+MillerValue *MillerValue_create(Pairing *pairing) {
+    // allocate the object of the type of the module of the pairing
+    PyTypeObject *type = pairing->state->MillerValueType;
+    MillerValue *value = (MillerValue *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!value) {
+        PyErr_SetString(PyExc_TypeError, "could not create MillerValue object");
+        return NULL;
+    }
+    // initialize the value in the field of GT
+    element_init_GT(value->value, pairing->pbc_pairing);
+    value->pairing = pairing;
+    Py_INCREF(pairing);
+    value->ready = 1;
+    return value;
+}
+
+// the Miller loops of the pairing, or NULL with NotImplementedError set
+static MillerCurve *MillerValue_curve(Pairing *pairing) {
+    MillerCurve *curve = Pairing_miller_curve(pairing);
+    if (!curve) {
+        PyErr_SetString(PyExc_NotImplementedError, "separate Miller loops are only available for type A pairings");
+    }
+    return curve;
+}
+
+PyObject *MillerValue_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    PyErr_SetString(PyExc_TypeError, "MillerValue objects are created by Pairing.miller_loop and MillerValue.from_bytes");
+    return NULL;
+}
+
+void MillerValue_dealloc(MillerValue *value) {
+    // clear the value if it's ready
+    if (value->ready) {
+        element_clear(value->value);
+        Py_DECREF(value->pairing);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(value);
+    type->tp_free((PyObject *)value);
+    Py_DECREF(type);
+}
+
+// check the sides of a product of pairings, the right sides being Elements of G2 or PreparedG2
+// objects, and gather their elements, the left ones then the right ones, and the lines of the
+// prepared ones; the arrays are freed by the caller with PyMem_Free
+static element_ptr *Pairing_pairs(Pairing *pairing, PyObject *lefts, PyObject *rights, Py_ssize_t count, AteLines ***ate) {
+    if (PySequence_Fast_GET_SIZE(rights) != count) {
+        PyErr_SetString(PyExc_ValueError, "there must be as many left sides as right sides");
+        return NULL;
+    }
+    element_ptr *ins = PyMem_Malloc((2 * count + 1) * sizeof(element_ptr));
+    *ate = PyMem_Malloc((count + 1) * sizeof(AteLines *));
+    if (!ins || !*ate) {
+        PyMem_Free(ins);
+        PyMem_Free(*ate);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject *lft = PySequence_Fast_GET_ITEM(lefts, i);
+        PyObject *rgt = PySequence_Fast_GET_ITEM(rights, i);
+        (*ate)[i] = NULL;
+        if (PyObject_TypeCheck(rgt, pairing->state->PreparedG2Type) && ((PreparedG2 *)rgt)->pairing == pairing) {
+            (*ate)[i] = ((PreparedG2 *)rgt)->ate;
+            rgt = ((PreparedG2 *)rgt)->element;
+        }
+        if (!PyObject_TypeCheck(lft, pairing->state->ElementType) || ((Element *)lft)->pairing != pairing || ((Element *)lft)->pbc_element->field != pairing->pbc_pairing->G1 ||
+            !PyObject_TypeCheck(rgt, pairing->state->ElementType) || ((Element *)rgt)->pairing != pairing || ((Element *)rgt)->pbc_element->field != pairing->pbc_pairing->G2) {
+            PyMem_Free(ins);
+            PyMem_Free(*ate);
+            PyErr_SetString(PyExc_TypeError, "the left sides must be Elements of G1 and the right sides Elements of G2 or PreparedG2 objects of the pairing");
+            return NULL;
+        }
+        ins[i] = ((Element *)lft)->pbc_element;
+        ins[count + i] = ((Element *)rgt)->pbc_element;
+    }
+    return ins;
+}
+
+PyObject *Pairing_miller_loop(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect the G1 and the G2 sides of the pairs
+    if (nargs != 2) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Elements of G1 and of G2");
+        return NULL;
+    }
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    MillerCurve *curve = MillerValue_curve(pairing);
+    if (!curve) {
+        return NULL;
+    }
+    PyObject *lefts = PySequence_Fast(args[0], "the left sides must be a sequence of Elements of G1");
+    PyObject *rights = lefts ? PySequence_Fast(args[1], "the right sides must be a sequence of Elements of G2") : NULL;
+    if (!rights) {
+        Py_XDECREF(lefts);
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(lefts);
+    AteLines **ate;
+    element_ptr *ins = Pairing_pairs(pairing, lefts, rights, count, &ate);
+    MillerValue *result = ins ? MillerValue_create(pairing) : NULL;
+    if (result) {
+        Py_BEGIN_ALLOW_THREADS
+        element_set1(result->value);
+        miller_loop(curve, result->value, ins, ins + count, count);
+        Py_END_ALLOW_THREADS
+    }
+    if (ins) {
+        PyMem_Free(ins);
+        PyMem_Free(ate);
+    }
+    Py_DECREF(lefts);
+    Py_DECREF(rights);
+    return (PyObject *)result;
+}
+
+PyObject *Pairing_apply_product(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect the G1 and the G2 sides of the pairs
+    if (nargs != 2) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Elements of G1 and of G2");
+        return NULL;
+    }
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    PyObject *lefts = PySequence_Fast(args[0], "the left sides must be a sequence of Elements of G1");
+    PyObject *rights = lefts ? PySequence_Fast(args[1], "the right sides must be a sequence of Elements of G2") : NULL;
+    if (!rights) {
+        Py_XDECREF(lefts);
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(lefts);
+    // the pairs go to PBC's multi-pairing, which counts them with an int
+    if (count > INT_MAX) {
+        Py_DECREF(lefts);
+        Py_DECREF(rights);
+        PyErr_SetString(PyExc_OverflowError, "too many pairs");
+        return NULL;
+    }
+    AteLines **ate;
+    element_ptr *ins = Pairing_pairs(pairing, lefts, rights, count, &ate);
+    Element *ele_res = ins ? Element_create(pairing) : NULL;
+    if (ele_res) {
+        element_init_GT(ele_res->pbc_element, pairing->pbc_pairing);
+        ele_res->pairing = pairing;
+        MillerCurve *curve = Pairing_miller_curve(pairing);
+        // the ate loop is only built once an Element has been prepared with it
+        int prepared = 0;
+        for (Py_ssize_t i = 0; i < count && !curve && !prepared; i++) {
+            prepared = ate[i] != NULL;
+        }
+        AteCurve *ate_curve = prepared ? Pairing_ate_curve(pairing) : NULL;
+        element_t *in1 = curve ? NULL : PyMem_Malloc((count + 1) * sizeof(element_t));
+        element_t *in2 = curve ? NULL : PyMem_Malloc((count + 1) * sizeof(element_t));
+        AteLines **sets = ate_curve ? PyMem_Malloc((count + 1) * sizeof(AteLines *)) : NULL;
+        element_ptr *points = ate_curve ? PyMem_Malloc((count + 1) * sizeof(element_ptr)) : NULL;
+        Py_BEGIN_ALLOW_THREADS
+        if (curve) {
+            // one Miller loop over all the pairs, then a single final exponentiation
+            element_set1(ele_res->pbc_element);
+            miller_loop(curve, ele_res->pbc_element, ins, ins + count, count);
+            miller_final_exponentiation(curve, ele_res->pbc_element, ele_res->pbc_element);
+        } else if (in1 && in2 && (!ate_curve || (sets && points))) {
+            // the prepared pairs the ate loop accepts are evaluated together, the others go
+            // through PBC, the arguments being only read, so they are shared with their elements
+            Py_ssize_t plain = 0;
+            Py_ssize_t grouped = 0;
+            for (Py_ssize_t i = 0; i < count; i++) {
+                if (ate_curve && ate[i] && !element_is0(ins[i]) && ate_curve_accepts(ate_curve, ins[i])) {
+                    sets[grouped] = ate[i];
+                    points[grouped++] = ins[i];
+                } else {
+                    in1[plain][0] = *ins[i];
+                    in2[plain++][0] = *ins[count + i];
+                }
+            }
+            prod_pairing_nonzero(ele_res->pbc_element, in1, in2, plain, pairing->pbc_pairing);
+            if (grouped) {
+                element_t product;
+                element_init_GT(product, pairing->pbc_pairing);
+                ate_evaluate(ate_curve, product, sets, points, grouped);
+                element_mul(ele_res->pbc_element, ele_res->pbc_element, product);
+                element_clear(product);
+            }
+        } else {
+            element_set1(ele_res->pbc_element);
+            for (Py_ssize_t i = 0; i < count; i++) {
+                element_t product;
+                element_init_GT(product, pairing->pbc_pairing);
+                pairing_apply(product, ins[i], ins[count + i], pairing->pbc_pairing);
+                element_mul(ele_res->pbc_element, ele_res->pbc_element, product);
+                element_clear(product);
+            }
+        }
+        Py_END_ALLOW_THREADS
+        PyMem_Free(in1);
+        PyMem_Free(in2);
+        PyMem_Free(sets);
+        PyMem_Free(points);
+        // the result is a product of pairings, so it is unitary
+        ele_res->unitary = pairing->gt_unitary;
+        ele_res->subgroup = 0;
+        // increment the reference count on the pairing and set the ready flag
+        Py_INCREF(ele_res->pairing);
+        ele_res->ready = 1;
+    }
+    if (ins) {
+        PyMem_Free(ins);
+        PyMem_Free(ate);
+    }
+    Py_DECREF(lefts);
+    Py_DECREF(rights);
+    return (PyObject *)ele_res;
+}
+
+PyObject *Pairing_final_exponentiation(PyObject *py_pairing, PyObject *py_value) {
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    MillerCurve *curve = MillerValue_curve(pairing);
+    if (!curve) {
+        return NULL;
+    }
+    if (!PyObject_TypeCheck(py_value, pairing->state->MillerValueType) || ((MillerValue *)py_value)->pairing != pairing) {
+        PyErr_SetString(PyExc_TypeError, "the value must be a MillerValue of the pairing");
+        return NULL;
+    }
+    MillerValue *value = (MillerValue *)py_value;
+    // build the result element and initialize it with the pairing and group
+    Element *ele_res = Element_create(pairing);
+    if (!ele_res) {
+        return NULL;
+    }
+    element_init_GT(ele_res->pbc_element, pairing->pbc_pairing);
+    ele_res->pairing = pairing;
+    Py_BEGIN_ALLOW_THREADS
+    miller_final_exponentiation(curve, ele_res->pbc_element, value->value);
+    Py_END_ALLOW_THREADS
+    // the result is a product of pairings, so it is unitary
+    ele_res->unitary = pairing->gt_unitary;
+    ele_res->subgroup = 0;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+PyObject *MillerValue_from_bytes(PyObject *cls, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect the pairing and the bytes
+    ModuleState *state = pypbc_state((PyTypeObject *)cls);
+    if (!state) {
+        return NULL;
+    }
+    if (nargs != 2 || !PyObject_TypeCheck(args[0], state->PairingType) || !PyBytes_Check(args[1])) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object and bytes");
+        return NULL;
+    }
+    // cast the arguments
+    Pairing *pairing = (Pairing *)args[0];
+    if (!MillerValue_curve(pairing)) {
+        return NULL;
+    }
+    MillerValue *value = MillerValue_create(pairing);
+    if (!value) {
+        return NULL;
+    }
+    // the value is any nonzero element of the field of GT, so only the length and zero are checked
+    if (PyBytes_GET_SIZE(args[1]) != element_length_in_bytes(value->value)) {
+        Py_DECREF(value);
+        PyErr_SetString(PyExc_ValueError, "the bytes do not have the length of a MillerValue of the pairing");
+        return NULL;
+    }
+    element_from_bytes(value->value, (unsigned char *)PyBytes_AS_STRING(args[1]));
+    // Miller values are products of nonzero lines, and the final exponentiation inverts them
+    if (element_is0(value->value)) {
+        Py_DECREF(value);
+        PyErr_SetString(PyExc_ValueError, "a MillerValue cannot be zero");
+        return NULL;
+    }
+    return (PyObject *)value;
+}
+
+PyObject *MillerValue_to_bytes(PyObject *py_value) {
+    // cast the argument
+    MillerValue *value = (MillerValue *)py_value;
+    // get the size of the buffer and allocate it
+    int size = element_length_in_bytes(value->value);
+    unsigned char buffer[size];
+    // convert the value to bytes
+    element_to_bytes(buffer, value->value);
+    // return the buffer as a bytes object
+    return PyBytes_FromStringAndSize((char *)buffer, size);
+}
+
+PyObject *MillerValue_mul(PyObject *py_lft, PyObject *py_rgt) {
+    // both sides must be values of the same pairing
+    if (!MillerValue_check(py_lft) || !MillerValue_check(py_rgt)) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+    MillerValue *lft = (MillerValue *)py_lft;
+    MillerValue *rgt = (MillerValue *)py_rgt;
+    if (lft->pairing != rgt->pairing) {
+        PyErr_SetString(PyExc_ValueError, "the values must come from the same pairing");
+        return NULL;
+    }
+    MillerValue *value = MillerValue_create(lft->pairing);
+    if (!value) {
+        return NULL;
+    }
+    element_mul(value->value, lft->value, rgt->value);
+    return (PyObject *)value;
+}
+
+PyObject *MillerValue_richcompare(PyObject *py_lft, PyObject *py_rgt, int op) {
+    if ((op != Py_EQ && op != Py_NE) || !MillerValue_check(py_lft) || !MillerValue_check(py_rgt)) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+    MillerValue *lft = (MillerValue *)py_lft;
+    MillerValue *rgt = (MillerValue *)py_rgt;
+    int equal = lft->pairing == rgt->pairing && element_cmp(lft->value, rgt->value) == 0;
+    return PyBool_FromLong(op == Py_EQ ? equal : !equal);
+}
+
+PyMemberDef MillerValue_members[] = {
+    {NULL},
+};
+
+PyMethodDef MillerValue_methods[] = {
+    {"from_bytes", (PyCFunction)(void (*)(void))MillerValue_from_bytes, METH_FASTCALL | METH_CLASS, "Creates a MillerValue from the bytes of MillerValue.to_bytes."},
+    {"to_bytes", (PyCFunction)MillerValue_to_bytes, METH_NOARGS, "Returns the value as bytes."},
+    {NULL},
+};
+
+PyType_Slot MillerValue_slots[] = {
+    {Py_tp_dealloc, MillerValue_dealloc},
+    {Py_tp_doc, (void *)MillerValue__doc__},
+    {Py_tp_methods, MillerValue_methods},
+    {Py_tp_members, MillerValue_members},
+    {Py_tp_new, MillerValue_new},
+    {Py_tp_richcompare, MillerValue_richcompare},
+    {Py_nb_multiply, MillerValue_mul},
+    {0, NULL},
+};
+
+PyType_Spec MillerValue_spec = {
+    "pypbc.MillerValue",                                                 /* name */
+    sizeof(MillerValue),                                                 /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE,                       /* flags */
+    MillerValue_slots,                                                   /* slots */
+};
+
+/*******************************************************************************
+*                                 Prepared G2                                  *
+*******************************************************************************/
+
+PyDoc_STRVAR(PreparedG2__doc__,
+    "Represents an Element of G2 prepared for many pairings.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "prepared = pairing.prepare(g2)\n"
+    "prepared.apply(g1) -> Element\n"
+    "pairing.apply_product([g1, h1], [prepared, h2]) -> Element\n"
+    "\n"
+    "The lines of the Miller loop of the Element are computed once, so that each\n"
+    "pairing with it only evaluates them at its G1 argument.");
+
+PyObject *PreparedG2_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    PyErr_SetString(PyExc_TypeError, "PreparedG2 objects are created by Pairing.prepare");
+    return NULL;
+}
+
+void PreparedG2_dealloc(PreparedG2 *prepared) {
+    // release the lines and the element if it's ready
+    if (prepared->ready) {
+        if (prepared->ate) {
+            ate_lines_free(prepared->ate);
+        }
+        Py_DECREF(prepared->element);
+        Py_DECREF(prepared->pairing);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(prepared);
+    type->tp_free((PyObject *)prepared);
+    Py_DECREF(type);
+}
+
+PyObject *Pairing_prepare(PyObject *py_pairing, PyObject *py_element) {
+    // cast the argument
+    Pairing *pairing = (Pairing *)py_pairing;
+    if (!PyObject_TypeCheck(py_element, pairing->state->ElementType) || ((Element *)py_element)->pairing != pairing || ((Element *)py_element)->pbc_element->field != pairing->pbc_pairing->G2) {
+        PyErr_SetString(PyExc_TypeError, "only Elements of G2 of the pairing can be prepared");
+        return NULL;
+    }
+    Element *element = (Element *)py_element;
+    PyTypeObject *type = pairing->state->PreparedG2Type;
+    PreparedG2 *prepared = (PreparedG2 *)type->tp_alloc(type, 0);
+    if (!prepared) {
+        PyErr_SetString(PyExc_TypeError, "could not create PreparedG2 object");
+        return NULL;
+    }
+    // the ate loop keeps the lines of the points of order r, the other pairings go through PBC;
+    // the loop of type A pairings iterates on the G1 argument, so they have no lines to keep
+    AteCurve *ate_curve = Pairing_ate_curve(pairing);
+    AteLines *ate = NULL;
+    int failed = 0;
+    if (ate_curve && !element_is0(element->pbc_element)) {
+        Py_BEGIN_ALLOW_THREADS
+        if (Pairing_in_subgroup(pairing, element->pbc_element)) {
+            ate = ate_lines_create(ate_curve, element->pbc_element);
+            failed = !ate;
+        }
+        Py_END_ALLOW_THREADS
+    }
+    if (failed) {
+        Py_DECREF(prepared);
+        return PyErr_NoMemory();
+    }
+    prepared->pairing = pairing;
+    prepared->element = py_element;
+    prepared->ate = ate;
+    Py_INCREF(pairing);
+    Py_INCREF(py_element);
+    prepared->ready = 1;
+    return (PyObject *)prepared;
+}
+
+PyObject *PreparedG2_apply(PyObject *py_prepared, PyObject *py_element) {
+    // cast the argument
+    PreparedG2 *prepared = (PreparedG2 *)py_prepared;
+    Pairing *pairing = prepared->pairing;
+    if (!PyObject_TypeCheck(py_element, pairing->state->ElementType) || ((Element *)py_element)->pairing != pairing || ((Element *)py_element)->pbc_element->field != pairing->pbc_pairing->G1) {
+        PyErr_SetString(PyExc_TypeError, "a PreparedG2 can only be applied to an Element of G1 of its pairing");
+        return NULL;
+    }
+    Element *ele_lft = (Element *)py_element;
+    Element *ele_rgt = (Element *)prepared->element;
+    // build the result element and initialize it with the pairing and group
+    Element *ele_res = Element_create(pairing);
+    if (!ele_res) {
+        return NULL;
+    }
+    element_init_GT(ele_res->pbc_element, pairing->pbc_pairing);
+    ele_res->pairing = pairing;
+    AteCurve *ate_curve = prepared->ate ? Pairing_ate_curve(pairing) : NULL;
+    Py_BEGIN_ALLOW_THREADS
+    element_ptr lft = ele_lft->pbc_element;
+    if (ate_curve && !element_is0(lft) && ate_curve_accepts(ate_curve, lft)) {
+        ate_evaluate(ate_curve, ele_res->pbc_element, &prepared->ate, &lft, 1);
+    } else {
+        pairing_apply(ele_res->pbc_element, lft, ele_rgt->pbc_element, pairing->pbc_pairing);
+    }
+    Py_END_ALLOW_THREADS
+    ele_res->unitary = pairing->gt_unitary;
+    ele_res->subgroup = ele_lft->subgroup == ele_rgt->subgroup ? ele_lft->subgroup : 0;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    return (PyObject *)ele_res;
+}
+
+PyMemberDef PreparedG2_members[] = {
+    {"element", T_OBJECT_EX, offsetof(PreparedG2, element), READONLY, "The Element of G2 that was prepared."},
+    {NULL},
+};
+
+PyMethodDef PreparedG2_methods[] = {
+    {"apply", (PyCFunction)PreparedG2_apply, METH_O, "Returns the pairing of an Element of G1 with the prepared Element."},
+    {NULL},
+};
+
+PyType_Slot PreparedG2_slots[] = {
+    {Py_tp_dealloc, PreparedG2_dealloc},
+    {Py_tp_doc, (void *)PreparedG2__doc__},
+    {Py_tp_methods, PreparedG2_methods},
+    {Py_tp_members, PreparedG2_members},
+    {Py_tp_new, PreparedG2_new},
+    {0, NULL},
+};
+
+PyType_Spec PreparedG2_spec = {
+    "pypbc.PreparedG2",                                                  /* name */
+    sizeof(PreparedG2),                                                  /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE,                       /* flags */
+    PreparedG2_slots,                                                    /* slots */
+};
+
+/*******************************************************************************
+*                                BLS Signatures                                *
+*******************************************************************************/
+
+PyDoc_STRVAR(BlsScheme__doc__,
+    "BLS signatures with signatures in G1 and public keys in G2.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "Scheme(pairing: Pairing, generator: Element, dst: bytes = DEFAULT_DST, validate: bool = True) -> Scheme\n"
+    "\n"
+    "Messages are hashed to G1 with expand_message_xmd under the tag dst, and\n"
+    "every verification is a single multi-pairing computed with the GIL released.");
+
+PyDoc_STRVAR(bls__doc__,
+    "Native BLS signatures over a pairing, with aggregation and batch verification.");
+
+#define BLS_DEFAULT_DST "BLS_SIG_PYPBC_XMD:SHA-256_NUL_"
+
+// the bits of the random coefficients of batch verification
+#define BLS_BATCH_BITS 64
+
+BlsScheme *BlsScheme_create(PyTypeObject *type) {
+    // allocate the object
+    BlsScheme *scheme = (BlsScheme *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!scheme) {
+        PyErr_SetString(PyExc_TypeError, "could not create Scheme object");
+        return NULL;
+    }
+    // set the ready flag to 0
+    scheme->ready = 0;
+    return scheme;
+}
+
+PyObject *BlsScheme_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    // required arguments are the pairing and the generator of G2, the tag and the checks are optional
+    static char *keywords[] = {"pairing", "generator", "dst", "validate", NULL};
+    PyObject *py_pairing;
+    PyObject *py_generator;
+    PyObject *py_dst = NULL;
+    int validate = 1;
+    ModuleState *state = pypbc_state(type);
+    if (!state) {
+        return NULL;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O!|Sp", keywords, state->PairingType, &py_pairing, state->ElementType, &py_generator, &py_dst, &validate)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, generator, optional domain separation tag and validate flag");
+        return NULL;
+    }
+    // cast the arguments
+    Pairing *pairing = (Pairing *)py_pairing;
+    Element *generator = (Element *)py_generator;
+    if (generator->pbc_element->field != pairing->pbc_pairing->G2 || element_is1(generator->pbc_element)) {
+        PyErr_SetString(PyExc_ValueError, "the generator must be an Element of G2 other than 1");
+        return NULL;
+    }
+    // create the object
+    BlsScheme *scheme = BlsScheme_create(type);
+    if (!scheme) {
+        return NULL;
+    }
+    scheme->pairing = pairing;
+    scheme->generator = py_generator;
+    scheme->validate = validate;
+    Py_INCREF(pairing);
+    Py_INCREF(py_generator);
+    // the generator gets a fixed-base table, and the hasher absorbs the tag once
+    scheme->table = PyObject_CallFunctionObjArgs((PyObject *)state->FixedBaseType, py_generator, NULL);
+    if (py_dst) {
+        scheme->hasher = PyObject_CallFunction((PyObject *)state->HashToGroupType, "OiO", py_pairing, G1, py_dst);
+    } else {
+        scheme->hasher = PyObject_CallFunction((PyObject *)state->HashToGroupType, "Oiy", py_pairing, G1, BLS_DEFAULT_DST);
+    }
+    if (!scheme->table || !scheme->hasher) {
+        Py_DECREF(scheme);
+        return NULL;
+    }
+    // verifications pair the signature with the inverse of the generator
+    element_init_same_as(scheme->neg_generator, generator->pbc_element);
+    element_invert(scheme->neg_generator, generator->pbc_element);
+    scheme->ready = 1;
+    return (PyObject *)scheme;
+}
+
+void BlsScheme_dealloc(BlsScheme *scheme) {
+    if (scheme->ready) {
+        element_clear(scheme->neg_generator);
+    }
+    Py_XDECREF(scheme->hasher);
+    Py_XDECREF(scheme->table);
+    Py_XDECREF(scheme->generator);
+    Py_XDECREF(scheme->pairing);
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(scheme);
+    type->tp_free((PyObject *)scheme);
+    Py_DECREF(type);
+}
+
+// hash a message to G1 into an initialized element
+int BlsScheme_hash(BlsScheme *scheme, PyObject *py_msg, element_ptr out) {
+    Py_buffer msg;
+    if (PyObject_GetBuffer(py_msg, &msg, PyBUF_SIMPLE) < 0) {
+        return -1;
+    }
+    HashToGroup *hasher = (HashToGroup *)scheme->hasher;
+    Hash ctx = hasher->hash;
+    hash_update(&ctx, msg.buf, msg.len);
+    PyBuffer_Release(&msg);
+    HashToGroup_map(hasher, &ctx, out);
+    return 0;
+}
+
+// check that an object is an Element of the given group of the scheme, returning -1 with an
+// exception if it is not, and 0 if it is but is the identity or fails the subgroup check, if
+// asked for; the identity pairs to 1 with anything, so it is never a valid key or signature
+int BlsScheme_check(BlsScheme *scheme, PyObject *obj, enum Group group, int validate) {
+    if (!Element_check(obj) || ((Element *)obj)->pbc_element->field != Pairing_field(scheme->pairing, group)) {
+        PyErr_SetString(PyExc_TypeError, group == G1 ? "signatures must be Elements of G1" : "public keys must be Elements of G2");
+        return -1;
+    }
+    if (element_is0(((Element *)obj)->pbc_element)) {
+        return 0;
+    }
+    if (validate && !Pairing_in_subgroup(scheme->pairing, ((Element *)obj)->pbc_element)) {
+        return 0;
+    }
+    return 1;
+}
+
+// an Element of the pairing of the scheme holding a copy of a computed element
+static PyObject *BlsScheme_element(BlsScheme *scheme, element_ptr value) {
+    Element *element = Element_create(scheme->pairing);
+    if (!element) {
+        return NULL;
+    }
+    element_init_same_as(element->pbc_element, value);
+    element_set(element->pbc_element, value);
+    element->pairing = scheme->pairing;
+    // increment the reference count on the pairing and set the ready flag
+    Py_INCREF(element->pairing);
+    element->ready = 1;
+    return (PyObject *)element;
+}
+
+PyObject *BlsScheme_keygen(PyObject *py_scheme) {
+    // cast the argument
+    BlsScheme *scheme = (BlsScheme *)py_scheme;
+    element_t sk;
+    element_init_Zr(sk, scheme->pairing->pbc_pairing);
+    element_random(sk);
+    PyObject *py_sk = BlsScheme_element(scheme, sk);
+    element_clear(sk);
+    if (!py_sk) {
+        return NULL;
+    }
+    PyObject *py_pk = FixedBase_pow(scheme->table, py_sk);
+    if (!py_pk) {
+        Py_DECREF(py_sk);
+        return NULL;
+    }
+    return Py_BuildValue("(NN)", py_sk, py_pk);
+}
+
+PyObject *BlsScheme_public_key(PyObject *py_scheme, PyObject *py_sk) {
+    // cast the argument
+    BlsScheme *scheme = (BlsScheme *)py_scheme;
+    return FixedBase_pow(scheme->table, py_sk);
+}
+
+PyObject *BlsScheme_sign(PyObject *py_scheme, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect a secret key and a message
+    if (nargs != 2) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected a secret key and a message");
+        return NULL;
+    }
+    PyObject *py_sk = args[0];
+    PyObject *py_msg = args[1];
+    // cast the argument
+    BlsScheme *scheme = (BlsScheme *)py_scheme;
+    mpz_t mpz_sk;
+    mpz_init(mpz_sk);
+    if (Pairing_exponent_to_mpz(scheme->pairing, mpz_sk, py_sk) < 0) {
+        mpz_clear(mpz_sk);
+        return NULL;
+    }
+    // build the result element and initialize it with the pairing and G1
+    Element *ele_res = Element_create(scheme->pairing);
+    if (!ele_res) {
+        mpz_clear(mpz_sk);
+        return NULL;
+    }
+    element_init_G1(ele_res->pbc_element, scheme->pairing->pbc_pairing);
+    ele_res->pairing = scheme->pairing;
+    Py_INCREF(ele_res->pairing);
+    ele_res->ready = 1;
+    if (BlsScheme_hash(scheme, py_msg, ele_res->pbc_element) < 0) {
+        mpz_clear(mpz_sk);
+        Py_DECREF(ele_res);
+        return NULL;
+    }
+    // the signature is the hash raised to the secret key
+    Py_BEGIN_ALLOW_THREADS
+    element_pow_mpz(ele_res->pbc_element, ele_res->pbc_element, mpz_sk);
+    Py_END_ALLOW_THREADS
+    mpz_clear(mpz_sk);
+    return (PyObject *)ele_res;
+}
+
+// the product of the elements of a sequence, which must all be in the given group
+static PyObject *BlsScheme_product(BlsScheme *scheme, PyObject *py_elements, enum Group group, int validate, int *valid) {
+    PyObject *elements = PySequence_Fast(py_elements, "expected a sequence of Elements");
+    if (!elements) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(elements);
+    PyObject **items = PySequence_Fast_ITEMS(elements);
+    if (count == 0) {
+        Py_DECREF(elements);
+        PyErr_SetString(PyExc_ValueError, "nothing to aggregate");
+        return NULL;
+    }
+    *valid = 1;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        int status = BlsScheme_check(scheme, items[i], group, validate);
+        if (status < 0) {
+            Py_DECREF(elements);
+            return NULL;
+        }
+        *valid = *valid && status;
+    }
+    element_t product;
+    element_init(product, Pairing_field(scheme->pairing, group));
+    Py_BEGIN_ALLOW_THREADS
+    element_set(product, ((Element *)items[0])->pbc_element);
+    for (Py_ssize_t i = 1; i < count; i++) {
+        element_mul(product, product, ((Element *)items[i])->pbc_element);
+    }
+    Py_END_ALLOW_THREADS
+    PyObject *result = BlsScheme_element(scheme, product);
+    element_clear(product);
+    Py_DECREF(elements);
+    return result;
+}
+
+PyObject *BlsScheme_aggregate(PyObject *py_scheme, PyObject *py_signatures) {
+    // cast the argument
+    BlsScheme *scheme = (BlsScheme *)py_scheme;
+    // aggregation does not check the subgroup, verification does
+    int valid;
+    return BlsScheme_product(scheme, py_signatures, G1, 0, &valid);
+}
+
+// check that the pairings of the hashes of the messages, raised to the coefficients if any,
+// with the public keys multiply to the pairing of the signature with the generator, all in
+// one multi-pairing with the GIL released
+static PyObject *BlsScheme_check_pairings(BlsScheme *scheme, element_ptr signature, PyObject **pks, PyObject **msgs, mpz_t *coefficients, Py_ssize_t count) {
+    element_t *in1 = PyMem_Malloc((count + 1) * sizeof(element_t));
+    element_t *in2 = PyMem_Malloc((count + 1) * sizeof(element_t));
+    if (!in1 || !in2) {
+        PyMem_Free(in1);
+        PyMem_Free(in2);
+        return PyErr_NoMemory();
+    }
+    // the arguments in G2 and the signature are only read, so they are shared with their elements
+    in1[0][0] = *signature;
+    in2[0][0] = *scheme->neg_generator;
+    Py_ssize_t hashed = 0;
+    int failed = 0;
+    while (hashed < count && !failed) {
+        element_init_G1(in1[hashed + 1], scheme->pairing->pbc_pairing);
+        in2[hashed + 1][0] = *((Element *)pks[hashed])->pbc_element;
+        failed = BlsScheme_hash(scheme, msgs[hashed], in1[hashed + 1]) < 0;
+        hashed++;
+    }
+    int valid = 0;
+    if (!failed) {
+        element_t product;
+        element_init_GT(product, scheme->pairing->pbc_pairing);
+        Py_BEGIN_ALLOW_THREADS
+        if (coefficients) {
+            for (Py_ssize_t i = 0; i < count; i++) {
+                element_pow_mpz(in1[i + 1], in1[i + 1], coefficients[i]);
+            }
+        }
+        prod_pairing_nonzero(product, in1, in2, count + 1, scheme->pairing->pbc_pairing);
+        valid = element_is1(product);
+        Py_END_ALLOW_THREADS
+        element_clear(product);
+    }
+    for (Py_ssize_t i = 1; i <= hashed; i++) {
+        element_clear(in1[i]);
+    }
+    PyMem_Free(in1);
+    PyMem_Free(in2);
+    if (failed) {
+        return NULL;
+    }
+    return PyBool_FromLong(valid);
+}
+
+PyObject *BlsScheme_verify(PyObject *py_scheme, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect a public key, a message and a signature
+    if (nargs != 3) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected a public key, a message and a signature");
+        return NULL;
+    }
+    PyObject *py_pk = args[0];
+    PyObject *py_msg = args[1];
+    PyObject *py_sig = args[2];
+    // cast the argument
+    BlsScheme *scheme = (BlsScheme *)py_scheme;
+    int pk_valid = BlsScheme_check(scheme, py_pk, G2, scheme->validate);
+    int sig_valid = pk_valid < 0 ? -1 : BlsScheme_check(scheme, py_sig, G1, scheme->validate);
+    if (pk_valid < 0 || sig_valid < 0) {
+        return NULL;
+    }
+    if (!pk_valid || !sig_valid) {
+        Py_RETURN_FALSE;
+    }
+    return BlsScheme_check_pairings(scheme, ((Element *)py_sig)->pbc_element, &py_pk, &py_msg, NULL, 1);
+}
+
+PyObject *BlsScheme_fast_aggregate_verify(PyObject *py_scheme, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect the public keys, the shared message and the aggregate signature
+    if (nargs != 3) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected public keys, a message and a signature");
+        return NULL;
+    }
+    PyObject *py_pks = args[0];
+    PyObject *py_msg = args[1];
+    PyObject *py_sig = args[2];
+    // cast the argument
+    BlsScheme *scheme = (BlsScheme *)py_scheme;
+    int sig_valid = BlsScheme_check(scheme, py_sig, G1, scheme->validate);
+    if (sig_valid < 0) {
+        return NULL;
+    }
+    // the keys are aggregated into one, which all sign the same message; keys that cancel
+    // each other out aggregate to the identity, which is rejected like an identity key
+    int pks_valid;
+    PyObject *py_pk = BlsScheme_product(scheme, py_pks, G2, scheme->validate, &pks_valid);
+    if (!py_pk) {
+        return NULL;
+    }
+    pks_valid = pks_valid && !element_is0(((Element *)py_pk)->pbc_element);
+    PyObject *result = sig_valid && pks_valid ? BlsScheme_check_pairings(scheme, ((Element *)py_sig)->pbc_element, &py_pk, &py_msg, NULL, 1) : Py_NewRef(Py_False);
+    Py_DECREF(py_pk);
+    return result;
+}
+
+// get the public keys and the messages of an aggregate, checking the keys and that there are
+// as many messages; returns 0 if a key fails the subgroup check
+static int BlsScheme_collect(BlsScheme *scheme, PyObject *py_pks, PyObject *py_msgs, PyObject **pks, PyObject **msgs) {
+    *pks = PySequence_Fast(py_pks, "the public keys must be a sequence of Elements");
+    *msgs = *pks ? PySequence_Fast(py_msgs, "the messages must be a sequence of bytes") : NULL;
+    if (!*msgs) {
+        return -1;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(*pks);
+    if (count == 0 || count != PySequence_Fast_GET_SIZE(*msgs)) {
+        PyErr_SetString(PyExc_ValueError, "there must be as many messages as public keys, and at least one");
+        return -1;
+    }
+    int valid = 1;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        int status = BlsScheme_check(scheme, PySequence_Fast_GET_ITEM(*pks, i), G2, scheme->validate);
+        if (status < 0) {
+            return -1;
+        }
+        valid = valid && status;
+    }
+    return valid;
+}
+
+PyObject *BlsScheme_aggregate_verify(PyObject *py_scheme, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect the public keys, their messages and the aggregate signature
+    if (nargs != 3) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected public keys, messages and a signature");
+        return NULL;
+    }
+    PyObject *py_pks = args[0];
+    PyObject *py_msgs = args[1];
+    PyObject *py_sig = args[2];
+    // cast the argument
+    BlsScheme *scheme = (BlsScheme *)py_scheme;
+    PyObject *pks = NULL;
+    PyObject *msgs = NULL;
+    PyObject *result = NULL;
+    int valid = BlsScheme_collect(scheme, py_pks, py_msgs, &pks, &msgs);
+    int sig_valid = valid < 0 ? -1 : BlsScheme_check(scheme, py_sig, G1, scheme->validate);
+    // the messages must be distinct, or a key could be made to cancel another one
+    PyObject *distinct = sig_valid < 0 ? NULL : PySet_New(msgs);
+    if (distinct) {
+        if (!valid || !sig_valid || PySet_GET_SIZE(distinct) != PySequence_Fast_GET_SIZE(msgs)) {
+            result = Py_NewRef(Py_False);
+        } else {
+            result = BlsScheme_check_pairings(scheme, ((Element *)py_sig)->pbc_element, PySequence_Fast_ITEMS(pks), PySequence_Fast_ITEMS(msgs), NULL, PySequence_Fast_GET_SIZE(pks));
+        }
+        Py_DECREF(distinct);
+    }
+    Py_XDECREF(pks);
+    Py_XDECREF(msgs);
+    return result;
+}
+
+PyObject *BlsScheme_batch_verify(PyObject *py_scheme, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect the public keys, the messages and the signatures of independent signatures
+    if (nargs != 3) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected public keys, messages and signatures");
+        return NULL;
+    }
+    PyObject *py_pks = args[0];
+    PyObject *py_msgs = args[1];
+    PyObject *py_sigs = args[2];
+    // cast the argument
+    BlsScheme *scheme = (BlsScheme *)py_scheme;
+    PyObject *pks = NULL;
+    PyObject *msgs = NULL;
+    PyObject *sigs = NULL;
+    PyObject *result = NULL;
+    int valid = BlsScheme_collect(scheme, py_pks, py_msgs, &pks, &msgs);
+    if (valid >= 0) {
+        sigs = PySequence_Fast(py_sigs, "the signatures must be a sequence of Elements");
+    }
+    if (sigs && PySequence_Fast_GET_SIZE(sigs) != PySequence_Fast_GET_SIZE(pks)) {
+        PyErr_SetString(PyExc_ValueError, "there must be as many signatures as public keys");
+        Py_CLEAR(sigs);
+    }
+    Py_ssize_t count = sigs ? PySequence_Fast_GET_SIZE(sigs) : 0;
+    for (Py_ssize_t i = 0; i < count && valid >= 0; i++) {
+        int status = BlsScheme_check(scheme, PySequence_Fast_GET_ITEM(sigs, i), G1, scheme->validate);
+        valid = status < 0 ? -1 : valid && status;
+    }
+    if (sigs && valid == 0) {
+        result = Py_NewRef(Py_False);
+    } else if (sigs && valid > 0) {
+        // the signatures are combined with small random coefficients, so that invalid ones
+        // cannot cancel each other out, and their combination is one multi-exponentiation
+        element_ptr *bases = PyMem_Malloc(count * sizeof(element_ptr));
+        mpz_t *coefficients = PyMem_Malloc(count * sizeof(mpz_t));
+        if (!bases || !coefficients) {
+            PyMem_Free(bases);
+            PyMem_Free(coefficients);
+            result = PyErr_NoMemory();
+        } else {
+            for (Py_ssize_t i = 0; i < count; i++) {
+                bases[i] = ((Element *)PySequence_Fast_GET_ITEM(sigs, i))->pbc_element;
+                mpz_init(coefficients[i]);
+                do {
+                    pbc_mpz_randomb(coefficients[i], BLS_BATCH_BITS);
+                } while (mpz_sgn(coefficients[i]) == 0);
+            }
+            element_t combined;
+            element_init_G1(combined, scheme->pairing->pbc_pairing);
+            Tuning tuning;
+            tuning_load(&tuning, &scheme->pairing->tuning);
+            Py_BEGIN_ALLOW_THREADS
+            Expr_multi_pow(combined, bases, coefficients, count, tuning.multi_pow_window);
+            Py_END_ALLOW_THREADS
+            result = BlsScheme_check_pairings(scheme, combined, PySequence_Fast_ITEMS(pks), PySequence_Fast_ITEMS(msgs), coefficients, count);
+            element_clear(combined);
+            for (Py_ssize_t i = 0; i < count; i++) {
+                mpz_clear(coefficients[i]);
+            }
+            PyMem_Free(bases);
+            PyMem_Free(coefficients);
+        }
+    }
+    Py_XDECREF(pks);
+    Py_XDECREF(msgs);
+    Py_XDECREF(sigs);
+    return result;
+}
+
+PyMemberDef BlsScheme_members[] = {
+    {"generator", T_OBJECT_EX, offsetof(BlsScheme, generator), READONLY, "The generator of G2 the public keys are powers of."},
+    {NULL},
+};
+
+PyMethodDef BlsScheme_methods[] = {
+    {"keygen", (PyCFunction)BlsScheme_keygen, METH_NOARGS, "Returns a random secret key and its public key."},
+    {"public_key", (PyCFunction)BlsScheme_public_key, METH_O, "Returns the public key of a secret key."},
+    {"sign", (PyCFunction)(void (*)(void))BlsScheme_sign, METH_FASTCALL, "Signs a message with a secret key."},
+    {"verify", (PyCFunction)(void (*)(void))BlsScheme_verify, METH_FASTCALL, "Verifies the signature of a message under a public key."},
+    {"aggregate", (PyCFunction)BlsScheme_aggregate, METH_O, "Aggregates signatures into one."},
+    {"fast_aggregate_verify", (PyCFunction)(void (*)(void))BlsScheme_fast_aggregate_verify, METH_FASTCALL, "Verifies an aggregate signature of one message under several public keys."},
+    {"aggregate_verify", (PyCFunction)(void (*)(void))BlsScheme_aggregate_verify, METH_FASTCALL, "Verifies an aggregate signature of distinct messages, one per public key."},
+    {"batch_verify", (PyCFunction)(void (*)(void))BlsScheme_batch_verify, METH_FASTCALL, "Verifies many independent signatures at once."},
+    {NULL},
+};
+
+PyType_Slot BlsScheme_slots[] = {
+    {Py_tp_dealloc, BlsScheme_dealloc},
+    {Py_tp_doc, (void *)BlsScheme__doc__},
+    {Py_tp_methods, BlsScheme_methods},
+    {Py_tp_members, BlsScheme_members},
+    {Py_tp_new, BlsScheme_new},
+    {0, NULL},
+};
+
+PyType_Spec BlsScheme_spec = {
+    "pypbc.bls.Scheme",                                                  /* name */
+    sizeof(BlsScheme),                                                   /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    BlsScheme_slots,                                                     /* slots */
+};
+
+// the submodule holding the scheme, also registered in sys.modules so that it can be imported
+static int bls_add(PyObject *module, ModuleState *state) {
+    PyObject *bls = PyModule_New("pypbc.bls");
+    if (!bls) {
+        return -1;
+    }
+    PyObject *dst = PyBytes_FromString(BLS_DEFAULT_DST);
+    int status = -1;
+    if (dst &&
+        PyModule_SetDocString(bls, bls__doc__) == 0 &&
+        PyModule_AddType(bls, state->BlsSchemeType) == 0 &&
+        PyModule_AddObjectRef(bls, "DEFAULT_DST", dst) == 0 &&
+        PyModule_AddObjectRef(module, "bls", bls) == 0 &&
+        PyDict_SetItemString(PyImport_GetModuleDict(), "pypbc.bls", bls) == 0) {
+        status = 0;
+    }
+    Py_XDECREF(dst);
+    Py_DECREF(bls);
+    return status;
+}
+
+/*******************************************************************************
+*                                Secret Sharing                                *
+*******************************************************************************/
+
+PyDoc_STRVAR(VssScheme__doc__,
+    "Feldman or Pedersen verifiable secret sharing in G1, G2 or GT.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "Scheme(pairing: Pairing, generator: Element, blinding_generator: Element | None = None) -> Scheme\n"
+    "\n"
+    "Without a blinding generator the commitments are Feldman's g^a_j, with one\n"
+    "they are Pedersen's g^a_j h^b_j. Shares are checked against the commitments\n"
+    "with a single multi-exponentiation computed with the GIL released.");
+
+PyDoc_STRVAR(vss__doc__,
+    "Native Feldman and Pedersen verifiable secret sharing, with batch verification.");
+
+// the bits of the random coefficients of batch verification
+#define VSS_BATCH_BITS 64
+
+VssScheme *VssScheme_create(PyTypeObject *type) {
+    // allocate the object
+    VssScheme *scheme = (VssScheme *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!scheme) {
+        PyErr_SetString(PyExc_TypeError, "could not create Scheme object");
+        return NULL;
+    }
+    // set the ready flag to 0
+    scheme->ready = 0;
+    return scheme;
+}
+
+PyObject *VssScheme_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    // required arguments are the pairing and the generator, the blinding generator is optional
+    static char *keywords[] = {"pairing", "generator", "blinding_generator", NULL};
+    PyObject *py_pairing;
+    PyObject *py_generator;
+    PyObject *py_blinding = Py_None;
+    ModuleState *state = pypbc_state(type);
+    if (!state) {
+        return NULL;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O!|O", keywords, state->PairingType, &py_pairing, state->ElementType, &py_generator, &py_blinding)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, generator and an optional blinding generator");
+        return NULL;
+    }
+    // cast the arguments
     Pairing *pairing = (Pairing *)py_pairing;
-    // build the result element and initialize it with the pairing and group
-    Element *element = Element_create();
-    switch (group) {
-    case G1: element_init_G1(element->pbc_element, pairing->pbc_pairing); break;
-    case G2: element_init_G2(element->pbc_element, pairing->pbc_pairing); break;
-    case GT: element_init_GT(element->pbc_element, pairing->pbc_pairing); break;
-    case Zr: element_init_Zr(element->pbc_element, pairing->pbc_pairing); break;
-    default: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "invalid group"); return NULL;
+    Element *generator = (Element *)py_generator;
+    field_ptr field = generator->pbc_element->field;
+    if (generator->pairing != pairing || field == pairing->pbc_pairing->Zr || element_is1(generator->pbc_element)) {
+        PyErr_SetString(PyExc_ValueError, "the generator must be an Element of G1, G2 or GT of the pairing other than 1");
+        return NULL;
+    }
+    if (py_blinding != Py_None) {
+        Element *blinding = (Element *)py_blinding;
+        if (!PyObject_TypeCheck(py_blinding, state->ElementType) || blinding->pairing != pairing || blinding->pbc_element->field != field ||
+            element_is1(blinding->pbc_element) || element_cmp(blinding->pbc_element, generator->pbc_element) == 0) {
+            PyErr_SetString(PyExc_ValueError, "the blinding generator must be another Element of the group of the generator other than 1");
+            return NULL;
+        }
+    }
+    // create the object
+    VssScheme *scheme = VssScheme_create(type);
+    if (!scheme) {
+        return NULL;
+    }
+    scheme->pairing = pairing;
+    scheme->field = field;
+    scheme->generator = py_generator;
+    scheme->blinding = py_blinding != Py_None ? py_blinding : NULL;
+    Py_INCREF(pairing);
+    Py_INCREF(py_generator);
+    Py_XINCREF(scheme->blinding);
+    // both generators get fixed-base tables, for commitments
+    scheme->table = PyObject_CallFunctionObjArgs((PyObject *)state->FixedBaseType, py_generator, NULL);
+    if (!scheme->table) {
+        Py_DECREF(scheme);
+        return NULL;
+    }
+    if (scheme->blinding) {
+        scheme->blinding_table = PyObject_CallFunctionObjArgs((PyObject *)state->FixedBaseType, scheme->blinding, NULL);
+        if (!scheme->blinding_table) {
+            Py_DECREF(scheme);
+            return NULL;
+        }
+    }
+    scheme->ready = 1;
+    return (PyObject *)scheme;
+}
+
+void VssScheme_dealloc(VssScheme *scheme) {
+    Py_XDECREF(scheme->blinding_table);
+    Py_XDECREF(scheme->table);
+    Py_XDECREF(scheme->blinding);
+    Py_XDECREF(scheme->generator);
+    Py_XDECREF(scheme->pairing);
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(scheme);
+    type->tp_free((PyObject *)scheme);
+    Py_DECREF(type);
+}
+
+// the commitments as a fast sequence, checking that they are Elements of the group of the scheme
+PyObject *VssScheme_commitments(VssScheme *scheme, PyObject *py_commitments) {
+    PyObject *commitments = PySequence_Fast(py_commitments, "the commitments must be a sequence of Elements");
+    if (!commitments) {
+        return NULL;
+    }
+    if (PySequence_Fast_GET_SIZE(commitments) == 0) {
+        Py_DECREF(commitments);
+        PyErr_SetString(PyExc_ValueError, "there must be at least one commitment");
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(commitments); i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(commitments, i);
+        if (!PyObject_TypeCheck(item, scheme->pairing->state->ElementType) || ((Element *)item)->pairing != scheme->pairing || ((Element *)item)->pbc_element->field != scheme->field) {
+            Py_DECREF(commitments);
+            PyErr_SetString(PyExc_TypeError, "the commitments must be Elements of the group of the generator");
+            return NULL;
+        }
+    }
+    return commitments;
+}
+
+// convert an index of a share, which must lie between 1 and the order
+int VssScheme_index(VssScheme *scheme, PyObject *py_index, mpz_t index) {
+    if (!PyLong_Check(py_index)) {
+        PyErr_SetString(PyExc_TypeError, "the indices must be integers");
+        return -1;
+    }
+    mpz_init_from_pynum(index, py_index);
+    if (mpz_sgn(index) <= 0 || mpz_cmp(index, scheme->pairing->pbc_pairing->r) >= 0) {
+        mpz_clear(index);
+        PyErr_SetString(PyExc_ValueError, "the indices must be positive and smaller than the order");
+        return -1;
+    }
+    return 0;
+}
+
+// check that the commitments raised to the exponents, times the generators raised to minus the
+// shares, multiply to 1, with one multi-exponentiation that needs no GIL
+int VssScheme_check(VssScheme *scheme, PyObject *commitments, mpz_t *exps, mpz_t share, mpz_t blinding_share) {
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(commitments);
+    Py_ssize_t total = count + 1 + (scheme->blinding ? 1 : 0);
+    element_ptr *bases = PyMem_Malloc(total * sizeof(element_ptr));
+    mpz_t *all = PyMem_Malloc(total * sizeof(mpz_t));
+    if (!bases || !all) {
+        PyMem_Free(bases);
+        PyMem_Free(all);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (Py_ssize_t j = 0; j < count; j++) {
+        bases[j] = ((Element *)PySequence_Fast_GET_ITEM(commitments, j))->pbc_element;
+        all[j][0] = exps[j][0];
+    }
+    // the generators are raised to r minus the shares
+    mpz_t *negated = all + count;
+    bases[count] = ((Element *)scheme->generator)->pbc_element;
+    mpz_init(negated[0]);
+    mpz_sub(negated[0], scheme->pairing->pbc_pairing->r, share);
+    if (scheme->blinding) {
+        bases[count + 1] = ((Element *)scheme->blinding)->pbc_element;
+        mpz_init(negated[1]);
+        mpz_sub(negated[1], scheme->pairing->pbc_pairing->r, blinding_share);
+    }
+    element_t product;
+    element_init(product, scheme->field);
+    int result;
+    Tuning tuning;
+    tuning_load(&tuning, &scheme->pairing->tuning);
+    Py_BEGIN_ALLOW_THREADS
+    Expr_multi_pow(product, bases, all, total, tuning.multi_pow_window);
+    result = element_is1(product);
+    Py_END_ALLOW_THREADS
+    element_clear(product);
+    for (Py_ssize_t j = count; j < total; j++) {
+        mpz_clear(all[j]);
+    }
+    PyMem_Free(bases);
+    PyMem_Free(all);
+    return result;
+}
+
+PyObject *VssScheme_sample(PyObject *py_scheme, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required argument is the threshold, the secret is optional
+    static const char *const keywords[] = {"threshold", "secret", NULL};
+    PyObject *slots[2];
+    Py_ssize_t threshold;
+    if (args_bind(args, nargs, kwnames, keywords, 1, slots) < 0 || args_ssize(slots[0], &threshold) < 0) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected a threshold and an optional secret");
+        return NULL;
+    }
+    if (threshold < 1) {
+        PyErr_SetString(PyExc_ValueError, "the threshold must be positive");
+        return NULL;
+    }
+    // cast the argument
+    VssScheme *scheme = (VssScheme *)py_scheme;
+    mpz_t secret;
+    mpz_init(secret);
+    if (slots[1] && slots[1] != Py_None && Pairing_exponent_to_mpz(scheme->pairing, secret, slots[1]) < 0) {
+        mpz_clear(secret);
+        return NULL;
+    }
+    element_ptr *outs = PyMem_Malloc(threshold * sizeof(element_ptr));
+    PyObject *list = outs ? Pairing_element_list(scheme->pairing, scheme->pairing->pbc_pairing->Zr, threshold, outs) : PyErr_NoMemory();
+    if (list) {
+        // the coefficients are random, except the constant one if the secret is given
+        for (Py_ssize_t j = 0; j < threshold; j++) {
+            element_random(outs[j]);
+        }
+        if (slots[1] && slots[1] != Py_None) {
+            mpz_mod(secret, secret, scheme->pairing->pbc_pairing->r);
+            element_set_mpz(outs[0], secret);
+        }
+    }
+    PyMem_Free(outs);
+    mpz_clear(secret);
+    return list;
+}
+
+PyObject *VssScheme_shares(PyObject *py_scheme, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect the coefficients and the number of shares
+    Py_ssize_t count;
+    if (nargs != 2 || args_ssize(args[1], &count) < 0) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected coefficients and a number of shares");
+        return NULL;
+    }
+    // cast the argument
+    VssScheme *scheme = (VssScheme *)py_scheme;
+    if (count < 1 || mpz_cmp_ui(scheme->pairing->pbc_pairing->r, (unsigned long)count) <= 0) {
+        PyErr_SetString(PyExc_ValueError, "the number of shares must be positive and smaller than the order");
+        return NULL;
+    }
+    Py_ssize_t degree;
+    mpz_t *coefficients = Pairing_scalars(scheme->pairing, args[0], &degree);
+    if (!coefficients) {
+        return NULL;
+    }
+    if (degree == 0) {
+        mpz_array_free(coefficients, degree);
+        PyErr_SetString(PyExc_ValueError, "there must be at least one coefficient");
+        return NULL;
+    }
+    element_ptr *outs = PyMem_Malloc(count * sizeof(element_ptr));
+    PyObject *list = outs ? Pairing_element_list(scheme->pairing, scheme->pairing->pbc_pairing->Zr, count, outs) : PyErr_NoMemory();
+    if (list) {
+        // the share of index i is the polynomial at i, evaluated with Horner's rule
+        Py_BEGIN_ALLOW_THREADS
+        mpz_t value;
+        mpz_init(value);
+        for (Py_ssize_t i = 0; i < count; i++) {
+            mpz_set_ui(value, 0);
+            for (Py_ssize_t j = degree; j-- > 0;) {
+                mpz_mul_ui(value, value, (unsigned long)(i + 1));
+                mpz_add(value, value, coefficients[j]);
+                mpz_mod(value, value, scheme->pairing->pbc_pairing->r);
+            }
+            element_set_mpz(outs[i], value);
+        }
+        mpz_clear(value);
+        Py_END_ALLOW_THREADS
+    }
+    PyMem_Free(outs);
+    mpz_array_free(coefficients, degree);
+    return list;
+}
+
+PyObject *VssScheme_commit(PyObject *py_scheme, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required argument is the coefficients, the blinding coefficients are for Pedersen commitments
+    static const char *const keywords[] = {"coefficients", "blinding", NULL};
+    PyObject *slots[2];
+    if (args_bind(args, nargs, kwnames, keywords, 1, slots) < 0) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected coefficients and optional blinding coefficients");
+        return NULL;
+    }
+    // cast the argument
+    VssScheme *scheme = (VssScheme *)py_scheme;
+    int pedersen = slots[1] && slots[1] != Py_None;
+    if (pedersen != (scheme->blinding != NULL)) {
+        PyErr_SetString(PyExc_ValueError, scheme->blinding ? "Pedersen commitments need blinding coefficients" : "Feldman commitments take no blinding coefficients");
+        return NULL;
+    }
+    Py_ssize_t degree;
+    Py_ssize_t blinding_degree = 0;
+    mpz_t *coefficients = Pairing_scalars(scheme->pairing, slots[0], &degree);
+    mpz_t *blinding = NULL;
+    if (!coefficients) {
+        return NULL;
+    }
+    if (pedersen) {
+        blinding = Pairing_scalars(scheme->pairing, slots[1], &blinding_degree);
+        if (!blinding) {
+            mpz_array_free(coefficients, degree);
+            return NULL;
+        }
+        if (blinding_degree != degree) {
+            mpz_array_free(coefficients, degree);
+            mpz_array_free(blinding, blinding_degree);
+            PyErr_SetString(PyExc_ValueError, "there must be as many blinding coefficients as coefficients");
+            return NULL;
+        }
+    }
+    element_ptr *outs = PyMem_Malloc((degree ? degree : 1) * sizeof(element_ptr));
+    PyObject *list = outs ? Pairing_element_list(scheme->pairing, scheme->field, degree, outs) : PyErr_NoMemory();
+    if (list) {
+        // every commitment is one or two fixed-base exponentiations
+        FixedBase *table = (FixedBase *)scheme->table;
+        FixedBase *blinding_table = (FixedBase *)scheme->blinding_table;
+        Py_BEGIN_ALLOW_THREADS
+        element_t power;
+        element_init(power, scheme->field);
+        for (Py_ssize_t j = 0; j < degree; j++) {
+            FixedBase_apply(table, outs[j], coefficients[j]);
+            if (pedersen) {
+                FixedBase_apply(blinding_table, power, blinding[j]);
+                element_mul(outs[j], outs[j], power);
+            }
+        }
+        element_clear(power);
+        Py_END_ALLOW_THREADS
+    }
+    PyMem_Free(outs);
+    mpz_array_free(coefficients, degree);
+    if (blinding) {
+        mpz_array_free(blinding, blinding_degree);
+    }
+    return list;
+}
+
+// convert the optional blinding share of a Pedersen scheme, which Feldman schemes do not take
+int VssScheme_blinding_share(VssScheme *scheme, PyObject *py_share, mpz_t share) {
+    int given = py_share && py_share != Py_None;
+    if (given != (scheme->blinding != NULL)) {
+        PyErr_SetString(PyExc_ValueError, scheme->blinding ? "Pedersen shares need their blinding shares" : "Feldman shares take no blinding shares");
+        return -1;
+    }
+    mpz_init(share);
+    if (given && Pairing_exponent_to_mpz(scheme->pairing, share, py_share) < 0) {
+        mpz_clear(share);
+        return -1;
+    }
+    mpz_mod(share, share, scheme->pairing->pbc_pairing->r);
+    return 0;
+}
+
+PyObject *VssScheme_verify(PyObject *py_scheme, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required arguments are the index, the share and the commitments, the blinding share is for Pedersen schemes
+    static const char *const keywords[] = {"index", "share", "commitments", "blinding_share", NULL};
+    PyObject *slots[4];
+    if (args_bind(args, nargs, kwnames, keywords, 3, slots) < 0) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected an index, a share, commitments and an optional blinding share");
+        return NULL;
+    }
+    // cast the argument
+    VssScheme *scheme = (VssScheme *)py_scheme;
+    mpz_ptr r = scheme->pairing->pbc_pairing->r;
+    mpz_t index;
+    if (VssScheme_index(scheme, slots[0], index) < 0) {
+        return NULL;
+    }
+    mpz_t share;
+    mpz_init(share);
+    if (Pairing_exponent_to_mpz(scheme->pairing, share, slots[1]) < 0) {
+        mpz_clear(share);
+        mpz_clear(index);
+        return NULL;
+    }
+    mpz_mod(share, share, r);
+    mpz_t blinding_share;
+    if (VssScheme_blinding_share(scheme, slots[3], blinding_share) < 0) {
+        mpz_clear(share);
+        mpz_clear(index);
+        return NULL;
+    }
+    PyObject *commitments = VssScheme_commitments(scheme, slots[2]);
+    PyObject *result = NULL;
+    if (commitments) {
+        // the commitment of degree j is raised to the index to the j
+        Py_ssize_t count = PySequence_Fast_GET_SIZE(commitments);
+        mpz_t *exps = PyMem_Malloc(count * sizeof(mpz_t));
+        if (!exps) {
+            result = PyErr_NoMemory();
+        } else {
+            for (Py_ssize_t j = 0; j < count; j++) {
+                mpz_init(exps[j]);
+                if (j == 0) {
+                    mpz_set_ui(exps[j], 1);
+                } else {
+                    mpz_mul(exps[j], exps[j - 1], index);
+                    mpz_mod(exps[j], exps[j], r);
+                }
+            }
+            int valid = VssScheme_check(scheme, commitments, exps, share, blinding_share);
+            result = valid < 0 ? NULL : PyBool_FromLong(valid);
+            mpz_array_free(exps, count);
+        }
+        Py_DECREF(commitments);
+    }
+    mpz_clear(blinding_share);
+    mpz_clear(share);
+    mpz_clear(index);
+    return result;
+}
+
+PyObject *VssScheme_batch_verify(PyObject *py_scheme, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required arguments are the shares and the commitments of one dealer, the blinding shares are for
+    // Pedersen schemes, and the indices default to 1, 2, ...
+    static const char *const keywords[] = {"shares", "commitments", "blinding_shares", "indices", NULL};
+    PyObject *slots[4];
+    if (args_bind(args, nargs, kwnames, keywords, 2, slots) < 0) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected shares, commitments, optional blinding shares and optional indices");
+        return NULL;
+    }
+    // cast the argument
+    VssScheme *scheme = (VssScheme *)py_scheme;
+    mpz_ptr r = scheme->pairing->pbc_pairing->r;
+    int pedersen = slots[2] && slots[2] != Py_None;
+    if (pedersen != (scheme->blinding != NULL)) {
+        PyErr_SetString(PyExc_ValueError, scheme->blinding ? "Pedersen shares need their blinding shares" : "Feldman shares take no blinding shares");
+        return NULL;
+    }
+    Py_ssize_t count;
+    Py_ssize_t blinding_count = 0;
+    Py_ssize_t index_count = 0;
+    mpz_t *shares = Pairing_scalars(scheme->pairing, slots[0], &count);
+    mpz_t *blinding = NULL;
+    mpz_t *indices = NULL;
+    mpz_t *exps = NULL;
+    PyObject *commitments = NULL;
+    PyObject *result = NULL;
+    if (!shares) {
+        return NULL;
+    }
+    if (pedersen) {
+        blinding = Pairing_scalars(scheme->pairing, slots[2], &blinding_count);
+        if (!blinding) {
+            goto done;
+        }
+        if (blinding_count != count) {
+            PyErr_SetString(PyExc_ValueError, "there must be as many blinding shares as shares");
+            goto done;
+        }
+    }
+    // the indices are checked as in verify
+    indices = PyMem_Malloc((count ? count : 1) * sizeof(mpz_t));
+    if (!indices) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    if (slots[3] && slots[3] != Py_None) {
+        PyObject *py_indices = PySequence_Fast(slots[3], "the indices must be a sequence of integers");
+        if (!py_indices) {
+            goto done;
+        }
+        if (PySequence_Fast_GET_SIZE(py_indices) != count) {
+            Py_DECREF(py_indices);
+            PyErr_SetString(PyExc_ValueError, "there must be as many indices as shares");
+            goto done;
+        }
+        for (; index_count < count; index_count++) {
+            if (VssScheme_index(scheme, PySequence_Fast_GET_ITEM(py_indices, index_count), indices[index_count]) < 0) {
+                break;
+            }
+        }
+        Py_DECREF(py_indices);
+        if (index_count < count) {
+            goto done;
+        }
+    } else {
+        for (; index_count < count; index_count++) {
+            mpz_init_set_ui(indices[index_count], (unsigned long)(index_count + 1));
+        }
     }
-    element->pairing = pairing;
-    // set the element to 0
-    element_set0(element->pbc_element);
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(element->pairing);
-    element->ready = 1;
-    return (PyObject *)element;
+    commitments = VssScheme_commitments(scheme, slots[1]);
+    if (!commitments) {
+        goto done;
+    }
+    Py_ssize_t degree = PySequence_Fast_GET_SIZE(commitments);
+    exps = PyMem_Malloc(degree * sizeof(mpz_t));
+    if (!exps) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (Py_ssize_t j = 0; j < degree; j++) {
+        mpz_init(exps[j]);
+    }
+    // the shares are combined with small random coefficients rho_i, so that the check of all of
+    // them is the one of a single share: the commitment of degree j is raised to the sum of
+    // rho_i i^j, and the generators to the sums of rho_i times the shares
+    mpz_t sum;
+    mpz_t blinding_sum;
+    mpz_t rho;
+    mpz_t power;
+    mpz_init(sum);
+    mpz_init(blinding_sum);
+    mpz_init(rho);
+    mpz_init(power);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        do {
+            pbc_mpz_randomb(rho, VSS_BATCH_BITS);
+        } while (mpz_sgn(rho) == 0);
+        mpz_addmul(sum, rho, shares[i]);
+        if (pedersen) {
+            mpz_addmul(blinding_sum, rho, blinding[i]);
+        }
+        mpz_set(power, rho);
+        for (Py_ssize_t j = 0; j < degree; j++) {
+            mpz_add(exps[j], exps[j], power);
+            mpz_mul(power, power, indices[i]);
+            mpz_mod(power, power, r);
+        }
+    }
+    for (Py_ssize_t j = 0; j < degree; j++) {
+        mpz_mod(exps[j], exps[j], r);
+    }
+    mpz_mod(sum, sum, r);
+    mpz_mod(blinding_sum, blinding_sum, r);
+    int valid = VssScheme_check(scheme, commitments, exps, sum, blinding_sum);
+    result = valid < 0 ? NULL : PyBool_FromLong(valid);
+    mpz_clear(sum);
+    mpz_clear(blinding_sum);
+    mpz_clear(rho);
+    mpz_clear(power);
+done:
+    if (exps) {
+        mpz_array_free(exps, PySequence_Fast_GET_SIZE(commitments));
+    }
+    Py_XDECREF(commitments);
+    if (indices) {
+        mpz_array_free(indices, index_count);
+    }
+    if (blinding) {
+        mpz_array_free(blinding, blinding_count);
+    }
+    mpz_array_free(shares, count);
+    return result;
 }
 
-PyObject *Element_one(PyObject *cls, PyObject *args) {
-    // required arguments are the pairing and the group
-    PyObject *py_pairing;
-    enum Group group;
-    if (!PyArg_ParseTuple(args, "O!i", &PairingType, &py_pairing, &group)) {
-        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object and group");
-        return NULL;
+PyMemberDef VssScheme_members[] = {
+    {"generator", T_OBJECT_EX, offsetof(VssScheme, generator), READONLY, "The generator the coefficients are committed to."},
+    {"blinding_generator", T_OBJECT, offsetof(VssScheme, blinding), READONLY, "The generator of the blinding coefficients, or None for Feldman commitments."},
+    {NULL},
+};
+
+PyMethodDef VssScheme_methods[] = {
+    {"sample", (PyCFunction)(void (*)(void))VssScheme_sample, METH_FASTCALL | METH_KEYWORDS, "Returns the random coefficients of a polynomial for the threshold."},
+    {"shares", (PyCFunction)(void (*)(void))VssScheme_shares, METH_FASTCALL, "Returns the values of the polynomial at 1, 2, ..., count."},
+    {"commit", (PyCFunction)(void (*)(void))VssScheme_commit, METH_FASTCALL | METH_KEYWORDS, "Returns the commitments to the coefficients."},
+    {"verify", (PyCFunction)(void (*)(void))VssScheme_verify, METH_FASTCALL | METH_KEYWORDS, "Verifies a share against the commitments."},
+    {"batch_verify", (PyCFunction)(void (*)(void))VssScheme_batch_verify, METH_FASTCALL | METH_KEYWORDS, "Verifies many shares of one dealer at once."},
+    {NULL},
+};
+
+PyType_Slot VssScheme_slots[] = {
+    {Py_tp_dealloc, VssScheme_dealloc},
+    {Py_tp_doc, (void *)VssScheme__doc__},
+    {Py_tp_methods, VssScheme_methods},
+    {Py_tp_members, VssScheme_members},
+    {Py_tp_new, VssScheme_new},
+    {0, NULL},
+};
+
+PyType_Spec VssScheme_spec = {
+    "pypbc.vss.Scheme",                                                  /* name */
+    sizeof(VssScheme),                                                   /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    VssScheme_slots,                                                     /* slots */
+};
+
+// the submodule holding the scheme, also registered in sys.modules so that it can be imported
+static int vss_add(PyObject *module, ModuleState *state) {
+    PyObject *vss = PyModule_New("pypbc.vss");
+    if (!vss) {
+        return -1;
     }
-    // cast the arguments
-    Pairing *pairing = (Pairing *)py_pairing;
-    // build the result element and initialize it with the pairing and group
-    Element *element = Element_create();
-    switch (group) {
-    case G1: element_init_G1(element->pbc_element, pairing->pbc_pairing); break;
-    case G2: element_init_G2(element->pbc_element, pairing->pbc_pairing); break;
-    case GT: element_init_GT(element->pbc_element, pairing->pbc_pairing); break;
-    case Zr: element_init_Zr(element->pbc_element, pairing->pbc_pairing); break;
-    default: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "invalid group"); return NULL;
+    int status = -1;
+    if (PyModule_SetDocString(vss, vss__doc__) == 0 &&
+        PyModule_AddType(vss, state->VssSchemeType) == 0 &&
+        PyModule_AddObjectRef(module, "vss", vss) == 0 &&
+        PyDict_SetItemString(PyImport_GetModuleDict(), "pypbc.vss", vss) == 0) {
+        status = 0;
     }
-    element->pairing = pairing;
-    // set the element to 1
-    element_set1(element->pbc_element);
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(element->pairing);
-    element->ready = 1;
-    return (PyObject *)element;
+    Py_DECREF(vss);
+    return status;
 }
 
-PyObject *Element_random(PyObject *cls, PyObject *args) {
-    // required arguments are the pairing and the group
-    PyObject *py_pairing;
-    enum Group group;
-    if (!PyArg_ParseTuple(args, "O!i", &PairingType, &py_pairing, &group)) {
-        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object and group");
+/*******************************************************************************
+*                                     KZG                                      *
+*******************************************************************************/
+
+PyDoc_STRVAR(KzgSetup__doc__,
+    "KZG polynomial commitments over a structured reference string.\n"
+    "\n"
+    "Basic usage:\n"
+    "\n"
+    "Setup(pairing: Pairing, g1_powers: Sequence[Element] | bytes-like, g2_powers: Sequence[Element]) -> Setup\n"
+    "\n"
+    "The powers g^(tau^i) of G1 are kept packed, commitments are multi-scalar\n"
+    "multiplications spread over several threads, and every verification is a\n"
+    "single multi-pairing computed with the GIL released.");
+
+PyDoc_STRVAR(kzg__doc__,
+    "Native KZG polynomial commitments, with opening proofs and batch verification.");
+
+// the bits of the random coefficients of batch verification
+#define KZG_BATCH_BITS 64
+
+// the most threads a multi-scalar multiplication is split over
+#define MSM_MAX_THREADS 64
+
+// a share of a multi-scalar multiplication, the bases are decoded from packed records
+typedef struct {
+    field_ptr field;
+    const unsigned char *records;
+    int record_size;
+    mpz_t *scalars;
+    Py_ssize_t begin;
+    Py_ssize_t end;
+    element_t result;
+} MsmJob;
+
+// the product of the bases raised to the scalars with Pippenger's bucket method: each window
+// of c bits of the scalars sorts the bases into 2^c - 1 buckets by digit, and the buckets are
+// weighted by their digits with two running products
+static void *msm_job_run(void *arg) {
+    MsmJob *job = arg;
+    Py_ssize_t count = job->end - job->begin;
+    element_set1(job->result);
+    if (count <= 0) {
         return NULL;
     }
-    // cast the arguments
-    Pairing *pairing = (Pairing *)py_pairing;
-    // build the result element and initialize it with the pairing and group
-    Element *element = Element_create();
-    switch (group) {
-    case G1: element_init_G1(element->pbc_element, pairing->pbc_pairing); break;
-    case G2: element_init_G2(element->pbc_element, pairing->pbc_pairing); break;
-    case GT: element_init_GT(element->pbc_element, pairing->pbc_pairing); break;
-    case Zr: element_init_Zr(element->pbc_element, pairing->pbc_pairing); break;
-    default: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "invalid group"); return NULL;
+    // the window grows with the logarithm of the number of points
+    int c = 2;
+    while (c < 16 && ((Py_ssize_t)1 << (c + 2)) < count) {
+        c++;
     }
-    element->pairing = pairing;
-    // make the element random
-    element_random(element->pbc_element);
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(element->pairing);
-    element->ready = 1;
-    return (PyObject *)element;
+    int size = (1 << c) - 1;
+    element_t *bases = PyMem_RawMalloc(count * sizeof(element_t));
+    element_t *buckets = PyMem_RawMalloc(size * sizeof(element_t));
+    if (!bases || !buckets) {
+        // without memory for buckets, fall back to one exponentiation per point
+        PyMem_RawFree(bases);
+        PyMem_RawFree(buckets);
+        element_t base;
+        element_init(base, job->field);
+        for (Py_ssize_t i = job->begin; i < job->end; i++) {
+            element_from_bytes(base, (unsigned char *)job->records + (size_t)i * job->record_size);
+            element_pow_mpz(base, base, job->scalars[i]);
+            element_mul(job->result, job->result, base);
+        }
+        element_clear(base);
+        return NULL;
+    }
+    size_t bits = 0;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        element_init(bases[i], job->field);
+        element_from_bytes(bases[i], (unsigned char *)job->records + (size_t)(job->begin + i) * job->record_size);
+        size_t length = mpz_sizeinbase(job->scalars[job->begin + i], 2);
+        if (length > bits) {
+            bits = length;
+        }
+    }
+    for (int d = 0; d < size; d++) {
+        element_init(buckets[d], job->field);
+    }
+    element_t running;
+    element_t sum;
+    element_init(running, job->field);
+    element_init(sum, job->field);
+    for (size_t window = (bits + c - 1) / c; window-- > 0;) {
+        for (int k = 0; k < c; k++) {
+            element_square(job->result, job->result);
+        }
+        for (int d = 0; d < size; d++) {
+            element_set1(buckets[d]);
+        }
+        for (Py_ssize_t i = 0; i < count; i++) {
+            int digit = 0;
+            for (int k = c - 1; k >= 0; k--) {
+                digit = digit << 1 | mpz_tstbit(job->scalars[job->begin + i], window * c + k);
+            }
+            if (digit) {
+                element_mul(buckets[digit - 1], buckets[digit - 1], bases[i]);
+            }
+        }
+        // the bucket of digit d ends up in d of the running products
+        element_set1(running);
+        element_set1(sum);
+        for (int d = size; d-- > 0;) {
+            element_mul(running, running, buckets[d]);
+            element_mul(sum, sum, running);
+        }
+        element_mul(job->result, job->result, sum);
+    }
+    element_clear(running);
+    element_clear(sum);
+    for (int d = 0; d < size; d++) {
+        element_clear(buckets[d]);
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        element_clear(bases[i]);
+    }
+    PyMem_RawFree(buckets);
+    PyMem_RawFree(bases);
+    return NULL;
 }
 
-PyObject *Element_from_hash(PyObject *cls, PyObject *args) {
-    // required arguments are the pairing and the group
-    PyObject *py_pairing;
-    enum Group group;
-    PyObject *py_bytes;
-    if (!PyArg_ParseTuple(args, "O!iO!", &PairingType, &py_pairing, &group, &PyBytes_Type, &py_bytes)) {
-        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, group, and bytes");
-        return NULL;
+// the product of the packed bases raised to the scalars with Straus' method, -1 when out of memory
+static int msm_straus(element_ptr out, const unsigned char *records, int record_size, mpz_t *scalars, Py_ssize_t count, int window) {
+    element_t *bases = PyMem_RawMalloc((count ? count : 1) * sizeof(element_t));
+    element_ptr *ptrs = PyMem_RawMalloc((count ? count : 1) * sizeof(element_ptr));
+    if (!bases || !ptrs) {
+        PyMem_RawFree(bases);
+        PyMem_RawFree(ptrs);
+        return -1;
     }
-    // cast the arguments
-    Pairing *pairing = (Pairing *)py_pairing;
-    // build the result element and initialize it with the pairing and group
-    Element *element = Element_create();
-    switch (group) {
-    case G1: element_init_G1(element->pbc_element, pairing->pbc_pairing); break;
-    case G2: element_init_G2(element->pbc_element, pairing->pbc_pairing); break;
-    case GT: element_init_GT(element->pbc_element, pairing->pbc_pairing); break;
-    case Zr: element_init_Zr(element->pbc_element, pairing->pbc_pairing); break;
-    default: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "invalid group"); return NULL;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        element_init_same_as(bases[i], out);
+        element_from_bytes(bases[i], (unsigned char *)records + (size_t)i * record_size);
+        ptrs[i] = bases[i];
     }
-    element->pairing = pairing;
-    // convert the bytes to an element
-    int size = PyBytes_Size(py_bytes);
-    unsigned char *bytes = (unsigned char *)PyBytes_AsString(py_bytes);
-    element_from_hash(element->pbc_element, bytes, size);
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(element->pairing);
-    element->ready = 1;
-    return (PyObject *)element;
+    Expr_multi_pow(out, ptrs, scalars, count, window);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        element_clear(bases[i]);
+    }
+    PyMem_RawFree(bases);
+    PyMem_RawFree(ptrs);
+    return 0;
 }
 
-PyObject *Element_from_bytes(PyObject *cls, PyObject *args) {
-    // required arguments are the pairing and the group
-    PyObject *py_pairing;
-    enum Group group;
-    PyObject *py_bytes;
-    if (!PyArg_ParseTuple(args, "O!iO!", &PairingType, &py_pairing, &group, &PyBytes_Type, &py_bytes)) {
-        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, group, and bytes");
-        return NULL;
+// the product of the packed bases raised to the scalars, which are reduced modulo the order:
+// few points take Straus' method, more are split over threads that each run Pippenger's on
+// a share of the points; needs no GIL
+void msm_packed(element_ptr out, const unsigned char *records, int record_size, mpz_t *scalars, Py_ssize_t count, const Tuning *tuning) {
+    if (count < tuning->msm_crossover && msm_straus(out, records, record_size, scalars, count, tuning->multi_pow_window) == 0) {
+        return;
     }
-    // cast the arguments
-    Pairing *pairing = (Pairing *)py_pairing;
-    // build the result element and initialize it with the pairing and group
-    Element *element = Element_create();
-    switch (group) {
-    case G1: element_init_G1(element->pbc_element, pairing->pbc_pairing); break;
-    case G2: element_init_G2(element->pbc_element, pairing->pbc_pairing); break;
-    case GT: element_init_GT(element->pbc_element, pairing->pbc_pairing); break;
-    case Zr: element_init_Zr(element->pbc_element, pairing->pbc_pairing); break;
-    default: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "invalid group"); return NULL;
+    MsmJob jobs[MSM_MAX_THREADS];
+    pthread_t ids[MSM_MAX_THREADS];
+    int started[MSM_MAX_THREADS] = {0};
+    int threads = tuning_threads(tuning, count);
+    if (threads > MSM_MAX_THREADS) {
+        threads = MSM_MAX_THREADS;
     }
-    element->pairing = pairing;
-    // check the size of the bytes
-    if (PyBytes_Size(py_bytes) != element_length_in_bytes(element->pbc_element)) {
-        Py_DECREF(element);
-        PyErr_SetString(PyExc_ValueError, "invalid number of bytes");
-        return NULL;
+    // split the points evenly, and run the first share on the calling thread
+    for (int k = 0; k < threads; k++) {
+        jobs[k].field = out->field;
+        jobs[k].records = records;
+        jobs[k].record_size = record_size;
+        jobs[k].scalars = scalars;
+        jobs[k].begin = count * k / threads;
+        jobs[k].end = count * (k + 1) / threads;
+        element_init(jobs[k].result, out->field);
+    }
+    for (int k = 1; k < threads; k++) {
+        started[k] = pthread_create(&ids[k], NULL, msm_job_run, &jobs[k]) == 0;
+    }
+    msm_job_run(&jobs[0]);
+    element_set(out, jobs[0].result);
+    for (int k = 1; k < threads; k++) {
+        if (started[k]) {
+            pthread_join(ids[k], NULL);
+        } else {
+            msm_job_run(&jobs[k]);
+        }
+        element_mul(out, out, jobs[k].result);
+    }
+    for (int k = 0; k < threads; k++) {
+        element_clear(jobs[k].result);
     }
-    // convert the bytes to an element
-    unsigned char *bytes = (unsigned char *)PyBytes_AsString(py_bytes);
-    element_from_bytes(element->pbc_element, bytes);
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(element->pairing);
-    element->ready = 1;
-    return (PyObject *)element;
 }
 
-PyObject *Element_from_bytes_compressed(PyObject *cls, PyObject *args) {
-    // required arguments are the pairing and the group
-    PyObject *py_pairing;
-    enum Group group;
-    PyObject *py_bytes;
-    if (!PyArg_ParseTuple(args, "O!iO!", &PairingType, &py_pairing, &group, &PyBytes_Type, &py_bytes)) {
-        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, group, and bytes");
+KzgSetup *KzgSetup_create(PyTypeObject *type) {
+    // allocate the object
+    KzgSetup *setup = (KzgSetup *)type->tp_alloc(type, 0);
+    // check if the object was allocated
+    if (!setup) {
+        PyErr_SetString(PyExc_TypeError, "could not create Setup object");
         return NULL;
     }
-    // cast the arguments
-    Pairing *pairing = (Pairing *)py_pairing;
-    // build the result element and initialize it with the pairing and group
-    Element *element = Element_create();
-    switch (group) {
-    case G1: element_init_G1(element->pbc_element, pairing->pbc_pairing); break;
-    case G2: element_init_G2(element->pbc_element, pairing->pbc_pairing); break;
-    case GT:
-    case Zr: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "only Elements in G1 or G2 can be created from compressed bytes"); return NULL;
-    default: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "invalid group"); return NULL;
-    }
-    element->pairing = pairing;
-    // check the size of the bytes
-    if (PyBytes_Size(py_bytes) != element_length_in_bytes_compressed(element->pbc_element)) {
-        Py_DECREF(element);
-        PyErr_SetString(PyExc_ValueError, "invalid number of bytes");
+    // set the ready flag to 0
+    setup->ready = 0;
+    return setup;
+}
+
+// build a setup from the packed powers of G1, which it takes over, and the two powers of G2
+static PyObject *KzgSetup_build(PyTypeObject *type, Pairing *pairing, unsigned char *powers, int record_size, Py_ssize_t count, element_ptr g2, element_ptr g2_tau) {
+    KzgSetup *setup = KzgSetup_create(type);
+    if (!setup) {
+        PyMem_Free(powers);
         return NULL;
     }
-    // convert the bytes to an element
-    unsigned char *bytes = (unsigned char *)PyBytes_AsString(py_bytes);
-    element_from_bytes_compressed(element->pbc_element, bytes);
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(element->pairing);
-    element->ready = 1;
-    return (PyObject *)element;
+    setup->pairing = pairing;
+    setup->powers = powers;
+    setup->record_size = record_size;
+    setup->count = count;
+    Py_INCREF(pairing);
+    // verifications pair with the generator of G2 and the inverse of its power of tau
+    element_init_G1(setup->g1, pairing->pbc_pairing);
+    element_from_bytes(setup->g1, powers);
+    element_init_G2(setup->g2, pairing->pbc_pairing);
+    element_set(setup->g2, g2);
+    element_init_G2(setup->neg_g2_tau, pairing->pbc_pairing);
+    element_invert(setup->neg_g2_tau, g2_tau);
+    setup->ready = 1;
+    return (PyObject *)setup;
 }
 
-PyObject *Element_from_bytes_x_only(PyObject *cls, PyObject *args) {
-    // required arguments are the pairing and the group
+PyObject *KzgSetup_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    // required arguments are the pairing, the powers of tau in G1 and the two first ones in G2
+    static char *keywords[] = {"pairing", "g1_powers", "g2_powers", NULL};
     PyObject *py_pairing;
-    enum Group group;
-    PyObject *py_bytes;
-    if (!PyArg_ParseTuple(args, "O!iO!", &PairingType, &py_pairing, &group, &PyBytes_Type, &py_bytes)) {
-        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, group, and bytes");
+    PyObject *py_g1_powers;
+    PyObject *py_g2_powers;
+    ModuleState *state = pypbc_state(type);
+    if (!state) {
+        return NULL;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!OO", keywords, state->PairingType, &py_pairing, &py_g1_powers, &py_g2_powers)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, powers of tau in G1 and in G2");
         return NULL;
     }
     // cast the arguments
     Pairing *pairing = (Pairing *)py_pairing;
-    // build the result element and initialize it with the pairing and group
-    Element *element = Element_create();
-    switch (group) {
-    case G1: element_init_G1(element->pbc_element, pairing->pbc_pairing); break;
-    case G2: element_init_G2(element->pbc_element, pairing->pbc_pairing); break;
-    case GT:
-    case Zr: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "only Elements in G1 or G2 can be created from x-only bytes"); return NULL;
-    default: Py_DECREF(element); PyErr_SetString(PyExc_ValueError, "invalid group"); return NULL;
+    field_ptr g1 = pairing->pbc_pairing->G1;
+    field_ptr g2 = pairing->pbc_pairing->G2;
+    // the powers of G2 are the generator and its power of tau
+    PyObject *g2_powers = PySequence_Fast(py_g2_powers, "the powers of tau in G2 must be a sequence of Elements");
+    if (!g2_powers) {
+        return NULL;
     }
-    element->pairing = pairing;
-    // check the size of the bytes
-    if (PyBytes_Size(py_bytes) != element_length_in_bytes_x_only(element->pbc_element)) {
-        Py_DECREF(element);
-        PyErr_SetString(PyExc_ValueError, "invalid number of bytes");
+    if (PySequence_Fast_GET_SIZE(g2_powers) < 2) {
+        Py_DECREF(g2_powers);
+        PyErr_SetString(PyExc_ValueError, "the powers of tau in G2 must hold the generator and its power of tau");
         return NULL;
     }
-    // convert the bytes to an element
-    unsigned char *bytes = (unsigned char *)PyBytes_AsString(py_bytes);
-    element_from_bytes_x_only(element->pbc_element, bytes);
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(element->pairing);
-    element->ready = 1;
-    return (PyObject *)element;
-}
-
-PyObject *Element_to_bytes(PyObject *py_element) {
-    // cast the argument
-    Element *element = (Element *)py_element;
-    // get the size of the buffer and allocate it
-    int size = element_length_in_bytes(element->pbc_element);
-    unsigned char buffer[size];
-    // convert the element to bytes
-    element_to_bytes(buffer, element->pbc_element);
-    // return the buffer as a bytes object
-    return PyBytes_FromStringAndSize((char *)buffer, size);
+    for (Py_ssize_t i = 0; i < 2; i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(g2_powers, i);
+        if (!PyObject_TypeCheck(item, state->ElementType) || ((Element *)item)->pairing != pairing || ((Element *)item)->pbc_element->field != g2) {
+            Py_DECREF(g2_powers);
+            PyErr_SetString(PyExc_TypeError, "the powers of tau in G2 must be Elements of G2 of the pairing");
+            return NULL;
+        }
+    }
+    // the powers of G1 are packed, copied from a buffer of records or serialized from Elements
+    element_t probe;
+    element_init(probe, g1);
+    int record_size = element_length_in_bytes(probe);
+    element_clear(probe);
+    unsigned char *powers = NULL;
+    Py_ssize_t count = 0;
+    if (PyObject_CheckBuffer(py_g1_powers)) {
+        Py_buffer data;
+        if (PyObject_GetBuffer(py_g1_powers, &data, PyBUF_C_CONTIGUOUS) < 0) {
+            Py_DECREF(g2_powers);
+            return NULL;
+        }
+        if (data.len % record_size != 0) {
+            PyBuffer_Release(&data);
+            Py_DECREF(g2_powers);
+            PyErr_SetString(PyExc_ValueError, "the powers of tau in G1 must be packed records of Elements of G1");
+            return NULL;
+        }
+        count = data.len / record_size;
+        powers = PyMem_Malloc(data.len ? data.len : 1);
+        if (powers) {
+            memcpy(powers, data.buf, data.len);
+        }
+        PyBuffer_Release(&data);
+    } else {
+        PyObject *g1_powers = PySequence_Fast(py_g1_powers, "the powers of tau in G1 must be a sequence of Elements or packed records");
+        if (!g1_powers) {
+            Py_DECREF(g2_powers);
+            return NULL;
+        }
+        count = PySequence_Fast_GET_SIZE(g1_powers);
+        for (Py_ssize_t i = 0; i < count; i++) {
+            PyObject *item = PySequence_Fast_GET_ITEM(g1_powers, i);
+            if (!PyObject_TypeCheck(item, state->ElementType) || ((Element *)item)->pairing != pairing || ((Element *)item)->pbc_element->field != g1) {
+                Py_DECREF(g1_powers);
+                Py_DECREF(g2_powers);
+                PyErr_SetString(PyExc_TypeError, "the powers of tau in G1 must be Elements of G1 of the pairing");
+                return NULL;
+            }
+        }
+        powers = PyMem_Malloc(count ? (size_t)count * record_size : 1);
+        for (Py_ssize_t i = 0; i < count && powers; i++) {
+            element_to_bytes(powers + (size_t)i * record_size, ((Element *)PySequence_Fast_GET_ITEM(g1_powers, i))->pbc_element);
+        }
+        Py_DECREF(g1_powers);
+    }
+    if (!powers) {
+        Py_DECREF(g2_powers);
+        return PyErr_NoMemory();
+    }
+    if (count < 1) {
+        PyMem_Free(powers);
+        Py_DECREF(g2_powers);
+        PyErr_SetString(PyExc_ValueError, "there must be at least one power of tau in G1");
+        return NULL;
+    }
+    PyObject *setup = KzgSetup_build(type, pairing, powers, record_size, count,
+        ((Element *)PySequence_Fast_GET_ITEM(g2_powers, 0))->pbc_element, ((Element *)PySequence_Fast_GET_ITEM(g2_powers, 1))->pbc_element);
+    Py_DECREF(g2_powers);
+    return setup;
 }
 
-Py_hash_t Element_hash(PyObject *py_element) {
-    // cast the argument
-    Element *element = (Element *)py_element;
-    // get the size of the buffer and allocate it
-    int size = element_length_in_bytes(element->pbc_element);
-    unsigned char buffer[size];
-    // convert the element to bytes
-    element_to_bytes(buffer, element->pbc_element);
-    // initialize the hash
-    Py_uhash_t hash = 14695981039346656037U;
-    // iterate over the string
-    for (Py_ssize_t i = 0; i < size; i++) {
-        hash ^= (Py_uhash_t)buffer[i];
-        hash *= 1099511628211U;
+PyObject *KzgSetup_insecure(PyObject *cls, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // required arguments are the pairing and the degree, the generators and tau are optional
+    static const char *const keywords[] = {"pairing", "degree", "g1", "g2", "tau", NULL};
+    PyObject *slots[5];
+    Py_ssize_t degree;
+    ModuleState *state = pypbc_state((PyTypeObject *)cls);
+    if (!state) {
+        return NULL;
+    }
+    if (args_bind(args, nargs, kwnames, keywords, 2, slots) < 0 || !PyObject_TypeCheck(slots[0], state->PairingType) || args_ssize(slots[1], &degree) < 0) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected Pairing object, a degree and optional generators and tau");
+        return NULL;
+    }
+    if (degree < 0) {
+        PyErr_SetString(PyExc_ValueError, "the degree must not be negative");
+        return NULL;
+    }
+    // cast the arguments
+    Pairing *pairing = (Pairing *)slots[0];
+    field_ptr fields[2] = {pairing->pbc_pairing->G1, pairing->pbc_pairing->G2};
+    for (int k = 0; k < 2; k++) {
+        PyObject *item = slots[2 + k];
+        if (item && item != Py_None && (!PyObject_TypeCheck(item, state->ElementType) || ((Element *)item)->pairing != pairing || ((Element *)item)->pbc_element->field != fields[k])) {
+            PyErr_SetString(PyExc_TypeError, k ? "g2 must be an Element of G2 of the pairing" : "g1 must be an Element of G1 of the pairing");
+            return NULL;
+        }
     }
-    // add the pointer to the hash
-    Py_uhash_t ptr = (Py_uhash_t)element->pbc_element->field;
-    hash ^= ptr >> 4 | ptr << (8 * sizeof(ptr) - 4);
-    // check if the hash is invalid
-    if (hash == (Py_uhash_t)-1) {
-        hash = (Py_uhash_t)-2;
+    // tau is random unless given
+    mpz_t tau;
+    mpz_init(tau);
+    if (slots[4] && slots[4] != Py_None) {
+        if (Pairing_exponent_to_mpz(pairing, tau, slots[4]) < 0) {
+            mpz_clear(tau);
+            return NULL;
+        }
+        mpz_mod(tau, tau, pairing->pbc_pairing->r);
+    } else {
+        pbc_mpz_random(tau, pairing->pbc_pairing->r);
     }
-    // return the hash
-    return (Py_hash_t)hash;
+    element_t g1;
+    element_t g2;
+    element_t g2_tau;
+    element_init_G1(g1, pairing->pbc_pairing);
+    element_init_G2(g2, pairing->pbc_pairing);
+    element_init_G2(g2_tau, pairing->pbc_pairing);
+    if (slots[2] && slots[2] != Py_None) {
+        element_set(g1, ((Element *)slots[2])->pbc_element);
+    } else {
+        element_random(g1);
+    }
+    if (slots[3] && slots[3] != Py_None) {
+        element_set(g2, ((Element *)slots[3])->pbc_element);
+    } else {
+        element_random(g2);
+    }
+    int record_size = element_length_in_bytes(g1);
+    // the degree comes from the caller, so the size of the powers must not wrap around
+    if (degree > PY_SSIZE_T_MAX / record_size - 1) {
+        element_clear(g1);
+        element_clear(g2);
+        element_clear(g2_tau);
+        mpz_clear(tau);
+        PyErr_SetString(PyExc_OverflowError, "the degree is too large");
+        return NULL;
+    }
+    unsigned char *powers = PyMem_Malloc((size_t)(degree + 1) * record_size);
+    if (!powers) {
+        element_clear(g1);
+        element_clear(g2);
+        element_clear(g2_tau);
+        mpz_clear(tau);
+        return PyErr_NoMemory();
+    }
+    // every power is the previous one raised to tau
+    Py_BEGIN_ALLOW_THREADS
+    element_pow_mpz(g2_tau, g2, tau);
+    for (Py_ssize_t i = 0; i <= degree; i++) {
+        element_to_bytes(powers + (size_t)i * record_size, g1);
+        element_pow_mpz(g1, g1, tau);
+    }
+    Py_END_ALLOW_THREADS
+    PyObject *setup = KzgSetup_build((PyTypeObject *)cls, pairing, powers, record_size, degree + 1, g2, g2_tau);
+    element_clear(g1);
+    element_clear(g2);
+    element_clear(g2_tau);
+    mpz_clear(tau);
+    return setup;
 }
 
-PyObject *Element_to_bytes_compressed(PyObject *py_element) {
-    // cast the argument
-    Element *element = (Element *)py_element;
-    // make sure the element is in G1 or G2
-    if (element->pbc_element->field != element->pairing->pbc_pairing->G1 && element->pbc_element->field != element->pairing->pbc_pairing->G2) {
-        PyErr_SetString(PyExc_TypeError, "only Elements in G1 or G2 can be converted to compressed bytes");
+void KzgSetup_dealloc(KzgSetup *setup) {
+    // clear the elements and the powers if they're ready
+    if (setup->ready) {
+        element_clear(setup->g1);
+        element_clear(setup->g2);
+        element_clear(setup->neg_g2_tau);
+        PyMem_Free(setup->powers);
+        Py_DECREF(setup->pairing);
+    }
+    // free the object and release its heap type
+    PyTypeObject *type = Py_TYPE(setup);
+    type->tp_free((PyObject *)setup);
+    Py_DECREF(type);
+}
+
+// convert the coefficients of a polynomial, which must fit the setup
+mpz_t *KzgSetup_coefficients(KzgSetup *setup, PyObject *py_coefficients, Py_ssize_t *count) {
+    mpz_t *coefficients = Pairing_scalars(setup->pairing, py_coefficients, count);
+    if (coefficients && *count > setup->count) {
+        mpz_array_free(coefficients, *count);
+        PyErr_SetString(PyExc_ValueError, "the degree of the polynomial is larger than the one of the setup");
         return NULL;
     }
-    // get the size of the buffer and allocate it
-    int size = element_length_in_bytes_compressed(element->pbc_element);
-    unsigned char buffer[size];
-    // convert the element to compressed bytes
-    element_to_bytes_compressed(buffer, element->pbc_element);
-    // return the buffer as a bytes object
-    return PyBytes_FromStringAndSize((char *)buffer, size);
+    return coefficients;
 }
 
-PyObject *Element_to_bytes_x_only(PyObject *py_element) {
-    // cast the argument
-    Element *element = (Element *)py_element;
-    // make sure the element is in G1 or G2
-    if (element->pbc_element->field != element->pairing->pbc_pairing->G1 && element->pbc_element->field != element->pairing->pbc_pairing->G2) {
-        PyErr_SetString(PyExc_TypeError, "only Elements in G1 or G2 can be converted to x-only bytes");
+// an Element of G1 of the pairing of the setup, initialized but not yet ready
+static Element *KzgSetup_g1_element(KzgSetup *setup) {
+    Element *element = Element_create(setup->pairing);
+    if (!element) {
         return NULL;
     }
-    // get the size of the buffer and allocate it
-    int size = element_length_in_bytes_x_only(element->pbc_element);
-    unsigned char buffer[size];
-    // convert the element to x-only bytes
-    element_to_bytes_x_only(buffer, element->pbc_element);
-    // return the buffer as a bytes object
-    return PyBytes_FromStringAndSize((char *)buffer, size);
+    element_init_G1(element->pbc_element, setup->pairing->pbc_pairing);
+    element->pairing = setup->pairing;
+    return element;
 }
 
-PyObject *Element_add(PyObject *py_lft, PyObject *py_rgt) {
-    // check the type of arguments
-    if (!PyObject_TypeCheck(py_lft, &ElementType) || !PyObject_TypeCheck(py_rgt, &ElementType)) {
-        PyErr_SetString(PyExc_TypeError, "operands must be Elements");
+// check that the G1 element pairs with the generator of G2 as the other one with its power of
+// tau, with one multi-pairing that needs no GIL
+static int KzgSetup_check(KzgSetup *setup, element_ptr lft, element_ptr rgt) {
+    element_t in1[2];
+    element_t in2[2];
+    element_t product;
+    // the arguments are only read, so they are shared with their elements
+    in1[0][0] = *lft;
+    in1[1][0] = *rgt;
+    in2[0][0] = *setup->g2;
+    in2[1][0] = *setup->neg_g2_tau;
+    element_init_GT(product, setup->pairing->pbc_pairing);
+    // an identity side pairs to 1, leaving the other pair to decide, so it is left out
+    prod_pairing_nonzero(product, in1, in2, 2, setup->pairing->pbc_pairing);
+    int result = element_is1(product);
+    element_clear(product);
+    return result;
+}
+
+PyObject *KzgSetup_commit(PyObject *py_setup, PyObject *py_coefficients) {
+    // cast the argument
+    KzgSetup *setup = (KzgSetup *)py_setup;
+    Py_ssize_t count;
+    mpz_t *coefficients = KzgSetup_coefficients(setup, py_coefficients, &count);
+    if (!coefficients) {
         return NULL;
     }
-    // declare the result element
-    Element *ele_res;
-    // convert both objects to Elements
-    Element *ele_lft = (Element *)py_lft;
-    Element *ele_rgt = (Element *)py_rgt;
-    // make sure they're in the same ring
-    if (ele_lft->pbc_element->field != ele_rgt->pbc_element->field) {
-        PyErr_SetString(PyExc_ValueError, "only Elements in the same group can be added");
+    Element *ele_res = KzgSetup_g1_element(setup);
+    if (!ele_res) {
+        mpz_array_free(coefficients, count);
         return NULL;
     }
-    // build and initialize the result element to the same group as the left element
-    ele_res = Element_create();
-    element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
-    ele_res->pairing = ele_lft->pairing;
-    // add the two elements
-    element_add(ele_res->pbc_element, ele_lft->pbc_element, ele_rgt->pbc_element);
+    // the commitment is the multi-scalar multiplication of the powers of tau by the coefficients
+    Tuning tuning;
+    tuning_load(&tuning, &setup->pairing->tuning);
+    Py_BEGIN_ALLOW_THREADS
+    msm_packed(ele_res->pbc_element, setup->powers, setup->record_size, coefficients, count, &tuning);
+    Py_END_ALLOW_THREADS
+    mpz_array_free(coefficients, count);
     // increment the reference count on the pairing and set the ready flag
     Py_INCREF(ele_res->pairing);
     ele_res->ready = 1;
     return (PyObject *)ele_res;
 }
 
-PyObject *Element_sub(PyObject *py_lft, PyObject *py_rgt) {
-    // check the type of arguments
-    if (!PyObject_TypeCheck(py_lft, &ElementType) || !PyObject_TypeCheck(py_rgt, &ElementType)) {
-        PyErr_SetString(PyExc_TypeError, "operands must be Elements");
+PyObject *KzgSetup_open(PyObject *py_setup, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect the coefficients and the point
+    if (nargs != 2) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected coefficients and a point");
         return NULL;
     }
-    // declare the result element
-    Element *ele_res;
-    // convert both objects to Elements
-    Element *ele_lft = (Element *)py_lft;
-    Element *ele_rgt = (Element *)py_rgt;
-    // make sure they're in the same ring
-    if (ele_lft->pbc_element->field != ele_rgt->pbc_element->field) {
-        PyErr_SetString(PyExc_ValueError, "only Elements in the same group can be subtracted");
+    // cast the argument
+    KzgSetup *setup = (KzgSetup *)py_setup;
+    mpz_ptr r = setup->pairing->pbc_pairing->r;
+    mpz_t point;
+    mpz_init(point);
+    if (Pairing_exponent_to_mpz(setup->pairing, point, args[1]) < 0) {
+        mpz_clear(point);
         return NULL;
     }
-    // build and initialize the result element to the same group as the left element
-    ele_res = Element_create();
-    element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
-    ele_res->pairing = ele_lft->pairing;
-    // subtract the two elements
-    element_sub(ele_res->pbc_element, ele_lft->pbc_element, ele_rgt->pbc_element);
+    mpz_mod(point, point, r);
+    Py_ssize_t count;
+    mpz_t *coefficients = KzgSetup_coefficients(setup, args[0], &count);
+    if (!coefficients) {
+        mpz_clear(point);
+        return NULL;
+    }
+    Element *value = Element_create_in(setup->pairing, Zr);
+    Element *proof = value ? KzgSetup_g1_element(setup) : NULL;
+    if (!proof) {
+        if (value) {
+            element_clear(value->pbc_element);
+            Py_DECREF(value);
+        }
+        mpz_array_free(coefficients, count);
+        mpz_clear(point);
+        return NULL;
+    }
+    // divide by X - z with Horner's rule: the running values replace the coefficients, the
+    // constant one becomes the value at z and the others the quotient, shifted down by one
+    Tuning tuning;
+    tuning_load(&tuning, &setup->pairing->tuning);
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t i = count - 1; i-- > 0;) {
+        mpz_addmul(coefficients[i], coefficients[i + 1], point);
+        mpz_mod(coefficients[i], coefficients[i], r);
+    }
+    if (count > 0) {
+        element_set_mpz(value->pbc_element, coefficients[0]);
+    } else {
+        element_set0(value->pbc_element);
+    }
+    msm_packed(proof->pbc_element, setup->powers, setup->record_size, coefficients + 1, count > 0 ? count - 1 : 0, &tuning);
+    Py_END_ALLOW_THREADS
+    mpz_array_free(coefficients, count);
+    mpz_clear(point);
     // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(ele_res->pairing);
-    ele_res->ready = 1;
-    return (PyObject *)ele_res;
+    Py_INCREF(value->pairing);
+    value->ready = 1;
+    Py_INCREF(proof->pairing);
+    proof->ready = 1;
+    return Py_BuildValue("(NN)", value, proof);
 }
 
-PyObject *Element_div(PyObject *py_lft, PyObject *py_rgt) {
-    // check the type of arguments
-    if (!PyObject_TypeCheck(py_lft, &ElementType) || !PyObject_TypeCheck(py_rgt, &ElementType)) {
-        PyErr_SetString(PyExc_TypeError, "operands must be Elements");
+// check that an object is an Element of G1 of the pairing of the setup
+static int KzgSetup_is_g1(KzgSetup *setup, PyObject *obj) {
+    return PyObject_TypeCheck(obj, setup->pairing->state->ElementType) && ((Element *)obj)->pairing == setup->pairing &&
+        ((Element *)obj)->pbc_element->field == setup->pairing->pbc_pairing->G1;
+}
+
+PyObject *KzgSetup_verify(PyObject *py_setup, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect the commitment, the point, the value and the proof
+    if (nargs != 4) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected a commitment, a point, a value and a proof");
         return NULL;
     }
-    // declare the result element
-    Element *ele_res;
-    // convert both objects to Elements
-    Element *ele_lft = (Element *)py_lft;
-    Element *ele_rgt = (Element *)py_rgt;
-    // make sure they're in the same ring or one is in Zr
-    if (ele_lft->pbc_element->field != ele_rgt->pbc_element->field) {
-        PyErr_SetString(PyExc_ValueError, "only Elements in the same group can be divided");
+    // cast the argument
+    KzgSetup *setup = (KzgSetup *)py_setup;
+    if (!KzgSetup_is_g1(setup, args[0]) || !KzgSetup_is_g1(setup, args[3])) {
+        PyErr_SetString(PyExc_TypeError, "commitments and proofs must be Elements of G1");
         return NULL;
     }
-    // build and initialize the result element to the same group as the left element
-    ele_res = Element_create();
-    element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
-    ele_res->pairing = ele_lft->pairing;
-    // divide the two elements
-    element_div(ele_res->pbc_element, ele_lft->pbc_element, ele_rgt->pbc_element);
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(ele_res->pairing);
-    ele_res->ready = 1;
-    return (PyObject *)ele_res;
+    mpz_ptr r = setup->pairing->pbc_pairing->r;
+    mpz_t point;
+    mpz_t value;
+    mpz_init(point);
+    mpz_init(value);
+    if (Pairing_exponent_to_mpz(setup->pairing, point, args[1]) < 0 || Pairing_exponent_to_mpz(setup->pairing, value, args[2]) < 0) {
+        mpz_clear(point);
+        mpz_clear(value);
+        return NULL;
+    }
+    mpz_mod(point, point, r);
+    mpz_mod(value, value, r);
+    // e(C / g^y, h) = e(pi, h^(tau - z)) is checked as e(C pi^z / g^y, h) e(pi, h^-tau) = 1
+    element_ptr commitment = ((Element *)args[0])->pbc_element;
+    element_ptr proof = ((Element *)args[3])->pbc_element;
+    int result;
+    Py_BEGIN_ALLOW_THREADS
+    element_t lft;
+    element_t term;
+    element_init_G1(lft, setup->pairing->pbc_pairing);
+    element_init_G1(term, setup->pairing->pbc_pairing);
+    element_pow_mpz(lft, proof, point);
+    element_mul(lft, lft, commitment);
+    element_pow_mpz(term, setup->g1, value);
+    element_div(lft, lft, term);
+    result = KzgSetup_check(setup, lft, proof);
+    element_clear(lft);
+    element_clear(term);
+    Py_END_ALLOW_THREADS
+    mpz_clear(point);
+    mpz_clear(value);
+    return PyBool_FromLong(result);
 }
 
-PyObject *Element_pow(PyObject *py_lft, PyObject *py_rgt, PyObject *py_mod) {
-    // check the type of the first argument
-    if (!PyObject_TypeCheck(py_lft, &ElementType)) {
-        PyErr_SetString(PyExc_TypeError, "the base must be an Element");
+PyObject *KzgSetup_batch_verify(PyObject *py_setup, PyObject *const *args, Py_ssize_t nargs) {
+    // we expect the commitments, the points, the values and the proofs of independent openings
+    if (nargs != 4) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected commitments, points, values and proofs");
         return NULL;
     }
-    // declare the result element
-    Element *ele_res;
-    // convert the first argument to an Element
-    Element *ele_lft = (Element *)py_lft;
-    // check the type of the second argument
-    if (PyObject_TypeCheck(py_rgt, &ElementType)) {
-        // convert the second argument to an Element
-        Element *ele_rgt = (Element *)py_rgt;
-        // make sure the second element is in Zr
-        if (ele_rgt->pbc_element->field == ele_lft->pairing->pbc_pairing->Zr && (ele_lft->pbc_element->field == ele_lft->pairing->pbc_pairing->Zr || ele_lft->pbc_element->field->pairing)) {
-            // build and initialize the result element to the same group as the left element
-            ele_res = Element_create();
-            element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
-            ele_res->pairing = ele_lft->pairing;
-            // raise the element to the power
-            element_pow_zn(ele_res->pbc_element, ele_lft->pbc_element, ele_rgt->pbc_element);
+    // cast the argument
+    KzgSetup *setup = (KzgSetup *)py_setup;
+    mpz_ptr r = setup->pairing->pbc_pairing->r;
+    PyObject *commitments = PySequence_Fast(args[0], "the commitments must be a sequence of Elements");
+    PyObject *proofs = commitments ? PySequence_Fast(args[3], "the proofs must be a sequence of Elements") : NULL;
+    Py_ssize_t count = proofs ? PySequence_Fast_GET_SIZE(commitments) : 0;
+    Py_ssize_t point_count = 0;
+    Py_ssize_t value_count = 0;
+    mpz_t *points = proofs ? Pairing_scalars(setup->pairing, args[1], &point_count) : NULL;
+    mpz_t *values = points ? Pairing_scalars(setup->pairing, args[2], &value_count) : NULL;
+    PyObject *result = NULL;
+    if (values && (PySequence_Fast_GET_SIZE(proofs) != count || point_count != count || value_count != count)) {
+        PyErr_SetString(PyExc_ValueError, "there must be as many points, values and proofs as commitments");
+    } else if (values && count == 0) {
+        Py_INCREF(Py_True);
+        result = Py_True;
+    } else if (values) {
+        int valid = 1;
+        for (Py_ssize_t i = 0; i < count && valid; i++) {
+            valid = KzgSetup_is_g1(setup, PySequence_Fast_GET_ITEM(commitments, i)) && KzgSetup_is_g1(setup, PySequence_Fast_GET_ITEM(proofs, i));
+        }
+        // the openings are combined with small random coefficients rho_i, so that invalid ones
+        // cannot cancel each other out: prod (C_i pi_i^z_i)^rho_i / g^(sum rho_i y_i) must pair
+        // with h as prod pi_i^rho_i with h^tau
+        element_ptr *bases = valid ? PyMem_Malloc((2 * count + 1) * sizeof(element_ptr)) : NULL;
+        mpz_t *exps = valid ? PyMem_Malloc((2 * count + 1) * sizeof(mpz_t)) : NULL;
+        if (!valid) {
+            PyErr_SetString(PyExc_TypeError, "commitments and proofs must be Elements of G1");
+        } else if (!bases || !exps) {
+            PyErr_NoMemory();
         } else {
-            PyErr_SetString(PyExc_TypeError, "if the exponent is an Element, it must be in Zr and the base must be in Zr, G1, G2, or GT");
-            return NULL;
+            mpz_t sum;
+            mpz_init(sum);
+            for (Py_ssize_t i = 0; i < count; i++) {
+                mpz_init(exps[i]);
+                mpz_init(exps[count + i]);
+                do {
+                    pbc_mpz_randomb(exps[count + i], KZG_BATCH_BITS);
+                } while (mpz_sgn(exps[count + i]) == 0);
+                bases[i] = ((Element *)PySequence_Fast_GET_ITEM(commitments, i))->pbc_element;
+                bases[count + i] = ((Element *)PySequence_Fast_GET_ITEM(proofs, i))->pbc_element;
+                mpz_set(exps[i], exps[count + i]);
+                mpz_addmul(sum, exps[count + i], values[i]);
+            }
+            // the commitments and the generator come first, the proofs last so that their
+            // coefficients can be used alone for the right side
+            mpz_init(exps[2 * count]);
+            mpz_mod(sum, sum, r);
+            mpz_sub(exps[2 * count], r, sum);
+            int status;
+            Tuning tuning;
+            tuning_load(&tuning, &setup->pairing->tuning);
+            Py_BEGIN_ALLOW_THREADS
+            element_t lft;
+            element_t rgt;
+            element_init_G1(lft, setup->pairing->pbc_pairing);
+            element_init_G1(rgt, setup->pairing->pbc_pairing);
+            Expr_multi_pow(rgt, bases + count, exps + count, count, tuning.multi_pow_window);
+            // the proofs are raised to rho_i z_i on the left side
+            mpz_t *left = PyMem_RawMalloc((2 * count + 1) * sizeof(mpz_t));
+            element_ptr *left_bases = PyMem_RawMalloc((2 * count + 1) * sizeof(element_ptr));
+            if (left && left_bases) {
+                for (Py_ssize_t i = 0; i < count; i++) {
+                    left_bases[i] = bases[i];
+                    left[i][0] = exps[i][0];
+                    left_bases[count + i] = bases[count + i];
+                    mpz_init(left[count + i]);
+                    mpz_mul(left[count + i], exps[count + i], points[i]);
+                    mpz_mod(left[count + i], left[count + i], r);
+                }
+                left_bases[2 * count] = setup->g1;
+                left[2 * count][0] = exps[2 * count][0];
+                Expr_multi_pow(lft, left_bases, left, 2 * count + 1, tuning.multi_pow_window);
+                status = KzgSetup_check(setup, lft, rgt);
+                for (Py_ssize_t i = 0; i < count; i++) {
+                    mpz_clear(left[count + i]);
+                }
+            } else {
+                status = -1;
+            }
+            PyMem_RawFree(left);
+            PyMem_RawFree(left_bases);
+            element_clear(lft);
+            element_clear(rgt);
+            Py_END_ALLOW_THREADS
+            result = status < 0 ? PyErr_NoMemory() : PyBool_FromLong(status);
+            mpz_clear(sum);
+            for (Py_ssize_t i = 0; i < 2 * count + 1; i++) {
+                mpz_clear(exps[i]);
+            }
         }
-    } else if (PyLong_Check(py_rgt)) {
-        // convert it to an mpz
-        mpz_t mpz_lft;
-        mpz_init_from_pynum(mpz_lft, py_rgt);
-        // build and initialize the result element to the same group as the left element
-        ele_res = Element_create();
-        element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
-        ele_res->pairing = ele_lft->pairing;
-        // raise the element to the power
-        element_pow_mpz(ele_res->pbc_element, ele_lft->pbc_element, mpz_lft);
-        // clean up the mpz
-        mpz_clear(mpz_lft);
-    } else {
-        PyErr_SetString(PyExc_TypeError, "the exponent must be an Element or an integer");
-        return NULL;
+        PyMem_Free(bases);
+        PyMem_Free(exps);
     }
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(ele_res->pairing);
-    ele_res->ready = 1;
-    return (PyObject *)ele_res;
+    if (points) {
+        mpz_array_free(points, point_count);
+    }
+    if (values) {
+        mpz_array_free(values, value_count);
+    }
+    Py_XDECREF(commitments);
+    Py_XDECREF(proofs);
+    return result;
 }
 
-PyObject *Element_mul(PyObject *py_lft, PyObject *py_rgt) {
-    // declare the result element
-    Element *ele_res;
-    // check the type of arguments
-    if (PyObject_TypeCheck(py_lft, &ElementType) && PyObject_TypeCheck(py_rgt, &ElementType)) {
-        // convert both objects to Elements
-        Element *ele_lft = (Element *)py_lft;
-        Element *ele_rgt = (Element *)py_rgt;
-        // make sure they're in the same ring or one is in Zr
-        if (ele_lft->pbc_element->field == ele_rgt->pbc_element->field) {
-            // build and initialize the result element to the same group as the left element
-            ele_res = Element_create();
-            element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
-            ele_res->pairing = ele_lft->pairing;
-            // multiply the two elements
-            element_mul(ele_res->pbc_element, ele_lft->pbc_element, ele_rgt->pbc_element);
-        } else if (ele_rgt->pbc_element->field == ele_lft->pairing->pbc_pairing->Zr && ele_lft->pbc_element->field->pairing) {
-            // build and initialize the result element to the same group as the left element
-            ele_res = Element_create();
-            element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
-            ele_res->pairing = ele_lft->pairing;
-            // multiply the two elements
-            element_mul_zn(ele_res->pbc_element, ele_lft->pbc_element, ele_rgt->pbc_element);
-        } else if (ele_lft->pbc_element->field == ele_rgt->pairing->pbc_pairing->Zr && ele_rgt->pbc_element->field->pairing) {
-            // build and initialize the result element to the same group as the right element
-            ele_res = Element_create();
-            element_init_same_as(ele_res->pbc_element, ele_rgt->pbc_element);
-            ele_res->pairing = ele_rgt->pairing;
-            // multiply the two elements
-            element_mul_zn(ele_res->pbc_element, ele_rgt->pbc_element, ele_lft->pbc_element);
-        } else {
-            PyErr_SetString(PyExc_ValueError, "only Elements in the same group can be multiplied, or one must be in Zr and the other in G1, G2, or GT");
-            return NULL;
-        }
-    } else if (PyLong_Check(py_rgt)) {
-        // convert the left object to an Element
-        Element *ele_lft = (Element *)py_lft;
-        // convert the right object to an mpz
-        mpz_t mpz_rgt;
-        mpz_init_from_pynum(mpz_rgt, py_rgt);
-        // build and initialize the result element to the same group as the left element
-        ele_res = Element_create();
-        element_init_same_as(ele_res->pbc_element, ele_lft->pbc_element);
-        ele_res->pairing = ele_lft->pairing;
-        // multiply the two elements
-        element_mul_mpz(ele_res->pbc_element, ele_lft->pbc_element, mpz_rgt);
-        // clean up the mpz
-        mpz_clear(mpz_rgt);
-    } else if (PyLong_Check(py_lft)) {
-        // convert the right object to an Element
-        Element *ele_rgt = (Element *)py_rgt;
-        // convert the left object to an mpz
-        mpz_t mpz_lft;
-        mpz_init_from_pynum(mpz_lft, py_lft);
-        // build and initialize the result element to the same group as the right element
-        ele_res = Element_create();
-        element_init_same_as(ele_res->pbc_element, ele_rgt->pbc_element);
-        ele_res->pairing = ele_rgt->pairing;
-        // multiply the two elements
-        element_mul_mpz(ele_res->pbc_element, ele_rgt->pbc_element, mpz_lft);
-        // clean up the mpz
-        mpz_clear(mpz_lft);
-    } else {
-        PyErr_SetString(PyExc_TypeError, "operands must be Elements or integers");
-        return NULL;
+PyObject *KzgSetup_degree(PyObject *py_setup) {
+    return PyLong_FromSsize_t(((KzgSetup *)py_setup)->count - 1);
+}
+
+PyMethodDef KzgSetup_methods[] = {
+    {"insecure", (PyCFunction)(void (*)(void))KzgSetup_insecure, METH_FASTCALL | METH_KEYWORDS | METH_CLASS, "Returns a setup for a known tau, for testing only."},
+    {"degree", (PyCFunction)KzgSetup_degree, METH_NOARGS, "Returns the largest degree of the polynomials the setup commits to."},
+    {"commit", (PyCFunction)KzgSetup_commit, METH_O, "Returns the commitment to a polynomial."},
+    {"open", (PyCFunction)(void (*)(void))KzgSetup_open, METH_FASTCALL, "Returns the value of a polynomial at a point and the proof of it."},
+    {"verify", (PyCFunction)(void (*)(void))KzgSetup_verify, METH_FASTCALL, "Verifies the opening of a commitment at a point."},
+    {"batch_verify", (PyCFunction)(void (*)(void))KzgSetup_batch_verify, METH_FASTCALL, "Verifies many openings at once."},
+    {NULL},
+};
+
+PyType_Slot KzgSetup_slots[] = {
+    {Py_tp_dealloc, KzgSetup_dealloc},
+    {Py_tp_doc, (void *)KzgSetup__doc__},
+    {Py_tp_methods, KzgSetup_methods},
+    {Py_tp_new, KzgSetup_new},
+    {0, NULL},
+};
+
+PyType_Spec KzgSetup_spec = {
+    "pypbc.kzg.Setup",                                                   /* name */
+    sizeof(KzgSetup),                                                    /* basicsize */
+    0,                                                                   /* itemsize */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE, /* flags */
+    KzgSetup_slots,                                                      /* slots */
+};
+
+// the submodule holding the setup, also registered in sys.modules so that it can be imported
+static int kzg_add(PyObject *module, ModuleState *state) {
+    PyObject *kzg = PyModule_New("pypbc.kzg");
+    if (!kzg) {
+        return -1;
     }
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(ele_res->pairing);
-    ele_res->ready = 1;
-    return (PyObject *)ele_res;
+    int status = -1;
+    if (PyModule_SetDocString(kzg, kzg__doc__) == 0 &&
+        PyModule_AddType(kzg, state->KzgSetupType) == 0 &&
+        PyModule_AddObjectRef(module, "kzg", kzg) == 0 &&
+        PyDict_SetItemString(PyImport_GetModuleDict(), "pypbc.kzg", kzg) == 0) {
+        status = 0;
+    }
+    Py_DECREF(kzg);
+    return status;
 }
 
-PyObject *Element_neg(PyObject *py_arg) {
-    // declare the result element
-    Element *ele_res;
-    // cast the argument
-    Element *ele_arg = (Element *)py_arg;
-    // build and initialize the result element to the same group as the argument
-    ele_res = Element_create();
-    element_init_same_as(ele_res->pbc_element, ele_arg->pbc_element);
-    ele_res->pairing = ele_arg->pairing;
-    // negate the element
-    element_neg(ele_res->pbc_element, ele_arg->pbc_element);
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(ele_res->pairing);
-    ele_res->ready = 1;
-    return (PyObject *)ele_res;
+/*******************************************************************************
+*                                    Tuning                                    *
+*******************************************************************************/
+
+// The windows of exponentiation, the point where Pippenger's method overtakes
+// Straus' and the share of work worth a thread depend on the curve and on the
+// host. Pairing.autotune times each choice on random elements of the pairing and
+// keeps the fastest; the profile can be saved as a dict and loaded back.
+
+// the points of the calibration of multi-scalar multiplication, and the bases of the one of
+// Straus' method
+#define TUNING_POINTS 256
+#define TUNING_BASES 16
+
+void tuning_defaults(Tuning *tuning) {
+    tuning->gt_window = 0;
+    tuning->multi_pow_window = 4;
+    tuning->msm_crossover = 32;
+    tuning->thread_items = 256;
+    tuning->threads = 0;
 }
 
-PyObject *Element_invert(PyObject *py_arg) {
-    // declare the result element
-    Element *ele_res;
-    // cast the argument
-    Element *ele_arg = (Element *)py_arg;
-    // build and initialize the result element to the same group as the argument
-    ele_res = Element_create();
-    element_init_same_as(ele_res->pbc_element, ele_arg->pbc_element);
-    ele_res->pairing = ele_arg->pairing;
-    // invert the element
-    element_invert(ele_res->pbc_element, ele_arg->pbc_element);
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(ele_res->pairing);
-    ele_res->ready = 1;
-    return (PyObject *)ele_res;
+// the fields are read while the GIL is released and written by set_tuning and autotune, under
+// the lock of the pairing, so every access is atomic and the readers work on a copy
+void tuning_load(Tuning *out, const Tuning *tuning) {
+    out->gt_window = __atomic_load_n(&tuning->gt_window, __ATOMIC_RELAXED);
+    out->multi_pow_window = __atomic_load_n(&tuning->multi_pow_window, __ATOMIC_RELAXED);
+    out->msm_crossover = __atomic_load_n(&tuning->msm_crossover, __ATOMIC_RELAXED);
+    out->thread_items = __atomic_load_n(&tuning->thread_items, __ATOMIC_RELAXED);
+    out->threads = __atomic_load_n(&tuning->threads, __ATOMIC_RELAXED);
+}
+
+void tuning_store(Tuning *tuning, const Tuning *in) {
+    __atomic_store_n(&tuning->gt_window, in->gt_window, __ATOMIC_RELAXED);
+    __atomic_store_n(&tuning->multi_pow_window, in->multi_pow_window, __ATOMIC_RELAXED);
+    __atomic_store_n(&tuning->msm_crossover, in->msm_crossover, __ATOMIC_RELAXED);
+    __atomic_store_n(&tuning->thread_items, in->thread_items, __ATOMIC_RELAXED);
+    __atomic_store_n(&tuning->threads, in->threads, __ATOMIC_RELAXED);
+}
+
+// the threads to split count items over: every processor unless limited, but at least the
+// given number of items per thread
+int tuning_threads(const Tuning *tuning, Py_ssize_t count) {
+    long limit = tuning->threads > 0 ? tuning->threads : sysconf(_SC_NPROCESSORS_ONLN);
+    Py_ssize_t items = tuning->thread_items > 0 ? tuning->thread_items : 1;
+    Py_ssize_t threads = (count + items - 1) / items;
+    if (threads > limit) {
+        threads = limit;
+    }
+    return threads < 1 ? 1 : (int)threads;
 }
 
-PyObject *Element_cmp(PyObject *py_lft, PyObject *py_rgt, int op) {
-    // check the type of arguments
-    if (!PyObject_TypeCheck(py_lft, &ElementType) || !PyObject_TypeCheck(py_rgt, &ElementType)) {
-        PyErr_SetString(PyExc_TypeError, "operands must be Elements");
-        return NULL;
+static double tuning_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void *tuning_idle(void *arg) {
+    return arg;
+}
+
+// measure the parameters on the host, rounds is the number of timings each choice keeps the
+// best of; needs no GIL
+static void tuning_measure(Pairing *pairing, Tuning *tuning, int rounds) {
+    pairing_ptr p = pairing->pbc_pairing;
+    double start, best, time;
+    element_t out;
+    element_t *points = PyMem_RawMalloc(TUNING_POINTS * sizeof(element_t));
+    element_ptr *bases = PyMem_RawMalloc(TUNING_POINTS * sizeof(element_ptr));
+    mpz_t *scalars = PyMem_RawMalloc(TUNING_POINTS * sizeof(mpz_t));
+    element_init_G1(out, p);
+    int record_size = element_length_in_bytes(out);
+    unsigned char *records = PyMem_RawMalloc((size_t)TUNING_POINTS * record_size);
+    if (!points || !bases || !scalars || !records) {
+        PyMem_RawFree(points);
+        PyMem_RawFree(bases);
+        PyMem_RawFree(scalars);
+        PyMem_RawFree(records);
+        element_clear(out);
+        return;
     }
-    // convert both objects to Elements
-    Element *ele_lft = (Element *)py_lft;
-    Element *ele_rgt = (Element *)py_rgt;
-    // make sure they're in the same ring
-    if (ele_lft->pbc_element->field != ele_rgt->pbc_element->field) {
-        PyErr_SetString(PyExc_ValueError, "only Elements in the same group can be compared");
-        return NULL;
+    for (int i = 0; i < TUNING_POINTS; i++) {
+        element_init_G1(points[i], p);
+        element_random(points[i]);
+        element_to_bytes(records + (size_t)i * record_size, points[i]);
+        bases[i] = points[i];
+        mpz_init(scalars[i]);
+        pbc_mpz_random(scalars[i], p->r);
     }
-    // compare the two elements
-    switch (op) {
-    case Py_EQ:
-        if (element_cmp(ele_lft->pbc_element, ele_rgt->pbc_element)) {
-            Py_RETURN_FALSE;
-        } else {
-            Py_RETURN_TRUE;
+    // the window of unitary exponentiation, on a pairing output
+    if (pairing->gt_unitary) {
+        element_t value, result;
+        element_init_GT(value, p);
+        element_init_GT(result, p);
+        pairing_apply(value, points[0], points[1], p);
+        double fastest = 0;
+        for (int w = 2; w <= 7; w++) {
+            best = 0;
+            for (int k = 0; k < rounds; k++) {
+                start = tuning_clock();
+                gt_unitary_pow_mpz(result, value, scalars[k % TUNING_POINTS], w);
+                time = tuning_clock() - start;
+                best = k == 0 || time < best ? time : best;
+            }
+            if (w == 2 || best < fastest) {
+                tuning->gt_window = w;
+                fastest = best;
+            }
         }
-    case Py_NE:
-        if (element_cmp(ele_lft->pbc_element, ele_rgt->pbc_element)) {
-            Py_RETURN_TRUE;
-        } else {
-            Py_RETURN_FALSE;
+        element_clear(value);
+        element_clear(result);
+    }
+    // the window of Straus' method
+    double fastest = 0;
+    for (int w = 1; w <= 7; w++) {
+        best = 0;
+        for (int k = 0; k < rounds; k++) {
+            start = tuning_clock();
+            Expr_multi_pow(out, bases, scalars, TUNING_BASES, w);
+            time = tuning_clock() - start;
+            best = k == 0 || time < best ? time : best;
         }
-    default:
-        PyErr_SetString(PyExc_ValueError, "only == and != comparisons are supported");
-        return NULL;
+        if (w == 1 || best < fastest) {
+            tuning->multi_pow_window = w;
+            fastest = best;
+        }
+    }
+    // the fewest points for which Pippenger's method beats Straus', both on one thread
+    MsmJob job;
+    job.field = out->field;
+    job.records = records;
+    job.record_size = record_size;
+    job.scalars = scalars;
+    job.begin = 0;
+    element_init(job.result, out->field);
+    double pippenger = 0;
+    tuning->msm_crossover = 2 * TUNING_POINTS;
+    for (Py_ssize_t n = 4; n <= TUNING_POINTS; n *= 2) {
+        double straus = 0;
+        job.end = n;
+        for (int k = 0; k < rounds; k++) {
+            start = tuning_clock();
+            Expr_multi_pow(out, bases, scalars, n, tuning->multi_pow_window);
+            time = tuning_clock() - start;
+            straus = k == 0 || time < straus ? time : straus;
+            start = tuning_clock();
+            msm_job_run(&job);
+            time = tuning_clock() - start;
+            pippenger = k == 0 || time < pippenger ? time : pippenger;
+        }
+        if (pippenger < straus) {
+            tuning->msm_crossover = n;
+            break;
+        }
+    }
+    if (job.end < TUNING_POINTS) {
+        job.end = TUNING_POINTS;
+        pippenger = 0;
+        for (int k = 0; k < rounds; k++) {
+            start = tuning_clock();
+            msm_job_run(&job);
+            time = tuning_clock() - start;
+            pippenger = k == 0 || time < pippenger ? time : pippenger;
+        }
+    }
+    element_clear(job.result);
+    // a thread is worth it when starting it costs at most an eighth of its share of the work
+    double spawn = 0;
+    for (int k = 0; k < rounds; k++) {
+        pthread_t id;
+        start = tuning_clock();
+        if (pthread_create(&id, NULL, tuning_idle, NULL) != 0) {
+            break;
+        }
+        pthread_join(id, NULL);
+        time = tuning_clock() - start;
+        spawn = k == 0 || time < spawn ? time : spawn;
+    }
+    double item = pippenger / TUNING_POINTS;
+    if (spawn > 0 && item > 0) {
+        double items = 8 * spawn / item;
+        tuning->thread_items = items < 16 ? 16 : items > 4096 ? 4096 : (Py_ssize_t)items + 1;
     }
+    for (int i = 0; i < TUNING_POINTS; i++) {
+        element_clear(points[i]);
+        mpz_clear(scalars[i]);
+    }
+    PyMem_RawFree(points);
+    PyMem_RawFree(bases);
+    PyMem_RawFree(scalars);
+    PyMem_RawFree(records);
+    element_clear(out);
 }
 
-PyObject *Element_is0(PyObject *py_element) {
-    // cast the argument
-    Element *element = (Element *)py_element;
-    // check if the element is 0
-    if (element_is0(element->pbc_element)) {
-        Py_RETURN_TRUE;
-    } else {
-        Py_RETURN_FALSE;
+// write the fingerprint of the parameters of a pairing in hexadecimal
+static void Pairing_fingerprint_hex(Pairing *pairing, char *out) {
+    for (size_t i = 0; i < sizeof(pairing->fingerprint); i++) {
+        snprintf(out + 2 * i, 3, "%02x", pairing->fingerprint[i]);
     }
 }
 
-PyObject *Element_is1(PyObject *py_element) {
-    // cast the argument
-    Element *element = (Element *)py_element;
-    // check if the element is 1
-    if (element_is1(element->pbc_element)) {
-        Py_RETURN_TRUE;
-    } else {
-        Py_RETURN_FALSE;
-    }
+// measure the parameters of a pairing and switch to them
+void Pairing_autotune_run(Pairing *pairing, int rounds) {
+    Tuning tuning;
+    lock_acquire(pairing->lock);
+    tuning_load(&tuning, &pairing->tuning);
+    PyThread_release_lock(pairing->lock);
+    Py_BEGIN_ALLOW_THREADS
+    tuning_measure(pairing, &tuning, rounds);
+    Py_END_ALLOW_THREADS
+    lock_acquire(pairing->lock);
+    tuning_store(&pairing->tuning, &tuning);
+    PyThread_release_lock(pairing->lock);
 }
 
-Py_ssize_t Element_len(PyObject *py_element) {
+PyObject *Pairing_tuning(PyObject *py_pairing) {
     // cast the argument
-    Element *element = (Element *)py_element;
-    // check the size of the element
-    Py_ssize_t sz_c = element_item_count(element->pbc_element);
-    // check if the element is in Zr
-    if (sz_c == 0) {
-        PyErr_SetString(PyExc_TypeError, "Element is not dimensioned");
-        return -1;
-    }
-    // return the length of the element
-    return sz_c;
+    Pairing *pairing = (Pairing *)py_pairing;
+    Tuning tuning;
+    lock_acquire(pairing->lock);
+    tuning_load(&tuning, &pairing->tuning);
+    PyThread_release_lock(pairing->lock);
+    // the profile names the parameters it was tuned for by their fingerprint
+    char fingerprint[2 * sizeof(pairing->fingerprint) + 1];
+    Pairing_fingerprint_hex(pairing, fingerprint);
+    return Py_BuildValue("{s:s,s:i,s:i,s:n,s:n,s:i}",
+        "fingerprint", fingerprint,
+        "gt_window", tuning.gt_window,
+        "multi_pow_window", tuning.multi_pow_window,
+        "msm_crossover", tuning.msm_crossover,
+        "thread_items", tuning.thread_items,
+        "threads", tuning.threads);
 }
 
-PyObject *Element_item(PyObject *py_element, Py_ssize_t sz_i) {
-    // cast the argument
-    Element *element = (Element *)py_element;
-    // check the size of the element
-    Py_ssize_t sz_c = element_item_count(element->pbc_element);
-    // check if the element is in Zr
-    if (sz_c == 0) {
-        PyErr_SetString(PyExc_ValueError, "Element is not dimensioned");
+PyObject *Pairing_autotune(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+    // the number of timings of each choice is optional
+    static const char *const keywords[] = {"rounds", NULL};
+    PyObject *slots[1];
+    Py_ssize_t rounds = 3;
+    if (args_bind(args, nargs, kwnames, keywords, 0, slots) < 0 || (slots[0] && args_ssize(slots[0], &rounds) < 0)) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected an optional number of rounds");
         return NULL;
     }
-    // check if the index is in range
-    if (sz_i < 0 || sz_i >= sz_c) {
-        PyErr_SetString(PyExc_IndexError, "index out of range");
+    if (rounds < 1 || rounds > 100) {
+        PyErr_SetString(PyExc_ValueError, "the number of rounds must be between 1 and 100");
         return NULL;
     }
-    // get the item
-    element_ptr item = element_item(element->pbc_element, sz_i);
-    // build the result element
-    Element *ele_res = Element_create();
-    element_init_same_as(ele_res->pbc_element, item);
-    ele_res->pairing = element->pairing;
-    // set the item
-    element_set(ele_res->pbc_element, item);
-    // increment the reference count on the pairing and set the ready flag
-    Py_INCREF(ele_res->pairing);
-    ele_res->ready = 1;
-    return (PyObject *)ele_res;
+    Pairing_autotune_run((Pairing *)py_pairing, (int)rounds);
+    return Pairing_tuning(py_pairing);
 }
 
-PyObject *Element_int(PyObject *py_element) {
-    // cast the argument
-    Element *element = (Element *)py_element;
-    // check the size of the element
-    Py_ssize_t sz_c = element_item_count(element->pbc_element);
-    // check if the element is in Zr
-    if (sz_c != 0) {
-        PyErr_SetString(PyExc_ValueError, "cannot convert multidimensional point to int");
-        return NULL;
+// read one integer of a profile into out when present, within lo and hi
+static int Pairing_tuning_item(PyObject *profile, const char *name, long lo, long hi, Py_ssize_t *out) {
+    PyObject *item = PyDict_GetItemString(profile, name);
+    if (!item) {
+        return 0;
     }
-    // allocate an mpz
-    mpz_t mpz_int;
-    mpz_init(mpz_int);
-    // convert the element to an mpz
-    element_to_mpz(mpz_int, element->pbc_element);
-    // convert the mpz to a Python integer
-    PyObject *py_int = mpz_to_pynum(mpz_int);
-    // clean up the mpz
-    mpz_clear(mpz_int);
-    return py_int;
-}
-
-PyObject *Element_str(PyObject *py_element) {
-    // cast the argument
-    Element *element = (Element *)py_element;
-    // allocate a buffer
-    char buffer[4096];
-    // convert the element to a string
-    int size = element_snprint(buffer, sizeof(buffer), element->pbc_element);
-    // return the string
-    return PyUnicode_FromStringAndSize(buffer, size);
+    Py_ssize_t value;
+    if (args_ssize(item, &value) < 0 || value < lo || value > hi) {
+        PyErr_Format(PyExc_ValueError, "%s must be an integer between %ld and %ld", name, lo, hi);
+        return -1;
+    }
+    *out = value;
+    return 0;
 }
 
-PyObject *Element_order(PyObject *py_element) {
+PyObject *Pairing_set_tuning(PyObject *py_pairing, PyObject *profile) {
     // cast the argument
-    Element *element = (Element *)py_element;
-    // convert the mpz to a Python integer
-    return mpz_to_pynum(element->pbc_element->field->order);
+    Pairing *pairing = (Pairing *)py_pairing;
+    if (!PyDict_Check(profile)) {
+        PyErr_SetString(PyExc_TypeError, "the profile must be a dict");
+        return NULL;
+    }
+    // a profile of other parameters does not apply to these
+    PyObject *fingerprint = PyDict_GetItemString(profile, "fingerprint");
+    if (fingerprint) {
+        char own[2 * sizeof(pairing->fingerprint) + 1];
+        Pairing_fingerprint_hex(pairing, own);
+        const char *given = PyUnicode_Check(fingerprint) ? PyUnicode_AsUTF8(fingerprint) : NULL;
+        if (!given || strcmp(given, own) != 0) {
+            PyErr_SetString(PyExc_ValueError, "the profile was tuned for other parameters");
+            return NULL;
+        }
+    }
+    Tuning tuning;
+    lock_acquire(pairing->lock);
+    tuning_load(&tuning, &pairing->tuning);
+    PyThread_release_lock(pairing->lock);
+    Py_ssize_t gt_window = tuning.gt_window;
+    Py_ssize_t multi_pow_window = tuning.multi_pow_window;
+    Py_ssize_t threads = tuning.threads;
+    if (Pairing_tuning_item(profile, "gt_window", 0, 7, &gt_window) < 0 ||
+        Pairing_tuning_item(profile, "multi_pow_window", 1, 8, &multi_pow_window) < 0 ||
+        Pairing_tuning_item(profile, "msm_crossover", 0, PY_SSIZE_T_MAX, &tuning.msm_crossover) < 0 ||
+        Pairing_tuning_item(profile, "thread_items", 1, PY_SSIZE_T_MAX, &tuning.thread_items) < 0 ||
+        Pairing_tuning_item(profile, "threads", 0, 1024, &threads) < 0) {
+        return NULL;
+    }
+    // the signed digits of a window of 1 would never end the recoding, 0 picks the window
+    if (gt_window == 1) {
+        PyErr_SetString(PyExc_ValueError, "gt_window must be 0 or an integer between 2 and 7");
+        return NULL;
+    }
+    tuning.gt_window = (int)gt_window;
+    tuning.multi_pow_window = (int)multi_pow_window;
+    tuning.threads = (int)threads;
+    lock_acquire(pairing->lock);
+    tuning_store(&pairing->tuning, &tuning);
+    PyThread_release_lock(pairing->lock);
+    Py_RETURN_NONE;
 }
 
-PyMemberDef Element_members[] = {
-    {NULL},
-};
-
-PyMethodDef Element_methods[] = {
-    {"zero", (PyCFunction)Element_zero, METH_VARARGS | METH_CLASS, "Creates an element representing the additive identity for its group."},
-    {"one", (PyCFunction)Element_one, METH_VARARGS | METH_CLASS, "Creates an element representing the multiplicative identity for its group."},
-    {"random", (PyCFunction)Element_random, METH_VARARGS | METH_CLASS, "Creates a random element from the given group."},
-    {"from_int", (PyCFunction)Element_from_int, METH_VARARGS | METH_CLASS, "Creates an element in Zr from the given integer."},
-    {"from_hash", (PyCFunction)Element_from_hash, METH_VARARGS | METH_CLASS, "Creates an Element from the given hash value."},
-    {"from_bytes", (PyCFunction)Element_from_bytes, METH_VARARGS | METH_CLASS, "Creates an element from a byte string."},
-    {"from_bytes_compressed", (PyCFunction)Element_from_bytes_compressed, METH_VARARGS | METH_CLASS, "Creates an element from a byte string using the compressed format."},
-    {"from_bytes_x_only", (PyCFunction)Element_from_bytes_x_only, METH_VARARGS | METH_CLASS, "Creates an element from a byte string using the x-only format."},
-    {"to_bytes", (PyCFunction)Element_to_bytes, METH_NOARGS, "Converts the element to a byte string."},
-    {"to_bytes_x_only", (PyCFunction)Element_to_bytes_x_only, METH_NOARGS, "Converts the element to a byte string using the x-only format."},
-    {"to_bytes_compressed", (PyCFunction)Element_to_bytes_compressed, METH_NOARGS, "Converts the element to a byte string using the compressed format."},
-    {"is0", (PyCFunction)Element_is0, METH_NOARGS, "Returns True if the element is additive identity."},
-    {"is1", (PyCFunction)Element_is1, METH_NOARGS, "Returns True if the element is multiplicative identity."},
-    {"order", (PyCFunction)Element_order, METH_NOARGS, "Returns the order of the element."},
-    {NULL},
-};
-
-PyNumberMethods Element_num_meths = {
-    Element_add,    // binaryfunc nb_add;
-    Element_sub,    // binaryfunc nb_subtract;
-    Element_mul,    // binaryfunc nb_multiply;
-    0,              // binaryfunc nb_remainder;
-    0,              // binaryfunc nb_divmod;
-    Element_pow,    // ternaryfunc nb_power;
-    Element_neg,    // unaryfunc nb_negative;
-    0,              // unaryfunc nb_positive;
-    0,              // unaryfunc nb_absolute;
-    0,              // inquiry nb_bool;
-    Element_invert, // unaryfunc nb_invert;
-    0,              // binaryfunc nb_lshift;
-    0,              // binaryfunc nb_rshift;
-    0,              // binaryfunc nb_and;
-    0,              // binaryfunc nb_xor;
-    0,              // binaryfunc nb_or;
-    Element_int,    // unaryfunc nb_int;
-    0,              // void *nb_reserved;
-    0,              // unaryfunc nb_float;
-    0,              // binaryfunc nb_inplace_add;
-    0,              // binaryfunc nb_inplace_subtract;
-    0,              // binaryfunc nb_inplace_multiply;
-    0,              // binaryfunc nb_inplace_remainder;
-    0,              // ternaryfunc nb_inplace_power;
-    0,              // binaryfunc nb_inplace_lshift;
-    0,              // binaryfunc nb_inplace_rshift;
-    0,              // binaryfunc nb_inplace_and;
-    0,              // binaryfunc nb_inplace_xor;
-    0,              // binaryfunc nb_inplace_or;
-    0,              // binaryfunc nb_floor_divide;
-    Element_div,    // binaryfunc nb_true_divide;
-    0,              // binaryfunc nb_inplace_floor_divide;
-    0,              // binaryfunc nb_inplace_true_divide;
-};
-
-PySequenceMethods Element_sq_meths = {
-    Element_len,    // inquiry sq_length;
-    0,              // binaryfunc sq_concat;
-    0,              // intargfunc sq_repeat;
-    Element_item,   // intargfunc sq_item;
-    0,              // intintargfunc sq_slice;
-    0,              // intobjargproc sq_ass_item;
-    0,              // intintobjargproc sq_ass_slice
-};
-
-PyTypeObject ElementType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    "pypbc.Element",                          /* tp_name */
-    sizeof(Element),                          /* tp_basicsize */
-    0,                                        /* tp_itemsize */
-    (destructor)Element_dealloc,              /* tp_dealloc */
-    0,                                        /* tp_print */
-    0,                                        /* tp_getattr */
-    0,                                        /* tp_setattr */
-    0,                                        /* tp_reserved */
-    Element_str,                              /* tp_repr */
-    &Element_num_meths,                       /* tp_as_number */
-    &Element_sq_meths,                        /* tp_as_sequence */
-    0,                                        /* tp_as_mapping */
-    Element_hash,                             /* tp_hash */
-    0,                                        /* tp_call */
-    Element_str,                              /* tp_str */
-    0,                                        /* tp_getattro */
-    0,                                        /* tp_setattro */
-    0,                                        /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /* tp_flags */
-    Element__doc__,                           /* tp_doc */
-    0,                                        /* tp_traverse */
-    0,                                        /* tp_clear */
-    Element_cmp,                              /* tp_richcompare */
-    0,                                        /* tp_weaklistoffset */
-    0,                                        /* tp_iter */
-    0,                                        /* tp_iternext */
-    Element_methods,                          /* tp_methods */
-    Element_members,                          /* tp_members */
-    0,                                        /* tp_getset */
-    0,                                        /* tp_base */
-    0,                                        /* tp_dict */
-    0,                                        /* tp_descr_get */
-    0,                                        /* tp_descr_set */
-    0,                                        /* tp_dictoffset */
-    0,                                        /* tp_init */
-    0,                                        /* tp_alloc */
-    Element_new,                              /* tp_new */
-};
-
 /*******************************************************************************
 *                                    Module                                    *
 *******************************************************************************/
@@ -1215,46 +11590,315 @@ PyDoc_STRVAR(pypbc__doc__,
     "to the PBC library, allowing for the creation of pairings, elements, and\n"
     "parameters, as well as operations on these objects.\n");
 
+PyObject *pypbc_set_allocator(PyObject *module, PyObject *const *args, Py_ssize_t nargs) {
+    const char *name = NULL;
+    if (nargs != 1 || !PyUnicode_Check(args[0]) || !(name = PyUnicode_AsUTF8(args[0]))) {
+        PyErr_SetString(PyExc_TypeError, "could not parse arguments, expected the name of an allocator");
+        return NULL;
+    }
+    if (strcmp(name, "pool") == 0) {
+        pool_set_enabled(1);
+    } else if (strcmp(name, "system") == 0) {
+        pool_set_enabled(0);
+    } else {
+        PyErr_SetString(PyExc_ValueError, "the allocator must be 'pool' or 'system'");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *pypbc_memory_usage(PyObject *module, PyObject *unused) {
+    PoolUsage usage;
+    pool_usage(&usage);
+    // the peak resident set size is in kilobytes, except on macOS where it is in bytes
+    struct rusage rusage;
+    getrusage(RUSAGE_SELF, &rusage);
+#ifdef __APPLE__
+    unsigned long long max_rss = rusage.ru_maxrss;
+#else
+    unsigned long long max_rss = (unsigned long long)rusage.ru_maxrss * 1024;
+#endif
+    return Py_BuildValue("{s:s,s:n,s:n,s:n,s:n,s:K}",
+        "allocator", usage.enabled ? "pool" : "system",
+        "chunks", (Py_ssize_t)usage.chunks,
+        "reserved", (Py_ssize_t)usage.reserved,
+        "in_use", (Py_ssize_t)usage.in_use,
+        "cached", (Py_ssize_t)(usage.reserved - usage.in_use),
+        "max_rss", max_rss);
+}
+
 PyMethodDef pypbc_methods[] = {
+    {"set_allocator", (PyCFunction)(void (*)(void))pypbc_set_allocator, METH_FASTCALL, "Switches the allocator of GMP and PBC between 'pool' and 'system'."},
+    {"memory_usage", (PyCFunction)pypbc_memory_usage, METH_NOARGS, "Returns the memory held by the pooled allocator and the peak resident set size, in bytes."},
     {NULL},
 };
 
-PyModuleDef pypbc_module = {
-    PyModuleDef_HEAD_INIT,
-    "pypbc",
-    pypbc__doc__,
-    -1,
-    pypbc_methods,
-};
-
-PyMODINIT_FUNC PyInit_pypbc(void) {
-    // initialize the types
-    if (PyType_Ready(&ParametersType) < 0) {
+// the module state of a pypbc type, or of a subclass of one
+ModuleState *pypbc_state(PyTypeObject *type) {
+    PyObject *module = PyType_GetModuleByDef(type, &pypbc_module);
+    if (!module) {
         return NULL;
     }
-    if (PyType_Ready(&PairingType) < 0) {
+    return (ModuleState *)PyModule_GetState(module);
+}
+
+// the module state of the type of an object, or NULL without an exception if it is not a
+// pypbc object
+ModuleState *pypbc_state_of(PyObject *obj) {
+    PyObject *mro = Py_TYPE(obj)->tp_mro;
+    if (!mro) {
         return NULL;
     }
-    if (PyType_Ready(&ElementType) < 0) {
-        return NULL;
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(mro); i++) {
+        PyTypeObject *base = (PyTypeObject *)PyTuple_GET_ITEM(mro, i);
+        if (!(base->tp_flags & Py_TPFLAGS_HEAPTYPE)) {
+            continue;
+        }
+        PyObject *module = ((PyHeapTypeObject *)base)->ht_module;
+        if (module && PyModule_GetDef(module) == &pypbc_module) {
+            return (ModuleState *)PyModule_GetState(module);
+        }
     }
-    // create the module
-    PyObject *module = PyModule_Create(&pypbc_module);
-    if (module == NULL) {
-        return NULL;
+    return NULL;
+}
+
+// the types differ between interpreters, so instances are checked against the types of the
+// module that created them
+int Element_check(PyObject *obj) {
+    ModuleState *state = pypbc_state_of(obj);
+    return state && PyObject_TypeCheck(obj, state->ElementType);
+}
+
+int Exponent_check(PyObject *obj) {
+    ModuleState *state = pypbc_state_of(obj);
+    return state && PyObject_TypeCheck(obj, state->ExponentType);
+}
+
+int Expr_check(PyObject *obj) {
+    ModuleState *state = pypbc_state_of(obj);
+    return state && PyObject_TypeCheck(obj, state->ExprType);
+}
+
+int MillerValue_check(PyObject *obj) {
+    ModuleState *state = pypbc_state_of(obj);
+    return state && PyObject_TypeCheck(obj, state->MillerValueType);
+}
+
+static pthread_once_t pypbc_once = PTHREAD_ONCE_INIT;
+
+// process-wide setup, shared by every interpreter that imports the module
+static void pypbc_setup(void) {
+    // the pooled allocator can be switched on before anything is allocated
+    const char *allocator = getenv("PYPBC_ALLOCATOR");
+    if (allocator && strcmp(allocator, "pool") == 0) {
+        pool_set_enabled(1);
+    }
+    // the worker pool is restarted lazily in forked children
+    pthread_atfork(async_atfork_prepare, async_atfork_parent, async_atfork_child);
+    // pbc seeds its default random source on first use, which is not thread-safe
+    mpz_t limit, z;
+    mpz_init_set_ui(limit, 2);
+    mpz_init(z);
+    pbc_mpz_random(z, limit);
+    mpz_clear(z);
+    mpz_clear(limit);
+}
+
+static int pypbc_exec(PyObject *module) {
+    ModuleState *state = (ModuleState *)PyModule_GetState(module);
+    pthread_once(&pypbc_once, pypbc_setup);
+    // create the types of this interpreter
+    state->ParametersType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &Parameters_spec, NULL);
+    if (!state->ParametersType) {
+        return -1;
+    }
+    state->PairingType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &Pairing_spec, NULL);
+    if (!state->PairingType) {
+        return -1;
+    }
+    state->ElementType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &Element_spec, NULL);
+    if (!state->ElementType) {
+        return -1;
+    }
+    state->ExponentType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &Exponent_spec, NULL);
+    if (!state->ExponentType) {
+        return -1;
+    }
+    state->FixedBaseType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &FixedBase_spec, NULL);
+    if (!state->FixedBaseType) {
+        return -1;
+    }
+    state->HashToGroupType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &HashToGroup_spec, NULL);
+    if (!state->HashToGroupType) {
+        return -1;
+    }
+    state->ElementWriterType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &ElementWriter_spec, NULL);
+    if (!state->ElementWriterType) {
+        return -1;
+    }
+    state->ElementReaderType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &ElementReader_spec, NULL);
+    if (!state->ElementReaderType) {
+        return -1;
+    }
+    state->ElementChunksType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &ElementChunks_spec, NULL);
+    if (!state->ElementChunksType) {
+        return -1;
+    }
+    state->ExprType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &Expr_spec, NULL);
+    if (!state->ExprType) {
+        return -1;
+    }
+    state->ZrMatrixType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &ZrMatrix_spec, NULL);
+    if (!state->ZrMatrixType) {
+        return -1;
+    }
+    state->MillerValueType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &MillerValue_spec, NULL);
+    if (!state->MillerValueType) {
+        return -1;
+    }
+    state->PreparedG2Type = (PyTypeObject *)PyType_FromModuleAndSpec(module, &PreparedG2_spec, NULL);
+    if (!state->PreparedG2Type) {
+        return -1;
+    }
+    state->BlsSchemeType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &BlsScheme_spec, NULL);
+    if (!state->BlsSchemeType) {
+        return -1;
+    }
+    state->VssSchemeType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &VssScheme_spec, NULL);
+    if (!state->VssSchemeType) {
+        return -1;
+    }
+    state->KzgSetupType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &KzgSetup_spec, NULL);
+    if (!state->KzgSetupType) {
+        return -1;
+    }
+    state->AsyncChannelType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &AsyncChannel_spec, NULL);
+    if (!state->AsyncChannelType) {
+        return -1;
+    }
+    state->ArrayBufferType = (PyTypeObject *)PyType_FromModuleAndSpec(module, &ArrayBuffer_spec, NULL);
+    if (!state->ArrayBufferType) {
+        return -1;
+    }
+    // calling the cheap types skips tp_new and its argument tuple, specs only take the
+    // vectorcall slot from 3.14 on, so it is set on the created types
+    state->ElementType->tp_vectorcall = Element_vectorcall;
+    state->ExponentType->tp_vectorcall = Exponent_vectorcall;
+    state->ExprType->tp_vectorcall = Expr_vectorcall;
+    // the channels of the event loops, dropped with their loops
+    PyObject *weakref = PyImport_ImportModule("weakref");
+    if (!weakref) {
+        return -1;
+    }
+    state->async_channels = PyObject_CallMethod(weakref, "WeakKeyDictionary", NULL);
+    Py_DECREF(weakref);
+    if (!state->async_channels) {
+        return -1;
     }
-    // increment the reference count for the types
-    Py_INCREF(&PairingType);
-    Py_INCREF(&ParametersType);
-    Py_INCREF(&ElementType);
     // add the types to the module
-    PyModule_AddObject(module, "Parameters", (PyObject *)&ParametersType);
-    PyModule_AddObject(module, "Pairing", (PyObject *)&PairingType);
-    PyModule_AddObject(module, "Element", (PyObject *)&ElementType);
+    if (PyModule_AddType(module, state->ParametersType) < 0 ||
+        PyModule_AddType(module, state->PairingType) < 0 ||
+        PyModule_AddType(module, state->ElementType) < 0 ||
+        PyModule_AddType(module, state->ExponentType) < 0 ||
+        PyModule_AddType(module, state->FixedBaseType) < 0 ||
+        PyModule_AddType(module, state->HashToGroupType) < 0 ||
+        PyModule_AddType(module, state->ElementWriterType) < 0 ||
+        PyModule_AddType(module, state->ElementReaderType) < 0 ||
+        PyModule_AddType(module, state->ExprType) < 0 ||
+        PyModule_AddType(module, state->ZrMatrixType) < 0 ||
+        PyModule_AddType(module, state->MillerValueType) < 0 ||
+        PyModule_AddType(module, state->PreparedG2Type) < 0) {
+        return -1;
+    }
+    // add the submodules
+    if (bls_add(module, state) < 0 || vss_add(module, state) < 0 || kzg_add(module, state) < 0) {
+        return -1;
+    }
     // add the group constants
-    PyModule_AddObject(module, "G1", PyLong_FromLong(G1));
-    PyModule_AddObject(module, "G2", PyLong_FromLong(G2));
-    PyModule_AddObject(module, "GT", PyLong_FromLong(GT));
-    PyModule_AddObject(module, "Zr", PyLong_FromLong(Zr));
-    return module;
+    if (PyModule_AddIntConstant(module, "G1", G1) < 0 ||
+        PyModule_AddIntConstant(module, "G2", G2) < 0 ||
+        PyModule_AddIntConstant(module, "GT", GT) < 0 ||
+        PyModule_AddIntConstant(module, "Zr", Zr) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int pypbc_traverse(PyObject *module, visitproc visit, void *arg) {
+    ModuleState *state = (ModuleState *)PyModule_GetState(module);
+    Py_VISIT(state->ParametersType);
+    Py_VISIT(state->PairingType);
+    Py_VISIT(state->ElementType);
+    Py_VISIT(state->ExponentType);
+    Py_VISIT(state->FixedBaseType);
+    Py_VISIT(state->HashToGroupType);
+    Py_VISIT(state->ElementWriterType);
+    Py_VISIT(state->ElementReaderType);
+    Py_VISIT(state->ElementChunksType);
+    Py_VISIT(state->ExprType);
+    Py_VISIT(state->ZrMatrixType);
+    Py_VISIT(state->MillerValueType);
+    Py_VISIT(state->PreparedG2Type);
+    Py_VISIT(state->BlsSchemeType);
+    Py_VISIT(state->VssSchemeType);
+    Py_VISIT(state->KzgSetupType);
+    Py_VISIT(state->AsyncChannelType);
+    Py_VISIT(state->ArrayBufferType);
+    Py_VISIT(state->async_channels);
+    return 0;
+}
+
+static int pypbc_clear(PyObject *module) {
+    ModuleState *state = (ModuleState *)PyModule_GetState(module);
+    Py_CLEAR(state->ParametersType);
+    Py_CLEAR(state->PairingType);
+    Py_CLEAR(state->ElementType);
+    Py_CLEAR(state->ExponentType);
+    Py_CLEAR(state->FixedBaseType);
+    Py_CLEAR(state->HashToGroupType);
+    Py_CLEAR(state->ElementWriterType);
+    Py_CLEAR(state->ElementReaderType);
+    Py_CLEAR(state->ElementChunksType);
+    Py_CLEAR(state->ExprType);
+    Py_CLEAR(state->ZrMatrixType);
+    Py_CLEAR(state->MillerValueType);
+    Py_CLEAR(state->PreparedG2Type);
+    Py_CLEAR(state->BlsSchemeType);
+    Py_CLEAR(state->VssSchemeType);
+    Py_CLEAR(state->KzgSetupType);
+    Py_CLEAR(state->AsyncChannelType);
+    Py_CLEAR(state->ArrayBufferType);
+    Py_CLEAR(state->async_channels);
+    return 0;
+}
+
+static void pypbc_free(void *module) {
+    pypbc_clear((PyObject *)module);
+}
+
+PyModuleDef_Slot pypbc_slots[] = {
+    {Py_mod_exec, pypbc_exec},
+#if PY_VERSION_HEX >= 0x030C0000
+    {Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+#if PY_VERSION_HEX >= 0x030D0000
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+    {0, NULL},
+};
+
+PyModuleDef pypbc_module = {
+    PyModuleDef_HEAD_INIT,
+    "pypbc",
+    pypbc__doc__,
+    sizeof(ModuleState),
+    pypbc_methods,
+    pypbc_slots,
+    pypbc_traverse,
+    pypbc_clear,
+    pypbc_free,
+};
+
+PyMODINIT_FUNC PyInit_pypbc(void) {
+    return PyModuleDef_Init(&pypbc_module);
 }
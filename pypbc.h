@@ -8,6 +8,9 @@
 // pbc stuff
 #include <pbc/pbc.h>
 
+// threads for the async worker pool
+#include <pthread.h>
+
 /*******************************************************************************
 * pypbc.c                                                                      *
 *                                                                              *
@@ -27,6 +30,214 @@
 // used to see which group a given element is in
 enum Group {G1, G2, GT, Zr};
 
+// the pooled allocator of GMP and PBC, and what it holds
+typedef struct {
+    int enabled;
+    size_t chunks;
+    size_t reserved;
+    size_t in_use;
+} PoolUsage;
+
+void pool_set_enabled(int enabled);
+void pool_usage(PoolUsage *usage);
+
+// SHA-256, for fingerprints and checksums
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    unsigned char buffer[64];
+    size_t used;
+} Sha256;
+
+void sha256_init(Sha256 *ctx);
+void sha256_update(Sha256 *ctx, const void *data, size_t size);
+void sha256_final(Sha256 *ctx, unsigned char *digest);
+void sha256(const void *data, size_t size, unsigned char *digest);
+
+// SHA-512, for expand_message_xmd
+typedef struct {
+    uint64_t state[8];
+    uint64_t length;
+    unsigned char buffer[128];
+    size_t used;
+} Sha512;
+
+void sha512_init(Sha512 *ctx);
+void sha512_update(Sha512 *ctx, const void *data, size_t size);
+void sha512_final(Sha512 *ctx, unsigned char *digest);
+
+// SHA-256 or SHA-512, told apart by the digest size
+typedef struct {
+    int digest_size;
+    union {
+        Sha256 sha256;
+        Sha512 sha512;
+    };
+} Hash;
+
+void hash_init(Hash *ctx, int digest_size);
+void hash_update(Hash *ctx, const void *data, size_t size);
+void hash_final(Hash *ctx, unsigned char *digest);
+int hash_block_size(Hash *ctx);
+void expand_message_xmd(Hash *msg, const unsigned char *dst, size_t dst_size, unsigned char *out, size_t size);
+
+// replaces the Zr field of a pairing with the fixed-limb Montgomery engine
+int zr_engine_install(pairing_ptr pairing);
+
+// the curve of G1 over a prime field, for decompressing points without PBC
+typedef struct G1Curve G1Curve;
+int g1_curve_coefficients(pairing_ptr pairing, mpz_t q, mpz_t a, mpz_t b);
+G1Curve *g1_curve_create(pairing_ptr pairing);
+void g1_curve_free(G1Curve *c);
+void decompress_batch(G1Curve *curve, int (*decode)(element_ptr, unsigned char *), element_ptr *outs, const unsigned char *data, int size, Py_ssize_t count, int threads);
+
+// compression of GT to the torus T2 when the embedding degree is 2
+int gt_torus_setup(field_ptr gt, element_ptr v);
+int gt_length_in_bytes_compressed(field_ptr gt);
+int gt_to_bytes_compressed(unsigned char *data, element_ptr e);
+int gt_from_bytes_compressed(element_ptr e, unsigned char *data);
+void gt_unitary_invert(element_ptr out, element_ptr e);
+void gt_unitary_pow(element_ptr out, element_ptr base, signed char *digits, Py_ssize_t length, int window);
+void gt_unitary_pow_mpz(element_ptr out, element_ptr base, mpz_t exp, int window);
+
+// the Miller loop and the final exponentiation of type A pairings, apart from each other
+typedef struct MillerCurve MillerCurve;
+MillerCurve *miller_curve_create(pairing_ptr pairing);
+void miller_curve_free(MillerCurve *m);
+void miller_loop(MillerCurve *m, element_ptr out, element_ptr *lefts, element_ptr *rights, Py_ssize_t count);
+void miller_final_exponentiation(MillerCurve *m, element_ptr out, element_ptr value);
+
+// the ate pairing of types D and F, with the lines of fixed G2 points precomputed
+typedef struct AteCurve AteCurve;
+typedef struct AteLines AteLines;
+AteCurve *ate_curve_create(pairing_ptr pairing);
+void ate_curve_free(AteCurve *a);
+int ate_curve_accepts(AteCurve *a, element_ptr point);
+AteLines *ate_lines_create(AteCurve *a, element_ptr point);
+void ate_lines_free(AteLines *lines);
+void ate_evaluate(AteCurve *a, element_ptr out, AteLines **lines, element_ptr *points, Py_ssize_t count);
+
+// a multi-pairing of PBC that leaves out the pairs with the identity
+void prod_pairing_nonzero(element_ptr out, element_t *in1, element_t *in2, Py_ssize_t count, pairing_ptr pairing);
+
+// the curve of G1 prepared for multi-lane SIMD arithmetic
+typedef struct G1Lanes G1Lanes;
+G1Lanes *g1_lanes_create(pairing_ptr pairing);
+void g1_lanes_free(G1Lanes *g);
+int g1_lanes_pow(G1Lanes *g, element_ptr *outs, element_ptr *bases, mpz_t *exps, Py_ssize_t count);
+
+// a bounded, thread-safe lru map from bytes to bytes
+typedef struct CacheEntry {
+    struct CacheEntry *prev;
+    struct CacheEntry *next;
+    struct CacheEntry *chain;
+    Py_hash_t hash;
+    PyObject *key;
+    PyObject *value;
+} CacheEntry;
+
+typedef struct {
+    PyThread_type_lock lock;
+    Py_ssize_t capacity;
+    Py_ssize_t size;
+    Py_ssize_t buckets_size;
+    CacheEntry **buckets;
+    CacheEntry *head;
+    CacheEntry *tail;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+} Cache;
+
+int cache_init(Cache *cache);
+PyObject *cache_get(Cache *cache, PyObject *key);
+void cache_put(Cache *cache, PyObject *key, PyObject *value);
+void cache_resize(Cache *cache, Py_ssize_t capacity);
+void cache_clear(Cache *cache);
+void cache_free(Cache *cache);
+
+// the per-interpreter state of the module, the heap types and the channels of its loops
+typedef struct {
+    PyTypeObject *ParametersType;
+    PyTypeObject *PairingType;
+    PyTypeObject *ElementType;
+    PyTypeObject *ExponentType;
+    PyTypeObject *FixedBaseType;
+    PyTypeObject *HashToGroupType;
+    PyTypeObject *ElementWriterType;
+    PyTypeObject *ElementReaderType;
+    PyTypeObject *ElementChunksType;
+    PyTypeObject *ExprType;
+    PyTypeObject *ZrMatrixType;
+    PyTypeObject *MillerValueType;
+    PyTypeObject *PreparedG2Type;
+    PyTypeObject *BlsSchemeType;
+    PyTypeObject *VssSchemeType;
+    PyTypeObject *KzgSetupType;
+    PyTypeObject *AsyncChannelType;
+    PyTypeObject *ArrayBufferType;
+    PyObject *async_channels;
+} ModuleState;
+
+PyModuleDef pypbc_module;
+ModuleState *pypbc_state(PyTypeObject *type);
+ModuleState *pypbc_state_of(PyObject *obj);
+int Element_check(PyObject *obj);
+int Exponent_check(PyObject *obj);
+int Expr_check(PyObject *obj);
+int MillerValue_check(PyObject *obj);
+
+// takes a lock, releasing the GIL while waiting for it
+void lock_acquire(PyThread_type_lock lock);
+
+// hand-rolled argument checks for the METH_FASTCALL entry points, -1 on a mismatch
+int args_bind(PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames, const char *const *keywords, Py_ssize_t required, PyObject **slots);
+int args_int(PyObject *arg, int *value);
+int args_group(PyObject *arg, enum Group *group);
+int args_ssize(PyObject *arg, Py_ssize_t *value);
+int args_bool(PyObject *arg, int *value);
+
+// a computation handed to the native worker pool, run without the GIL and completed on the
+// asyncio loop of its future; run returns -1 if memory runs out, finish builds the result
+// (or raises) and clear releases the inputs, both with the GIL
+typedef struct AsyncJob AsyncJob;
+struct AsyncJob {
+    AsyncJob *next;
+    int (*run)(AsyncJob *job);
+    PyObject *(*finish)(AsyncJob *job);
+    void (*clear)(AsyncJob *job);
+    int status;
+    PyObject *future;
+    PyObject *channel;
+};
+
+// the finished jobs of one event loop and the self-pipe that wakes it up, linked to the
+// other live channels so that a fork can reach them
+typedef struct AsyncChannel AsyncChannel;
+struct AsyncChannel {
+    PyObject_HEAD
+    int ready;
+    int fds[2];
+    pthread_mutex_t mutex;
+    AsyncJob *done;
+    AsyncChannel *prev;
+    AsyncChannel *next;
+};
+
+PyObject *async_loop(void);
+PyObject *async_submit(ModuleState *state, AsyncJob *job);
+PyObject *async_resolved(PyObject *result);
+void async_atfork_prepare(void);
+void async_atfork_parent(void);
+void async_atfork_child(void);
+
+PyObject *AsyncChannel_create(ModuleState *state);
+void AsyncChannel_dealloc(AsyncChannel *channel);
+
+PyMethodDef AsyncChannel_methods[];
+PyType_Slot AsyncChannel_slots[];
+PyType_Spec AsyncChannel_spec;
+
 // We're going to need a few types
 // the param type
 typedef struct {
@@ -35,28 +246,82 @@ typedef struct {
     pbc_param_t pbc_params;
 } Parameters;
 
-Parameters *Parameters_create();
+Parameters *Parameters_create(PyTypeObject *type);
 PyObject *Parameters_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
 void Parameters_dealloc(Parameters *parameter);
+char *Parameters_to_buffer(pbc_param_ptr pbc_params, size_t *length);
 
 PyMemberDef Parameters_members[];
 PyMethodDef Parameters_methods[];
-PyTypeObject ParametersType;
+PyType_Slot Parameters_slots[];
+PyType_Spec Parameters_spec;
+
+// the parameters of the exponentiation and batch algorithms of a pairing, measured on the
+// host by Pairing.autotune
+typedef struct {
+    int gt_window; // the NAF window of unitary exponentiation in GT, 0 picks it by exponent size
+    int multi_pow_window; // the window of Straus' multi-exponentiation
+    Py_ssize_t msm_crossover; // the fewest points for which Pippenger's method is used
+    Py_ssize_t thread_items; // the fewest items worth a thread in the batch operations
+    int threads; // the most threads of the batch operations, 0 for one per processor
+} Tuning;
+
+void tuning_defaults(Tuning *tuning);
+void tuning_load(Tuning *out, const Tuning *tuning);
+void tuning_store(Tuning *tuning, const Tuning *in);
+int tuning_threads(const Tuning *tuning, Py_ssize_t count);
 
 // the pairing type
 typedef struct {
     PyObject_HEAD
     int ready;
+    ModuleState *state;
     pairing_t pbc_pairing;
+    PyThread_type_lock lock; // guards the lazily built helpers below
+    G1Lanes *g1_lanes;
+    int g1_lanes_tried;
+    G1Curve *g1_curve;
+    int g1_curve_tried;
+    MillerCurve *miller_curve;
+    int miller_curve_tried;
+    AteCurve *ate_curve;
+    int ate_curve_tried;
+    Tuning tuning;
+    int gt_unitary; // GT is quadratic, so its unitary elements get the fast paths
+    mpz_t *factors; // the prime factors of the order, when the pairing is trusted with them
+    int factor_count;
+    unsigned char fingerprint[32];
+    Cache cache;
 } Pairing;
 
-Pairing *Pairing_create();
+Pairing *Pairing_create(PyTypeObject *type, ModuleState *state);
 PyObject *Pairing_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
 void Pairing_dealloc(Pairing *pairing);
+G1Lanes *Pairing_g1_lanes(Pairing *pairing);
+G1Curve *Pairing_g1_curve(Pairing *pairing);
+MillerCurve *Pairing_miller_curve(Pairing *pairing);
+AteCurve *Pairing_ate_curve(Pairing *pairing);
+void Pairing_autotune_run(Pairing *pairing, int rounds);
+PyObject *Pairing_autotune(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames);
+PyObject *Pairing_tuning(PyObject *py_pairing);
+PyObject *Pairing_set_tuning(PyObject *py_pairing, PyObject *profile);
+field_ptr Pairing_field(Pairing *pairing, enum Group group);
+int Pairing_group(Pairing *pairing, field_ptr field);
+int Pairing_exponent_to_mpz(Pairing *pairing, mpz_t mpz_exp, PyObject *py_exp);
+mpz_t *Pairing_scalars(Pairing *pairing, PyObject *py_values, Py_ssize_t *count);
+void mpz_array_free(mpz_t *scalars, Py_ssize_t count);
+void Pairing_cache_store(Pairing *pairing, PyObject *key, element_ptr element);
+int Pairing_in_subgroup(Pairing *pairing, element_ptr element);
+int Pairing_set_factors(Pairing *pairing, PyObject *py_factors);
+void Pairing_project_range(Pairing *pairing, element_ptr *outs, element_ptr element, int lo, int hi);
+PyObject *Pairing_validate_collect(Pairing *pairing, PyObject *py_elements, G1Lanes **lanes);
+int Pairing_validate_elements(Pairing *pairing, G1Lanes *lanes, element_ptr *elements, Py_ssize_t count, signed char *valid);
+PyObject *Pairing_validate_result(signed char *valid, Py_ssize_t count);
 
 PyMemberDef Pairing_members[];
 PyMethodDef Pairing_methods[];
-PyTypeObject PairingType;
+PyType_Slot Pairing_slots[];
+PyType_Spec Pairing_spec;
 
 // the element type
 typedef struct {
@@ -64,12 +329,367 @@ typedef struct {
     int ready;
     element_t pbc_element;
     Pairing *pairing;
+    int unitary; // known to be a unitary element of a quadratic GT
+    int subgroup; // one more than the index of the prime subgroup it is known to lie in, or 0
 } Element;
 
-Element *Element_create();
+Element *Element_create(Pairing *pairing);
+Element *Element_create_in(Pairing *pairing, enum Group group);
+PyObject *Element_from_str(Pairing *pairing, enum Group group, const char *string);
 PyObject *Element_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+PyObject *Element_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames);
 void Element_dealloc(Element *element);
+void Element_raise(Element *ele_res, Element *ele_base, mpz_t mpz_exp);
+void Element_mul_mpz(Element *ele_res, Element *ele_arg, mpz_t mpz_arg);
+void Element_mul_zn(Element *ele_res, Element *ele_arg, Element *ele_zn);
+int Element_check_decoded(Element *element, unsigned char *bytes, Py_ssize_t size, int (*encode)(unsigned char *, element_ptr));
+
+// the two halves of Pairing.apply around the pairing itself, which needs no GIL
+Element *Pairing_apply_begin(Pairing *pairing, PyObject *py_lft, PyObject *py_rgt, element_ptr *in1, element_ptr *in2, PyObject **key, int *pending);
+PyObject *Pairing_apply_end(Pairing *pairing, Element *ele_res, PyObject *key);
 
 PyMemberDef Element_members[];
 PyMethodDef Element_methods[];
-PyTypeObject ElementType;
+PyType_Slot Element_slots[];
+PyType_Spec Element_spec;
+
+// the precomputed exponent type
+typedef struct {
+    PyObject_HEAD
+    int ready;
+    mpz_t value;
+    int window;
+    Py_ssize_t length;
+    signed char *digits;
+} Exponent;
+
+int naf_window(size_t bits);
+Py_ssize_t naf_recode(signed char *digits, mpz_t value, int window);
+
+Exponent *Exponent_create(PyTypeObject *type);
+PyObject *Exponent_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+PyObject *Exponent_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames);
+PyObject *Exponent_from_value(PyTypeObject *type, PyObject *py_val);
+void Exponent_dealloc(Exponent *exponent);
+void Exponent_apply(element_ptr out, element_ptr base, Exponent *exponent);
+void Element_raise_recoded(Element *ele_res, Element *ele_base, Exponent *exponent);
+
+PyMemberDef Exponent_members[];
+PyMethodDef Exponent_methods[];
+PyType_Slot Exponent_slots[];
+PyType_Spec Exponent_spec;
+
+// the fixed-base table type, the table is either owned or part of a mapped file
+typedef struct {
+    PyObject_HEAD
+    int ready;
+    Pairing *pairing;
+    enum Group group;
+    int window;
+    int windows;
+    int entry_size;
+    unsigned char *table;
+    size_t table_size;
+    void *mapping;
+    size_t mapping_size;
+} FixedBase;
+
+void le32_store(unsigned char *p, uint32_t v);
+uint32_t le32_load(const unsigned char *p);
+void le64_store(unsigned char *p, uint64_t v);
+uint64_t le64_load(const unsigned char *p);
+
+FixedBase *FixedBase_create(PyTypeObject *type);
+PyObject *FixedBase_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void FixedBase_dealloc(FixedBase *fixed);
+void FixedBase_apply(FixedBase *fixed, element_ptr out, mpz_t mpz_exp);
+PyObject *FixedBase_pow(PyObject *py_fixed, PyObject *py_exp);
+
+PyMemberDef FixedBase_members[];
+PyMethodDef FixedBase_methods[];
+PyType_Slot FixedBase_slots[];
+PyType_Spec FixedBase_spec;
+
+// the element file types, a header followed by fixed-size records of one group; the writer
+// buffers the records, the reader maps the file and decodes them on access
+typedef struct {
+    PyObject_HEAD
+    int ready;
+    Pairing *pairing;
+    enum Group group;
+    int record_size;
+    FILE *fp;
+    unsigned char *buffer;
+    size_t used;
+    uint64_t count;
+    Sha256 checksum;
+    PyThread_type_lock lock;
+} ElementWriter;
+
+typedef struct {
+    PyObject_HEAD
+    int ready;
+    Pairing *pairing;
+    enum Group group;
+    int record_size;
+    Py_ssize_t count;
+    int validate;
+    unsigned char *records;
+    void *mapping;
+    size_t mapping_size;
+    Py_ssize_t shape[2]; // of the records, exported through the buffer protocol
+    Py_ssize_t strides[2];
+} ElementReader;
+
+// the iterator of ElementReader.chunks
+typedef struct {
+    PyObject_HEAD
+    ElementReader *reader;
+    Py_ssize_t position;
+    Py_ssize_t size;
+} ElementChunks;
+
+ElementWriter *ElementWriter_create(PyTypeObject *type);
+PyObject *ElementWriter_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void ElementWriter_dealloc(ElementWriter *writer);
+ElementReader *ElementReader_create(PyTypeObject *type);
+PyObject *ElementReader_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void ElementReader_dealloc(ElementReader *reader);
+PyObject *Pairing_element_list(Pairing *pairing, field_ptr field, Py_ssize_t count, element_ptr *outs);
+PyObject *Pairing_decode_records(Pairing *pairing, field_ptr field, unsigned char *records, int record_size, Py_ssize_t count, int validate);
+PyObject *ElementReader_decode(ElementReader *reader, Py_ssize_t start, Py_ssize_t count);
+int ElementReader_getbuffer(PyObject *py_reader, Py_buffer *view, int flags);
+void ElementChunks_dealloc(ElementChunks *chunks);
+
+PyMemberDef ElementWriter_members[];
+PyMethodDef ElementWriter_methods[];
+PyType_Slot ElementWriter_slots[];
+PyType_Spec ElementWriter_spec;
+PyMemberDef ElementReader_members[];
+PyMethodDef ElementReader_methods[];
+PyType_Slot ElementReader_slots[];
+PyType_Spec ElementReader_spec;
+PyType_Slot ElementChunks_slots[];
+PyType_Spec ElementChunks_spec;
+
+// the packed storage behind the arrays of Pairing.to_array and Pairing.to_int_array, rows of
+// fixed-size items exported through the buffer protocol
+typedef struct {
+    PyObject_HEAD
+    unsigned char *data;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+    Py_ssize_t itemsize;
+    char format[2];
+} ArrayBuffer;
+
+ArrayBuffer *ArrayBuffer_create(ModuleState *state, int ndim, Py_ssize_t rows, Py_ssize_t width, Py_ssize_t itemsize, char format);
+void ArrayBuffer_dealloc(ArrayBuffer *buffer);
+int ArrayBuffer_getbuffer(PyObject *py_buffer, Py_buffer *view, int flags);
+PyObject *ArrayBuffer_view(ArrayBuffer *buffer);
+PyObject *Pairing_array_elements(Pairing *pairing, PyObject *py_elements, field_ptr *field);
+element_ptr *Pairing_array_pointers(PyObject *elements);
+Py_ssize_t Pairing_zr_limbs(Pairing *pairing);
+uint64_t array_item(unsigned char *item, Py_ssize_t size, int is_signed);
+PyObject *Pairing_to_array(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs);
+PyObject *Pairing_from_array(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames);
+PyObject *Pairing_to_int_array(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames);
+PyObject *Pairing_from_int_array(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs);
+
+PyType_Slot ArrayBuffer_slots[];
+PyType_Spec ArrayBuffer_spec;
+
+// the streaming hash-to-group type, the message is absorbed into the hash context and
+// expanded with expand_message_xmd when finalized
+typedef struct {
+    PyObject_HEAD
+    int ready;
+    Pairing *pairing;
+    enum Group group;
+    Hash hash;
+    unsigned char dst[255];
+    int dst_size;
+    field_ptr base;
+    int items;
+    int item_size;
+    int uniform_size;
+    PyThread_type_lock lock;
+} HashToGroup;
+
+HashToGroup *HashToGroup_create(PyTypeObject *type);
+PyObject *HashToGroup_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void HashToGroup_dealloc(HashToGroup *hasher);
+void HashToGroup_map(HashToGroup *hasher, Hash *ctx, element_ptr out);
+
+PyMemberDef HashToGroup_members[];
+PyMethodDef HashToGroup_methods[];
+PyType_Slot HashToGroup_slots[];
+PyType_Spec HashToGroup_spec;
+
+// the lazy expression type, a product of elements and pairings raised to integer powers,
+// the right element of a term is NULL unless the term is a pairing
+typedef struct {
+    PyObject *lft;
+    PyObject *rgt;
+    mpz_t exp;
+} ExprTerm;
+
+typedef struct {
+    PyObject_HEAD
+    int ready;
+    Pairing *pairing;
+    field_ptr field;
+    Py_ssize_t count;
+    ExprTerm *terms;
+} Expr;
+
+Expr *Expr_create(ModuleState *state, Pairing *pairing, field_ptr field, Py_ssize_t count);
+Expr *Expr_from_element(Element *element);
+PyObject *Expr_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+PyObject *Expr_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames);
+void Expr_dealloc(Expr *expr);
+void Expr_push(Expr *expr, PyObject *lft, PyObject *rgt, mpz_t exp);
+void Expr_multi_pow(element_ptr out, element_ptr *bases, mpz_t *exps, Py_ssize_t count, int window);
+PyObject *Element_lazy(PyObject *py_element);
+PyObject *Pairing_apply_lazy(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs);
+
+PyMemberDef Expr_members[];
+PyMethodDef Expr_methods[];
+PyType_Slot Expr_slots[];
+PyType_Spec Expr_spec;
+
+// the matrix type over Zr, the entries are packed row by row as canonical integers of as many
+// limbs as the order
+typedef struct {
+    PyObject_HEAD
+    int ready;
+    Pairing *pairing;
+    Py_ssize_t rows;
+    Py_ssize_t cols;
+    int limbs;
+    mp_limb_t *data;
+} ZrMatrix;
+
+ZrMatrix *ZrMatrix_create(PyTypeObject *type);
+PyObject *ZrMatrix_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void ZrMatrix_dealloc(ZrMatrix *matrix);
+PyObject *ZrMatrix_mul_vector(PyObject *py_matrix, PyObject *py_vector);
+PyObject *ZrMatrix_reconstruction(PyObject *py_matrix, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames);
+
+PyMemberDef ZrMatrix_members[];
+PyMethodDef ZrMatrix_methods[];
+PyType_Slot ZrMatrix_slots[];
+PyType_Spec ZrMatrix_spec;
+
+// the product of Miller loops of a pairing, an element of the field of GT that is not yet
+// raised to the final exponent
+typedef struct {
+    PyObject_HEAD
+    int ready;
+    Pairing *pairing;
+    element_t value;
+} MillerValue;
+
+MillerValue *MillerValue_create(Pairing *pairing);
+PyObject *MillerValue_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void MillerValue_dealloc(MillerValue *value);
+PyObject *Pairing_miller_loop(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs);
+PyObject *Pairing_final_exponentiation(PyObject *py_pairing, PyObject *py_value);
+
+PyMemberDef MillerValue_members[];
+PyMethodDef MillerValue_methods[];
+PyType_Slot MillerValue_slots[];
+PyType_Spec MillerValue_spec;
+
+// an element of G2 with the lines of its ate loop for types D and F; otherwise ate is NULL and
+// the pairings go through PBC
+typedef struct {
+    PyObject_HEAD
+    int ready;
+    Pairing *pairing;
+    PyObject *element;
+    AteLines *ate;
+} PreparedG2;
+
+PyObject *PreparedG2_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void PreparedG2_dealloc(PreparedG2 *prepared);
+PyObject *Pairing_prepare(PyObject *py_pairing, PyObject *py_element);
+PyObject *Pairing_apply_product(PyObject *py_pairing, PyObject *const *args, Py_ssize_t nargs);
+PyObject *PreparedG2_apply(PyObject *py_prepared, PyObject *py_element);
+
+PyMemberDef PreparedG2_members[];
+PyMethodDef PreparedG2_methods[];
+PyType_Slot PreparedG2_slots[];
+PyType_Spec PreparedG2_spec;
+
+// the bls signature scheme type, signatures are in G1 and public keys in G2
+typedef struct {
+    PyObject_HEAD
+    int ready;
+    Pairing *pairing;
+    PyObject *generator;
+    PyObject *table; // a FixedBase of the generator, for public keys
+    PyObject *hasher; // a HashToGroup into G1 that has absorbed only the padding
+    element_t neg_generator;
+    int validate;
+} BlsScheme;
+
+BlsScheme *BlsScheme_create(PyTypeObject *type);
+PyObject *BlsScheme_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void BlsScheme_dealloc(BlsScheme *scheme);
+int BlsScheme_hash(BlsScheme *scheme, PyObject *py_msg, element_ptr out);
+int BlsScheme_check(BlsScheme *scheme, PyObject *obj, enum Group group, int validate);
+
+PyMemberDef BlsScheme_members[];
+PyMethodDef BlsScheme_methods[];
+PyType_Slot BlsScheme_slots[];
+PyType_Spec BlsScheme_spec;
+
+// the verifiable secret sharing type, Feldman's without a blinding generator and Pedersen's with one
+typedef struct {
+    PyObject_HEAD
+    int ready;
+    Pairing *pairing;
+    field_ptr field; // the group of the generators and the commitments
+    PyObject *generator;
+    PyObject *blinding; // the blinding generator, or NULL
+    PyObject *table; // FixedBases of the generators, for commitments
+    PyObject *blinding_table;
+} VssScheme;
+
+VssScheme *VssScheme_create(PyTypeObject *type);
+PyObject *VssScheme_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void VssScheme_dealloc(VssScheme *scheme);
+PyObject *VssScheme_commitments(VssScheme *scheme, PyObject *py_commitments);
+int VssScheme_index(VssScheme *scheme, PyObject *py_index, mpz_t index);
+int VssScheme_check(VssScheme *scheme, PyObject *commitments, mpz_t *exps, mpz_t share, mpz_t blinding_share);
+int VssScheme_blinding_share(VssScheme *scheme, PyObject *py_share, mpz_t share);
+
+PyMemberDef VssScheme_members[];
+PyMethodDef VssScheme_methods[];
+PyType_Slot VssScheme_slots[];
+PyType_Spec VssScheme_spec;
+
+// the KZG setup, the powers of tau in G1 packed as records and what verifications pair with
+typedef struct {
+    PyObject_HEAD
+    int ready;
+    Pairing *pairing;
+    unsigned char *powers; // the records of g^(tau^i), for i up to the degree
+    int record_size;
+    Py_ssize_t count;
+    element_t g1; // the generator of G1, the first power
+    element_t g2;
+    element_t neg_g2_tau; // the inverse of h^tau, so that verifications are one product of pairings
+} KzgSetup;
+
+void msm_packed(element_ptr out, const unsigned char *records, int record_size, mpz_t *scalars, Py_ssize_t count, const Tuning *tuning);
+KzgSetup *KzgSetup_create(PyTypeObject *type);
+PyObject *KzgSetup_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void KzgSetup_dealloc(KzgSetup *setup);
+mpz_t *KzgSetup_coefficients(KzgSetup *setup, PyObject *py_coefficients, Py_ssize_t *count);
+
+PyMethodDef KzgSetup_methods[];
+PyType_Slot KzgSetup_slots[];
+PyType_Spec KzgSetup_spec;
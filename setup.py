@@ -11,5 +11,6 @@ setup(
     author="Jemtaly (original by Geremy Condra)",
     author_email="Jemtaly@outlook.com",
     url="https://www.github.com/Jemtaly/pypbc",
+    python_requires=">=3.11",
     ext_modules=[pypbc_module],
 )
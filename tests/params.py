@@ -0,0 +1,305 @@
+#! /usr/bin/env python3
+
+# Parameters of the pairings the tests run on: the type A parameters of the README, and type F
+# (Barreto-Naehrig) and type D (MNT, embedding degree 6) parameters generated here, small enough
+# to be found in about a second. The type D curve has a cofactor, so G1 has points outside
+# the subgroup of order r.
+
+import random
+
+from pypbc import *
+
+TYPE_A = (
+    "type a\n"
+    "q 8780710799663312522437781984754049815806883199414208211028653399266475630880222957078625179422662221423155858769582317459277713367317481324925129998224791\n"
+    "h 12016012264891146079388821366740534204802954401251311822919615131047207289359704531102844802183906537786776\n"
+    "r 730750818665451621361119245571504901405976559617\n"
+    "exp2 159\n"
+    "exp1 107\n"
+    "sign1 1\n"
+    "sign0 1\n"
+)
+
+
+def is_prime(n):
+    # Miller-Rabin with fixed bases, exact far beyond the sizes used here
+    if n < 2:
+        return False
+    for p in (2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37):
+        if n % p == 0:
+            return n == p
+    d, s = n - 1, 0
+    while d % 2 == 0:
+        d, s = d // 2, s + 1
+    for a in (2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37):
+        x = pow(a, d, n)
+        if x in (1, n - 1):
+            continue
+        for _ in range(s - 1):
+            x = x * x % n
+            if x == n - 1:
+                break
+        else:
+            return False
+    return True
+
+
+def is_square(a, q):
+    return a % q == 0 or pow(a, (q - 1) // 2, q) == 1
+
+
+def sqrt(a, q):
+    # Tonelli-Shanks
+    a %= q
+    if a == 0:
+        return 0
+    d, s = q - 1, 0
+    while d % 2 == 0:
+        d, s = d // 2, s + 1
+    z = 2
+    while is_square(z, q):
+        z += 1
+    m, c, t, x = s, pow(z, d, q), pow(a, d, q), pow(a, (d + 1) // 2, q)
+    while t != 1:
+        i, u = 0, t
+        while u != 1:
+            u, i = u * u % q, i + 1
+        b = pow(c, 1 << (m - i - 1), q)
+        m, c, t, x = i, b * b % q, t * b * b % q, x * b % q
+    return x
+
+
+def non_residue(q):
+    n = 2
+    while is_square(n, q):
+        n += 1
+    return n
+
+
+def curve_add(P, Q, a, q):
+    # affine addition on y^2 = x^3 + a x + b, None is the point at infinity
+    if P is None:
+        return Q
+    if Q is None:
+        return P
+    if P[0] == Q[0] and (P[1] + Q[1]) % q == 0:
+        return None
+    if P == Q:
+        slope = (3 * P[0] * P[0] + a) * pow(2 * P[1], -1, q) % q
+    else:
+        slope = (Q[1] - P[1]) * pow(Q[0] - P[0], -1, q) % q
+    x = (slope * slope - P[0] - Q[0]) % q
+    return x, (slope * (P[0] - x) - P[1]) % q
+
+
+def curve_mul(P, n, a, q):
+    R = None
+    while n:
+        if n & 1:
+            R = curve_add(R, P, a, q)
+        P, n = curve_add(P, P, a, q), n >> 1
+    return R
+
+
+def curve_point(a, b, q, rng):
+    while True:
+        x = rng.randrange(q)
+        rhs = (x * x * x + a * x + b) % q
+        if rhs and is_square(rhs, q):
+            return x, sqrt(rhs, q)
+
+
+def point_bytes(P, q):
+    # PBC's encoding of a point of a curve over Fq: x then y, big-endian, padded to the size of q
+    size = (q.bit_length() + 7) // 8
+    return P[0].to_bytes(size, "big") + P[1].to_bytes(size, "big")
+
+
+def fq2_mul(u, v, beta, q):
+    return (u[0] * v[0] + beta * u[1] * v[1]) % q, (u[0] * v[1] + u[1] * v[0]) % q
+
+
+def fq2_pow(u, n, beta, q):
+    result = (1, 0)
+    while n:
+        if n & 1:
+            result = fq2_mul(result, u, beta, q)
+        u, n = fq2_mul(u, u, beta, q), n >> 1
+    return result
+
+
+def type_f(rng):
+    # q = 36u^4 + 36u^3 + 24u^2 + 6u + 1 and r = q + 1 - t with t = 6u^2 + 1, both prime
+    while True:
+        u = rng.randrange(1 << 20, 1 << 21)
+        q = 36 * u ** 4 + 36 * u ** 3 + 24 * u ** 2 + 6 * u + 1
+        r = q - 6 * u ** 2
+        if is_prime(q) and is_prime(r):
+            break
+    # y^2 = x^3 + b has order r for one of the six twists, found by testing a point
+    b = 1
+    while True:
+        P = curve_point(0, b, q, rng)
+        if curve_mul(P, r, 0, q) is None:
+            break
+        b += 1
+    beta = non_residue(q)
+    # x^6 + alpha is irreducible over Fq2 = Fq(sqrt(beta)) when alpha is neither a square nor a cube;
+    # PBC builds the twist from alpha, and which of alpha and alpha^5 gives the twist of order
+    # divisible by r depends on its conventions, so both are returned
+    while True:
+        alpha = (rng.randrange(1, q), rng.randrange(1, q))
+        if fq2_pow(alpha, (q * q - 1) // 2, beta, q) != (1, 0) and fq2_pow(alpha, (q * q - 1) // 3, beta, q) != (1, 0):
+            break
+    candidates = []
+    for alpha in (alpha, fq2_pow(alpha, 5, beta, q)):
+        candidates.append(
+            "type f\n"
+            f"q {q}\n"
+            f"r {r}\n"
+            f"b {b}\n"
+            f"beta {beta}\n"
+            f"alpha0 {alpha[0]}\n"
+            f"alpha1 {alpha[1]}\n"
+        )
+    return candidates
+
+
+def poly_mod(u, f, q):
+    # the remainder of u by the monic f, lists of coefficients from the constant up
+    u = [c % q for c in u]
+    while len(u) >= len(f):
+        c = u[-1]
+        for i in range(len(f)):
+            u[len(u) - len(f) + i] -= c * f[i]
+        u = [c % q for c in u[:-1]]
+    while u and u[-1] == 0:
+        u.pop()
+    return u
+
+
+def poly_mul(u, v, q):
+    result = [0] * max(len(u) + len(v) - 1, 0)
+    for i, c in enumerate(u):
+        for j, d in enumerate(v):
+            result[i + j] += c * d
+    return [c % q for c in result]
+
+
+def cubic_has_no_root(coeffs, q):
+    # x^q modulo f = x^3 + coeffs[2] x^2 + coeffs[1] x + coeffs[0]
+    f = coeffs + [1]
+    power, base, n = [1], [0, 1], q
+    while n:
+        if n & 1:
+            power = poly_mod(poly_mul(power, base, q), f, q)
+        base, n = poly_mod(poly_mul(base, base, q), f, q), n >> 1
+    # the gcd of f with x^q - x
+    v = power + [0] * (2 - len(power))
+    v[1] -= 1
+    u, v = f, poly_mod(v, f, q)
+    while v:
+        inverse = pow(v[-1], -1, q)
+        u, v = v, poly_mod(u, [c * inverse % q for c in v], q)
+    return len(u) == 1
+
+
+def type_d(rng):
+    # MNT curves of embedding degree 6: q = 4l^2 + 1 and trace t = 1 +- 2l; n = q + 1 - t has
+    # a large prime factor r and a small cofactor h. A curve has n points when [n]P is the
+    # identity and [h]P is not, since r is then the order of [h]P, and r > 4 sqrt(q) leaves
+    # a single multiple of r in the Hasse interval
+    while True:
+        l = rng.randrange(300, 1000)
+        q = 4 * l * l + 1
+        if not is_prime(q):
+            continue
+        t = 1 + 2 * l * rng.choice((1, -1))
+        n = q + 1 - t
+        for h in range(2, 8):
+            if n % h == 0 and is_prime(n // h) and n // h > 4 * q ** 0.5:
+                break
+        else:
+            continue
+        r = n // h
+        for _ in range(20000):
+            a, b = rng.randrange(1, q), rng.randrange(1, q)
+            if (4 * a ** 3 + 27 * b ** 2) % q == 0:
+                continue
+            P = curve_point(a, b, q, rng)
+            if curve_mul(P, n, a, q) is None and curve_mul(P, h, a, q) is not None:
+                break
+        else:
+            continue
+        break
+    # the order of the curve over Fq^6, from the traces of the powers of Frobenius
+    traces = [2, t]
+    for _ in range(5):
+        traces.append(t * traces[-1] - q * traces[-2])
+    nk = q ** 6 + 1 - traces[6]
+    hk = nk // (r * r)
+    # a cubic is irreducible when it has no root in Fq, i.e. is coprime to x^q - x
+    while True:
+        coeffs = [rng.randrange(1, q) for _ in range(3)]
+        if cubic_has_no_root(coeffs, q):
+            break
+    params = (
+        "type d\n"
+        f"q {q}\n"
+        f"n {n}\n"
+        f"h {h}\n"
+        f"r {r}\n"
+        f"a {a}\n"
+        f"b {b}\n"
+        "k 6\n"
+        f"nk {nk}\n"
+        f"hk {hk}\n"
+        f"coeff0 {coeffs[0]}\n"
+        f"coeff1 {coeffs[1]}\n"
+        f"coeff2 {coeffs[2]}\n"
+        f"nqr {non_residue(q)}\n"
+    )
+    # a point of G1 outside the subgroup of order r
+    while True:
+        P = curve_point(a, b, q, rng)
+        if curve_mul(P, r, a, q) is not None:
+            break
+    return params, point_bytes(P, q)
+
+
+def outside_type_a(rng):
+    # a point of y^2 = x^3 + x outside the subgroup of order r
+    q, r = (int(line.split()[1]) for line in TYPE_A.splitlines()[1:4:2])
+    while True:
+        P = curve_point(1, 0, q, rng)
+        if curve_mul(P, r, 1, q) is not None:
+            return point_bytes(P, q)
+
+
+def bilinear(pairing):
+    # whether the pairing is bilinear and non-degenerate, and G2 of order r
+    g1, g2 = Element.random(pairing, G1), Element.random(pairing, G2)
+    x = Element.random(pairing, Zr)
+    e = pairing.apply(g1, g2)
+    return (
+        not e.is1()
+        and pairing.apply(g1 ** x, g2) == e ** x
+        and pairing.apply(g1, g2 ** x) == e ** x
+        and g2 ** (pairing.order() - 1) == -g2
+    )
+
+
+def pairings(seed=1):
+    # the pairings of types A, D and F, with a point of G1 outside the subgroup for A and D
+    rng = random.Random(seed)
+    result = {"a": (Pairing(Parameters(TYPE_A)), outside_type_a(rng))}
+    params, outside = type_d(rng)
+    result["d"] = (Pairing(Parameters(params)), outside)
+    for params in type_f(rng):
+        pairing = Pairing(Parameters(params))
+        if bilinear(pairing):
+            result["f"] = (pairing, None)
+            break
+    else:
+        raise RuntimeError("no twist of the type F parameters gives a pairing")
+    return result
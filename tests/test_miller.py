@@ -0,0 +1,89 @@
+#! /usr/bin/env python3
+
+# Miller values of type A pairings, raised to the final exponent, must give the products of
+# Pairing.apply, also once multiplied together or serialized.
+# Run with: python3 -m unittest discover tests
+
+import unittest
+
+from pypbc import *
+
+import params
+
+
+def setUpModule():
+    global PAIRINGS
+    PAIRINGS = params.pairings()
+
+
+class TestMiller(unittest.TestCase):
+    def setUp(self):
+        self.pairing, self.outside = PAIRINGS["a"]
+
+    def product(self, lefts, rights):
+        result = Element.one(self.pairing, GT)
+        for g1, g2 in zip(lefts, rights):
+            result *= self.pairing.apply(g1, g2)
+        return result
+
+    def test_single(self):
+        pairing = self.pairing
+        for _ in range(5):
+            g1, g2 = Element.random(pairing, G1), Element.random(pairing, G2)
+            value = pairing.miller_loop([g1], [g2])
+            self.assertEqual(pairing.final_exponentiation(value), pairing.apply(g1, g2))
+
+    def test_product(self):
+        pairing = self.pairing
+        lefts = [Element.random(pairing, G1) for _ in range(6)] + [Element.zero(pairing, G1)]
+        rights = [Element.random(pairing, G2) for _ in range(5)] + [Element.zero(pairing, G2)] * 2
+        expected = self.product(lefts, rights)
+        self.assertEqual(pairing.final_exponentiation(pairing.miller_loop(lefts, rights)), expected)
+        self.assertEqual(pairing.apply_product(lefts, rights), expected)
+        # shards multiplied before a single final exponentiation
+        shards = [pairing.miller_loop(lefts[i:i + 3], rights[i:i + 3]) for i in range(0, len(lefts), 3)]
+        value = shards[0]
+        for shard in shards[1:]:
+            value = value * shard
+        self.assertEqual(pairing.final_exponentiation(value), expected)
+        # prepared right sides
+        prepared = [pairing.prepare(g2) for g2 in rights]
+        self.assertEqual(pairing.final_exponentiation(pairing.miller_loop(lefts, prepared)), expected)
+        self.assertTrue(pairing.final_exponentiation(pairing.miller_loop([], [])).is1())
+
+    def test_serialization(self):
+        pairing = self.pairing
+        g1, g2 = Element.random(pairing, G1), Element.random(pairing, G2)
+        value = pairing.miller_loop([g1], [g2])
+        data = value.to_bytes()
+        decoded = MillerValue.from_bytes(pairing, data)
+        self.assertEqual(decoded, value)
+        self.assertEqual(decoded.to_bytes(), data)
+        self.assertEqual(pairing.final_exponentiation(decoded), pairing.apply(g1, g2))
+        with self.assertRaises(ValueError):
+            MillerValue.from_bytes(pairing, data[:-1])
+        with self.assertRaises(ValueError):
+            MillerValue.from_bytes(pairing, bytes(len(data)))
+
+    def test_outside_subgroup(self):
+        # PBC's loop does not reach r on points of G1 outside the subgroup, and neither does this one
+        pairing = self.pairing
+        point = Element.from_bytes(pairing, G1, self.outside)
+        with self.assertRaises(ValueError):
+            Element.from_bytes(pairing, G1, self.outside, validate=True)
+        g1, g2 = Element.random(pairing, G1), Element.random(pairing, G2)
+        value = pairing.miller_loop([point], [g2])
+        self.assertEqual(pairing.final_exponentiation(value), pairing.apply(point, g2))
+        expected = pairing.apply(point, g2) * pairing.apply(g1, g2)
+        self.assertEqual(pairing.final_exponentiation(pairing.miller_loop([point, g1], [g2, g2])), expected)
+        self.assertEqual(pairing.apply_product([point, g1], [g2, g2]), expected)
+
+    def test_unsupported(self):
+        for name in ("d", "f"):
+            pairing, _ = PAIRINGS[name]
+            with self.subTest(type=name), self.assertRaises(NotImplementedError):
+                pairing.miller_loop([Element.random(pairing, G1)], [Element.random(pairing, G2)])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,83 @@
+#! /usr/bin/env python3
+
+# PreparedG2 pairs with the ate loop on type D and F pairings and through PBC otherwise; either
+# way it must give the same values as Pairing.apply.
+# Run with: python3 -m unittest discover tests
+
+import unittest
+
+from pypbc import *
+
+import params
+
+
+def setUpModule():
+    global PAIRINGS
+    PAIRINGS = params.pairings()
+
+
+class TestPrepared(unittest.TestCase):
+    def test_apply(self):
+        for name, (pairing, _) in PAIRINGS.items():
+            with self.subTest(type=name):
+                for _ in range(3):
+                    g2 = Element.random(pairing, G2)
+                    prepared = pairing.prepare(g2)
+                    self.assertEqual(prepared.element, g2)
+                    for _ in range(4):
+                        g1 = Element.random(pairing, G1)
+                        self.assertEqual(prepared.apply(g1), pairing.apply(g1, g2))
+
+    def test_bilinear(self):
+        for name, (pairing, _) in PAIRINGS.items():
+            with self.subTest(type=name):
+                g1, g2 = Element.random(pairing, G1), Element.random(pairing, G2)
+                x, y = Element.random(pairing, Zr), Element.random(pairing, Zr)
+                expected = pairing.apply(g1, g2) ** (x * y)
+                self.assertEqual(pairing.prepare(g2 ** y).apply(g1 ** x), expected)
+                self.assertFalse(pairing.prepare(g2).apply(g1).is1())
+
+    def test_identities(self):
+        for name, (pairing, _) in PAIRINGS.items():
+            with self.subTest(type=name):
+                g1, g2 = Element.random(pairing, G1), Element.random(pairing, G2)
+                self.assertTrue(pairing.prepare(g2).apply(Element.zero(pairing, G1)).is1())
+                self.assertTrue(pairing.prepare(Element.zero(pairing, G2)).apply(g1).is1())
+
+    def test_apply_product(self):
+        for name, (pairing, _) in PAIRINGS.items():
+            with self.subTest(type=name):
+                lefts = [Element.random(pairing, G1) for _ in range(5)] + [Element.zero(pairing, G1)]
+                rights = [Element.random(pairing, G2) for _ in range(4)] + [Element.zero(pairing, G2)] * 2
+                expected = Element.one(pairing, GT)
+                for g1, g2 in zip(lefts, rights):
+                    expected *= pairing.apply(g1, g2)
+                # every pair prepared, none, and every other one
+                for mask in ((1,) * 6, (0,) * 6, (1, 0) * 3):
+                    mixed = [pairing.prepare(g2) if m else g2 for g2, m in zip(rights, mask)]
+                    self.assertEqual(pairing.apply_product(lefts, mixed), expected)
+                # a prepared element paired several times in one product
+                prepared = pairing.prepare(rights[0])
+                self.assertEqual(
+                    pairing.apply_product(lefts[:3], [prepared] * 3),
+                    pairing.apply(lefts[0] * lefts[1] * lefts[2], rights[0]),
+                )
+                self.assertTrue(pairing.apply_product([], []).is1())
+
+    def test_outside_subgroup(self):
+        # a point of G1 whose order is not r is paired by PBC, as without preparation
+        pairing, outside = PAIRINGS["d"]
+        point = Element.from_bytes(pairing, G1, outside)
+        with self.assertRaises(ValueError):
+            Element.from_bytes(pairing, G1, outside, validate=True)
+        g1, g2 = Element.random(pairing, G1), Element.random(pairing, G2)
+        prepared = pairing.prepare(g2)
+        self.assertEqual(prepared.apply(point), pairing.apply(point, g2))
+        self.assertEqual(
+            pairing.apply_product([point, g1], [prepared, prepared]),
+            pairing.apply(point, g2) * pairing.apply(g1, g2),
+        )
+
+
+if __name__ == "__main__":
+    unittest.main()